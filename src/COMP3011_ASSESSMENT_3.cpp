@@ -1,5 +1,8 @@
 /* ---- Standard Library ---- */
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
 
 /* ---- OpenGL Headers ---- */
 #define GLFW_INCLUDE_NONE // Allows for opengl includes in any order
@@ -20,6 +23,8 @@
 #endif
 
 /* ---- Header Files ---- */
+#include "headers/gl_state.h"
+#include "headers/memory.h"
 #include "headers/window.h"
 #include "headers/shader.h"
 #include "headers/texture.h"
@@ -27,15 +32,57 @@
 #include "headers/ModelViewerCamera.h"
 #include "headers/FlyThroughCamera.h"
 #include "headers/parser.h"
+#include "headers/mesh.h"
+#include "headers/culling.h"
+#include "headers/occlusion.h"
+#include "headers/bvh.h"
+#include "headers/collision.h"
+#include "headers/render_queue.h"
+#include "headers/stream_buffer.h"
+#include "headers/transform.h"
+#include "headers/animation.h"
+#include "headers/jobs.h"
+#include "headers/simulation.h"
+#include "headers/timing.h"
+#include "headers/headless.h"
+#include "headers/dynamic_resolution.h"
+#include "headers/antialiasing.h"
+#include "headers/software_renderer.h"
+#include "headers/profiler.h"
+#include "headers/input_log.h"
+#include "headers/metrics.h"
+#include "headers/scene.h"
+#include "headers/streaming.h"
+#include "headers/impostor.h"
 
 /* ---- Function Prototypes ---- */
 void processKeyboard(GLFWwindow *window);
 void processMouse(GLFWwindow *window, double x, double y);
+SBvhHit pickCursor(GLFWwindow *window, double x, double y);
+SInputState sampleInput(GLFWwindow *window);
+void simulateTick(const SInputState &input, float dt);
+SViewState captureViewState();
+void captureFrameInput(SFrameInput &input, const SViewState &view_state, float dt);
+const char *argumentValue(int argc, char *argv[], const char *name);
+std::pair<float *, unsigned int> loadSceneMesh(const char *filename, SBounds *bounds);
+void releaseSceneMesh(float *vertices);
+EVertexFormat sceneVertexFormat(const float *vertices, unsigned int vertex_count);
+GLuint loadSceneTexture(SSoftRenderer *software, const char *filename, bool mipmaps);
+void updatePickScene(const SSimulation &simulation, const SFrameState &frame);
+void updateCollisionScene(const SSimulation &simulation);
+bool setupViews(const char *layout);
+void updateFramebufferSize(GLFWwindow *window);
+void beginFrameView(void *data, int view);
+void registerMetrics();
 
 /* ---- Definitions ---- */
 #define PIXEL_W 1280
 #define PIXEL_H 720
 
+// The per frame speeds of the camera and tree controls were tuned at this frame rate,
+// the fixed timestep scales them so each second of input moves the same distance
+#define SIM_REFERENCE_HZ 60.f
+
 /* ---- Global Vars and Constants ---- */
 // Declare Light Variables
 // Set the light direction vars
@@ -55,41 +102,227 @@ float cam_dist = 0.f;
 
 float y_rotation_angle = 0.0f;
 
+// Cursor movement since the last tick, the tick applies it so that recorded runs replay exactly
+float pending_mouse_dx = 0.f;
+float pending_mouse_dy = 0.f;
+
+// Split screen and picture-in-picture draw the active camera into the first viewport and the other
+// camera into the second, viewports are (x, y, width, height) fractions of the framebuffer
+unsigned int view_count = 1;
+glm::vec4 view_viewports[MAX_FRAME_VIEWS] = { glm::vec4(0.f, 0.f, 1.f, 1.f), glm::vec4(0.f, 0.f, 1.f, 1.f) };
+
+// Size of the framebuffer the frame is presented in, the projections follow its aspect ratio
+int framebuffer_width = PIXEL_W;
+int framebuffer_height = PIXEL_H;
+
+// What the per view callback of the render queue needs to set up a view
+struct SFrameViewTarget
+{
+    const SFrameState *frame;
+    int framebuffer_width;
+    int framebuffer_height;
+    int cam_pos_loc;
+    int v_loc;
+    int p_loc;
+    unsigned int program;
+    const SImpostorSystem *impostors;
+};
+
+// Ray picking against the objects as they were drawn in the current frame, in the first view.
+// picked is what is under the cursor, published with the frame metrics.
+SSceneBvh scene_bvh;
+glm::mat4 pick_view_projection = glm::mat4(1.f);
+glm::vec4 pick_viewport = glm::vec4(0.f, 0.f, 1.f, 1.f);
+SBvhHit picked = { -1, -1, 0.f, 0.f, 0.f };
+
+// Meshes are uploaded in the smallest vertex format that fits them unless --full-vertices is given
+bool full_vertices = false;
+
+// GL textures of the scene, deleted together at shutdown
+std::vector<GLuint> scene_textures;
+
+// Ids of the metrics fed by the render loop and the loaders, exported with --metrics
+struct SRenderMetrics
+{
+    int frames;
+    int draws;
+    int draw_calls;
+    int frame_ms;
+    int submit_ms;
+    int wait_ms;
+    int frame_time;
+    int render_scale;
+    int host_memory;
+    int gpu_memory;
+    int meshes_loaded;
+    int textures_loaded;
+    int asset_bytes;
+    int streamed_memory;
+    int chunks_resident;
+    int impostors;
+    int picked_object;
+    int picked_triangle;
+    int picked_distance;
+};
+SRenderMetrics render_metrics;
+
+// Solid scene geometry the fly through camera collides with, and the object each instance belongs to
+SCollisionWorld collision_world;
+std::vector<int> collision_objects;
+bool collision_enabled = true;
+
 /* Main Function */
 int main(int argc, char *argv[])
 {
-    // Create pairs from the parsed OBJ data
-    std::pair<float *, unsigned int> pair_island   = parse_OBJ("models/island.obj");
-    std::pair<float *, unsigned int> pair_stadium  = parse_OBJ("models/stadium.obj");
-    std::pair<float *, unsigned int> pair_podium   = parse_OBJ("models/podium.obj");
-    std::pair<float *, unsigned int> pair_statue_1 = parse_OBJ("models/metalgreymon.obj");
-    std::pair<float *, unsigned int> pair_statue_2 = parse_OBJ("models/weregarurumon.obj");
-    std::pair<float *, unsigned int> pair_agumon   = parse_OBJ("models/agumon.obj");
-    std::pair<float *, unsigned int> pair_gabumon  = parse_OBJ("models/gabumon.obj");
-    std::pair<float *, unsigned int> pair_tree     = parse_OBJ("models/tree.obj");
-
-    // Declare Vertex Arrays
-    float *vertices_island   = pair_island.first;
-    float *vertices_stadium  = pair_stadium.first;
-    float *vertices_podium   = pair_podium.first;
-    float *vertices_statue_1 = pair_statue_1.first;
-    float *vertices_statue_2 = pair_statue_2.first;
-    float *vertices_agumon   = pair_agumon.first;
-    float *vertices_gabumon  = pair_gabumon.first;
-    float *vertices_tree     = pair_tree.first;
-
-    // Create GLFW Window
-    GLFWwindow *window = Create_Window(PIXEL_W, PIXEL_H, "Computer Graphics Assessment 3");
-
-    // Setup Mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-    glfwSetCursorPosCallback(window, processMouse);
-
-    // Initialize GLAD Loader to Configure OpenGL
-    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    // Benchmark modes run without a window and exit
+    if (argumentValue(argc, argv, "--bench-transforms") != NULL)
+        return BenchmarkTransforms(100000);
+    if (argumentValue(argc, argv, "--bench-animation") != NULL)
+        return BenchmarkAnimation(100000);
+    const char *bench_bvh = argumentValue(argc, argv, "--bench-bvh");
+    if (bench_bvh != NULL)
+        return BenchmarkBvh(bench_bvh[0] != '\0' ? atoi(bench_bvh) : 1000000);
+    const char *bench_collision = argumentValue(argc, argv, "--bench-collision");
+    if (bench_collision != NULL)
+        return BenchmarkCollision(bench_collision[0] != '\0' ? atoi(bench_collision) : 1000000);
+    const char *bench_occlusion = argumentValue(argc, argv, "--bench-occlusion");
+    if (bench_occlusion != NULL)
+        return BenchmarkOcclusion(bench_occlusion[0] != '\0' ? atoi(bench_occlusion) : 100000);
+    const char *bench_parser = argumentValue(argc, argv, "--bench-parser");
+    if (bench_parser != NULL)
+        return benchmark_OBJ(bench_parser[0] != '\0' ? (unsigned int) atoi(bench_parser) : 4000000);
+    // The scene to draw, a text scene or one compiled with --compile-scene, which writes it out and exits
+    const char *scene_path = argumentValue(argc, argv, "--scene");
+    if (scene_path == NULL || scene_path[0] == '\0')
+        scene_path = "scenes/island.scene";
+    const char *compile_scene = argumentValue(argc, argv, "--compile-scene");
+    if (compile_scene != NULL)
+        return CompileScene(scene_path, compile_scene[0] != '\0' ? compile_scene : "scene.sceneb");
+    // Prints the metrics a running renderer publishes, once a second until it exits
+    const char *metrics_reader = argumentValue(argc, argv, "--metrics-reader");
+    if (metrics_reader != NULL)
+        return ReadMetricsSegment(metrics_reader[0] != '\0' ? metrics_reader : METRICS_SEGMENT_NAME, 1000, 0);
+
+    // Counters, gauges and histograms of the run are published into shared memory for monitoring
+    // without a debugger, registered up front so that the loading progress is visible too
+    InitMetrics(metrics);
+    registerMetrics();
+    const char *metrics_segment = argumentValue(argc, argv, "--metrics");
+    if (metrics_segment != NULL && !OpenMetricsSegment(metrics, metrics_segment[0] != '\0' ? metrics_segment : METRICS_SEGMENT_NAME))
+        return -1;
+
+    // The profiler records CPU scopes from every thread and GPU timer queries of the draws,
+    // written out as a Chrome trace when the program ends
+    const char *profile_path = argumentValue(argc, argv, "--profile");
+    SProfiler profiler;
+    if (profile_path != NULL)
+        InitProfiler(profiler);
+
+    // Headless mode renders a fixed number of frames into an FBO through a surfaceless EGL context,
+    // so the scene runs on machines without a display or GPU (Mesa llvmpipe)
+    const char *headless_frames = argumentValue(argc, argv, "--headless");
+    // Software mode runs like headless mode but rasterizes on the CPU and creates no GL context at all
+    const char *software_frames = argumentValue(argc, argv, "--software");
+    bool software = software_frames != NULL;
+    if (software)
+        headless_frames = software_frames;
+    bool headless = headless_frames != NULL;
+    unsigned int headless_frame_count = headless && headless_frames[0] != '\0' ? (unsigned int) atoi(headless_frames) : 300;
+    const char *dump_directory = argumentValue(argc, argv, "--dump-frames");
+    const char *timings_path = argumentValue(argc, argv, "--timings");
+
+    // Input of every simulation tick can be recorded to a log and replayed later for repeatable benchmarks
+    const char *record_path = argumentValue(argc, argv, "--record");
+    const char *replay_path = argumentValue(argc, argv, "--replay");
+    bool recording = record_path != NULL && record_path[0] != '\0';
+    bool replaying = replay_path != NULL && replay_path[0] != '\0';
+
+    SInputLog input_log;
+    InitInputLog(input_log, SIM_HZ);
+    if (replaying && !LoadInputLog(input_log, replay_path, SIM_HZ))
+        return -1;
+
+    // The meshes, textures, instances and lights come from the scene file
+    SScene scene;
+    if (!LoadScene(scene, scene_path))
+        return -1;
+
+    // Chunks stream in around the active camera. The software renderer and --no-streaming load the whole scene up front.
+    bool streaming = scene.chunk_size > 0.f && !software && argumentValue(argc, argv, "--no-streaming") == NULL;
+    if (!streaming)
+        KeepSceneResident(scene);
+
+    lightPos = scene.lights[0].position;
+    lightDirection = scene.lights[0].direction;
+    lightPos_scene = scene.lights[1].position;
+    lightDirection_scene = scene.lights[1].direction;
+
+    // Assets of the global instances are loaded now, the others with the chunks that use them
+    std::vector<bool> mesh_resident(scene.meshes.size(), false), texture_resident(scene.textures.size(), false);
+    for (size_t i = 0; i < scene.instances.size(); i++)
+    {
+        if (scene.instances[i].chunk < 0)
+            mesh_resident[scene.instances[i].mesh] = texture_resident[scene.instances[i].texture] = true;
+    }
+
+    // Create pairs from the parsed OBJ data, with the bounding volumes of each mesh. Main owns the arrays until
+    // the registry, the picking and collision structures and the occluder proxies have been built from them.
+    std::vector<std::pair<float *, unsigned int> > mesh_sources(scene.meshes.size(), std::make_pair((float *) NULL, 0u));
+    std::vector<SBounds> mesh_bounds(scene.meshes.size());
+    uint64_t profile_start = BeginProfileEvent();
+    for (size_t m = 0; m < scene.meshes.size(); m++)
+        if (mesh_resident[m])
+            mesh_sources[m] = loadSceneMesh(scene.meshes[m].path, &mesh_bounds[m]);
+    EndProfileEvent("parse models", profile_start);
+
+    GLFWwindow *window = NULL;
+    SHeadlessContext headless_context;
+    SSoftRenderer software_renderer;
+
+    profile_start = BeginProfileEvent();
+
+    if (software)
+    {
+        // Nothing to create, the renderer draws into memory
+        InitSoftwareRenderer(software_renderer, PIXEL_W, PIXEL_H);
+    }
+    else if (headless)
+    {
+        if (!CreateHeadlessContext(headless_context))
+            return -1;
+
+        // Initialize GLAD Loader to Configure OpenGL
+        gladLoadGLLoader((GLADloadproc)eglGetProcAddress);
+
+        if (!CreateHeadlessFramebuffer(headless_context, PIXEL_W, PIXEL_H))
+            return -1;
+    }
+    else
+    {
+        // Create GLFW Window
+        window = Create_Window(PIXEL_W, PIXEL_H, "Computer Graphics Assessment 3");
+
+        // Setup Mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+        glfwSetCursorPosCallback(window, processMouse);
+
+        // Initialize GLAD Loader to Configure OpenGL
+        gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+
+        updateFramebufferSize(window);
+    }
+    EndProfileEvent("create context", profile_start);
+
+    // All state changes go through the tracker from here on, it starts out knowing nothing
+    InitGLState(gl_state);
+
+    if (profile_path != NULL && !software)
+        InitGpuProfiler(profiler);
 
     // Load GLSL Vertex and Fragment Shaders
-    unsigned int shaderProgram = LoadShader("shaders/vertex.vert", "shaders/fragment.frag");
+    profile_start = BeginProfileEvent();
+    unsigned int shaderProgram = software ? 0 : LoadShader("shaders/vertex.vert", "shaders/fragment.frag");
+    EndProfileEvent("load shaders", profile_start);
 
     // Initialize Fly Through Camera
     InitCamera(Camera_FT, 45, -15);
@@ -103,306 +336,858 @@ int main(int argc, char *argv[])
     MoveAndOrientCamera(Camera_MV, glm::vec3(0, 0, 0), cam_dist, cam_x_offset, cam_y_offset);
 
     // Setup All Textures - Some textures have Mipmaps applied
-    GLuint texture_island   = setup_mipmaps("textures/island.bmp");
-    GLuint texture_stadium  = setup_texture("textures/stadium.bmp");
-    GLuint texture_podium   = setup_texture("textures/podium.bmp");
-    GLuint texture_statue_1 = setup_mipmaps("textures/metalgreymon.bmp");
-    GLuint texture_statue_2 = setup_mipmaps("textures/weregarurumon.bmp");
-    GLuint texture_agumon   = setup_texture("textures/agumon.bmp");
-    GLuint texture_gabumon  = setup_texture("textures/gabumon.bmp");
-    GLuint texture_tree     = setup_texture("textures/tree.bmp");
-
-    // Create reference container for the VAO/VBO and Generate with 8 objects
-    unsigned int VAO[8];
-    glGenVertexArrays(8, VAO);
-    unsigned int VBO[8];
-    glGenBuffers(8, VBO);
-
-    /* Object 0 - Island */
-    // Bind the VAO to make it the current Vertex Array Object
-    glBindVertexArray(VAO[0]);
-    // Bind the VBO specifying it is a GL_ARRAY_BUFFER Vertex Buffer Object
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[0]);
-    // Copy the specified vertices into the VBO
-    glBufferData(GL_ARRAY_BUFFER, (long) sizeof(float) * pair_island.second * 8, vertices_island, GL_STATIC_DRAW);
-    // Set the Vertex Attribute Pointers so that OpenGL knows how to read the VBO
-    // Enable the Vertex Attribute so that OpenGL knows to use it
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(0);  // v position
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (3 * sizeof(float)));
-    glEnableVertexAttribArray(1);  // v texture
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (5 * sizeof(float)));
-    glEnableVertexAttribArray(2);  // v normal
-
-    /* Object 1 - Stadium */
-    glBindVertexArray(VAO[1]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[1]);
-    glBufferData(GL_ARRAY_BUFFER, (long) sizeof(float) * pair_stadium.second * 8, vertices_stadium, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(0);  // v position
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (3 * sizeof(float)));
-    glEnableVertexAttribArray(1);  // v texture
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (5 * sizeof(float)));
-    glEnableVertexAttribArray(2);  // v normal
-
-    /* Object 2 - Podium */
-    glBindVertexArray(VAO[2]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[2]);
-    glBufferData(GL_ARRAY_BUFFER, (long) sizeof(float) * pair_podium.second * 8, vertices_podium, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(0);  // v position
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (3 * sizeof(float)));
-    glEnableVertexAttribArray(1);  // v texture
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (5 * sizeof(float)));
-    glEnableVertexAttribArray(2);  // v normal
-
-    /* Object 3 - Statue 1 - MetalGreymon */
-    glBindVertexArray(VAO[3]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[3]);
-    glBufferData(GL_ARRAY_BUFFER, (long) sizeof(float) * pair_statue_1.second * 8, vertices_statue_1, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(0);  // v position
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (3 * sizeof(float)));
-    glEnableVertexAttribArray(1);  // v texture
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (5 * sizeof(float)));
-    glEnableVertexAttribArray(2);  // v normal
-
-    /* Object 4 - Statue 2 - WereGarurumon */
-    glBindVertexArray(VAO[4]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[4]);
-    glBufferData(GL_ARRAY_BUFFER, (long) sizeof(float) * pair_statue_2.second * 8, vertices_statue_2, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(0);  // v position
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (3 * sizeof(float)));
-    glEnableVertexAttribArray(1);  // v texture
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (5 * sizeof(float)));
-    glEnableVertexAttribArray(2);  // v normal
-
-    /* Object 5 - Agumon */
-    glBindVertexArray(VAO[5]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[5]);
-    glBufferData(GL_ARRAY_BUFFER, (long) sizeof(float) * pair_agumon.second * 8, vertices_agumon, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(0);  // v position
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (3 * sizeof(float)));
-    glEnableVertexAttribArray(1);  // v texture
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (5 * sizeof(float)));
-    glEnableVertexAttribArray(2);  // v normal
-
-    /* Object 6 - Gabumon */
-    glBindVertexArray(VAO[6]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[6]);
-    glBufferData(GL_ARRAY_BUFFER, (long) sizeof(float) * pair_gabumon.second * 8, vertices_gabumon, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(0);  // v position
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (3 * sizeof(float)));
-    glEnableVertexAttribArray(1);  // v texture
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (5 * sizeof(float)));
-    glEnableVertexAttribArray(2);  // v normal
-
-    /* Object 7 - Tree */
-    glBindVertexArray(VAO[7]);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO[7]);
-    glBufferData(GL_ARRAY_BUFFER, (long) sizeof(float) * pair_tree.second * 8, vertices_tree, GL_STATIC_DRAW);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) 0);
-    glEnableVertexAttribArray(0);  // v position
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (3 * sizeof(float)));
-    glEnableVertexAttribArray(1);  // v texture
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void *) (5 * sizeof(float)));
-    glEnableVertexAttribArray(2);  // v normal
-
-    // Bind both the VBO and VAO to 0
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    profile_start = BeginProfileEvent();
+    SSoftRenderer *texture_target = software ? &software_renderer : NULL;
+    std::vector<GLuint> textures(scene.textures.size(), 0);
+    for (size_t t = 0; t < scene.textures.size(); t++)
+        if (texture_resident[t])
+            textures[t] = loadSceneTexture(texture_target, scene.textures[t].path, scene.textures[t].mipmaps);
+    EndProfileEvent("load textures", profile_start);
+
+    // The job system runs the per frame simulation, the calling thread is worker 0
+    SJobSystem jobs;
+    InitJobSystem(jobs, (int) std::max(1u, std::min(8u, std::thread::hardware_concurrency())));
+    software_renderer.jobs = &jobs;
+
+    // Suballocate all meshes into one vertex buffer per format and a shared index buffer
+    full_vertices = argumentValue(argc, argv, "--full-vertices") != NULL;
+    profile_start = BeginProfileEvent();
+    SMeshRegistry mesh_registry;
+    InitMeshRegistry(mesh_registry);
+
+    // Streamed meshes keep an empty slot, so a mesh's id is its place in the scene either way
+    std::vector<int> solid_meshes;
+    for (size_t m = 0; m < scene.meshes.size(); m++)
+    {
+        if (mesh_resident[m])
+            RegisterMesh(mesh_registry, mesh_sources[m].first, mesh_sources[m].second, mesh_bounds[m],
+                         sceneVertexFormat(mesh_sources[m].first, mesh_sources[m].second));
+        else
+            ReserveMesh(mesh_registry);
+        if (scene.meshes[m].solid)
+            solid_meshes.push_back((int) m);
+    }
 
-    // Enable Depth Testing
-    glEnable(GL_DEPTH_TEST);
+    // Every impostor is drawn with the same quad. The software renderer draws the full meshes.
+    bool use_impostors = !software && argumentValue(argc, argv, "--no-impostors") == NULL;
+    int impostor_quad = use_impostors ? RegisterImpostorQuad(mesh_registry, full_vertices ? VERTEX_FORMAT_FULL : VERTEX_FORMAT_COMPACT) : -1;
+
+    // Triangle hierarchies for mouse picking are built from the CPU copy before the upload frees it
+    BuildSceneBvh(scene_bvh, mesh_registry, jobs);
+
+    // So are the collision grids of the meshes the scene marks as solid
+    BuildCollisionWorld(collision_world, mesh_registry, solid_meshes.data(), (int) solid_meshes.size(), jobs);
+
+    // The software renderer reads the CPU copy, which the upload would free
+    if (!software)
+        UploadMeshRegistry(mesh_registry);
+    EndProfileEvent("upload meshes", profile_start);
+
+    // Occluder meshes hide large parts of the scene, so their low poly proxies are rasterized into
+    // a software depth buffer that the other draws are tested against. Only meshes loaded up front occlude.
+    // Occluder tiles are rasterized by the job workers rather than threads of their own.
+    // --validate-occlusion also rasterizes the full meshes now and then to measure the proxies' accuracy.
+    SOcclusionSystem occlusion;
+    InitOcclusionSystem(occlusion, 1);
+    occlusion.jobs = &jobs;
+    occlusion.validate = argumentValue(argc, argv, "--validate-occlusion") != NULL;
+    profile_start = BeginProfileEvent();
+    for (size_t m = 0; m < scene.meshes.size(); m++)
+        if (mesh_sources[m].first != NULL && scene.meshes[m].occluder)
+            mesh_registry.meshes[m].occluder = AddOccluderProxy(occlusion, mesh_sources[m].first, mesh_sources[m].second, OCC_PROXY_COVERAGE);
+    EndProfileEvent("occluder proxies", profile_start);
+
+    // The occlusion system owns the sources of its proxies now, nothing reads the others again
+    for (size_t m = 0; m < scene.meshes.size(); m++)
+        if (mesh_sources[m].first != NULL && !scene.meshes[m].occluder)
+            releaseSceneMesh(mesh_sources[m].first);
+
+    // Instances of the meshes the scene marks as impostor are drawn as quads past --impostor-distance metres,
+    // their views are captured from the uploaded meshes or loaded from --impostor-cache.
+    // Only meshes and textures loaded up front get an impostor.
+    SImpostorSystem impostors;
+    std::vector<int> instance_impostors(scene.instances.size(), -1);
+    if (use_impostors)
+    {
+        profile_start = BeginProfileEvent();
+        const char *impostor_distance = argumentValue(argc, argv, "--impostor-distance");
+        const char *impostor_cache = argumentValue(argc, argv, "--impostor-cache");
+        if (!InitImpostorSystem(impostors, impostor_quad, impostor_distance != NULL && impostor_distance[0] != '\0' ? (float) atof(impostor_distance) : 25.f,
+                                impostor_cache != NULL && impostor_cache[0] != '\0' ? impostor_cache : "impostors"))
+            return -1;
+
+        for (size_t i = 0; i < scene.instances.size(); i++)
+        {
+            const SSceneInstance &instance = scene.instances[i];
+            if (!scene.meshes[instance.mesh].impostor || !mesh_resident[instance.mesh] || !texture_resident[instance.texture])
+                continue;
+
+            char name[2 * SCENE_NAME_LENGTH + 1];
+            snprintf(name, sizeof(name), "%s_%s", scene.meshes[instance.mesh].name, scene.textures[instance.texture].name);
+            instance_impostors[i] = AddImpostor(impostors, mesh_registry, instance.mesh, textures[instance.texture], name,
+                                                scene.meshes[instance.mesh].path, scene.textures[instance.texture].path);
+        }
+        EndProfileEvent("impostors", profile_start);
+    }
 
-    // Tell OpenGL which Shader Program to use
-    glUseProgram(shaderProgram);
+    // Setup the Scene Graph, every instance is a root node with translation, rotation (about y) and scale
+    glm::vec3 y_axis = glm::vec3(0.0f, 1.0f, 0.0f);
+    STransformSystem transforms;
+    InitTransformSystem(transforms, (int) scene.instances.size());
 
-    // Main Render Loop
-    while (!glfwWindowShouldClose(window))
+    // Setup the Animation Clips
+    SAnimationSystem animation;
+    InitAnimationSystem(animation);
+
+    // The draws with their texture, mesh and scene graph node, one per instance in the scene's order
+    std::vector<SSceneObject> scene_objects;
+    std::vector<int> input_nodes;
+    for (size_t i = 0; i < scene.instances.size(); i++)
     {
-        processKeyboard(window);
+        const SSceneInstance &instance = scene.instances[i];
+        int node = AddTransformNode(transforms, -1, instance.position, glm::angleAxis(glm::radians(instance.yaw), y_axis), glm::vec3(instance.scale));
+
+        // Spin, a quarter turn every 2*pi seconds (the old glfwGetTime() / 4 radians)
+        if (instance.flags & SCENE_INSTANCE_SPIN)
+        {
+            float spin_times[5];
+            glm::vec3 spin_positions[5], spin_scales[5];
+            glm::quat spin_rotations[5];
+            for (int k = 0; k < 5; k++)
+            {
+                spin_times[k] = (float) k * 6.2831853f;
+                spin_positions[k] = instance.position;
+                spin_rotations[k] = glm::angleAxis(glm::radians(instance.yaw + 90.f * (float) k), y_axis);
+                spin_scales[k] = glm::vec3(instance.scale);
+            }
+            int clip_spin = AddAnimationClip(animation, spin_times, spin_positions, spin_rotations, spin_scales, 5);
+            AddAnimationInstance(animation, clip_spin, node, 0.f, 1.f);
+        }
 
-        // Specify the background color
-        glClearColor(0.05f, 0.15f, 0.5f, 1.f);
+        // Turned with the arrow keys
+        if (instance.flags & SCENE_INSTANCE_INPUT)
+            input_nodes.push_back(node);
 
-        // Clear the back buffer and assign the new color to it
-        // Clear the depth buffer
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        SSceneObject object = { textures[instance.texture], instance.mesh, node, instance_impostors[i] };
+        scene_objects.push_back(object);
+    }
 
-        // Controls the interpolation of polygons for Rasterization
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    // Enable Depth Testing
+    if (!software)
+        SetCapability(gl_state, GL_CAP_DEPTH_TEST, true);
+
+    // Setup Frustum Culling against the bounds of each queued draw
+    SCullingSystem culling;
+    InitCullingSystem(culling);
+
+    // Setup the Frame Pipeline. The jobs simulate frame N+1 into one frame state (input, animation,
+    // transforms, draw commands, culling, sorting) while this thread submits frame N from the other.
+    bool pipelined = argumentValue(argc, argv, "--no-pipeline") == NULL;
+    collision_enabled = argumentValue(argc, argv, "--no-collision") == NULL;
+    // Both cameras at once, side by side or the second one inset into the first
+    const char *views_layout = argumentValue(argc, argv, "--views");
+    if (views_layout != NULL && !setupViews(views_layout))
+        return -1;
+    if (software && view_count > 1)
+    {
+        printf("INFO: Software renderer draws the first view only.\n");
+        view_count = 1;
+    }
+    // Renders at a scale that holds the GPU frame time at the target (ms) and upscales to the output
+    const char *dynamic_resolution_target = argumentValue(argc, argv, "--dynamic-resolution");
+    bool dynamic_resolution = dynamic_resolution_target != NULL && !software;
+    if (software && dynamic_resolution_target != NULL)
+        printf("INFO: Software renderer always renders at full resolution.\n");
+    // Anti-aliasing: off, msaa2, msaa4, msaa8 or fxaa. Windows default to 4x MSAA, headless runs to off
+    // so their frames stay comparable across drivers.
+    const char *aa_name = argumentValue(argc, argv, "--aa");
+    EAntiAliasingMode aa_mode = headless ? AA_OFF : AA_MSAA_4;
+    if (aa_name != NULL && !ParseAntiAliasingMode(aa_name, aa_mode))
+    {
+        printf("ERROR: Unknown anti-aliasing mode %s, expected off, msaa2, msaa4, msaa8 or fxaa\n", aa_name);
+        return -1;
+    }
+    // Per draw object data is streamed through a triple buffered ring instead of one glUniform call per draw.
+    // A region fits every instance of the scene drawn on its own, plus the runs of the impostors.
+    SStreamBuffer object_stream;
+    if (!software)
+    {
+        size_t impostor_instances = 0;
+        for (size_t i = 0; i < instance_impostors.size(); i++)
+            impostor_instances += instance_impostors[i] >= 0 ? 1 : 0;
 
-        // Transfer uniform values of Light 1 to the shaders
-        glUniform3f(glGetUniformLocation(shaderProgram, "light_1.lightDirection"), lightDirection.x, lightDirection.y, lightDirection.z);
-        glUniform3f(glGetUniformLocation(shaderProgram, "light_1.lightPos"), lightPos.x, lightPos.y, lightPos.z);
-        glUniform3f(glGetUniformLocation(shaderProgram, "light_1.lightColor"), 1.0f, 1.0f, 1.0f);
+        glUniformBlockBinding(shaderProgram, glGetUniformBlockIndex(shaderProgram, "ObjectData"), STREAM_OBJECT_BINDING);
+        InitStreamBuffer(object_stream, GL_UNIFORM_BUFFER,
+                         ObjectStreamRegionSize(scene.instances.size(), impostor_instances, use_impostors ? impostors.impostors.size() : 0));
+    }
+
+    SDynamicResolution drs;
+    if (dynamic_resolution)
+    {
+        float target_ms = dynamic_resolution_target[0] != '\0' ? (float) atof(dynamic_resolution_target) : 1000.f / 60.f;
+        if (!InitDynamicResolution(drs, framebuffer_width, framebuffer_height, target_ms))
+            return -1;
+    }
 
-        // Transfer uniform values of Light 2 to the shaders
-        glUniform3f(glGetUniformLocation(shaderProgram, "light_2.lightDirection"), lightDirection_scene.x, lightDirection_scene.y, lightDirection_scene.z);
-        glUniform3f(glGetUniformLocation(shaderProgram, "light_2.lightPos"), lightPos_scene.x, lightPos_scene.y, lightPos_scene.z);
-        glUniform3f(glGetUniformLocation(shaderProgram, "light_2.lightColor"), 1.0f, 1.0f, 1.0f);
+    SAntiAliasing aa;
+    if (!software && !InitAntiAliasing(aa, aa_mode, framebuffer_width, framebuffer_height))
+        return -1;
 
-        // Transfer uniform values of the camera position to the shaders, depending on the camera type
-        if (is_fly_through)
-            glUniform3f(glGetUniformLocation(shaderProgram, "camPos"), Camera_FT.Position.x, Camera_FT.Position.y, Camera_FT.Position.z);
+    // Uniform locations do not change after linking, so they are looked up once
+    int light_1_direction_loc = -1, light_1_position_loc = -1, light_1_color_loc = -1;
+    int light_2_direction_loc = -1, light_2_position_loc = -1, light_2_color_loc = -1;
+    int cam_pos_loc = -1, v_loc = -1, p_loc = -1;
+    if (!software)
+    {
+        light_1_direction_loc = glGetUniformLocation(shaderProgram, "light_1.lightDirection");
+        light_1_position_loc  = glGetUniformLocation(shaderProgram, "light_1.lightPos");
+        light_1_color_loc     = glGetUniformLocation(shaderProgram, "light_1.lightColor");
+        light_2_direction_loc = glGetUniformLocation(shaderProgram, "light_2.lightDirection");
+        light_2_position_loc  = glGetUniformLocation(shaderProgram, "light_2.lightPos");
+        light_2_color_loc     = glGetUniformLocation(shaderProgram, "light_2.lightColor");
+        cam_pos_loc           = glGetUniformLocation(shaderProgram, "camPos");
+        v_loc                 = glGetUniformLocation(shaderProgram, "view");
+        p_loc                 = glGetUniformLocation(shaderProgram, "projection");
+    }
+
+    SFrameState frames[2];
+    InitFrameState(frames[0]);
+    InitFrameState(frames[1]);
+
+    SSimulation simulation;
+    simulation.frame = &frames[0];
+    simulation.transforms = &transforms;
+    simulation.animation = &animation;
+    simulation.culling = &culling;
+    simulation.occlusion = &occlusion;
+    simulation.meshes = &mesh_registry;
+    simulation.program = shaderProgram;
+    simulation.impostors = use_impostors ? &impostors : NULL;
+    simulation.input_nodes = input_nodes;
+    simulation.objects = scene_objects;
+
+    // Every draw can be picked with the mouse, the object index is its place in the scene
+    for (size_t i = 0; i < simulation.objects.size(); i++)
+        AddSceneBvhInstance(scene_bvh, simulation.objects[i].mesh);
+
+    for (size_t i = 0; i < simulation.objects.size(); i++)
+        if (AddCollisionInstance(collision_world, simulation.objects[i].mesh) >= 0)
+            collision_objects.push_back((int) i);
+
+    // The chunks around the start position are loaded before the first frame, later ones while it runs
+    SSceneStreamer streamer;
+    if (streaming)
+    {
+        const char *stream_budget = argumentValue(argc, argv, "--stream-budget");
+        InitSceneStreamer(streamer, scene, mesh_registry, scene_bvh, collision_world, simulation.objects, collision_objects, textures,
+                          stream_budget != NULL && stream_budget[0] != '\0' ? (float) atof(stream_budget) : 256.f, full_vertices);
+        UpdateSceneStreaming(streamer, is_fly_through ? Camera_FT.Position : Camera_MV.Position, true);
+    }
+
+    // The fly through camera starts at the origin, inside the podium, so with collision it instead
+    // stands on whatever is highest above the ground there
+    if (collision_enabled)
+    {
+        UpdateTransforms(transforms);
+        updateCollisionScene(simulation);
+        ClampCameraToGround(Camera_FT, collision_world, 100.f);
+    }
+
+    SJobGraph frame_graph;
+    BuildSimulationGraph(frame_graph, simulation);
+
+    // Everything the scene keeps for its lifetime has been allocated by now
+    PrintMemoryReport(memory_tracker, "after loading");
+    SetGauge(metrics, render_metrics.host_memory, (double) memory_tracker.current[MEMORY_HOST] / (1024.0 * 1024.0));
+    SetGauge(metrics, render_metrics.gpu_memory, (double) memory_tracker.current[MEMORY_GPU] / (1024.0 * 1024.0));
+    PublishMetrics(metrics, true);
+
+    // Input, camera movement and animation advance in fixed SIM_HZ ticks, rendering runs at whatever
+    // rate the pacing mode allows and shows a blend of the last two ticks
+    SFixedTimestep timestep;
+    InitFixedTimestep(timestep, SIM_HZ);
+    SViewState previous_state = captureViewState();
+    SViewState current_state = previous_state;
+    double render_time = 0.0;
+
+    const char *pacing = argumentValue(argc, argv, "--pacing");
+    SFramePacer pacer;
+    InitFramePacer(pacer, pacing != NULL && pacing[0] != '\0' ? pacing : (headless ? "uncapped" : "vsync"));
+
+    // Only vsync lets the driver block in glfwSwapBuffers
+    if (!headless)
+        glfwSwapInterval(pacer.mode == PACING_VSYNC ? 1 : 0);
+
+    // Per frame timings for regression runs, one line per frame
+    FILE *timings_file = NULL;
+    if (timings_path != NULL && timings_path[0] != '\0')
+    {
+        timings_file = fopen(timings_path, "w");
+        if (timings_file != NULL)
+            fprintf(timings_file, "frame,frame_ms,submit_ms,wait_ms,draws,render_scale\n");
         else
-            glUniform3f(glGetUniformLocation(shaderProgram, "camPos"), Camera_MV.Position.x, Camera_MV.Position.y, Camera_MV.Position.z);
+            printf("ERROR: Could not open timings file %s\n", timings_path);
+    }
+
+    SFrameTimeHistogram frame_times;
+    InitFrameTimeHistogram(frame_times);
+    std::vector<float> replay_frame_times;
+
+    // Headless runs and replays are deterministic, every frame advances the simulation by exactly 1/60 s
+    bool fixed_frames = headless || replaying;
+    const double fixed_frame_seconds = 1.0 / 60.0;
+
+    // Simulate the first frame up front so the loop always has a finished frame to submit
+    double last_time = fixed_frames ? 0.0 : glfwGetTime();
+    int current = 0;
+    captureFrameInput(frames[current].input, current_state, 0.f);
+    profile_start = BeginProfileEvent();
+    KickJobGraph(jobs, frame_graph);
+    WaitJobGraph(jobs, frame_graph);
+    EndProfileEvent("first simulation", profile_start);
+
+    typedef std::chrono::high_resolution_clock clock;
+    float submit_ms = 0.f;
+    float stall_ms = 0.f;
+    unsigned int frame_count = 0;
 
-        // Setup and Copy the View Matrix
-        glm::mat4 view = glm::mat4(1.f);
-        view = glm::translate(view, -glm::vec3(0.f, 0.f, 0.f));
+    clock::time_point frame_start = clock::now();
 
-        if (is_fly_through)
-            view = glm::lookAt(Camera_FT.Position, Camera_FT.Position + Camera_FT.Front, Camera_FT.Up);
+    // Main Render Loop
+    while ((headless ? replaying || frame_count < headless_frame_count : !glfwWindowShouldClose(window)) &&
+           !(replaying && InputLogFinished(input_log)))
+    {
+        PROFILE_SCOPE("frame");
+
+        profile_start = BeginProfileEvent();
+        if (!headless)
+        {
+            // The simulation is idle here, so picks see the transforms of the frame about to be drawn
+            updatePickScene(simulation, frames[current]);
+            processKeyboard(window);
+            updateFramebufferSize(window);
+        }
+        EndProfileEvent("poll input", profile_start);
+
+        double now = fixed_frames ? last_time + fixed_frame_seconds : glfwGetTime();
+        double frame_seconds = now - last_time;
+        last_time = now;
+
+        // Run the ticks that fit into the elapsed time, colliding with the scene as it was last simulated
+        int ticks = AdvanceFixedTimestep(timestep, frame_seconds);
+        if (ticks > 0 && collision_enabled)
+            updateCollisionScene(simulation);
+        for (int i = 0; i < ticks; i++)
+        {
+            PROFILE_SCOPE("tick");
+            previous_state = current_state;
+
+            SInputState input = { 0, 0.f, 0.f };
+            if (replaying)
+                input = ReplayInputTick(input_log);
+            else if (!headless)
+                input = sampleInput(window);
+            if (recording)
+                RecordInputTick(input_log, input);
+
+            simulateTick(input, (float) timestep.step);
+            current_state = captureViewState();
+        }
+
+        // Animations are sampled at the interpolated tick time, so they also move at the simulation rate
+        double frame_render_time = FixedTimestepRenderTime(timestep);
+        float animation_dt = (float) std::max(0.0, frame_render_time - render_time);
+        render_time = std::max(render_time, frame_render_time);
+
+        // Start simulating the next frame on the workers
+        int next = 1 - current;
+        SViewState view_state = InterpolateViewState(previous_state, current_state, FixedTimestepAlpha(timestep));
+        captureFrameInput(frames[next].input, view_state, animation_dt);
+
+        simulation.frame = &frames[next];
+        profile_start = BeginProfileEvent();
+        KickJobGraph(jobs, frame_graph);
+        if (!pipelined)
+            WaitJobGraph(jobs, frame_graph);
+        EndProfileEvent("kick simulation", profile_start);
+
+        clock::time_point submit_start = clock::now();
+        profile_start = BeginProfileEvent();
+        const SFrameState &frame = frames[current];
+        float frame_scale = 1.f;
+
+        if (software)
+        {
+            // Rasterized and shaded on the job workers, alongside the simulation of the next frame
+            RenderSoftwareFrame(software_renderer, mesh_registry, frame);
+        }
         else
-            view = glm::lookAt(Camera_MV.Position, Camera_MV.Position + Camera_MV.Front, Camera_MV.Up);
-
-        int v_loc = glGetUniformLocation(shaderProgram, "view");
-        glUniformMatrix4fv(v_loc, 1, GL_FALSE, glm::value_ptr(view));
-
-        // Setup and Copy the Projection Matrix
-        glm::mat4 projection = glm::mat4(1.f);
-        projection = glm::perspective(glm::radians(45.f), (float) 800 / (float) 600, .1f, 200.f);
-        int p_loc = glGetUniformLocation(shaderProgram, "projection");
-        glUniformMatrix4fv(p_loc, 1, GL_FALSE, glm::value_ptr(projection));
-
-        // Setup and Copy all the Model Matrices
-        // Island - Model 0
-        glm::mat4 model_island = glm::mat4(1.f);
-        // Declare Transformations
-        model_island = glm::translate(model_island, glm::vec3(0.0f, 0.0f, 0.0f));
-        model_island = glm::rotate(model_island, glm::radians(180.f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model_island = glm::scale(model_island, glm::vec3(0.225f, 0.225f, 0.225f));
-        // Transfer uniform value of the specified model matrix to the shaders
-        int m_loc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(m_loc, 1, GL_FALSE, glm::value_ptr(model_island));
-        // Set the model texture
-        glBindTexture(GL_TEXTURE_2D, texture_island);
-        glUseProgram(shaderProgram);
-        // Set and Draw Triangles
-        glBindVertexArray(VAO[0]);
-        glDrawArrays(GL_TRIANGLES, 0, (int) pair_island.second);
-
-        // Stadium - Model 1
-        glm::mat4 model_stadium = glm::mat4(1.f);
-        model_stadium = glm::translate(model_stadium, glm::vec3(0.0f, 0.0f, 0.0f));
-        model_stadium = glm::rotate(model_stadium, (float) glfwGetTime() / 4, glm::vec3(0.0f, 1.0f, 0.0f));
-        model_stadium = glm::scale(model_stadium, glm::vec3(0.15f, 0.15f, 0.15f));
-        m_loc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(m_loc, 1, GL_FALSE, glm::value_ptr(model_stadium));
-        glBindTexture(GL_TEXTURE_2D, texture_stadium);
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO[1]);
-        glDrawArrays(GL_TRIANGLES, 0, (int) pair_stadium.second);
-
-        // Podium - Model 2
-        glm::mat4 model_podium = glm::mat4(1.f);
-        model_podium = glm::translate(model_podium, glm::vec3(0.0f, 0.0f, 0.0f));
-        model_podium = glm::rotate(model_podium, glm::radians(45.f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model_podium = glm::scale(model_podium, glm::vec3(0.4f, 0.4f, 0.4f));
-        m_loc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(m_loc, 1, GL_FALSE, glm::value_ptr(model_podium));
-        glBindTexture(GL_TEXTURE_2D, texture_podium);
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO[2]);
-        glDrawArrays(GL_TRIANGLES, 0, (int) pair_podium.second);
-
-        // Statue 1 - Model 3
-        glm::mat4 model_statue_1 = glm::mat4(1.f);
-        model_statue_1 = glm::translate(model_statue_1, glm::vec3(-0.2f, 0.5f, 0.1f));
-        model_statue_1 = glm::rotate(model_statue_1, glm::radians(210.f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model_statue_1 = glm::scale(model_statue_1, glm::vec3(0.55f, 0.55f, 0.55f));
-        m_loc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(m_loc, 1, GL_FALSE, glm::value_ptr(model_statue_1));
-        glBindTexture(GL_TEXTURE_2D, texture_statue_1);
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO[3]);
-        glDrawArrays(GL_TRIANGLES, 0, (int) pair_statue_1.second);
-
-        // Statue 2 - Model 4
-        glm::mat4 model_statue_2 = glm::mat4(1.f);
-        model_statue_2 = glm::translate(model_statue_2, glm::vec3(0.1f, 0.5f, -0.2f));
-        model_statue_2 = glm::rotate(model_statue_2, glm::radians(230.f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model_statue_2 = glm::scale(model_statue_2, glm::vec3(0.55f, 0.55f, 0.55f));
-        m_loc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(m_loc, 1, GL_FALSE, glm::value_ptr(model_statue_2));
-        glBindTexture(GL_TEXTURE_2D, texture_statue_2);
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO[4]);
-        glDrawArrays(GL_TRIANGLES, 0, (int) pair_statue_2.second);
-
-        // Agumon - Model 5
-        glm::mat4 model_agumon = glm::mat4(1.f);
-        model_agumon = glm::translate(model_agumon, glm::vec3(0.0f, 0.0f, -1.25f));
-        model_agumon = glm::rotate(model_agumon, glm::radians(270.f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model_agumon = glm::scale(model_agumon, glm::vec3(0.6f, 0.6f, 0.6f));
-        m_loc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(m_loc, 1, GL_FALSE, glm::value_ptr(model_agumon));
-        glBindTexture(GL_TEXTURE_2D, texture_agumon);
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO[5]);
-        glDrawArrays(GL_TRIANGLES, 0, (int) pair_agumon.second);
-
-        // Gabumon - Model 6
-        glm::mat4 model_gabumon = glm::mat4(1.f);
-        model_gabumon = glm::translate(model_gabumon, glm::vec3(-1.25f, 0.0f, 0.0f));
-        model_gabumon = glm::rotate(model_gabumon, glm::radians(180.f), glm::vec3(0.0f, 1.0f, 0.0f));
-        model_gabumon = glm::scale(model_gabumon, glm::vec3(0.6f, 0.6f, 0.6f));
-        m_loc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(m_loc, 1, GL_FALSE, glm::value_ptr(model_gabumon));
-        glBindTexture(GL_TEXTURE_2D, texture_gabumon);
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO[6]);
-        glDrawArrays(GL_TRIANGLES, 0, (int) pair_gabumon.second);
-
-        // Tree 1 - Model 7
-        glm::mat4 model_tree_1 = glm::mat4(1.f);
-        model_tree_1 = glm::translate(model_tree_1, glm::vec3(1.5f, 0.0f, -1.0f));
-        model_tree_1 = glm::rotate(model_tree_1, glm::radians(y_rotation_angle), glm::vec3(0.0f, 1.0f, 0.0f));
-        model_tree_1 = glm::scale(model_tree_1, glm::vec3(0.5f, 0.5f, 0.5f));
-        m_loc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(m_loc, 1, GL_FALSE, glm::value_ptr(model_tree_1));
-        glBindTexture(GL_TEXTURE_2D, texture_tree);
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO[7]);
-        glDrawArrays(GL_TRIANGLES, 0, (int) pair_tree.second);
-
-        // Tree 2 - Model 7
-        glm::mat4 model_tree_2 = glm::mat4(1.f);
-        model_tree_2 = glm::translate(model_tree_2, glm::vec3(-1.0f, 0.0f, 1.5f));
-        model_tree_2 = glm::rotate(model_tree_2, glm::radians(y_rotation_angle), glm::vec3(0.0f, 1.0f, 0.0f));
-        model_tree_2 = glm::scale(model_tree_2, glm::vec3(0.5f, 0.5f, 0.5f));
-        m_loc = glGetUniformLocation(shaderProgram, "model");
-        glUniformMatrix4fv(m_loc, 1, GL_FALSE, glm::value_ptr(model_tree_2));
-        glBindTexture(GL_TEXTURE_2D, texture_tree);
-        glUseProgram(shaderProgram);
-        glBindVertexArray(VAO[7]);
-        glDrawArrays(GL_TRIANGLES, 0, (int) pair_tree.second);
-
-        glBindVertexArray(0);
-
-        // Swap buffers so the image gets updated with each frame
-        glfwSwapBuffers(window);
+        {
+            BeginGLStateFrame(gl_state);
+
+            // Timer queries of the frame issued PROFILER_GPU_LATENCY frames ago are collected here
+            if (active_profiler != NULL)
+                BeginGpuFrame(*active_profiler);
+
+            // Draw into the scaled render target, it follows the size of the output
+            if (dynamic_resolution)
+            {
+                if (drs.width != framebuffer_width || drs.height != framebuffer_height)
+                    ResizeDynamicResolution(drs, framebuffer_width, framebuffer_height);
+                BeginDynamicResolutionFrame(drs);
+                frame_scale = drs.scale;
+            }
+            int scene_width = dynamic_resolution ? drs.render_width : framebuffer_width;
+            int scene_height = dynamic_resolution ? drs.render_height : framebuffer_height;
+
+            // The anti-aliased target sits in front of the scaled one and resolves into it
+            if (aa.width != framebuffer_width || aa.height != framebuffer_height)
+                ResizeAntiAliasing(aa, framebuffer_width, framebuffer_height);
+            BeginAntiAliasingFrame(aa, scene_width, scene_height);
+
+            // Specify the background color
+            SetClearColor(gl_state, 0.05f, 0.15f, 0.5f, 1.f);
+
+            // Clear the back buffer and assign the new color to it
+            // Clear the depth buffer
+            PROFILE_GPU_BEGIN("clear");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            PROFILE_GPU_END();
+
+            // Controls the interpolation of polygons for Rasterization
+            SetPolygonMode(gl_state, GL_FILL);
+
+            // Tell OpenGL which Shader Program to use, the uniforms below belong to it
+            UseProgram(gl_state, shaderProgram);
+
+            SFrameViewTarget view_target = { &frame, scene_width, scene_height, cam_pos_loc, v_loc, p_loc, shaderProgram,
+                                             use_impostors ? &impostors : NULL };
+
+            // Transfer uniform values of Light 1 to the shaders
+            glUniform3f(light_1_direction_loc, frame.input.light_1_direction.x, frame.input.light_1_direction.y, frame.input.light_1_direction.z);
+            glUniform3f(light_1_position_loc, frame.input.light_1_position.x, frame.input.light_1_position.y, frame.input.light_1_position.z);
+            glUniform3f(light_1_color_loc, 1.0f, 1.0f, 1.0f);
+
+            // Transfer uniform values of Light 2 to the shaders
+            glUniform3f(light_2_direction_loc, frame.input.light_2_direction.x, frame.input.light_2_direction.y, frame.input.light_2_direction.z);
+            glUniform3f(light_2_position_loc, frame.input.light_2_position.x, frame.input.light_2_position.y, frame.input.light_2_position.z);
+            glUniform3f(light_2_color_loc, 1.0f, 1.0f, 1.0f);
+
+            // The impostors are lit the same way
+            if (use_impostors)
+                SetImpostorLights(impostors, frame.input.light_1_position, frame.input.light_1_direction,
+                                  frame.input.light_2_position, frame.input.light_2_direction);
+
+            // Issue the culled and sorted draws of the frame once per view, the camera uniforms are set per view
+            BeginStreamFrame(object_stream);
+            SubmitRenderQueue(frames[current].queue, object_stream, beginFrameView, &view_target);
+            EndStreamFrame(object_stream);
+
+            unsigned int output_fbo = headless ? headless_context.fbo : 0;
+            EndAntiAliasingFrame(aa, dynamic_resolution ? drs.fbo : output_fbo);
+            if (dynamic_resolution)
+                EndDynamicResolutionFrame(drs, output_fbo);
+        }
+        float frame_submit_ms = std::chrono::duration<float, std::milli>(clock::now() - submit_start).count();
+        submit_ms += frame_submit_ms;
+        EndProfileEvent("submit", profile_start);
+        if (!software)
+            EndGLStateFrame(gl_state);
+
+        profile_start = BeginProfileEvent();
+        if (headless)
+        {
+            // Nothing is presented, finish the frame so its timing includes the rendering
+            if (!software)
+                glFinish();
+
+            if (dump_directory != NULL && dump_directory[0] != '\0')
+            {
+                char path[512];
+                snprintf(path, sizeof(path), "%s/frame_%05u.ppm", dump_directory, frame_count);
+                if (software)
+                    WriteSoftwareFramePPM(software_renderer, path);
+                else
+                    WriteHeadlessFramePPM(headless_context, path);
+            }
+        }
+        else
+        {
+            // Swap buffers so the image gets updated with each frame
+            glfwSwapBuffers(window);
+        }
+        EndProfileEvent(headless ? "finish" : "swap buffers", profile_start);
+
+        // Hold the frame back in target frame rate mode, the simulation keeps running meanwhile
+        profile_start = BeginProfileEvent();
+        PaceFrame(pacer);
+        EndProfileEvent("pace", profile_start);
+
+        // The next frame becomes current once its simulation is done, this thread helps out while it waits
+        clock::time_point wait_start = clock::now();
+        profile_start = BeginProfileEvent();
+        WaitJobGraph(jobs, frame_graph);
+        clock::time_point frame_end = clock::now();
+        float frame_wait_ms = std::chrono::duration<float, std::milli>(frame_end - wait_start).count();
+        stall_ms += frame_wait_ms;
+        EndProfileEvent("wait simulation", profile_start);
+
+        // Wall clock time of the whole frame, the first one includes start up work and is left out
+        float frame_ms = std::chrono::duration<float, std::milli>(frame_end - frame_start).count();
+        frame_start = frame_end;
+        if (frame_count > 0)
+        {
+            AddFrameTime(frame_times, frame_ms);
+            if (replaying)
+                replay_frame_times.push_back(frame_ms);
+        }
+
+        if (timings_file != NULL)
+            fprintf(timings_file, "%u,%.4f,%.4f,%.4f,%u,%.3f\n", frame_count, frame_ms, frame_submit_ms, frame_wait_ms, frame.queue.stats.draws, frame_scale);
+
+        IncrementCounter(metrics, render_metrics.frames, 1.0);
+        IncrementCounter(metrics, render_metrics.draws, (double) frame.queue.stats.draws);
+        IncrementCounter(metrics, render_metrics.draw_calls, (double) frame.queue.stats.draw_calls);
+        IncrementCounter(metrics, render_metrics.impostors, (double) frame.queue.stats.instances);
+        SetGauge(metrics, render_metrics.frame_ms, frame_ms);
+        SetGauge(metrics, render_metrics.submit_ms, frame_submit_ms);
+        SetGauge(metrics, render_metrics.wait_ms, frame_wait_ms);
+        SetGauge(metrics, render_metrics.render_scale, frame_scale);
+        SetGauge(metrics, render_metrics.host_memory, (double) memory_tracker.current[MEMORY_HOST] / (1024.0 * 1024.0));
+        SetGauge(metrics, render_metrics.gpu_memory, (double) memory_tracker.current[MEMORY_GPU] / (1024.0 * 1024.0));
+        SetGauge(metrics, render_metrics.picked_object, (double) picked.object);
+        SetGauge(metrics, render_metrics.picked_triangle, (double) picked.triangle);
+        SetGauge(metrics, render_metrics.picked_distance, picked.object >= 0 ? (double) picked.t : 0.0);
+        if (frame_count > 0)
+            RecordHistogram(metrics, render_metrics.frame_time, frame_ms);
+
+        // The jobs are idle until the next kick, so chunks can come and go without locking the scene.
+        // Headless runs and replays wait for the loads so every run draws the same frames.
+        if (streaming)
+        {
+            UpdateSceneStreaming(streamer, current_state.cameras[0].position, fixed_frames);
+            SetGauge(metrics, render_metrics.streamed_memory, (double) streamer.resident_bytes / (1024.0 * 1024.0));
+            SetGauge(metrics, render_metrics.chunks_resident, (double) streamer.resident_chunks);
+        }
+        PublishMetrics(metrics, false);
+
+        current = next;
+        frame_count++;
+    }
+
+    if (timings_file != NULL)
+    {
+        fclose(timings_file);
+        printf("INFO: Wrote %u frame timings to %s\n", frame_count, timings_path);
+    }
+
+    AccumulateRenderQueueStats(frames[0].queue, frames[1].queue);
+    PrintRenderQueueStats(frames[0].queue);
+    if (use_impostors)
+        PrintImpostorStats(impostors, frames[0].queue);
+    PrintGLStateStats(gl_state);
+    if (!software)
+        PrintStreamStats(object_stream);
+    PrintSoftwareStats(software_renderer);
+    if (dynamic_resolution)
+        PrintDynamicResolutionStats(drs);
+    if (!software)
+        PrintAntiAliasingStats(aa);
+    PrintCullingStats(culling);
+    PrintOcclusionStats(occlusion);
+    PrintAnimationStats(animation);
+    PrintJobStats(jobs, frame_graph);
+    PrintBvhStats(scene_bvh);
+    PrintCollisionStats(collision_world);
+    if (streaming)
+        PrintSceneStreamingStats(streamer);
+    PrintMetricsStats(metrics);
+    PrintFrameTimeHistogram(frame_times);
+    if (replaying)
+        PrintReplayFrameTimes(replay_frame_times);
+    if (recording)
+        SaveInputLog(input_log, record_path);
+    printf("INFO: Fixed Timestep - %d Hz, %llu ticks, %u dropped after stalls\n", SIM_HZ, timestep.ticks, timestep.dropped_ticks);
+    if (frame_count > 0)
+        printf("INFO: Frame Pipeline - %s, per frame averages: submit %.4f ms, waiting on simulation %.4f ms\n",
+               pipelined ? "simulation overlapped with submission" : "serial", submit_ms / (float) frame_count, stall_ms / (float) frame_count);
+
+    // Renders the last simulated frame again with more and more workers
+    const char *scaling_workers = argumentValue(argc, argv, "--software-scaling");
+    if (software && scaling_workers != NULL)
+    {
+        int max_workers = scaling_workers[0] != '\0' ? atoi(scaling_workers) : (int) std::thread::hardware_concurrency();
+        BenchmarkSoftwareScaling(software_renderer, mesh_registry, frames[current], max_workers, 20);
+    }
+
+    CloseMetrics(metrics);
+    ShutdownOcclusionSystem(occlusion);
+    ShutdownJobSystem(jobs);
+    if (streaming)
+        ShutdownSceneStreamer(streamer);
+    DeleteSceneBvh(scene_bvh);
+    DeleteCollisionWorld(collision_world);
+
+    if (profile_path != NULL)
+    {
+        PrintProfilerStats(profiler, "frame");
+        WriteChromeTrace(profiler, profile_path[0] != '\0' ? profile_path : "profile.json");
+        ShutdownProfiler(profiler);
+    }
+
+    // A software run created no GL objects
+    if (software)
+    {
+        DeleteMeshRegistry(mesh_registry);
+        DeleteSoftwareRenderer(software_renderer);
+        return CheckMemoryLeaks(memory_tracker) ? 0 : -1;
     }
 
     // Delete all the objects that were created
-    glDeleteVertexArrays(8, VAO);
-    glDeleteBuffers(8, VBO);
+    if (use_impostors)
+        DeleteImpostorSystem(impostors);
+    DeleteMeshRegistry(mesh_registry);
+    DeleteStreamBuffer(object_stream);
+    if (dynamic_resolution)
+        DeleteDynamicResolution(drs);
+    DeleteAntiAliasing(aa);
+    glDeleteTextures((GLsizei) scene_textures.size(), scene_textures.data());
+    ReleaseMemory(memory_tracker, &scene_textures, MEMORY_TEXTURES);
     glDeleteProgram(shaderProgram);
 
+    if (headless)
+    {
+        DestroyHeadlessContext(headless_context);
+        return CheckMemoryLeaks(memory_tracker) ? 0 : -1;
+    }
+
     // Delete window before ending the program
     glfwDestroyWindow(window);
     // Terminate GLFW before ending the program
     glfwTerminate();
 
-    return 0;
+    return CheckMemoryLeaks(memory_tracker) ? 0 : -1;
 }
 
-/* Function to Process Keyboard Input */
+/* Returns the value following name on the command line, an empty string for a flag without one
+ * and NULL when name is not there */
+const char *argumentValue(int argc, char *argv[], const char *name)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], name) == 0)
+            return (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) ? argv[i + 1] : "";
+    }
+    return NULL;
+}
+
+/* Parses an OBJ file into a malloc'ed array of interleaved vertices that the caller owns */
+std::pair<float *, unsigned int> loadSceneMesh(const char *filename, SBounds *bounds)
+{
+    std::pair<float *, unsigned int> mesh = parse_OBJ(filename, bounds);
+    if (mesh.first != NULL)
+    {
+        size_t bytes = sizeof(float) * MESH_VERTEX_FLOATS * mesh.second;
+        TrackMemory(memory_tracker, filename, MEMORY_MESH_SOURCE, MEMORY_HOST, mesh.first, bytes);
+        IncrementCounter(metrics, render_metrics.meshes_loaded, 1.0);
+        IncrementCounter(metrics, render_metrics.asset_bytes, (double) bytes);
+        PublishMetrics(metrics, false);
+    }
+    return mesh;
+}
+
+/* Frees a parsed OBJ array once everything that needs the full mesh on the CPU has been built */
+void releaseSceneMesh(float *vertices)
+{
+    ReleaseMemory(memory_tracker, vertices, MEMORY_MESH_SOURCE);
+    free(vertices);
+}
+
+/* Vertex format a scene mesh is uploaded in */
+EVertexFormat sceneVertexFormat(const float *vertices, unsigned int vertex_count)
+{
+    return full_vertices ? VERTEX_FORMAT_FULL : SelectVertexFormat(vertices, vertex_count);
+}
+
+/* Loads a texture for whichever renderer draws the scene, software is NULL for the GL path.
+ * Mipmapped textures are filtered, the others use nearest sampling. */
+GLuint loadSceneTexture(SSoftRenderer *software, const char *filename, bool mipmaps)
+{
+    IncrementCounter(metrics, render_metrics.textures_loaded, 1.0);
+    if (software != NULL)
+        return LoadSoftwareTexture(*software, filename, mipmaps);
+
+    GLuint texture = mipmaps ? setup_mipmaps(filename) : setup_texture(filename);
+    scene_textures.push_back(texture);
+
+    // Drivers pad RGB8 to four bytes per texel, a full mip chain adds a third
+    GLint width = 0, height = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    size_t bytes = (size_t) width * (size_t) height * 4;
+    TrackMemory(memory_tracker, filename, MEMORY_TEXTURES, MEMORY_GPU, &scene_textures, mipmaps ? bytes * 4 / 3 : bytes);
+    IncrementCounter(metrics, render_metrics.asset_bytes, (double) bytes);
+    PublishMetrics(metrics, false);
+    return texture;
+}
+
+/* Registers the metrics of the render loop and the asset loaders */
+void registerMetrics()
+{
+    render_metrics.frames          = AddCounter(metrics, "frames");
+    render_metrics.draws           = AddCounter(metrics, "draws");
+    render_metrics.draw_calls      = AddCounter(metrics, "draw_calls");
+    render_metrics.frame_ms        = AddGauge(metrics, "frame_ms");
+    render_metrics.submit_ms       = AddGauge(metrics, "submit_ms");
+    render_metrics.wait_ms         = AddGauge(metrics, "wait_ms");
+    render_metrics.frame_time      = AddHistogram(metrics, "frame_time_ms", FRAME_BUCKET_MS, FRAME_BUCKETS);
+    render_metrics.render_scale    = AddGauge(metrics, "render_scale");
+    render_metrics.host_memory     = AddGauge(metrics, "host_memory_mb");
+    render_metrics.gpu_memory      = AddGauge(metrics, "gpu_memory_mb");
+    render_metrics.meshes_loaded   = AddCounter(metrics, "meshes_loaded");
+    render_metrics.textures_loaded = AddCounter(metrics, "textures_loaded");
+    render_metrics.asset_bytes     = AddCounter(metrics, "asset_bytes_loaded");
+    render_metrics.streamed_memory = AddGauge(metrics, "streamed_memory_mb");
+    render_metrics.chunks_resident = AddGauge(metrics, "chunks_resident");
+    render_metrics.impostors       = AddCounter(metrics, "impostors");
+    render_metrics.picked_object   = AddGauge(metrics, "picked_object");
+    render_metrics.picked_triangle = AddGauge(metrics, "picked_triangle");
+    render_metrics.picked_distance = AddGauge(metrics, "picked_distance");
+}
+
+/* Places the pickable objects where the frame draws them */
+void updatePickScene(const SSimulation &simulation, const SFrameState &frame)
+{
+    std::vector<glm::mat4> models(simulation.objects.size());
+    for (size_t i = 0; i < simulation.objects.size(); i++)
+        models[i] = GetWorldMatrix(*simulation.transforms, simulation.objects[i].node);
+
+    UpdateSceneBvhInstances(scene_bvh, models.data());
+    pick_view_projection = frame.view_projections[0];
+    pick_viewport = frame.input.viewports[0];
+}
+
+/* Places the collision instances where the last simulated frame put their objects */
+void updateCollisionScene(const SSimulation &simulation)
+{
+    for (size_t i = 0; i < collision_objects.size(); i++)
+        UpdateCollisionInstance(collision_world, (int) i, GetWorldMatrix(*simulation.transforms, simulation.objects[collision_objects[i]].node));
+}
+
+/* Selects the viewports of a multi view layout, "split" or "pip" */
+bool setupViews(const char *layout)
+{
+    if (strcmp(layout, "split") == 0)
+    {
+        view_count = 2;
+        view_viewports[0] = glm::vec4(0.f, 0.f, .5f, 1.f);
+        view_viewports[1] = glm::vec4(.5f, 0.f, .5f, 1.f);
+    }
+    else if (strcmp(layout, "pip") == 0)
+    {
+        view_count = 2;
+        view_viewports[0] = glm::vec4(0.f, 0.f, 1.f, 1.f);
+        view_viewports[1] = glm::vec4(.68f, .68f, .3f, .3f);
+    }
+    else
+    {
+        printf("ERROR: Unknown view layout %s, expected split or pip\n", layout);
+        return false;
+    }
+
+    printf("INFO: Drawing %u views (%s)\n", view_count, layout);
+    return true;
+}
+
+/* Follows window resizes, a minimized window keeps the last size */
+void updateFramebufferSize(GLFWwindow *window)
+{
+    int w, h;
+    glfwGetFramebufferSize(window, &w, &h);
+    if (w > 0 && h > 0)
+    {
+        framebuffer_width = w;
+        framebuffer_height = h;
+    }
+}
+
+/* Points the viewport and the camera uniforms at a view before the render queue issues its draws */
+void beginFrameView(void *data, int view)
+{
+    const SFrameViewTarget &target = *(const SFrameViewTarget *) data;
+    const SFrameState &frame = *target.frame;
+
+    if (frame.input.view_count > 1)
+    {
+        const glm::vec4 &viewport = frame.input.viewports[view];
+        int x = (int) (viewport.x * (float) target.framebuffer_width);
+        int y = (int) (viewport.y * (float) target.framebuffer_height);
+        int w = (int) (viewport.z * (float) target.framebuffer_width);
+        int h = (int) (viewport.w * (float) target.framebuffer_height);
+        SetViewport(gl_state, x, y, w, h);
+
+        // Later views may be inset into earlier ones, so their area is cleared again
+        if (view > 0)
+        {
+            SetCapability(gl_state, GL_CAP_SCISSOR_TEST, true);
+            glScissor(x, y, w, h);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            SetCapability(gl_state, GL_CAP_SCISSOR_TEST, false);
+        }
+    }
+
+    UseProgram(gl_state, target.program);
+
+    // Transfer uniform values of the camera position to the shaders
+    const glm::vec3 &position = frame.input.cameras[view].position;
+    glUniform3f(target.cam_pos_loc, position.x, position.y, position.z);
+
+    // Copy the View and Projection Matrices built by the input job
+    glUniformMatrix4fv(target.v_loc, 1, GL_FALSE, glm::value_ptr(frame.views[view]));
+    glUniformMatrix4fv(target.p_loc, 1, GL_FALSE, glm::value_ptr(frame.projections[view]));
+
+    // The impostors face the camera of the view
+    if (target.impostors != NULL)
+        SetImpostorView(*target.impostors, position, frame.views[view], frame.projections[view]);
+}
+
+/* Camera and tree state at the end of a tick, the active camera comes first and the other one second */
+SViewState captureViewState()
+{
+    const SCamera *cameras[MAX_FRAME_VIEWS] = { is_fly_through ? &Camera_FT : &Camera_MV, is_fly_through ? &Camera_MV : &Camera_FT };
+
+    SViewState state;
+    for (int v = 0; v < MAX_FRAME_VIEWS; v++)
+    {
+        state.cameras[v].position = cameras[v]->Position;
+        state.cameras[v].front = cameras[v]->Front;
+        state.cameras[v].up = cameras[v]->Up;
+    }
+    state.tree_angle = y_rotation_angle;
+    return state;
+}
+
+/* Copies the interpolated views and the light state that the simulation jobs of the next frame read */
+void captureFrameInput(SFrameInput &input, const SViewState &view_state, float dt)
+{
+    input.view_count = view_count;
+    input.aspect = (float) framebuffer_width / (float) framebuffer_height;
+    for (unsigned int v = 0; v < view_count; v++)
+    {
+        input.cameras[v] = view_state.cameras[v];
+        input.viewports[v] = view_viewports[v];
+    }
+
+    input.light_1_direction = lightDirection;
+    input.light_1_position = lightPos;
+    input.light_2_direction = lightDirection_scene;
+    input.light_2_position = lightPos_scene;
+
+    input.tree_angle = view_state.tree_angle;
+    input.dt = dt;
+}
+
+/* Function to Process Keyboard Input, only the actions that are not part of the simulation */
 void processKeyboard(GLFWwindow *window)
 {
     // Processes all the GLFW events
@@ -411,85 +1196,114 @@ void processKeyboard(GLFWwindow *window)
     // Close window when escape is hit
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)        
         glfwSetWindowShouldClose(window, true);
+}
 
-    // Left Angle Bracket
-    if (glfwGetKey(window, GLFW_KEY_COMMA) == GLFW_PRESS)
-        y_rotation_angle += 5.f;
-    // Right Angle Bracket
-    if (glfwGetKey(window, GLFW_KEY_PERIOD) == GLFW_PRESS)
-        y_rotation_angle -= 5.f;
+/* Reads the keys the simulation uses and takes the cursor movement since the last tick */
+SInputState sampleInput(GLFWwindow *window)
+{
+    static const struct { int key; uint16_t bit; } bindings[] = {
+        { GLFW_KEY_W, INPUT_KEY_FORWARD },         { GLFW_KEY_A, INPUT_KEY_LEFT },
+        { GLFW_KEY_S, INPUT_KEY_BACKWARD },        { GLFW_KEY_D, INPUT_KEY_RIGHT },
+        { GLFW_KEY_UP, INPUT_KEY_ORBIT_UP },       { GLFW_KEY_DOWN, INPUT_KEY_ORBIT_DOWN },
+        { GLFW_KEY_LEFT, INPUT_KEY_ORBIT_LEFT },   { GLFW_KEY_RIGHT, INPUT_KEY_ORBIT_RIGHT },
+        { GLFW_KEY_R, INPUT_KEY_ZOOM_IN },         { GLFW_KEY_F, INPUT_KEY_ZOOM_OUT },
+        { GLFW_KEY_COMMA, INPUT_KEY_TREE_LEFT },   { GLFW_KEY_PERIOD, INPUT_KEY_TREE_RIGHT },
+        { GLFW_KEY_M, INPUT_KEY_MODEL_VIEW },      { GLFW_KEY_N, INPUT_KEY_FLY_THROUGH },
+        { GLFW_KEY_SPACE, INPUT_KEY_LIGHT },       { GLFW_KEY_L, INPUT_KEY_LIGHT },
+    };
+
+    SInputState input;
+    input.keys = 0;
+    for (size_t i = 0; i < sizeof(bindings) / sizeof(bindings[0]); i++)
+        if (glfwGetKey(window, bindings[i].key) == GLFW_PRESS)
+            input.keys |= bindings[i].bit;
+
+    input.mouse_dx = pending_mouse_dx;
+    input.mouse_dy = pending_mouse_dy;
+    pending_mouse_dx = 0.f;
+    pending_mouse_dy = 0.f;
+    return input;
+}
 
-    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
+/* Function to Process the input of one fixed timestep tick of dt seconds, live or replayed */
+void simulateTick(const SInputState &input, float dt)
+{
+    // Fraction of a reference frame that this tick covers
+    float step = SIM_REFERENCE_HZ * dt;
+
+    if (input.keys & INPUT_KEY_MODEL_VIEW) {
         is_fly_through = false;
     }
-    if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) {
+    if (input.keys & INPUT_KEY_FLY_THROUGH) {
         is_fly_through = true;
     }
 
-    if ((glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) || (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS))
-    {
-        if (is_fly_through) {
-            lightDirection = Camera_FT.Front;
-            lightPos = Camera_FT.Position;
-        }
-        else {
-            lightDirection = Camera_MV.Front;
-            lightPos = Camera_MV.Position;
-        }
+    if (is_fly_through && (input.mouse_dx != 0.f || input.mouse_dy != 0.f)) {
+        OrientCamera(Camera_FT, input.mouse_dx, input.mouse_dy);
     }
 
+    // Left Angle Bracket
+    if (input.keys & INPUT_KEY_TREE_LEFT)
+        y_rotation_angle += 5.f * step;
+    // Right Angle Bracket
+    if (input.keys & INPUT_KEY_TREE_RIGHT)
+        y_rotation_angle -= 5.f * step;
+
     float cam_x_offset = 0.f;
     float cam_y_offset = 0.f;
     bool cam_changed = false;
 
     if (is_fly_through)
     {
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-            MoveCamera(Camera_FT, SCamera::FORWARD);
+        float distance = Camera_FT.MovementSpeed * step;
+        SCollisionWorld *collision = collision_enabled ? &collision_world : NULL;
+
+        if (input.keys & INPUT_KEY_FORWARD) {
+            MoveCamera(Camera_FT, SCamera::FORWARD, distance, collision);
             cam_changed = true;
         }
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-            MoveCamera(Camera_FT, SCamera::LEFT);
+        if (input.keys & INPUT_KEY_LEFT) {
+            MoveCamera(Camera_FT, SCamera::LEFT, distance, collision);
             cam_changed = true;
         }
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-            MoveCamera(Camera_FT, SCamera::BACKWARD);
+        if (input.keys & INPUT_KEY_BACKWARD) {
+            MoveCamera(Camera_FT, SCamera::BACKWARD, distance, collision);
             cam_changed = true;
         }
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-            MoveCamera(Camera_FT, SCamera::RIGHT);
+        if (input.keys & INPUT_KEY_RIGHT) {
+            MoveCamera(Camera_FT, SCamera::RIGHT, distance, collision);
             cam_changed = true;
         }
     }
     else
     {
-        if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
+        if (input.keys & INPUT_KEY_ORBIT_UP) {
             cam_x_offset = 0.f;
-            cam_y_offset = -1.f;
+            cam_y_offset = -step;
             cam_changed = true;
         }
-        if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
+        if (input.keys & INPUT_KEY_ORBIT_DOWN) {
             cam_x_offset = 0.f;
-            cam_y_offset = 1.f;
+            cam_y_offset = step;
             cam_changed = true;
         }
-        if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) {
-            cam_x_offset = -1.f;
+        if (input.keys & INPUT_KEY_ORBIT_LEFT) {
+            cam_x_offset = -step;
             cam_y_offset = 0.f;
             cam_changed = true;
         }
-        if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
-            cam_x_offset = 1.f;
+        if (input.keys & INPUT_KEY_ORBIT_RIGHT) {
+            cam_x_offset = step;
             cam_y_offset = 0.f;
             cam_changed = true;
         }
 
-        if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
-            cam_dist -= 0.2f * Camera_MV.MovementSpeed;
+        if (input.keys & INPUT_KEY_ZOOM_IN) {
+            cam_dist -= 0.2f * Camera_MV.MovementSpeed * step;
             cam_changed = true;
         }
-        if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
-            cam_dist += 0.2f * Camera_MV.MovementSpeed;
+        if (input.keys & INPUT_KEY_ZOOM_OUT) {
+            cam_dist += 0.2f * Camera_MV.MovementSpeed * step;
             cam_changed = true;
         }
     }
@@ -506,6 +1320,19 @@ void processKeyboard(GLFWwindow *window)
         //printf("[LIGHT POS]         X: %f \t| Y: %f \t| Z: %f \n", lightPos.x, lightPos.y, lightPos.z);
         //printf("[LIGHT DIRECTION]   X: %f \t| Y: %f \t| Z: %f \n", lightDirection.x, lightDirection.y, lightDirection.z);
     }
+
+    // The light follows the active camera while space or L is held
+    if (input.keys & INPUT_KEY_LIGHT)
+    {
+        if (is_fly_through) {
+            lightDirection = Camera_FT.Front;
+            lightPos = Camera_FT.Position;
+        }
+        else {
+            lightDirection = Camera_MV.Front;
+            lightPos = Camera_MV.Position;
+        }
+    }
 }
 
 bool firstMouse = true;
@@ -528,8 +1355,29 @@ void processMouse(GLFWwindow *window, double x, double y)
     prevMouseX = x;
     prevMouseY = y;
 
-    if (is_fly_through) {
-        OrientCamera(Camera_FT, (float) dX, (float) dY);
-    }
+    // Applied to the fly through camera on the next tick
+    pending_mouse_dx += (float) dX;
+    pending_mouse_dy += (float) dY;
+
+    picked = pickCursor(window, x, y);
 }
 
+/* Returns the object and triangle under the cursor, hit.object is -1 when there is none */
+SBvhHit pickCursor(GLFWwindow *window, double x, double y)
+{
+    SBvhHit miss = { -1, -1, 0.f, 0.f, 0.f };
+    int w, h;
+    glfwGetWindowSize(window, &w, &h);
+    if (w <= 0 || h <= 0 || scene_bvh.top.nodes.empty())
+        return miss;
+
+    // Only the first view is pickable, the cursor is moved into its viewport which GL measures from the bottom
+    float view_x = (float) x - pick_viewport.x * (float) w;
+    float view_y = (float) y - (1.f - pick_viewport.y - pick_viewport.w) * (float) h;
+    int view_w = (int) (pick_viewport.z * (float) w);
+    int view_h = (int) (pick_viewport.w * (float) h);
+    if (view_x < 0.f || view_y < 0.f || view_x >= (float) view_w || view_y >= (float) view_h)
+        return miss;
+
+    return PickSceneBvh(scene_bvh, pick_view_projection, view_x, view_y, view_w, view_h);
+}
@@ -2,6 +2,7 @@
 
 /* ---- Standard Library ---- */
 #include <cstdio>
+#include <cfloat>
 
 /* ---- GLM Includes ---- */
 #ifdef _WIN32
@@ -14,17 +15,55 @@
 
 /* ---- Header Files ---- */
 #include "camera.h"
+#include "collision.h"
 
-void MoveCamera(SCamera &in, SCamera::Camera_Movement direction)
+/* ---- Definitions ---- */
+// Radius of the sphere the camera collides as, wide enough that the near plane at 0.1 never reaches a wall
+#define CAMERA_COLLISION_RADIUS 0.15f
+
+// The camera is kept at least this far above the ground under it
+#define CAMERA_EYE_HEIGHT 0.25f
+
+/* Moves the camera by distance, used by the fixed timestep to scale the step to the tick length */
+void MoveCamera(SCamera &in, SCamera::Camera_Movement direction, float distance)
 {
     if (direction == in.FORWARD)
-        in.Position += in.Front * in.MovementSpeed;
+        in.Position += in.Front * distance;
     if (direction == in.BACKWARD)
-        in.Position -= in.Front * in.MovementSpeed;
+        in.Position -= in.Front * distance;
     if (direction == in.LEFT)
-        in.Position -= in.Right * in.MovementSpeed;
+        in.Position -= in.Right * distance;
     if (direction == in.RIGHT)
-        in.Position += in.Right * in.MovementSpeed;
+        in.Position += in.Right * distance;
+}
+
+void MoveCamera(SCamera &in, SCamera::Camera_Movement direction)
+{
+    MoveCamera(in, direction, in.MovementSpeed);
+}
+
+/* Lifts the camera to CAMERA_EYE_HEIGHT above the highest ground that is at most reach above it */
+void ClampCameraToGround(SCamera &in, SCollisionWorld &world, float reach)
+{
+    float ground = CollisionGroundHeight(world, in.Position + glm::vec3(0.f, reach, 0.f));
+    if (ground > -FLT_MAX && in.Position.y < ground + CAMERA_EYE_HEIGHT)
+    {
+        in.Position.y = ground + CAMERA_EYE_HEIGHT;
+        world.stats.ground_clamps++;
+    }
+}
+
+/* Moves the camera by distance as a sphere swept through the collision world, sliding along whatever
+ * it hits, then keeps it above the ground. Without a world the camera moves freely. */
+void MoveCamera(SCamera &in, SCamera::Camera_Movement direction, float distance, SCollisionWorld *world)
+{
+    glm::vec3 start = in.Position;
+    MoveCamera(in, direction, distance);
+    if (world == NULL)
+        return;
+
+    in.Position = SweepCollisionSphere(*world, start, in.Position, CAMERA_COLLISION_RADIUS);
+    ClampCameraToGround(in, *world, CAMERA_COLLISION_RADIUS);
 }
 
 void OrientCamera(SCamera &in, float xoffset, float yoffset)
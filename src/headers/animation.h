@@ -0,0 +1,536 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+/* ---- SIMD Intrinsics ---- */
+// Tracks are blended 8 instances at a time with AVX, 4 with SSE and fall back to scalar code
+#if defined(__AVX__)
+    #include <immintrin.h>
+    #define ANIM_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define ANIM_LANES 4
+#else
+    #define ANIM_LANES 1
+#endif
+
+/* ---- GLM Includes ---- */
+#ifdef _WIN32
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/quaternion.hpp>
+#endif
+
+#ifdef __unix
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#endif
+
+/* ---- Header Files ---- */
+#include "transform.h"
+
+/* ---- Definitions ---- */
+// Channels of the per-frame lane buffer: the two sampled keys and the blend factor of every instance,
+// followed by the blended local transform
+enum EAnimationChannel
+{
+    ANIM_T,
+    ANIM_P0X, ANIM_P0Y, ANIM_P0Z, ANIM_P1X, ANIM_P1Y, ANIM_P1Z,
+    ANIM_R0X, ANIM_R0Y, ANIM_R0Z, ANIM_R0W, ANIM_R1X, ANIM_R1Y, ANIM_R1Z, ANIM_R1W,
+    ANIM_S0X, ANIM_S0Y, ANIM_S0Z, ANIM_S1X, ANIM_S1Y, ANIM_S1Z,
+    ANIM_OUT_PX, ANIM_OUT_PY, ANIM_OUT_PZ,
+    ANIM_OUT_RX, ANIM_OUT_RY, ANIM_OUT_RZ, ANIM_OUT_RW,
+    ANIM_OUT_SX, ANIM_OUT_SY, ANIM_OUT_SZ,
+    ANIM_CHANNELS
+};
+
+// A looping clip is a range of the shared key arrays, every key holds a full TRS pose
+struct SAnimationClip
+{
+    int first_key;
+    int key_count;
+    float duration;
+};
+
+struct SAnimationStats
+{
+    unsigned int instances;
+    float sample_ms;
+    float blend_ms;
+    float apply_ms;
+};
+
+struct SAnimationSystem
+{
+    // Keys of every clip, structure of arrays
+    std::vector<float> key_time;
+    std::vector<float> key_px, key_py, key_pz;
+    std::vector<float> key_rx, key_ry, key_rz, key_rw;
+    std::vector<float> key_sx, key_sy, key_sz;
+
+    std::vector<SAnimationClip> clips;
+
+    // Instances, structure of arrays. key is the segment found last frame, where the search restarts.
+    std::vector<int> clip;
+    std::vector<int> node;
+    std::vector<float> time;
+    std::vector<float> speed;
+    std::vector<int> key;
+
+    // ANIM_CHANNELS rows of lane_stride floats, padded to ANIM_LANES
+    std::vector<float> lanes;
+    size_t lane_stride;
+
+    SAnimationStats stats;
+    SAnimationStats totals;
+    unsigned int frames;
+};
+
+void InitAnimationSystem(SAnimationSystem &anim)
+{
+    anim.lane_stride = 0;
+    anim.stats = SAnimationStats();
+    anim.totals = SAnimationStats();
+    anim.frames = 0;
+}
+
+/* Adds a looping clip from key_count poses, times must start at 0 and increase. Returns its id */
+int AddAnimationClip(SAnimationSystem &anim, const float *times, const glm::vec3 *positions,
+                     const glm::quat *rotations, const glm::vec3 *scales, int key_count)
+{
+    if (key_count < 1 || times[0] != 0.f)
+    {
+        printf("ERROR: Animation Clip needs at least one key starting at time 0.\n");
+        return -1;
+    }
+
+    SAnimationClip c;
+    c.first_key = (int) anim.key_time.size();
+    c.key_count = key_count;
+    c.duration = times[key_count - 1];
+
+    for (int k = 0; k < key_count; k++)
+    {
+        if (k > 0 && times[k] <= times[k - 1])
+        {
+            printf("ERROR: Animation Clip key times must increase (key %d).\n", k);
+            anim.key_time.resize(c.first_key);
+            return -1;
+        }
+        anim.key_time.push_back(times[k]);
+    }
+
+    for (int k = 0; k < key_count; k++)
+    {
+        // Keep neighbouring rotations in the same hemisphere so each segment takes the short arc
+        glm::quat r = rotations[k];
+        if (k > 0 && anim.key_rx.back() * r.x + anim.key_ry.back() * r.y + anim.key_rz.back() * r.z + anim.key_rw.back() * r.w < 0.f)
+            r = glm::quat(-r.w, -r.x, -r.y, -r.z);
+
+        anim.key_px.push_back(positions[k].x);
+        anim.key_py.push_back(positions[k].y);
+        anim.key_pz.push_back(positions[k].z);
+        anim.key_rx.push_back(r.x);
+        anim.key_ry.push_back(r.y);
+        anim.key_rz.push_back(r.z);
+        anim.key_rw.push_back(r.w);
+        anim.key_sx.push_back(scales[k].x);
+        anim.key_sy.push_back(scales[k].y);
+        anim.key_sz.push_back(scales[k].z);
+    }
+
+    anim.clips.push_back(c);
+    return (int) anim.clips.size() - 1;
+}
+
+/* Plays clip on a transform node, starting start_time seconds in. Returns the instance id */
+int AddAnimationInstance(SAnimationSystem &anim, int clip, int node, float start_time, float speed)
+{
+    if (clip < 0 || clip >= (int) anim.clips.size())
+    {
+        printf("ERROR: Animation Clip %d does not exist.\n", clip);
+        return -1;
+    }
+
+    anim.clip.push_back(clip);
+    anim.node.push_back(node);
+    anim.time.push_back(start_time);
+    anim.speed.push_back(speed);
+    anim.key.push_back(0);
+    return (int) anim.clip.size() - 1;
+}
+
+float *AnimationLane(SAnimationSystem &anim, int channel)
+{
+    return anim.lanes.data() + channel * anim.lane_stride;
+}
+
+/* Advances every instance by dt, finds its key segment and copies both keys into the lane buffer */
+void SampleAnimations(SAnimationSystem &anim, float dt)
+{
+    size_t n = anim.clip.size();
+    size_t padded = ((n + ANIM_LANES - 1) / ANIM_LANES) * ANIM_LANES;
+    if (padded != anim.lane_stride)
+    {
+        // Padding lanes blend identity poses so the kernel never reads garbage
+        anim.lane_stride = padded;
+        anim.lanes.assign(ANIM_CHANNELS * padded, 0.f);
+        for (size_t i = n; i < padded; i++)
+        {
+            AnimationLane(anim, ANIM_R0W)[i] = 1.f;
+            AnimationLane(anim, ANIM_R1W)[i] = 1.f;
+        }
+    }
+
+    float *lt = AnimationLane(anim, ANIM_T);
+    float *p0x = AnimationLane(anim, ANIM_P0X), *p0y = AnimationLane(anim, ANIM_P0Y), *p0z = AnimationLane(anim, ANIM_P0Z);
+    float *p1x = AnimationLane(anim, ANIM_P1X), *p1y = AnimationLane(anim, ANIM_P1Y), *p1z = AnimationLane(anim, ANIM_P1Z);
+    float *r0x = AnimationLane(anim, ANIM_R0X), *r0y = AnimationLane(anim, ANIM_R0Y), *r0z = AnimationLane(anim, ANIM_R0Z), *r0w = AnimationLane(anim, ANIM_R0W);
+    float *r1x = AnimationLane(anim, ANIM_R1X), *r1y = AnimationLane(anim, ANIM_R1Y), *r1z = AnimationLane(anim, ANIM_R1Z), *r1w = AnimationLane(anim, ANIM_R1W);
+    float *s0x = AnimationLane(anim, ANIM_S0X), *s0y = AnimationLane(anim, ANIM_S0Y), *s0z = AnimationLane(anim, ANIM_S0Z);
+    float *s1x = AnimationLane(anim, ANIM_S1X), *s1y = AnimationLane(anim, ANIM_S1Y), *s1z = AnimationLane(anim, ANIM_S1Z);
+
+    const float *times = anim.key_time.data();
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const SAnimationClip &c = anim.clips[anim.clip[i]];
+
+        float t = anim.time[i] + dt * anim.speed[i];
+        if (c.duration > 0.f && (t >= c.duration || t < 0.f))
+            t -= floorf(t / c.duration) * c.duration;
+        anim.time[i] = t;
+
+        // Playback is coherent, so walk on from last frame's segment and only restart after a wrap
+        const float *ct = times + c.first_key;
+        int k = anim.key[i];
+        if (k >= c.key_count || ct[k] > t)
+            k = 0;
+        while (k + 2 < c.key_count && ct[k + 1] <= t)
+            k++;
+        anim.key[i] = k;
+
+        int k0 = c.first_key + k;
+        int k1 = c.key_count > 1 ? k0 + 1 : k0;
+        float span = times[k1] - times[k0];
+        float f = span > 0.f ? (t - times[k0]) / span : 0.f;
+        lt[i] = f < 1.f ? f : 1.f;
+
+        p0x[i] = anim.key_px[k0]; p0y[i] = anim.key_py[k0]; p0z[i] = anim.key_pz[k0];
+        p1x[i] = anim.key_px[k1]; p1y[i] = anim.key_py[k1]; p1z[i] = anim.key_pz[k1];
+        r0x[i] = anim.key_rx[k0]; r0y[i] = anim.key_ry[k0]; r0z[i] = anim.key_rz[k0]; r0w[i] = anim.key_rw[k0];
+        r1x[i] = anim.key_rx[k1]; r1y[i] = anim.key_ry[k1]; r1z[i] = anim.key_rz[k1]; r1w[i] = anim.key_rw[k1];
+        s0x[i] = anim.key_sx[k0]; s0y[i] = anim.key_sy[k0]; s0z[i] = anim.key_sz[k0];
+        s1x[i] = anim.key_sx[k1]; s1y[i] = anim.key_sy[k1]; s1z[i] = anim.key_sz[k1];
+    }
+}
+
+/* Slerp is approximated by a normalized lerp with a corrected blend factor (a cubic in t whose
+ * coefficients depend on the angle between the keys), which needs no acos or sin and stays
+ * within about 1e-3 of the exact result. The scalar path and the SIMD lanes use the same curve. */
+float SlerpFactor(float d, float t)
+{
+    float a = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+    float b = 0.848013f + d * (-1.06021f + d * 0.215638f);
+    float k = a * (t - 0.5f) * (t - 0.5f) + b;
+    return t + t * (t - 0.5f) * (t - 1.f) * k;
+}
+
+#if ANIM_LANES == 8
+    typedef __m256 anim_vec;
+    #define ANIM_LOAD(p)      _mm256_loadu_ps(p)
+    #define ANIM_STORE(p, v)  _mm256_storeu_ps(p, v)
+    #define ANIM_SET1(x)      _mm256_set1_ps(x)
+    #define ANIM_ADD(a, b)    _mm256_add_ps(a, b)
+    #define ANIM_SUB(a, b)    _mm256_sub_ps(a, b)
+    #define ANIM_MUL(a, b)    _mm256_mul_ps(a, b)
+    #define ANIM_DIV(a, b)    _mm256_div_ps(a, b)
+    #define ANIM_SQRT(a)      _mm256_sqrt_ps(a)
+    #define ANIM_AND(a, b)    _mm256_and_ps(a, b)
+    #define ANIM_XOR(a, b)    _mm256_xor_ps(a, b)
+    #define ANIM_LT(a, b)     _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#elif ANIM_LANES == 4
+    typedef __m128 anim_vec;
+    #define ANIM_LOAD(p)      _mm_loadu_ps(p)
+    #define ANIM_STORE(p, v)  _mm_storeu_ps(p, v)
+    #define ANIM_SET1(x)      _mm_set1_ps(x)
+    #define ANIM_ADD(a, b)    _mm_add_ps(a, b)
+    #define ANIM_SUB(a, b)    _mm_sub_ps(a, b)
+    #define ANIM_MUL(a, b)    _mm_mul_ps(a, b)
+    #define ANIM_DIV(a, b)    _mm_div_ps(a, b)
+    #define ANIM_SQRT(a)      _mm_sqrt_ps(a)
+    #define ANIM_AND(a, b)    _mm_and_ps(a, b)
+    #define ANIM_XOR(a, b)    _mm_xor_ps(a, b)
+    #define ANIM_LT(a, b)     _mm_cmplt_ps(a, b)
+#endif
+
+/* Blends the sampled keys of every instance: lerp for position and scale, corrected nlerp for rotation */
+void BlendAnimations(SAnimationSystem &anim)
+{
+    size_t padded = anim.lane_stride;
+
+    const float *lt = AnimationLane(anim, ANIM_T);
+    const float *p0x = AnimationLane(anim, ANIM_P0X), *p0y = AnimationLane(anim, ANIM_P0Y), *p0z = AnimationLane(anim, ANIM_P0Z);
+    const float *p1x = AnimationLane(anim, ANIM_P1X), *p1y = AnimationLane(anim, ANIM_P1Y), *p1z = AnimationLane(anim, ANIM_P1Z);
+    const float *r0x = AnimationLane(anim, ANIM_R0X), *r0y = AnimationLane(anim, ANIM_R0Y), *r0z = AnimationLane(anim, ANIM_R0Z), *r0w = AnimationLane(anim, ANIM_R0W);
+    const float *r1x = AnimationLane(anim, ANIM_R1X), *r1y = AnimationLane(anim, ANIM_R1Y), *r1z = AnimationLane(anim, ANIM_R1Z), *r1w = AnimationLane(anim, ANIM_R1W);
+    const float *s0x = AnimationLane(anim, ANIM_S0X), *s0y = AnimationLane(anim, ANIM_S0Y), *s0z = AnimationLane(anim, ANIM_S0Z);
+    const float *s1x = AnimationLane(anim, ANIM_S1X), *s1y = AnimationLane(anim, ANIM_S1Y), *s1z = AnimationLane(anim, ANIM_S1Z);
+    float *opx = AnimationLane(anim, ANIM_OUT_PX), *opy = AnimationLane(anim, ANIM_OUT_PY), *opz = AnimationLane(anim, ANIM_OUT_PZ);
+    float *orx = AnimationLane(anim, ANIM_OUT_RX), *ory = AnimationLane(anim, ANIM_OUT_RY), *orz = AnimationLane(anim, ANIM_OUT_RZ), *orw = AnimationLane(anim, ANIM_OUT_RW);
+    float *osx = AnimationLane(anim, ANIM_OUT_SX), *osy = AnimationLane(anim, ANIM_OUT_SY), *osz = AnimationLane(anim, ANIM_OUT_SZ);
+
+#if ANIM_LANES > 1
+    const anim_vec sign_mask = ANIM_SET1(-0.f);
+    const anim_vec zero = ANIM_SET1(0.f);
+    const anim_vec one = ANIM_SET1(1.f);
+    const anim_vec half = ANIM_SET1(0.5f);
+
+    for (size_t i = 0; i < padded; i += ANIM_LANES)
+    {
+        anim_vec t = ANIM_LOAD(lt + i);
+
+        // Position and scale: p0 + (p1 - p0) * t
+        anim_vec v0 = ANIM_LOAD(p0x + i); ANIM_STORE(opx + i, ANIM_ADD(v0, ANIM_MUL(ANIM_SUB(ANIM_LOAD(p1x + i), v0), t)));
+        v0 = ANIM_LOAD(p0y + i); ANIM_STORE(opy + i, ANIM_ADD(v0, ANIM_MUL(ANIM_SUB(ANIM_LOAD(p1y + i), v0), t)));
+        v0 = ANIM_LOAD(p0z + i); ANIM_STORE(opz + i, ANIM_ADD(v0, ANIM_MUL(ANIM_SUB(ANIM_LOAD(p1z + i), v0), t)));
+        v0 = ANIM_LOAD(s0x + i); ANIM_STORE(osx + i, ANIM_ADD(v0, ANIM_MUL(ANIM_SUB(ANIM_LOAD(s1x + i), v0), t)));
+        v0 = ANIM_LOAD(s0y + i); ANIM_STORE(osy + i, ANIM_ADD(v0, ANIM_MUL(ANIM_SUB(ANIM_LOAD(s1y + i), v0), t)));
+        v0 = ANIM_LOAD(s0z + i); ANIM_STORE(osz + i, ANIM_ADD(v0, ANIM_MUL(ANIM_SUB(ANIM_LOAD(s1z + i), v0), t)));
+
+        anim_vec ax = ANIM_LOAD(r0x + i), ay = ANIM_LOAD(r0y + i), az = ANIM_LOAD(r0z + i), aw = ANIM_LOAD(r0w + i);
+        anim_vec bx = ANIM_LOAD(r1x + i), by = ANIM_LOAD(r1y + i), bz = ANIM_LOAD(r1z + i), bw = ANIM_LOAD(r1w + i);
+
+        // Flip the second key into the first key's hemisphere, d becomes |cos(theta)|
+        anim_vec d = ANIM_ADD(ANIM_ADD(ANIM_MUL(ax, bx), ANIM_MUL(ay, by)), ANIM_ADD(ANIM_MUL(az, bz), ANIM_MUL(aw, bw)));
+        anim_vec flip = ANIM_AND(ANIM_LT(d, zero), sign_mask);
+        d = ANIM_XOR(d, flip);
+        bx = ANIM_XOR(bx, flip); by = ANIM_XOR(by, flip); bz = ANIM_XOR(bz, flip); bw = ANIM_XOR(bw, flip);
+
+        // Vector form of SlerpFactor
+        anim_vec ka = ANIM_ADD(ANIM_SET1(1.0904f), ANIM_MUL(d, ANIM_ADD(ANIM_SET1(-3.2452f), ANIM_MUL(d, ANIM_SUB(ANIM_SET1(3.55645f), ANIM_MUL(d, ANIM_SET1(1.43519f)))))));
+        anim_vec kb = ANIM_ADD(ANIM_SET1(0.848013f), ANIM_MUL(d, ANIM_ADD(ANIM_SET1(-1.06021f), ANIM_MUL(d, ANIM_SET1(0.215638f)))));
+        anim_vec th = ANIM_SUB(t, half);
+        anim_vec k = ANIM_ADD(ANIM_MUL(ka, ANIM_MUL(th, th)), kb);
+        anim_vec ot = ANIM_ADD(t, ANIM_MUL(ANIM_MUL(t, th), ANIM_MUL(ANIM_SUB(t, one), k)));
+
+        anim_vec qx = ANIM_ADD(ax, ANIM_MUL(ANIM_SUB(bx, ax), ot));
+        anim_vec qy = ANIM_ADD(ay, ANIM_MUL(ANIM_SUB(by, ay), ot));
+        anim_vec qz = ANIM_ADD(az, ANIM_MUL(ANIM_SUB(bz, az), ot));
+        anim_vec qw = ANIM_ADD(aw, ANIM_MUL(ANIM_SUB(bw, aw), ot));
+
+        anim_vec len = ANIM_SQRT(ANIM_ADD(ANIM_ADD(ANIM_MUL(qx, qx), ANIM_MUL(qy, qy)), ANIM_ADD(ANIM_MUL(qz, qz), ANIM_MUL(qw, qw))));
+        anim_vec inv = ANIM_DIV(one, len);
+        ANIM_STORE(orx + i, ANIM_MUL(qx, inv));
+        ANIM_STORE(ory + i, ANIM_MUL(qy, inv));
+        ANIM_STORE(orz + i, ANIM_MUL(qz, inv));
+        ANIM_STORE(orw + i, ANIM_MUL(qw, inv));
+    }
+#else
+    for (size_t i = 0; i < padded; i++)
+    {
+        float t = lt[i];
+        opx[i] = p0x[i] + (p1x[i] - p0x[i]) * t;
+        opy[i] = p0y[i] + (p1y[i] - p0y[i]) * t;
+        opz[i] = p0z[i] + (p1z[i] - p0z[i]) * t;
+        osx[i] = s0x[i] + (s1x[i] - s0x[i]) * t;
+        osy[i] = s0y[i] + (s1y[i] - s0y[i]) * t;
+        osz[i] = s0z[i] + (s1z[i] - s0z[i]) * t;
+
+        float bx = r1x[i], by = r1y[i], bz = r1z[i], bw = r1w[i];
+        float d = r0x[i] * bx + r0y[i] * by + r0z[i] * bz + r0w[i] * bw;
+        if (d < 0.f)
+        {
+            d = -d;
+            bx = -bx; by = -by; bz = -bz; bw = -bw;
+        }
+
+        float ot = SlerpFactor(d, t);
+        float qx = r0x[i] + (bx - r0x[i]) * ot;
+        float qy = r0y[i] + (by - r0y[i]) * ot;
+        float qz = r0z[i] + (bz - r0z[i]) * ot;
+        float qw = r0w[i] + (bw - r0w[i]) * ot;
+
+        float inv = 1.f / sqrtf(qx * qx + qy * qy + qz * qz + qw * qw);
+        orx[i] = qx * inv; ory[i] = qy * inv; orz[i] = qz * inv; orw[i] = qw * inv;
+    }
+#endif
+}
+
+/* Writes the blended poses into the transform system, unchanged poses do not dirty their node */
+void ApplyAnimations(SAnimationSystem &anim, STransformSystem &transforms)
+{
+    const float *opx = AnimationLane(anim, ANIM_OUT_PX), *opy = AnimationLane(anim, ANIM_OUT_PY), *opz = AnimationLane(anim, ANIM_OUT_PZ);
+    const float *orx = AnimationLane(anim, ANIM_OUT_RX), *ory = AnimationLane(anim, ANIM_OUT_RY), *orz = AnimationLane(anim, ANIM_OUT_RZ), *orw = AnimationLane(anim, ANIM_OUT_RW);
+    const float *osx = AnimationLane(anim, ANIM_OUT_SX), *osy = AnimationLane(anim, ANIM_OUT_SY), *osz = AnimationLane(anim, ANIM_OUT_SZ);
+
+    for (size_t i = 0; i < anim.clip.size(); i++)
+    {
+        int n = anim.node[i];
+        SetTransformPosition(transforms, n, glm::vec3(opx[i], opy[i], opz[i]));
+        SetTransformRotation(transforms, n, glm::quat(orw[i], orx[i], ory[i], orz[i]));
+        SetTransformScale(transforms, n, glm::vec3(osx[i], osy[i], osz[i]));
+    }
+}
+
+/* Advances, samples and blends every instance by dt seconds and feeds the results to the transforms */
+void UpdateAnimations(SAnimationSystem &anim, STransformSystem &transforms, float dt)
+{
+    typedef std::chrono::high_resolution_clock clock;
+
+    clock::time_point start = clock::now();
+    SampleAnimations(anim, dt);
+    clock::time_point sampled = clock::now();
+    BlendAnimations(anim);
+    clock::time_point blended = clock::now();
+    ApplyAnimations(anim, transforms);
+    clock::time_point applied = clock::now();
+
+    anim.stats.instances = (unsigned int) anim.clip.size();
+    anim.stats.sample_ms = std::chrono::duration<float, std::milli>(sampled - start).count();
+    anim.stats.blend_ms = std::chrono::duration<float, std::milli>(blended - sampled).count();
+    anim.stats.apply_ms = std::chrono::duration<float, std::milli>(applied - blended).count();
+
+    anim.totals.instances += anim.stats.instances;
+    anim.totals.sample_ms += anim.stats.sample_ms;
+    anim.totals.blend_ms += anim.stats.blend_ms;
+    anim.totals.apply_ms += anim.stats.apply_ms;
+    anim.frames++;
+}
+
+void PrintAnimationStats(const SAnimationSystem &anim)
+{
+    if (anim.frames == 0)
+        return;
+
+    float f = (float) anim.frames;
+    printf("INFO: Animation - %u frames, %d-wide SIMD, %d clips, per frame averages:\n", anim.frames, ANIM_LANES, (int) anim.clips.size());
+    printf("INFO:   instances:   %.1f\n", (float) anim.totals.instances / f);
+    printf("INFO:   sample:      %.4f ms\n", anim.totals.sample_ms / f);
+    printf("INFO:   blend:       %.4f ms\n", anim.totals.blend_ms / f);
+    printf("INFO:   apply:       %.4f ms\n", anim.totals.apply_ms / f);
+}
+
+/* Benchmark: instance_count objects playing random clips, the batched evaluation against a scalar
+ * glm::mix/glm::slerp evaluation of the same keys, with the largest rotation error between them */
+int BenchmarkAnimation(int instance_count)
+{
+    const int frames = 100;
+    const int clip_count = 64;
+    const float dt = 1.f / 60.f;
+    srand(4321);
+
+    SAnimationSystem anim;
+    InitAnimationSystem(anim);
+    STransformSystem transforms;
+    InitTransformSystem(transforms, instance_count);
+
+    // Clips of 4 to 32 keys with random poses, spaced 0.1 to 0.5 seconds apart
+    std::vector<float> times;
+    std::vector<glm::vec3> positions, scales;
+    std::vector<glm::quat> rotations;
+    for (int c = 0; c < clip_count; c++)
+    {
+        int keys = 4 + rand() % 29;
+        times.resize(keys);
+        positions.resize(keys);
+        rotations.resize(keys);
+        scales.resize(keys);
+
+        float t = 0.f;
+        for (int k = 0; k < keys; k++)
+        {
+            times[k] = t;
+            t += 0.1f + (float) (rand() % 400) * 0.001f;
+
+            positions[k] = glm::vec3((float) (rand() % 200 - 100) * 0.01f, (float) (rand() % 200 - 100) * 0.01f, (float) (rand() % 200 - 100) * 0.01f);
+            glm::vec3 axis = glm::normalize(glm::vec3((float) (rand() % 200 - 100) + 0.5f, (float) (rand() % 200 - 100), (float) (rand() % 200 - 100)));
+            rotations[k] = glm::angleAxis(glm::radians((float) (rand() % 360)), axis);
+            float s = 0.5f + (float) (rand() % 100) * 0.01f;
+            scales[k] = glm::vec3(s, s, s);
+        }
+        AddAnimationClip(anim, times.data(), positions.data(), rotations.data(), scales.data(), keys);
+    }
+
+    for (int i = 0; i < instance_count; i++)
+    {
+        int node = AddTransformNode(transforms, -1, glm::vec3(0.f), glm::quat(1.f, 0.f, 0.f, 0.f), glm::vec3(1.f));
+        AddAnimationInstance(anim, rand() % clip_count, node, (float) (rand() % 1000) * 0.01f, 0.5f + (float) (rand() % 100) * 0.01f);
+    }
+
+    typedef std::chrono::high_resolution_clock clock;
+
+    // Batched path, sampling and blending only, then with the write back into the transforms
+    float sample_ms = 0.f, blend_ms = 0.f;
+    for (int f = 0; f < frames; f++)
+    {
+        clock::time_point start = clock::now();
+        SampleAnimations(anim, dt);
+        clock::time_point sampled = clock::now();
+        BlendAnimations(anim);
+        sample_ms += std::chrono::duration<float, std::milli>(sampled - start).count();
+        blend_ms += std::chrono::duration<float, std::milli>(clock::now() - sampled).count();
+    }
+
+    float applied_ms = 0.f;
+    for (int f = 0; f < frames; f++)
+    {
+        clock::time_point start = clock::now();
+        UpdateAnimations(anim, transforms, dt);
+        applied_ms += std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    }
+
+    // Scalar reference on the keys sampled by the last frame
+    std::vector<glm::vec3> ref_position(instance_count), ref_scale(instance_count);
+    std::vector<glm::quat> ref_rotation(instance_count);
+    float scalar_ms = 0.f;
+    for (int f = 0; f < frames; f++)
+    {
+        clock::time_point start = clock::now();
+        for (int i = 0; i < instance_count; i++)
+        {
+            float t = AnimationLane(anim, ANIM_T)[i];
+            glm::vec3 p0(AnimationLane(anim, ANIM_P0X)[i], AnimationLane(anim, ANIM_P0Y)[i], AnimationLane(anim, ANIM_P0Z)[i]);
+            glm::vec3 p1(AnimationLane(anim, ANIM_P1X)[i], AnimationLane(anim, ANIM_P1Y)[i], AnimationLane(anim, ANIM_P1Z)[i]);
+            glm::vec3 s0(AnimationLane(anim, ANIM_S0X)[i], AnimationLane(anim, ANIM_S0Y)[i], AnimationLane(anim, ANIM_S0Z)[i]);
+            glm::vec3 s1(AnimationLane(anim, ANIM_S1X)[i], AnimationLane(anim, ANIM_S1Y)[i], AnimationLane(anim, ANIM_S1Z)[i]);
+            glm::quat r0(AnimationLane(anim, ANIM_R0W)[i], AnimationLane(anim, ANIM_R0X)[i], AnimationLane(anim, ANIM_R0Y)[i], AnimationLane(anim, ANIM_R0Z)[i]);
+            glm::quat r1(AnimationLane(anim, ANIM_R1W)[i], AnimationLane(anim, ANIM_R1X)[i], AnimationLane(anim, ANIM_R1Y)[i], AnimationLane(anim, ANIM_R1Z)[i]);
+
+            ref_position[i] = glm::mix(p0, p1, t);
+            ref_scale[i] = glm::mix(s0, s1, t);
+            ref_rotation[i] = glm::slerp(r0, r1, t);
+        }
+        scalar_ms += std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    }
+
+    float max_error = 0.f;
+    for (int i = 0; i < instance_count; i++)
+    {
+        const glm::quat &r = ref_rotation[i];
+        float d = fabsf(r.x * AnimationLane(anim, ANIM_OUT_RX)[i] + r.y * AnimationLane(anim, ANIM_OUT_RY)[i] +
+                        r.z * AnimationLane(anim, ANIM_OUT_RZ)[i] + r.w * AnimationLane(anim, ANIM_OUT_RW)[i]);
+        // Angle between the two rotations
+        float error = 2.f * acosf(d < 1.f ? d : 1.f);
+        if (error > max_error)
+            max_error = error;
+    }
+
+    printf("INFO: Animation Benchmark - %d instances, %d clips, %d frames each, %d-wide SIMD\n",
+           instance_count, clip_count, frames, ANIM_LANES);
+    printf("INFO:   sample + blend:          %.3f ms/frame (%.0f objects/ms)\n",
+           (sample_ms + blend_ms) / frames, (float) instance_count * frames / (sample_ms + blend_ms));
+    printf("INFO:   blend only:              %.3f ms/frame (%.0f objects/ms)\n",
+           blend_ms / frames, (float) instance_count * frames / blend_ms);
+    printf("INFO:   with transform write:    %.3f ms/frame (%.0f objects/ms)\n",
+           applied_ms / frames, (float) instance_count * frames / applied_ms);
+    printf("INFO:   scalar glm blend only:   %.3f ms/frame (%.0f objects/ms)\n",
+           scalar_ms / frames, (float) instance_count * frames / scalar_ms);
+    printf("INFO:   max rotation error:      %.5f degrees\n", glm::degrees(max_error));
+
+    return 0;
+}
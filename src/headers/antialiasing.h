@@ -0,0 +1,319 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstring>
+
+/* ---- OpenGL Headers ---- */
+#include <glad/glad.h>
+
+/* ---- Header Files ---- */
+#include "gl_state.h"
+#include "shader.h"
+#include "memory.h"
+
+/* ---- Definitions ---- */
+// GPU times are read back this many frames after they were issued so that reading never stalls
+#define AA_QUERY_LATENCY 4
+
+// Bytes per pixel and sample of the RGBA8 colour and DEPTH24_STENCIL8 depth buffers
+#define AA_COLOR_BYTES 4
+#define AA_DEPTH_BYTES 4
+
+// The samples the window used to request, only used to report what a mode saves
+#define AA_LEGACY_SAMPLES 16
+
+enum EAntiAliasingMode
+{
+    AA_OFF,
+    AA_MSAA_2,
+    AA_MSAA_4,
+    AA_MSAA_8,
+    AA_FXAA,
+    AA_MODE_COUNT
+};
+
+const char *aa_mode_names[AA_MODE_COUNT] = { "off", "msaa2", "msaa4", "msaa8", "fxaa" };
+const int aa_mode_samples[AA_MODE_COUNT] = { 0, 2, 4, 8, 0 };
+
+// GPU timestamps of one frame: scene start, resolve start and resolve end
+struct SAntiAliasingQueries
+{
+    unsigned int queries[3];
+    bool pending;
+};
+
+// MSAA modes draw into a multisampled FBO that is resolved by a blit, FXAA draws into a single sample
+// texture that a post pass filters into the output. Like the dynamic resolution target the buffers
+// have the size of the output and a frame may only use the bottom left render_width x render_height.
+struct SAntiAliasing
+{
+    EAntiAliasingMode mode;
+    int samples;
+
+    unsigned int fbo;
+    unsigned int color_buffer;      // multisampled renderbuffer, or the texture FXAA reads
+    unsigned int depth_buffer;
+    int width;
+    int height;
+    int render_width;
+    int render_height;
+    size_t memory_bytes;
+
+    unsigned int program;
+    unsigned int vao;
+    int region_loc;
+    int texel_loc;
+
+    SAntiAliasingQueries frame_queries[AA_QUERY_LATENCY];
+    int query;
+
+    unsigned int frames;
+    unsigned int samples_read;
+    double frame_ms_sum;
+    double resolve_ms_sum;
+};
+
+/* Looks up a mode by its name, returns false for an unknown name */
+bool ParseAntiAliasingMode(const char *name, EAntiAliasingMode &mode)
+{
+    for (int i = 0; i < AA_MODE_COUNT; i++)
+    {
+        if (strcmp(name, aa_mode_names[i]) == 0)
+        {
+            mode = (EAntiAliasingMode) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Allocates the buffers of the mode for an output of width x height */
+bool ResizeAntiAliasing(SAntiAliasing &aa, int width, int height)
+{
+    aa.width = width;
+    aa.height = height;
+    aa.memory_bytes = 0;
+    if (aa.mode == AA_OFF || width <= 0 || height <= 0)
+        return true;
+
+    if (aa.fbo == 0)
+    {
+        glGenFramebuffers(1, &aa.fbo);
+        glGenRenderbuffers(1, &aa.depth_buffer);
+        if (aa.mode == AA_FXAA)
+            glGenTextures(1, &aa.color_buffer);
+        else
+            glGenRenderbuffers(1, &aa.color_buffer);
+    }
+
+    size_t pixels = (size_t) width * (size_t) height;
+    size_t samples = aa.samples > 0 ? (size_t) aa.samples : 1;
+
+    if (aa.mode == AA_FXAA)
+    {
+        // FXAA taps between texels, so the source is filtered linearly
+        BindTexture(gl_state, 0, aa.color_buffer);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, aa.depth_buffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    }
+    else
+    {
+        glBindRenderbuffer(GL_RENDERBUFFER, aa.color_buffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, aa.samples, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, aa.depth_buffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, aa.samples, GL_DEPTH24_STENCIL8, width, height);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    BindFramebuffer(gl_state, GL_FRAMEBUFFER, aa.fbo);
+    if (aa.mode == AA_FXAA)
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, aa.color_buffer, 0);
+    else
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, aa.color_buffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, aa.depth_buffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        printf("ERROR: Anti-Aliasing - Framebuffer for %s is incomplete.\n", aa_mode_names[aa.mode]);
+        return false;
+    }
+
+    aa.memory_bytes = pixels * samples * (AA_COLOR_BYTES + AA_DEPTH_BYTES);
+    ReleaseMemory(memory_tracker, &aa, MEMORY_RENDER_TARGETS);
+    TrackMemory(memory_tracker, "anti-aliasing target", MEMORY_RENDER_TARGETS, MEMORY_GPU, &aa, aa.memory_bytes);
+    printf("INFO: Anti-Aliasing - %s target %dx%d, %.2f MB\n", aa_mode_names[aa.mode], width, height, (double) aa.memory_bytes / (1024.0 * 1024.0));
+    return true;
+}
+
+/* Creates the buffers, shader and timer queries of a mode, needs a current GL context */
+bool InitAntiAliasing(SAntiAliasing &aa, EAntiAliasingMode mode, int width, int height)
+{
+    aa.mode = mode;
+    aa.samples = aa_mode_samples[mode];
+    aa.fbo = 0;
+    aa.program = 0;
+    aa.vao = 0;
+
+    aa.frames = 0;
+    aa.samples_read = 0;
+    aa.frame_ms_sum = 0.0;
+    aa.resolve_ms_sum = 0.0;
+
+    // Drivers cap the sample count, fall back to the highest one available
+    if (aa.samples > 0)
+    {
+        GLint max_samples = 0;
+        glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+        if (aa.samples > max_samples)
+        {
+            printf("INFO: Anti-Aliasing - %d samples requested, the driver supports %d\n", aa.samples, max_samples);
+            aa.samples = max_samples;
+        }
+    }
+
+    if (mode == AA_FXAA)
+    {
+        aa.program = LoadShader("shaders/upscale.vert", "shaders/fxaa.frag");
+        aa.region_loc = glGetUniformLocation(aa.program, "region");
+        aa.texel_loc = glGetUniformLocation(aa.program, "texel");
+        UseProgram(gl_state, aa.program);
+        glUniform1i(glGetUniformLocation(aa.program, "Source"), 0);
+
+        // Core profile draws need a VAO even when the vertices come from gl_VertexID
+        glGenVertexArrays(1, &aa.vao);
+    }
+
+    for (int i = 0; i < AA_QUERY_LATENCY; i++)
+    {
+        glGenQueries(3, aa.frame_queries[i].queries);
+        aa.frame_queries[i].pending = false;
+    }
+    aa.query = 0;
+
+    return ResizeAntiAliasing(aa, width, height);
+}
+
+/* Collects the GPU times of the frame issued AA_QUERY_LATENCY frames ago, then binds the scene target of the
+ * mode with a render_width x render_height viewport. Off leaves the current framebuffer bound. */
+void BeginAntiAliasingFrame(SAntiAliasing &aa, int render_width, int render_height)
+{
+    aa.query = (aa.query + 1) % AA_QUERY_LATENCY;
+    SAntiAliasingQueries &frame = aa.frame_queries[aa.query];
+
+    if (frame.pending)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[2], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 t[3];
+            for (int i = 0; i < 3; i++)
+                glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &t[i]);
+
+            // Some drivers (llvmpipe) report garbage for the very first query, a frame never takes 10 s
+            if (t[2] >= t[1] && t[1] >= t[0] && t[2] - t[0] < 10000000000ull)
+            {
+                aa.frame_ms_sum += (double) (t[2] - t[0]) / 1e6;
+                aa.resolve_ms_sum += (double) (t[2] - t[1]) / 1e6;
+                aa.samples_read++;
+            }
+        }
+        frame.pending = false;
+    }
+
+    glQueryCounter(frame.queries[0], GL_TIMESTAMP);
+
+    aa.render_width = render_width;
+    aa.render_height = render_height;
+    if (aa.mode != AA_OFF)
+    {
+        BindFramebuffer(gl_state, GL_FRAMEBUFFER, aa.fbo);
+        SetViewport(gl_state, 0, 0, render_width, render_height);
+    }
+    aa.frames++;
+}
+
+/* Resolves the scene into the bottom left region of the output framebuffer, which must be as large as the render size */
+void EndAntiAliasingFrame(SAntiAliasing &aa, unsigned int output_fbo)
+{
+    SAntiAliasingQueries &frame = aa.frame_queries[aa.query];
+    glQueryCounter(frame.queries[1], GL_TIMESTAMP);
+
+    int w = aa.render_width;
+    int h = aa.render_height;
+
+    if (aa.mode == AA_FXAA)
+    {
+        BindFramebuffer(gl_state, GL_FRAMEBUFFER, output_fbo);
+        SetViewport(gl_state, 0, 0, w, h);
+        SetCapability(gl_state, GL_CAP_DEPTH_TEST, false);
+
+        UseProgram(gl_state, aa.program);
+        BindTexture(gl_state, 0, aa.color_buffer);
+        BindVertexArray(gl_state, aa.vao);
+        glUniform2f(aa.region_loc, (float) w / (float) aa.width, (float) h / (float) aa.height);
+        glUniform2f(aa.texel_loc, 1.f / (float) aa.width, 1.f / (float) aa.height);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        SetCapability(gl_state, GL_CAP_DEPTH_TEST, true);
+    }
+    else if (aa.mode != AA_OFF)
+    {
+        // A blit out of a multisampled buffer averages the samples of each pixel
+        BindFramebuffer(gl_state, GL_READ_FRAMEBUFFER, aa.fbo);
+        BindFramebuffer(gl_state, GL_DRAW_FRAMEBUFFER, output_fbo);
+        glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        BindFramebuffer(gl_state, GL_FRAMEBUFFER, output_fbo);
+    }
+
+    glQueryCounter(frame.queries[2], GL_TIMESTAMP);
+    frame.pending = true;
+}
+
+void DeleteAntiAliasing(SAntiAliasing &aa)
+{
+    for (int i = 0; i < AA_QUERY_LATENCY; i++)
+        glDeleteQueries(3, aa.frame_queries[i].queries);
+
+    if (aa.fbo != 0)
+    {
+        glDeleteFramebuffers(1, &aa.fbo);
+        glDeleteRenderbuffers(1, &aa.depth_buffer);
+        if (aa.mode == AA_FXAA)
+            glDeleteTextures(1, &aa.color_buffer);
+        else
+            glDeleteRenderbuffers(1, &aa.color_buffer);
+        ReleaseMemory(memory_tracker, &aa, MEMORY_RENDER_TARGETS);
+    }
+    if (aa.program != 0)
+    {
+        glDeleteVertexArrays(1, &aa.vao);
+        glDeleteProgram(aa.program);
+    }
+    ResetGLState(gl_state);
+}
+
+void PrintAntiAliasingStats(const SAntiAliasing &aa)
+{
+    if (aa.frames == 0)
+        return;
+
+    double legacy_bytes = (double) aa.width * (double) aa.height * AA_LEGACY_SAMPLES * (AA_COLOR_BYTES + AA_DEPTH_BYTES);
+
+    printf("INFO: Anti-Aliasing - %s", aa_mode_names[aa.mode]);
+    if (aa.samples > 0)
+        printf(" (%d samples)", aa.samples);
+    printf(", %u frames at %dx%d:\n", aa.frames, aa.width, aa.height);
+    printf("INFO:   offscreen buffers: %.2f MB, %dx MSAA would take %.2f MB\n",
+           (double) aa.memory_bytes / (1024.0 * 1024.0), AA_LEGACY_SAMPLES, legacy_bytes / (1024.0 * 1024.0));
+    if (aa.samples_read > 0)
+        printf("INFO:   GPU frame time: %.4f ms average, of which resolve %.4f ms\n",
+               aa.frame_ms_sum / (double) aa.samples_read, aa.resolve_ms_sum / (double) aa.samples_read);
+}
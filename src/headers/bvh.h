@@ -0,0 +1,812 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+/* ---- GLM Includes ---- */
+#ifdef _WIN32
+#include <glm/glm/glm.hpp>
+#endif
+
+#ifdef __unix
+#include <glm/glm.hpp>
+#endif
+
+/* ---- Header Files ---- */
+#include "mesh.h"
+#include "jobs.h"
+#include "memory.h"
+
+// Bounding volume hierarchies for ray picking: one over the triangles of each mesh, built once at
+// load time, and one over the object instances, rebuilt whenever they move. No OpenGL is involved.
+
+/* ---- Definitions ---- */
+// Buckets each axis is split into when looking for the cheapest surface area split
+#define BVH_BINS 16
+
+// Nodes with this many primitives or fewer always become leaves
+#define BVH_LEAF_SIZE 2
+
+// Nodes with more primitives than this build their two children as separate jobs
+#define BVH_PARALLEL_SIZE 8192
+
+// Traversal stack. Nodes at BVH_MAX_DEPTH are left as leaves, however many primitives they hold, so a
+// traversal never has more than BVH_MAX_DEPTH + 1 nodes waiting and the stack cannot overflow.
+#define BVH_STACK_SIZE 64
+#define BVH_MAX_DEPTH  (BVH_STACK_SIZE - 1)
+
+// A node is a leaf when count > 0, then its primitives are indices[left_first, left_first + count).
+// Otherwise its children are the nodes left_first and left_first + 1.
+struct SBvhNode
+{
+    glm::vec3 min;
+    int left_first;
+    glm::vec3 max;
+    int count;
+};
+
+struct SBvh
+{
+    std::vector<SBvhNode> nodes;
+    std::vector<unsigned int> indices;
+    int node_count;
+};
+
+// Triangle in leaf order, stored as a corner and two edges for the intersection test
+struct SBvhTriangle
+{
+    glm::vec3 v0;
+    glm::vec3 e1;
+    glm::vec3 e2;
+};
+
+struct SMeshBvh
+{
+    SBvh bvh;
+    std::vector<SBvhTriangle> triangles;    // triangles[i] is the triangle bvh.indices[i] of the mesh
+};
+
+// A placed mesh, its world bounds are what the top level hierarchy is built over
+struct SBvhInstance
+{
+    int mesh;
+    glm::mat4 model;
+    glm::mat4 inverse;
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct SBvhRay
+{
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+struct SBvhHit
+{
+    int object;     // instance index, -1 for a miss
+    int triangle;   // triangle of the instance's mesh, in index buffer order
+    float t;        // distance along the ray direction
+    float u, v;     // barycentrics of the hit within the triangle
+};
+
+struct SSceneBvh
+{
+    std::vector<SMeshBvh> meshes;
+    std::vector<SBvhInstance> instances;
+    SBvh top;
+
+    float build_ms;
+    unsigned int triangle_count;
+
+    unsigned int picks;
+    float pick_us;
+};
+
+// Shared state of one build, node slots are handed out from the atomic counter
+struct SBvhBuilder
+{
+    SBvh *bvh;
+    const glm::vec3 *prim_min;
+    const glm::vec3 *prim_max;
+    const glm::vec3 *centroid;
+    SJobSystem *jobs;
+    std::atomic<int> next_node;
+};
+
+struct SBvhChildren
+{
+    SBvhBuilder *builder;
+    int first;
+    int depth;
+};
+
+inline float BvhArea(const glm::vec3 &min, const glm::vec3 &max)
+{
+    glm::vec3 e = max - min;
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+void UpdateBvhNodeBounds(SBvhBuilder &builder, SBvhNode &node)
+{
+    node.min = glm::vec3(FLT_MAX);
+    node.max = glm::vec3(-FLT_MAX);
+    for (int i = 0; i < node.count; i++)
+    {
+        unsigned int p = builder.bvh->indices[node.left_first + i];
+        node.min = glm::min(node.min, builder.prim_min[p]);
+        node.max = glm::max(node.max, builder.prim_max[p]);
+    }
+}
+
+void SubdivideBvhNode(SBvhBuilder &builder, int node_index, int depth);
+
+void SubdivideBvhChildJob(void *data, int index)
+{
+    SBvhChildren &children = *(SBvhChildren *) data;
+    SubdivideBvhNode(*children.builder, children.first + index, children.depth);
+}
+
+/* Splits a node at the cheapest of the binned surface area heuristic planes, or leaves it a leaf
+ * when no split is cheaper than intersecting all of its primitives or it is at the depth limit */
+void SubdivideBvhNode(SBvhBuilder &builder, int node_index, int depth)
+{
+    SBvh &bvh = *builder.bvh;
+    SBvhNode &node = bvh.nodes[node_index];
+    if (node.count <= BVH_LEAF_SIZE || depth >= BVH_MAX_DEPTH)
+        return;
+
+    unsigned int *indices = bvh.indices.data() + node.left_first;
+
+    glm::vec3 cmin(FLT_MAX), cmax(-FLT_MAX);
+    for (int i = 0; i < node.count; i++)
+    {
+        cmin = glm::min(cmin, builder.centroid[indices[i]]);
+        cmax = glm::max(cmax, builder.centroid[indices[i]]);
+    }
+
+    int best_axis = -1, best_split = 0;
+    float best_cost = (float) node.count * BvhArea(node.min, node.max);
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float extent = cmax[axis] - cmin[axis];
+        if (extent <= 0.f)
+            continue;
+
+        int bin_count[BVH_BINS] = { 0 };
+        glm::vec3 bin_min[BVH_BINS], bin_max[BVH_BINS];
+        for (int b = 0; b < BVH_BINS; b++)
+        {
+            bin_min[b] = glm::vec3(FLT_MAX);
+            bin_max[b] = glm::vec3(-FLT_MAX);
+        }
+
+        float scale = (float) BVH_BINS / extent;
+        for (int i = 0; i < node.count; i++)
+        {
+            unsigned int p = indices[i];
+            int b = std::min(BVH_BINS - 1, (int) ((builder.centroid[p][axis] - cmin[axis]) * scale));
+            bin_count[b]++;
+            bin_min[b] = glm::min(bin_min[b], builder.prim_min[p]);
+            bin_max[b] = glm::max(bin_max[b], builder.prim_max[p]);
+        }
+
+        // Sweep from both sides, plane s puts bins [0, s) on the left
+        float left_area[BVH_BINS - 1], right_area[BVH_BINS - 1];
+        int left_count[BVH_BINS - 1], right_count[BVH_BINS - 1];
+        glm::vec3 lmin(FLT_MAX), lmax(-FLT_MAX), rmin(FLT_MAX), rmax(-FLT_MAX);
+        int lsum = 0, rsum = 0;
+        for (int s = 0; s < BVH_BINS - 1; s++)
+        {
+            lsum += bin_count[s];
+            lmin = glm::min(lmin, bin_min[s]);
+            lmax = glm::max(lmax, bin_max[s]);
+            left_count[s] = lsum;
+            left_area[s] = lsum > 0 ? BvhArea(lmin, lmax) : 0.f;
+
+            int r = BVH_BINS - 1 - s;
+            rsum += bin_count[r];
+            rmin = glm::min(rmin, bin_min[r]);
+            rmax = glm::max(rmax, bin_max[r]);
+            right_count[r - 1] = rsum;
+            right_area[r - 1] = rsum > 0 ? BvhArea(rmin, rmax) : 0.f;
+        }
+
+        for (int s = 0; s < BVH_BINS - 1; s++)
+        {
+            float cost = (float) left_count[s] * left_area[s] + (float) right_count[s] * right_area[s];
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = s + 1;
+            }
+        }
+    }
+
+    if (best_axis < 0)
+        return;
+
+    // Partition the primitives in place around the chosen plane
+    float scale = (float) BVH_BINS / (cmax[best_axis] - cmin[best_axis]);
+    int i = 0, j = node.count - 1;
+    while (i <= j)
+    {
+        int b = std::min(BVH_BINS - 1, (int) ((builder.centroid[indices[i]][best_axis] - cmin[best_axis]) * scale));
+        if (b < best_split)
+            i++;
+        else
+            std::swap(indices[i], indices[j--]);
+    }
+
+    if (i == 0 || i == node.count)
+        return;
+
+    int left = builder.next_node.fetch_add(2);
+    SBvhNode &left_node = bvh.nodes[left];
+    SBvhNode &right_node = bvh.nodes[left + 1];
+    left_node.left_first = node.left_first;
+    left_node.count = i;
+    right_node.left_first = node.left_first + i;
+    right_node.count = node.count - i;
+    UpdateBvhNodeBounds(builder, left_node);
+    UpdateBvhNodeBounds(builder, right_node);
+
+    int count = node.count;
+    node.left_first = left;
+    node.count = 0;
+
+    if (builder.jobs != NULL && count > BVH_PARALLEL_SIZE)
+    {
+        SBvhChildren children = { &builder, left, depth + 1 };
+        ParallelFor(*builder.jobs, 2, SubdivideBvhChildJob, &children);
+    }
+    else
+    {
+        SubdivideBvhNode(builder, left, depth + 1);
+        SubdivideBvhNode(builder, left + 1, depth + 1);
+    }
+}
+
+/* Builds a hierarchy over count primitives given by their bounds and centroids, the large
+ * subtrees are built on the job workers when jobs is set */
+void BuildBvh(SBvh &bvh, const glm::vec3 *prim_min, const glm::vec3 *prim_max, const glm::vec3 *centroid,
+              unsigned int count, SJobSystem *jobs)
+{
+    bvh.indices.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+        bvh.indices[i] = i;
+
+    // A binary tree over n leaves has at most 2n - 1 nodes, slot 1 stays empty so siblings share a cache line
+    bvh.nodes.resize(std::max(2u * count, 2u));
+
+    SBvhBuilder builder;
+    builder.bvh = &bvh;
+    builder.prim_min = prim_min;
+    builder.prim_max = prim_max;
+    builder.centroid = centroid;
+    builder.jobs = jobs;
+    builder.next_node = 2;
+
+    SBvhNode &root = bvh.nodes[0];
+    root.left_first = 0;
+    root.count = (int) count;
+    UpdateBvhNodeBounds(builder, root);
+    SubdivideBvhNode(builder, 0, 0);
+
+    bvh.node_count = builder.next_node.load();
+}
+
+/* Builds the triangle hierarchy of one registered mesh, reading the registry's CPU copy */
+void BuildMeshBvh(SMeshBvh &mesh_bvh, const SMeshRegistry &registry, int mesh, SJobSystem *jobs)
+{
+    const SMesh &source = registry.meshes[mesh];
+    unsigned int count = (unsigned int) source.index_count / 3;
+    const unsigned int *indices = registry.indices.data() + source.first_index;
+    const float *vertices = registry.vertices.data() + (size_t) source.base_vertex * MESH_VERTEX_FLOATS;
+
+    // Slots reserved for streamed meshes have no triangles until they are loaded
+    if (count == 0)
+    {
+        mesh_bvh.bvh.nodes.clear();
+        mesh_bvh.bvh.indices.clear();
+        mesh_bvh.bvh.node_count = 0;
+        mesh_bvh.triangles.clear();
+        return;
+    }
+
+    std::vector<glm::vec3> corners((size_t) count * 3);
+    std::vector<glm::vec3> prim_min(count), prim_max(count), centroid(count);
+    for (unsigned int t = 0; t < count; t++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            const float *p = vertices + (size_t) indices[t * 3 + k] * MESH_VERTEX_FLOATS;
+            corners[t * 3 + k] = glm::vec3(p[0], p[1], p[2]);
+        }
+        prim_min[t] = glm::min(corners[t * 3], glm::min(corners[t * 3 + 1], corners[t * 3 + 2]));
+        prim_max[t] = glm::max(corners[t * 3], glm::max(corners[t * 3 + 1], corners[t * 3 + 2]));
+        centroid[t] = (prim_min[t] + prim_max[t]) * 0.5f;
+    }
+
+    BuildBvh(mesh_bvh.bvh, prim_min.data(), prim_max.data(), centroid.data(), count, jobs);
+
+    // Store the triangles in leaf order so a leaf reads one contiguous range
+    mesh_bvh.triangles.resize(count);
+    for (unsigned int i = 0; i < count; i++)
+    {
+        unsigned int t = mesh_bvh.bvh.indices[i];
+        SBvhTriangle &tri = mesh_bvh.triangles[i];
+        tri.v0 = corners[t * 3];
+        tri.e1 = corners[t * 3 + 1] - tri.v0;
+        tri.e2 = corners[t * 3 + 2] - tri.v0;
+    }
+}
+
+struct SMeshBvhBuild
+{
+    SSceneBvh *scene;
+    const SMeshRegistry *registry;
+    SJobSystem *jobs;
+};
+
+void BuildMeshBvhJob(void *data, int index)
+{
+    SMeshBvhBuild &build = *(SMeshBvhBuild *) data;
+    BuildMeshBvh(build.scene->meshes[index], *build.registry, index, build.jobs);
+}
+
+/* Builds the hierarchy of every registered mesh, one job per mesh, must run before the registry is uploaded */
+void BuildSceneBvh(SSceneBvh &scene, const SMeshRegistry &registry, SJobSystem &jobs)
+{
+    typedef std::chrono::high_resolution_clock clock;
+    clock::time_point start = clock::now();
+
+    scene.meshes.resize(registry.meshes.size());
+    scene.instances.clear();
+    scene.top.node_count = 0;
+    scene.picks = 0;
+    scene.pick_us = 0.f;
+
+    SMeshBvhBuild build = { &scene, &registry, &jobs };
+    ParallelFor(jobs, (int) registry.meshes.size(), BuildMeshBvhJob, &build);
+
+    scene.build_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+    scene.triangle_count = 0;
+    int nodes = 0;
+    size_t bytes = 0;
+    for (size_t m = 0; m < scene.meshes.size(); m++)
+    {
+        const SMeshBvh &mesh_bvh = scene.meshes[m];
+        scene.triangle_count += (unsigned int) mesh_bvh.triangles.size();
+        nodes += mesh_bvh.bvh.node_count;
+        bytes += sizeof(SBvhNode) * mesh_bvh.bvh.nodes.capacity() + sizeof(unsigned int) * mesh_bvh.bvh.indices.capacity() +
+                 sizeof(SBvhTriangle) * mesh_bvh.triangles.capacity();
+    }
+
+    // Picking keeps its own copy of the triangles, so the registry's CPU copy is not needed after this
+    TrackMemory(memory_tracker, "scene bvh", MEMORY_PICKING, MEMORY_HOST, &scene, bytes);
+
+    printf("INFO: BVH - %d meshes, %u triangles, %d nodes built in %.3f ms on %d workers\n",
+           (int) scene.meshes.size(), scene.triangle_count, nodes, scene.build_ms, jobs.worker_count);
+}
+
+/* Adds a pickable instance of a mesh and returns its object index, place it with UpdateSceneBvhInstances */
+int AddSceneBvhInstance(SSceneBvh &scene, int mesh)
+{
+    SBvhInstance instance;
+    instance.mesh = mesh;
+    instance.model = glm::mat4(1.f);
+    instance.inverse = glm::mat4(1.f);
+    instance.min = glm::vec3(0.f);
+    instance.max = glm::vec3(0.f);
+    scene.instances.push_back(instance);
+    return (int) scene.instances.size() - 1;
+}
+
+/* Moves every instance to its new model matrix and rebuilds the top level hierarchy over them.
+ * Instances without a mesh (-1) or of a mesh that is not loaded are left out of the hierarchy. */
+void UpdateSceneBvhInstances(SSceneBvh &scene, const glm::mat4 *models)
+{
+    size_t count = scene.instances.size();
+    std::vector<glm::vec3> prim_min, prim_max, centroid;
+    std::vector<unsigned int> placed;
+    prim_min.reserve(count);
+    prim_max.reserve(count);
+    centroid.reserve(count);
+    placed.reserve(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        SBvhInstance &instance = scene.instances[i];
+        instance.model = models[i];
+        instance.inverse = glm::inverse(models[i]);
+        if (instance.mesh < 0 || scene.meshes[instance.mesh].bvh.nodes.empty())
+            continue;
+
+        // World bounds of the mesh root box, from its 8 transformed corners
+        const SBvhNode &root = scene.meshes[instance.mesh].bvh.nodes[0];
+        instance.min = glm::vec3(FLT_MAX);
+        instance.max = glm::vec3(-FLT_MAX);
+        for (int c = 0; c < 8; c++)
+        {
+            glm::vec3 corner((c & 1) ? root.max.x : root.min.x, (c & 2) ? root.max.y : root.min.y, (c & 4) ? root.max.z : root.min.z);
+            glm::vec3 world = glm::vec3(instance.model * glm::vec4(corner, 1.f));
+            instance.min = glm::min(instance.min, world);
+            instance.max = glm::max(instance.max, world);
+        }
+
+        prim_min.push_back(instance.min);
+        prim_max.push_back(instance.max);
+        centroid.push_back((instance.min + instance.max) * 0.5f);
+        placed.push_back((unsigned int) i);
+    }
+
+    if (placed.empty())
+    {
+        scene.top.nodes.clear();
+        scene.top.indices.clear();
+        scene.top.node_count = 0;
+        return;
+    }
+
+    BuildBvh(scene.top, prim_min.data(), prim_max.data(), centroid.data(), (unsigned int) placed.size(), NULL);
+
+    // The leaves refer to the placed instances, point them back at the object indices
+    for (size_t i = 0; i < placed.size(); i++)
+        scene.top.indices[i] = placed[scene.top.indices[i]];
+}
+
+/* Slab test, returns the entry distance or FLT_MAX when the box is missed or further than t_max */
+inline float IntersectBvhBounds(const glm::vec3 &origin, const glm::vec3 &inv_direction,
+                                const glm::vec3 &min, const glm::vec3 &max, float t_max)
+{
+    glm::vec3 t0 = (min - origin) * inv_direction;
+    glm::vec3 t1 = (max - origin) * inv_direction;
+    glm::vec3 entry = glm::min(t0, t1);
+    glm::vec3 exit = glm::max(t0, t1);
+    float t_near = std::max(std::max(entry.x, entry.y), std::max(entry.z, 0.f));
+    float t_far = std::min(std::min(exit.x, exit.y), std::min(exit.z, t_max));
+    return t_near <= t_far ? t_near : FLT_MAX;
+}
+
+/* Möller-Trumbore, both sides of the triangle count as the scene is drawn without face culling */
+inline bool IntersectBvhTriangle(const SBvhRay &ray, const SBvhTriangle &tri, float &t, float &u, float &v)
+{
+    glm::vec3 p = glm::cross(ray.direction, tri.e2);
+    float det = glm::dot(tri.e1, p);
+    if (fabsf(det) < 1e-12f)
+        return false;
+
+    float inv_det = 1.f / det;
+    glm::vec3 s = ray.origin - tri.v0;
+    u = glm::dot(s, p) * inv_det;
+    if (u < 0.f || u > 1.f)
+        return false;
+
+    glm::vec3 q = glm::cross(s, tri.e1);
+    v = glm::dot(ray.direction, q) * inv_det;
+    if (v < 0.f || u + v > 1.f)
+        return false;
+
+    t = glm::dot(tri.e2, q) * inv_det;
+    return t > 0.f;
+}
+
+inline glm::vec3 BvhInverseDirection(const glm::vec3 &direction)
+{
+    // Axis parallel rays get a huge rather than an infinite inverse, which keeps 0 * inf out of the slab test
+    return glm::vec3(1.f / (fabsf(direction.x) > 1e-20f ? direction.x : 1e-20f),
+                     1.f / (fabsf(direction.y) > 1e-20f ? direction.y : 1e-20f),
+                     1.f / (fabsf(direction.z) > 1e-20f ? direction.z : 1e-20f));
+}
+
+/* Closest hit of the ray with the mesh nearer than hit.t, updates hit.triangle, t, u and v */
+bool IntersectMeshBvh(const SMeshBvh &mesh_bvh, const SBvhRay &ray, SBvhHit &hit)
+{
+    const SBvh &bvh = mesh_bvh.bvh;
+    if (bvh.nodes.empty() || mesh_bvh.triangles.empty())
+        return false;
+
+    glm::vec3 inv_direction = BvhInverseDirection(ray.direction);
+    if (IntersectBvhBounds(ray.origin, inv_direction, bvh.nodes[0].min, bvh.nodes[0].max, hit.t) == FLT_MAX)
+        return false;
+
+    int stack[BVH_STACK_SIZE];
+    int depth = 0;
+    int node_index = 0;
+    bool found = false;
+
+    while (true)
+    {
+        const SBvhNode &node = bvh.nodes[node_index];
+        if (node.count > 0)
+        {
+            for (int i = 0; i < node.count; i++)
+            {
+                float t, u, v;
+                if (IntersectBvhTriangle(ray, mesh_bvh.triangles[node.left_first + i], t, u, v) && t < hit.t)
+                {
+                    hit.t = t;
+                    hit.u = u;
+                    hit.v = v;
+                    hit.triangle = (int) bvh.indices[node.left_first + i];
+                    found = true;
+                }
+            }
+        }
+        else
+        {
+            // Visit the nearer child first, the other one waits on the stack
+            const SBvhNode &left = bvh.nodes[node.left_first];
+            const SBvhNode &right = bvh.nodes[node.left_first + 1];
+            float t_left = IntersectBvhBounds(ray.origin, inv_direction, left.min, left.max, hit.t);
+            float t_right = IntersectBvhBounds(ray.origin, inv_direction, right.min, right.max, hit.t);
+
+            int near_child = node.left_first, far_child = node.left_first + 1;
+            if (t_right < t_left)
+            {
+                std::swap(t_left, t_right);
+                std::swap(near_child, far_child);
+            }
+
+            if (t_left != FLT_MAX)
+            {
+                // At most one node per level above this one is waiting, the depth limit keeps that within the stack
+                if (t_right != FLT_MAX)
+                    stack[depth++] = far_child;
+                node_index = near_child;
+                continue;
+            }
+        }
+
+        // Pop, skipping nodes that a closer hit found since they were pushed has ruled out
+        bool popped = false;
+        while (depth > 0 && !popped)
+        {
+            node_index = stack[--depth];
+            const SBvhNode &next = bvh.nodes[node_index];
+            popped = IntersectBvhBounds(ray.origin, inv_direction, next.min, next.max, hit.t) != FLT_MAX;
+        }
+        if (!popped)
+            break;
+    }
+
+    return found;
+}
+
+/* Closest object and triangle along a world space ray, hit.object is -1 for a miss */
+SBvhHit IntersectSceneBvh(const SSceneBvh &scene, const SBvhRay &ray)
+{
+    SBvhHit hit;
+    hit.object = -1;
+    hit.triangle = -1;
+    hit.t = FLT_MAX;
+    hit.u = hit.v = 0.f;
+
+    const SBvh &top = scene.top;
+    if (scene.instances.empty() || top.nodes.empty())
+        return hit;
+
+    glm::vec3 inv_direction = BvhInverseDirection(ray.direction);
+    int stack[BVH_STACK_SIZE];
+    int depth = 0;
+    stack[depth++] = 0;
+
+    while (depth > 0)
+    {
+        const SBvhNode &node = top.nodes[stack[--depth]];
+        if (IntersectBvhBounds(ray.origin, inv_direction, node.min, node.max, hit.t) == FLT_MAX)
+            continue;
+
+        // Both children are pushed, which with the depth limit still needs at most BVH_MAX_DEPTH + 1 slots
+        if (node.count == 0)
+        {
+            stack[depth++] = node.left_first;
+            stack[depth++] = node.left_first + 1;
+            continue;
+        }
+
+        for (int i = 0; i < node.count; i++)
+        {
+            int object = (int) top.indices[node.left_first + i];
+            const SBvhInstance &instance = scene.instances[object];
+
+            // The object space direction is not normalized, so t is the same distance in both spaces
+            SBvhRay local;
+            local.origin = glm::vec3(instance.inverse * glm::vec4(ray.origin, 1.f));
+            local.direction = glm::vec3(instance.inverse * glm::vec4(ray.direction, 0.f));
+
+            if (IntersectMeshBvh(scene.meshes[instance.mesh], local, hit))
+                hit.object = object;
+        }
+    }
+
+    return hit;
+}
+
+/* Ray from the camera through a point in window coordinates (origin top left) */
+SBvhRay ScreenRay(const glm::mat4 &view_projection, float x, float y, int width, int height)
+{
+    glm::mat4 inverse = glm::inverse(view_projection);
+    float ndc_x = 2.f * x / (float) width - 1.f;
+    float ndc_y = 1.f - 2.f * y / (float) height;
+
+    // Points on the near and far planes under the cursor
+    glm::vec4 front = inverse * glm::vec4(ndc_x, ndc_y, -1.f, 1.f);
+    glm::vec4 back = inverse * glm::vec4(ndc_x, ndc_y, 1.f, 1.f);
+
+    SBvhRay ray;
+    ray.origin = glm::vec3(front) / front.w;
+    ray.direction = glm::normalize(glm::vec3(back) / back.w - ray.origin);
+    return ray;
+}
+
+/* Timed pick for the interactive path, the result is the closest object under the cursor */
+SBvhHit PickSceneBvh(SSceneBvh &scene, const glm::mat4 &view_projection, float x, float y, int width, int height)
+{
+    typedef std::chrono::high_resolution_clock clock;
+    clock::time_point start = clock::now();
+
+    SBvhHit hit = IntersectSceneBvh(scene, ScreenRay(view_projection, x, y, width, height));
+
+    scene.picks++;
+    scene.pick_us += std::chrono::duration<float, std::micro>(clock::now() - start).count();
+    return hit;
+}
+
+/* Frees the hierarchies of every mesh and the top level */
+void DeleteSceneBvh(SSceneBvh &scene)
+{
+    std::vector<SMeshBvh>().swap(scene.meshes);
+    std::vector<SBvhInstance>().swap(scene.instances);
+    std::vector<SBvhNode>().swap(scene.top.nodes);
+    std::vector<unsigned int>().swap(scene.top.indices);
+    scene.top.node_count = 0;
+    ReleaseMemory(memory_tracker, &scene, MEMORY_PICKING);
+}
+
+void PrintBvhStats(const SSceneBvh &scene)
+{
+    if (scene.picks == 0)
+        return;
+
+    printf("INFO: BVH - %u picks against %d objects, %.2f us per pick\n",
+           scene.picks, (int) scene.instances.size(), scene.pick_us / (float) scene.picks);
+}
+
+struct SBvhRayBatch
+{
+    const SMeshBvh *mesh_bvh;
+    const SBvhRay *rays;
+    int ray_count;
+    int batch_size;
+    std::atomic<int> hits;
+};
+
+void TraceBvhRaysJob(void *data, int index)
+{
+    SBvhRayBatch &batch = *(SBvhRayBatch *) data;
+    int end = std::min(batch.ray_count, (index + 1) * batch.batch_size);
+
+    int hits = 0;
+    for (int i = index * batch.batch_size; i < end; i++)
+    {
+        SBvhHit hit;
+        hit.t = FLT_MAX;
+        hit.triangle = -1;
+        if (IntersectMeshBvh(*batch.mesh_bvh, batch.rays[i], hit))
+            hits++;
+    }
+    batch.hits.fetch_add(hits);
+}
+
+/* Benchmark: a bumpy terrain of about triangle_count triangles, build time on one and on every worker,
+ * rays per second on one and on every worker, and a brute force check of the closest hits */
+int BenchmarkBvh(int triangle_count)
+{
+    srand(1234);
+
+    // n x n quads of two triangles each
+    int n = std::max(2, (int) sqrtf((float) triangle_count * 0.5f));
+    SMeshRegistry registry;
+    InitMeshRegistry(registry);
+
+    int mesh = RegisterBenchmarkTerrain(registry, n);
+
+    typedef std::chrono::high_resolution_clock clock;
+    int workers = (int) std::max(1u, std::min((unsigned int) JOB_MAX_WORKERS, std::thread::hardware_concurrency()));
+
+    SJobSystem *jobs = new SJobSystem;
+    InitJobSystem(*jobs, workers);
+
+    SMeshBvh serial, parallel;
+    clock::time_point start = clock::now();
+    BuildMeshBvh(serial, registry, mesh, NULL);
+    float serial_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+    start = clock::now();
+    BuildMeshBvh(parallel, registry, mesh, jobs);
+    float parallel_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+    // Rays from above towards random points of the terrain, and some random directions
+    const int ray_count = 1 << 20;
+    std::vector<SBvhRay> rays(ray_count);
+    for (int i = 0; i < ray_count; i++)
+    {
+        rays[i].origin = glm::vec3((float) (rand() % 10000) * 0.01f - 50.f, 30.f, (float) (rand() % 10000) * 0.01f - 50.f);
+        glm::vec3 target((float) (rand() % 10000) * 0.01f - 50.f, 0.f, (float) (rand() % 10000) * 0.01f - 50.f);
+        if (i % 4 == 3)
+            target = rays[i].origin + glm::vec3((float) (rand() % 200 - 100), (float) (rand() % 200 - 100), (float) (rand() % 200 - 100));
+        rays[i].direction = glm::normalize(target - rays[i].origin);
+    }
+
+    SBvhRayBatch batch;
+    batch.mesh_bvh = &parallel;
+    batch.rays = rays.data();
+    batch.ray_count = ray_count;
+    batch.batch_size = ray_count;
+    batch.hits = 0;
+
+    start = clock::now();
+    TraceBvhRaysJob(&batch, 0);
+    float single_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    int hits = batch.hits.load();
+
+    batch.batch_size = 4096;
+    batch.hits = 0;
+    start = clock::now();
+    ParallelFor(*jobs, (ray_count + batch.batch_size - 1) / batch.batch_size, TraceBvhRaysJob, &batch);
+    float multi_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+    // The closest hits must match testing every triangle
+    const int checks = 32;
+    int agree = 0;
+    float brute_ms = 0.f;
+    for (int i = 0; i < checks; i++)
+    {
+        SBvhHit hit;
+        hit.t = FLT_MAX;
+        hit.triangle = -1;
+        IntersectMeshBvh(parallel, rays[i], hit);
+
+        start = clock::now();
+        float best = FLT_MAX;
+        for (size_t t = 0; t < parallel.triangles.size(); t++)
+        {
+            float d, u, v;
+            if (IntersectBvhTriangle(rays[i], parallel.triangles[t], d, u, v) && d < best)
+                best = d;
+        }
+        brute_ms += std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+        if (best == hit.t)
+            agree++;
+    }
+
+    ShutdownJobSystem(*jobs);
+    delete jobs;
+
+    printf("INFO: BVH Benchmark - %d triangles, %d nodes, %d bins, leaves of up to %d triangles\n",
+           registry.meshes[mesh].index_count / 3, parallel.bvh.node_count, BVH_BINS, BVH_LEAF_SIZE);
+    printf("INFO:   build:   %.1f ms on 1 thread, %.1f ms on %d workers\n", serial_ms, parallel_ms, workers);
+    printf("INFO:   rays:    %d, %.1f%% hit\n", ray_count, 100.f * (float) hits / (float) ray_count);
+    printf("INFO:   trace:   %.2f Mrays/s on 1 thread (%.3f us per ray), %.2f Mrays/s on %d workers\n",
+           (float) ray_count / (single_ms * 1000.f), single_ms * 1000.f / (float) ray_count,
+           (float) ray_count / (multi_ms * 1000.f), workers);
+    printf("INFO:   check:   %d of %d closest hits match brute force (%.3f ms per brute force ray)\n",
+           agree, checks, brute_ms / (float) checks);
+
+    return agree == checks ? 0 : -1;
+}
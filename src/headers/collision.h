@@ -0,0 +1,642 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+/* ---- GLM Includes ---- */
+#ifdef _WIN32
+#include <glm/glm/glm.hpp>
+#endif
+
+#ifdef __unix
+#include <glm/glm.hpp>
+#endif
+
+/* ---- Header Files ---- */
+#include "mesh.h"
+#include "jobs.h"
+#include "memory.h"
+
+// Sphere collision for the fly through camera: a uniform grid over the triangles of each solid mesh,
+// built once at load time, and instances that place the grids in the world. Instances may be scaled
+// uniformly and rotated about y only, so a vertical line stays within one column of grid cells.
+
+/* ---- Definitions ---- */
+// Average triangles per grid cell the resolution is chosen for
+#define COLLISION_CELL_TRIANGLES 4
+
+// Cells are no wider than this many times the mean triangle extent
+#define COLLISION_CELL_EXTENTS 2.f
+
+// Upper limit of cells along each axis of a grid
+#define COLLISION_MAX_CELLS 256
+
+// Push outs per query step, each resolves the deepest remaining contact
+#define COLLISION_ITERATIONS 4
+
+// Sweeps advance at most this fraction of the radius per step, so thin walls cannot be skipped
+#define COLLISION_SWEEP_STEP 0.5f
+
+struct SCollisionTriangle
+{
+    glm::vec3 a;
+    glm::vec3 b;
+    glm::vec3 c;
+    glm::vec3 normal;
+};
+
+// The triangles of cell (x, y, z) are cell_triangles[cell_start[i], cell_start[i + 1]),
+// with i = (z * dims[1] + y) * dims[0] + x. A triangle is listed in every cell its box overlaps.
+struct SCollisionGrid
+{
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 inv_cell_size;
+    int dims[3];
+
+    std::vector<unsigned int> cell_start;
+    std::vector<unsigned int> cell_triangles;
+    std::vector<SCollisionTriangle> triangles;
+};
+
+struct SCollisionInstance
+{
+    int grid;
+    glm::mat4 model;
+    glm::mat4 inverse;
+    float scale;
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct SCollisionStats
+{
+    unsigned int queries;
+    unsigned int contacts;
+    unsigned int ground_clamps;
+    unsigned long long triangle_tests;
+    float query_us;
+};
+
+struct SCollisionWorld
+{
+    std::vector<SCollisionGrid> grids;
+    std::vector<int> mesh_grids;            // grid of each registered mesh, -1 when it is not solid
+    std::vector<SCollisionInstance> instances;
+
+    float build_ms;
+    SCollisionStats stats;
+};
+
+// Deepest overlap found by one pass over the candidate triangles
+struct SCollisionContact
+{
+    glm::vec3 push;     // moves the sphere out of the triangle
+    float depth;
+};
+
+inline int CollisionCell(const SCollisionGrid &grid, float value, int axis)
+{
+    int cell = (int) ((value - grid.min[axis]) * grid.inv_cell_size[axis]);
+    return std::max(0, std::min(grid.dims[axis] - 1, cell));
+}
+
+/* Builds the grid of one registered mesh in object space, reading the registry's CPU copy */
+void BuildCollisionGrid(SCollisionGrid &grid, const SMeshRegistry &registry, int mesh)
+{
+    const SMesh &source = registry.meshes[mesh];
+    unsigned int count = (unsigned int) source.index_count / 3;
+    const unsigned int *indices = registry.indices.data() + source.first_index;
+    const float *vertices = registry.vertices.data() + (size_t) source.base_vertex * MESH_VERTEX_FLOATS;
+
+    // Slots reserved for streamed meshes get a single empty cell until they are loaded
+    if (count == 0)
+    {
+        grid.min = grid.max = glm::vec3(0.f);
+        grid.inv_cell_size = glm::vec3(1.f);
+        grid.dims[0] = grid.dims[1] = grid.dims[2] = 1;
+        grid.cell_start.assign(2, 0);
+        grid.cell_triangles.clear();
+        grid.triangles.clear();
+        return;
+    }
+
+    grid.triangles.resize(count);
+    float triangle_extent = 0.f;
+    grid.min = glm::vec3(FLT_MAX);
+    grid.max = glm::vec3(-FLT_MAX);
+    for (unsigned int t = 0; t < count; t++)
+    {
+        glm::vec3 corners[3];
+        for (int k = 0; k < 3; k++)
+        {
+            const float *p = vertices + (size_t) indices[t * 3 + k] * MESH_VERTEX_FLOATS;
+            corners[k] = glm::vec3(p[0], p[1], p[2]);
+            grid.min = glm::min(grid.min, corners[k]);
+            grid.max = glm::max(grid.max, corners[k]);
+        }
+
+        SCollisionTriangle &tri = grid.triangles[t];
+        tri.a = corners[0];
+        tri.b = corners[1];
+        tri.c = corners[2];
+
+        // Degenerate triangles keep a zero normal, their closest points still work
+        glm::vec3 normal = glm::cross(tri.b - tri.a, tri.c - tri.a);
+        float length = glm::length(normal);
+        tri.normal = length > 0.f ? normal / length : glm::vec3(0.f);
+
+        glm::vec3 size = glm::max(corners[0], glm::max(corners[1], corners[2])) - glm::min(corners[0], glm::min(corners[1], corners[2]));
+        triangle_extent += std::max(size.x, std::max(size.y, size.z));
+    }
+
+    // Cubic cells sized for COLLISION_CELL_TRIANGLES per cell if the triangles filled the volume. Meshes are
+    // surfaces that leave most cells empty, so cells are also kept within a few triangles across.
+    glm::vec3 extent = glm::max(grid.max - grid.min, glm::vec3(1e-4f));
+    float cells = std::max(1.f, (float) count / (float) COLLISION_CELL_TRIANGLES);
+    float cell_size = std::min(cbrtf(extent.x * extent.y * extent.z / cells), COLLISION_CELL_EXTENTS * triangle_extent / (float) std::max(1u, count));
+    for (int axis = 0; axis < 3; axis++)
+    {
+        grid.dims[axis] = std::max(1, std::min(COLLISION_MAX_CELLS, (int) ceilf(extent[axis] / cell_size)));
+        grid.inv_cell_size[axis] = (float) grid.dims[axis] / extent[axis];
+    }
+
+    // Count, prefix sum, then fill, so every cell's list is one contiguous range
+    int cell_count = grid.dims[0] * grid.dims[1] * grid.dims[2];
+    grid.cell_start.assign((size_t) cell_count + 1, 0);
+    for (int pass = 0; pass < 2; pass++)
+    {
+        std::vector<unsigned int> cursor;
+        if (pass == 1)
+        {
+            for (int i = 0; i < cell_count; i++)
+                grid.cell_start[i + 1] += grid.cell_start[i];
+            grid.cell_triangles.resize(grid.cell_start[cell_count]);
+            cursor.assign(grid.cell_start.begin(), grid.cell_start.end() - 1);
+        }
+
+        for (unsigned int t = 0; t < count; t++)
+        {
+            const SCollisionTriangle &tri = grid.triangles[t];
+            glm::vec3 lo = glm::min(tri.a, glm::min(tri.b, tri.c));
+            glm::vec3 hi = glm::max(tri.a, glm::max(tri.b, tri.c));
+
+            int x0 = CollisionCell(grid, lo.x, 0), x1 = CollisionCell(grid, hi.x, 0);
+            int y0 = CollisionCell(grid, lo.y, 1), y1 = CollisionCell(grid, hi.y, 1);
+            int z0 = CollisionCell(grid, lo.z, 2), z1 = CollisionCell(grid, hi.z, 2);
+            for (int z = z0; z <= z1; z++)
+                for (int y = y0; y <= y1; y++)
+                    for (int x = x0; x <= x1; x++)
+                    {
+                        int cell = (z * grid.dims[1] + y) * grid.dims[0] + x;
+                        if (pass == 0)
+                            grid.cell_start[cell + 1]++;
+                        else
+                            grid.cell_triangles[cursor[cell]++] = t;
+                    }
+        }
+    }
+}
+
+struct SCollisionGridBuild
+{
+    SCollisionWorld *world;
+    const SMeshRegistry *registry;
+    std::vector<int> meshes;
+};
+
+void BuildCollisionGridJob(void *data, int index)
+{
+    SCollisionGridBuild &build = *(SCollisionGridBuild *) data;
+    BuildCollisionGrid(build.world->grids[index], *build.registry, build.meshes[index]);
+}
+
+/* Builds a grid for each of the solid meshes, one job per mesh, must run before the registry is uploaded */
+void BuildCollisionWorld(SCollisionWorld &world, const SMeshRegistry &registry, const int *solid_meshes, int solid_count, SJobSystem &jobs)
+{
+    typedef std::chrono::high_resolution_clock clock;
+    clock::time_point start = clock::now();
+
+    SCollisionGridBuild build;
+    build.world = &world;
+    build.registry = &registry;
+    build.meshes.assign(solid_meshes, solid_meshes + solid_count);
+
+    world.mesh_grids.assign(registry.meshes.size(), -1);
+    for (int i = 0; i < solid_count; i++)
+        world.mesh_grids[solid_meshes[i]] = i;
+
+    world.grids.resize(solid_count);
+    world.instances.clear();
+    memset(&world.stats, 0, sizeof(SCollisionStats));
+
+    ParallelFor(jobs, solid_count, BuildCollisionGridJob, &build);
+
+    world.build_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+    unsigned int triangles = 0, cells = 0, references = 0;
+    size_t bytes = 0;
+    for (size_t g = 0; g < world.grids.size(); g++)
+    {
+        const SCollisionGrid &grid = world.grids[g];
+        triangles += (unsigned int) grid.triangles.size();
+        cells += (unsigned int) grid.cell_start.size() - 1;
+        references += (unsigned int) grid.cell_triangles.size();
+        bytes += sizeof(unsigned int) * (grid.cell_start.capacity() + grid.cell_triangles.capacity()) +
+                 sizeof(SCollisionTriangle) * grid.triangles.capacity();
+    }
+
+    TrackMemory(memory_tracker, "collision grids", MEMORY_COLLISION, MEMORY_HOST, &world, bytes);
+
+    printf("INFO: Collision - %d meshes, %u triangles in %u cells (%.1f references per triangle) built in %.3f ms\n",
+           solid_count, triangles, cells, triangles > 0 ? (float) references / (float) triangles : 0.f, world.build_ms);
+}
+
+/* Adds an instance of a mesh if the mesh is solid, place it with UpdateCollisionInstance */
+int AddCollisionInstance(SCollisionWorld &world, int mesh)
+{
+    if (world.mesh_grids[mesh] < 0)
+        return -1;
+
+    SCollisionInstance instance;
+    instance.grid = world.mesh_grids[mesh];
+    instance.model = glm::mat4(1.f);
+    instance.inverse = glm::mat4(1.f);
+    instance.scale = 1.f;
+    instance.min = glm::vec3(0.f);
+    instance.max = glm::vec3(0.f);
+    world.instances.push_back(instance);
+    return (int) world.instances.size() - 1;
+}
+
+/* Moves an instance to a new model matrix and updates its world bounds */
+void UpdateCollisionInstance(SCollisionWorld &world, int index, const glm::mat4 &model)
+{
+    SCollisionInstance &instance = world.instances[index];
+    instance.model = model;
+    instance.inverse = glm::inverse(model);
+    instance.scale = glm::length(glm::vec3(model[0]));
+
+    // Disabled instances get inverted bounds, which every overlap test rejects
+    instance.min = glm::vec3(FLT_MAX);
+    instance.max = glm::vec3(-FLT_MAX);
+    if (instance.grid < 0)
+        return;
+
+    const SCollisionGrid &grid = world.grids[instance.grid];
+    for (int c = 0; c < 8; c++)
+    {
+        glm::vec3 corner((c & 1) ? grid.max.x : grid.min.x, (c & 2) ? grid.max.y : grid.min.y, (c & 4) ? grid.max.z : grid.min.z);
+        glm::vec3 world_corner = glm::vec3(model * glm::vec4(corner, 1.f));
+        instance.min = glm::min(instance.min, world_corner);
+        instance.max = glm::max(instance.max, world_corner);
+    }
+}
+
+/* Closest point to p on the triangle, by the Voronoi region p falls in */
+glm::vec3 ClosestPointOnTriangle(const glm::vec3 &p, const SCollisionTriangle &tri)
+{
+    glm::vec3 ab = tri.b - tri.a, ac = tri.c - tri.a, ap = p - tri.a;
+    float d1 = glm::dot(ab, ap), d2 = glm::dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f)
+        return tri.a;
+
+    glm::vec3 bp = p - tri.b;
+    float d3 = glm::dot(ab, bp), d4 = glm::dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3)
+        return tri.b;
+
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+        return tri.a + ab * (d1 / (d1 - d3));
+
+    glm::vec3 cp = p - tri.c;
+    float d5 = glm::dot(ab, cp), d6 = glm::dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6)
+        return tri.c;
+
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+        return tri.a + ac * (d2 / (d2 - d6));
+
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && d4 - d3 >= 0.f && d5 - d6 >= 0.f)
+        return tri.b + (tri.c - tri.b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    float denominator = 1.f / (va + vb + vc);
+    return tri.a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+/* Finds the deepest triangle overlapping the sphere, in the grid's object space. Triangles in several
+ * cells are tested more than once, which costs less than tracking the ones already seen. */
+bool FindCollisionContact(const SCollisionGrid &grid, const glm::vec3 &center, float radius,
+                          SCollisionContact &contact, unsigned long long &tests)
+{
+    glm::vec3 lo = center - glm::vec3(radius), hi = center + glm::vec3(radius);
+    if (hi.x < grid.min.x || hi.y < grid.min.y || hi.z < grid.min.z || lo.x > grid.max.x || lo.y > grid.max.y || lo.z > grid.max.z)
+        return false;
+
+    int x0 = CollisionCell(grid, lo.x, 0), x1 = CollisionCell(grid, hi.x, 0);
+    int y0 = CollisionCell(grid, lo.y, 1), y1 = CollisionCell(grid, hi.y, 1);
+    int z0 = CollisionCell(grid, lo.z, 2), z1 = CollisionCell(grid, hi.z, 2);
+
+    bool found = false;
+    float radius_2 = radius * radius;
+    for (int z = z0; z <= z1; z++)
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+            {
+                int cell = (z * grid.dims[1] + y) * grid.dims[0] + x;
+                for (unsigned int i = grid.cell_start[cell]; i < grid.cell_start[cell + 1]; i++)
+                {
+                    // Candidates further from their plane than the radius are rejected before the closest point is found
+                    const SCollisionTriangle &tri = grid.triangles[grid.cell_triangles[i]];
+                    tests++;
+                    if (fabsf(glm::dot(center - tri.a, tri.normal)) >= radius)
+                        continue;
+
+                    glm::vec3 offset = center - ClosestPointOnTriangle(center, tri);
+                    float distance_2 = glm::dot(offset, offset);
+                    if (distance_2 >= radius_2)
+                        continue;
+
+                    float distance = sqrtf(distance_2);
+                    float depth = radius - distance;
+                    if (found && depth <= contact.depth)
+                        continue;
+
+                    // A centre exactly on the surface has no offset to push along, the normal is used instead
+                    glm::vec3 direction = distance > 1e-6f ? offset / distance : tri.normal;
+                    contact.push = direction * depth;
+                    contact.depth = depth;
+                    found = true;
+                }
+            }
+
+    return found;
+}
+
+/* Pushes a world space sphere out of every instance it overlaps, returns the new centre */
+glm::vec3 ResolveCollisionSphere(const SCollisionWorld &world, glm::vec3 center, float radius, unsigned long long &tests, unsigned int &contacts)
+{
+    for (int iteration = 0; iteration < COLLISION_ITERATIONS; iteration++)
+    {
+        bool found = false;
+        glm::vec3 push(0.f);
+        float depth = 0.f;
+
+        for (size_t i = 0; i < world.instances.size(); i++)
+        {
+            const SCollisionInstance &instance = world.instances[i];
+            if (center.x + radius < instance.min.x || center.y + radius < instance.min.y || center.z + radius < instance.min.z ||
+                center.x - radius > instance.max.x || center.y - radius > instance.max.y || center.z - radius > instance.max.z)
+                continue;
+
+            // Uniform scale keeps the sphere a sphere in object space
+            SCollisionContact contact;
+            glm::vec3 local = glm::vec3(instance.inverse * glm::vec4(center, 1.f));
+            if (!FindCollisionContact(world.grids[instance.grid], local, radius / instance.scale, contact, tests))
+                continue;
+
+            float world_depth = contact.depth * instance.scale;
+            if (found && world_depth <= depth)
+                continue;
+
+            push = glm::vec3(instance.model * glm::vec4(contact.push, 0.f));
+            depth = world_depth;
+            found = true;
+        }
+
+        if (!found)
+            break;
+
+        // A little past the surface so the next iteration does not find the same contact again
+        center += push * 1.001f;
+        contacts++;
+    }
+
+    return center;
+}
+
+/* Moves a sphere from start towards end in steps of at most COLLISION_SWEEP_STEP * radius, pushing it out
+ * of the world after each step. The sphere slides along what it hits rather than stopping. */
+glm::vec3 SweepCollisionSphere(SCollisionWorld &world, const glm::vec3 &start, const glm::vec3 &end, float radius)
+{
+    typedef std::chrono::high_resolution_clock clock;
+    clock::time_point query_start = clock::now();
+
+    glm::vec3 delta = end - start;
+    int steps = std::max(1, (int) ceilf(glm::length(delta) / (radius * COLLISION_SWEEP_STEP)));
+    delta /= (float) steps;
+
+    glm::vec3 center = start;
+    for (int s = 0; s < steps; s++)
+        center = ResolveCollisionSphere(world, center + delta, radius, world.stats.triangle_tests, world.stats.contacts);
+
+    world.stats.queries++;
+    world.stats.query_us += std::chrono::duration<float, std::micro>(clock::now() - query_start).count();
+    return center;
+}
+
+/* Height of the highest surface under the point that is no higher than point.y, -FLT_MAX if there is none */
+float CollisionGroundHeight(const SCollisionWorld &world, const glm::vec3 &point)
+{
+    float ground = -FLT_MAX;
+    for (size_t i = 0; i < world.instances.size(); i++)
+    {
+        const SCollisionInstance &instance = world.instances[i];
+        if (point.x < instance.min.x || point.z < instance.min.z || point.x > instance.max.x || point.z > instance.max.z ||
+            point.y < instance.min.y)
+            continue;
+
+        // Rotations about y keep the vertical line vertical, so only one column of cells is searched
+        const SCollisionGrid &grid = world.grids[instance.grid];
+        glm::vec3 local = glm::vec3(instance.inverse * glm::vec4(point, 1.f));
+        if (local.x < grid.min.x || local.z < grid.min.z || local.x > grid.max.x || local.z > grid.max.z)
+            continue;
+
+        int x = CollisionCell(grid, local.x, 0);
+        int z = CollisionCell(grid, local.z, 2);
+        int y1 = CollisionCell(grid, local.y, 1);
+
+        float local_ground = -FLT_MAX;
+        for (int y = 0; y <= y1; y++)
+        {
+            int cell = (z * grid.dims[1] + y) * grid.dims[0] + x;
+            for (unsigned int c = grid.cell_start[cell]; c < grid.cell_start[cell + 1]; c++)
+            {
+                const SCollisionTriangle &tri = grid.triangles[grid.cell_triangles[c]];
+
+                // Barycentrics of the point in the triangle projected onto the xz plane
+                float area = (tri.b.x - tri.a.x) * (tri.c.z - tri.a.z) - (tri.c.x - tri.a.x) * (tri.b.z - tri.a.z);
+                if (fabsf(area) < 1e-12f)
+                    continue;
+
+                float u = ((local.x - tri.a.x) * (tri.c.z - tri.a.z) - (tri.c.x - tri.a.x) * (local.z - tri.a.z)) / area;
+                float v = ((tri.b.x - tri.a.x) * (local.z - tri.a.z) - (local.x - tri.a.x) * (tri.b.z - tri.a.z)) / area;
+                if (u < 0.f || v < 0.f || u + v > 1.f)
+                    continue;
+
+                float height = tri.a.y + u * (tri.b.y - tri.a.y) + v * (tri.c.y - tri.a.y);
+                if (height <= local.y && height > local_ground)
+                    local_ground = height;
+            }
+        }
+
+        if (local_ground > -FLT_MAX)
+        {
+            glm::vec3 surface = glm::vec3(instance.model * glm::vec4(local.x, local_ground, local.z, 1.f));
+            ground = std::max(ground, surface.y);
+        }
+    }
+
+    return ground;
+}
+
+void DeleteCollisionWorld(SCollisionWorld &world)
+{
+    std::vector<SCollisionGrid>().swap(world.grids);
+    std::vector<int>().swap(world.mesh_grids);
+    std::vector<SCollisionInstance>().swap(world.instances);
+    ReleaseMemory(memory_tracker, &world, MEMORY_COLLISION);
+}
+
+void PrintCollisionStats(const SCollisionWorld &world)
+{
+    const SCollisionStats &s = world.stats;
+    if (s.queries == 0)
+        return;
+
+    printf("INFO: Collision - %u sweeps, %.2f us per sweep, %.1f triangle tests per sweep, %u contacts, %u ground clamps\n",
+           s.queries, s.query_us / (float) s.queries, (float) s.triangle_tests / (float) s.queries, s.contacts, s.ground_clamps);
+}
+
+struct SCollisionQueryBatch
+{
+    const SCollisionWorld *world;
+    const glm::vec3 *centers;
+    float radius;
+    int query_count;
+    int batch_size;
+    std::atomic<int> contacts;
+};
+
+void ResolveCollisionQueriesJob(void *data, int index)
+{
+    SCollisionQueryBatch &batch = *(SCollisionQueryBatch *) data;
+    int end = std::min(batch.query_count, (index + 1) * batch.batch_size);
+
+    unsigned long long tests = 0;
+    unsigned int contacts = 0;
+    for (int i = index * batch.batch_size; i < end; i++)
+    {
+        ResolveCollisionSphere(*batch.world, batch.centers[i], batch.radius, tests, contacts);
+        CollisionGroundHeight(*batch.world, batch.centers[i]);
+    }
+    batch.contacts.fetch_add((int) contacts);
+}
+
+/* Benchmark: a bumpy terrain of about triangle_count triangles, grid build time, sphere and ground
+ * queries per second on one and on every worker, and a brute force check of the contacts */
+int BenchmarkCollision(int triangle_count)
+{
+    srand(1234);
+
+    int n = std::max(2, (int) sqrtf((float) triangle_count * 0.5f));
+    SMeshRegistry registry;
+    InitMeshRegistry(registry);
+    int mesh = RegisterBenchmarkTerrain(registry, n);
+
+    typedef std::chrono::high_resolution_clock clock;
+    int workers = (int) std::max(1u, std::min((unsigned int) JOB_MAX_WORKERS, std::thread::hardware_concurrency()));
+
+    SJobSystem *jobs = new SJobSystem;
+    InitJobSystem(*jobs, workers);
+
+    SCollisionWorld world;
+    BuildCollisionWorld(world, registry, &mesh, 1, *jobs);
+    AddCollisionInstance(world, mesh);
+    UpdateCollisionInstance(world, 0, glm::mat4(1.f));
+
+    // Spheres that overlap about as many triangles as the camera does in the scene, near the surface so most touch it
+    const int query_count = 1 << 20;
+    const float radius = 0.1f;
+    std::vector<glm::vec3> centers(query_count);
+    for (int i = 0; i < query_count; i++)
+    {
+        float x = (float) (rand() % 10000) * 0.01f - 50.f;
+        float z = (float) (rand() % 10000) * 0.01f - 50.f;
+        float fx = (x + 50.f) * 0.01f, fz = (z + 50.f) * 0.01f;
+        float y = 4.f * sinf(fx * 17.f) * cosf(fz * 13.f) + (float) (rand() % 400) * 0.001f - 0.1f;
+        centers[i] = glm::vec3(x, y, z);
+    }
+
+    SCollisionQueryBatch batch;
+    batch.world = &world;
+    batch.centers = centers.data();
+    batch.radius = radius;
+    batch.query_count = query_count;
+    batch.batch_size = query_count;
+    batch.contacts = 0;
+
+    clock::time_point start = clock::now();
+    ResolveCollisionQueriesJob(&batch, 0);
+    float single_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    int contacts = batch.contacts.load();
+
+    batch.batch_size = 4096;
+    batch.contacts = 0;
+    start = clock::now();
+    ParallelFor(*jobs, (query_count + batch.batch_size - 1) / batch.batch_size, ResolveCollisionQueriesJob, &batch);
+    float multi_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+    // The deepest contact of the grid must match testing every triangle
+    const SCollisionGrid &grid = world.grids[0];
+    const int checks = 256;
+    int agree = 0;
+    float brute_ms = 0.f;
+    for (int i = 0; i < checks; i++)
+    {
+        SCollisionContact contact;
+        unsigned long long tests = 0;
+        bool found = FindCollisionContact(grid, centers[i], radius, contact, tests);
+
+        start = clock::now();
+        float deepest = 0.f;
+        for (size_t t = 0; t < grid.triangles.size(); t++)
+        {
+            glm::vec3 offset = centers[i] - ClosestPointOnTriangle(centers[i], grid.triangles[t]);
+            float distance = glm::length(offset);
+            if (distance < radius)
+                deepest = std::max(deepest, radius - distance);
+        }
+        brute_ms += std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+        if ((found ? contact.depth : 0.f) == deepest)
+            agree++;
+    }
+
+    ShutdownJobSystem(*jobs);
+    delete jobs;
+
+    printf("INFO: Collision Benchmark - %d triangles, %d x %d x %d cells, radius %.2f\n",
+           (int) grid.triangles.size(), grid.dims[0], grid.dims[1], grid.dims[2], radius);
+    printf("INFO:   build:   %.1f ms\n", world.build_ms);
+    printf("INFO:   queries: %d sphere + ground queries, %.2f push outs per query\n", query_count, (float) contacts / (float) query_count);
+    printf("INFO:   resolve: %.2f Mqueries/s on 1 thread (%.3f us per query), %.2f Mqueries/s on %d workers\n",
+           (float) query_count / (single_ms * 1000.f), single_ms * 1000.f / (float) query_count,
+           (float) query_count / (multi_ms * 1000.f), workers);
+    printf("INFO:   check:   %d of %d deepest contacts match brute force (%.3f ms per brute force query)\n",
+           agree, checks, brute_ms / (float) checks);
+
+    return agree == checks ? 0 : -1;
+}
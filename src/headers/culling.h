@@ -0,0 +1,625 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+/* ---- SIMD Intrinsics ---- */
+// The plane tests run 8 objects at a time with AVX, 4 with SSE and fall back to scalar code
+#if defined(__AVX__)
+    #include <immintrin.h>
+    #define CULL_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define CULL_LANES 4
+#else
+    #define CULL_LANES 1
+#endif
+
+/* ---- GLM Includes ---- */
+#ifdef _WIN32
+#include <glm/glm/glm.hpp>
+#endif
+
+#ifdef __unix
+#include <glm/glm.hpp>
+#endif
+
+/* ---- Header Files ---- */
+#include "parser.h"
+
+/* ---- Definitions ---- */
+// Object counts from which the loose octree is built instead of testing every object
+#ifndef CULL_OCTREE_THRESHOLD
+    #define CULL_OCTREE_THRESHOLD 4096
+#endif
+// Depth of the loose octree, level L has 8^L cells
+#ifndef CULL_OCTREE_LEVELS
+    #define CULL_OCTREE_LEVELS 5
+#endif
+// Views culled together in one pass, each one owns a bit of the visibility mask of an object
+#define CULL_MAX_VIEWS 8
+
+// Planes are stored as (normal, distance) with the normal pointing into the frustum
+struct SFrustum
+{
+    glm::vec4 planes[6];
+};
+
+struct SCullingStats
+{
+    unsigned int tested;
+    unsigned int visible;
+    unsigned int culled;
+    unsigned int views;
+    float time_ms;
+};
+
+// A loose octree over the bounding spheres, rebuilt from the current frame's objects.
+// Cells are stored densely per level and each cell owns a contiguous range of the object list.
+struct SLooseOctree
+{
+    glm::vec3 root_min;
+    float root_size;
+
+    std::vector<int> level_offset;        // first cell index of each level
+    std::vector<unsigned int> cell_start; // first entry of each cell in objects
+    std::vector<unsigned int> cell_count; // objects stored directly in each cell
+    std::vector<unsigned int> tree_count; // objects stored in each cell and its children
+    std::vector<unsigned int> objects;    // object indices sorted by cell
+    std::vector<int> object_cell;         // cell index of each object
+};
+
+// World space bounds of every object of the frame, structure of arrays padded to CULL_LANES.
+// visible holds a mask per object with bit v set when the object is inside the frustum of view v.
+struct SCullingSystem
+{
+    std::vector<float> center_x;
+    std::vector<float> center_y;
+    std::vector<float> center_z;
+    std::vector<float> radius;
+    std::vector<float> extent_x;
+    std::vector<float> extent_y;
+    std::vector<float> extent_z;
+    std::vector<unsigned char> visible;
+    unsigned int count;
+
+    // The octree is only rebuilt when an object moved or the object count changed
+    unsigned int previous_count;
+    bool octree_dirty;
+
+    SFrustum frusta[CULL_MAX_VIEWS];
+    unsigned int view_count;
+    SLooseOctree octree;
+
+    // Scratch SoA used to gather the objects of an octree cell for the batch kernel
+    std::vector<float> gather[7];
+    std::vector<unsigned char> gather_visible;
+    std::vector<unsigned char> view_visible;
+
+    SCullingStats stats;
+    SCullingStats totals;
+    unsigned int frames;
+};
+
+/* Extracts the six planes of projection * view (Gribb/Hartmann), normalised so distances are in world units */
+SFrustum ExtractFrustum(const glm::mat4 &view_projection)
+{
+    const glm::mat4 &m = view_projection;
+
+    // GLM is column major, so row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 row_0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row_1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row_2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row_3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    SFrustum frustum;
+    frustum.planes[0] = row_3 + row_0; // left
+    frustum.planes[1] = row_3 - row_0; // right
+    frustum.planes[2] = row_3 + row_1; // bottom
+    frustum.planes[3] = row_3 - row_1; // top
+    frustum.planes[4] = row_3 + row_2; // near
+    frustum.planes[5] = row_3 - row_2; // far
+
+    for (int i = 0; i < 6; i++)
+    {
+        glm::vec4 &p = frustum.planes[i];
+        float length = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+        p = p / length;
+    }
+
+    return frustum;
+}
+
+/* Returns 0 when the box is outside, 1 when it intersects and 2 when it is fully inside the frustum */
+int ClassifyAABB(const SFrustum &frustum, const glm::vec3 &center, const glm::vec3 &extent)
+{
+    int result = 2;
+    for (int i = 0; i < 6; i++)
+    {
+        const glm::vec4 &p = frustum.planes[i];
+        float d = p.x * center.x + p.y * center.y + p.z * center.z + p.w;
+        float r = fabsf(p.x) * extent.x + fabsf(p.y) * extent.y + fabsf(p.z) * extent.z;
+
+        if (d < -r)
+            return 0;
+        if (d < r)
+            result = 1;
+    }
+    return result;
+}
+
+/* Batch kernel over SoA bounds, count must be padded to a multiple of CULL_LANES.
+ * An object is culled when it lies fully behind a plane, using the tighter of the
+ * sphere radius and the projected box radius, both of which are conservative. */
+void CullBatch(const float *cx, const float *cy, const float *cz, const float *rad,
+               const float *ex, const float *ey, const float *ez,
+               unsigned int count, const SFrustum &frustum, unsigned char *visible)
+{
+#if CULL_LANES == 8
+    const __m256 sign_mask = _mm256_set1_ps(-0.f);
+
+    for (unsigned int i = 0; i < count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(cx + i);
+        __m256 y = _mm256_loadu_ps(cy + i);
+        __m256 z = _mm256_loadu_ps(cz + i);
+        __m256 r = _mm256_loadu_ps(rad + i);
+        __m256 bx = _mm256_loadu_ps(ex + i);
+        __m256 by = _mm256_loadu_ps(ey + i);
+        __m256 bz = _mm256_loadu_ps(ez + i);
+
+        __m256 outside = _mm256_setzero_ps();
+
+        for (int p = 0; p < 6; p++)
+        {
+            const glm::vec4 &plane = frustum.planes[p];
+            __m256 nx = _mm256_set1_ps(plane.x);
+            __m256 ny = _mm256_set1_ps(plane.y);
+            __m256 nz = _mm256_set1_ps(plane.z);
+            __m256 nw = _mm256_set1_ps(plane.w);
+
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, x), _mm256_mul_ps(ny, y)),
+                                     _mm256_add_ps(_mm256_mul_ps(nz, z), nw));
+
+            __m256 box_r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_andnot_ps(sign_mask, nx), bx),
+                                                       _mm256_mul_ps(_mm256_andnot_ps(sign_mask, ny), by)),
+                                         _mm256_mul_ps(_mm256_andnot_ps(sign_mask, nz), bz));
+
+            __m256 neg_r = _mm256_xor_ps(_mm256_min_ps(r, box_r), sign_mask);
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(d, neg_r, _CMP_LT_OQ));
+        }
+
+        int mask = _mm256_movemask_ps(outside);
+        for (int lane = 0; lane < 8; lane++)
+            visible[i + lane] = (unsigned char) (((mask >> lane) & 1) == 0);
+    }
+#elif CULL_LANES == 4
+    const __m128 sign_mask = _mm_set1_ps(-0.f);
+
+    for (unsigned int i = 0; i < count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(cx + i);
+        __m128 y = _mm_loadu_ps(cy + i);
+        __m128 z = _mm_loadu_ps(cz + i);
+        __m128 r = _mm_loadu_ps(rad + i);
+        __m128 bx = _mm_loadu_ps(ex + i);
+        __m128 by = _mm_loadu_ps(ey + i);
+        __m128 bz = _mm_loadu_ps(ez + i);
+
+        __m128 outside = _mm_setzero_ps();
+
+        for (int p = 0; p < 6; p++)
+        {
+            const glm::vec4 &plane = frustum.planes[p];
+            __m128 nx = _mm_set1_ps(plane.x);
+            __m128 ny = _mm_set1_ps(plane.y);
+            __m128 nz = _mm_set1_ps(plane.z);
+            __m128 nw = _mm_set1_ps(plane.w);
+
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, x), _mm_mul_ps(ny, y)),
+                                  _mm_add_ps(_mm_mul_ps(nz, z), nw));
+
+            __m128 box_r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, nx), bx),
+                                                 _mm_mul_ps(_mm_andnot_ps(sign_mask, ny), by)),
+                                      _mm_mul_ps(_mm_andnot_ps(sign_mask, nz), bz));
+
+            __m128 neg_r = _mm_xor_ps(_mm_min_ps(r, box_r), sign_mask);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, neg_r));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int lane = 0; lane < 4; lane++)
+            visible[i + lane] = (unsigned char) (((mask >> lane) & 1) == 0);
+    }
+#else
+    for (unsigned int i = 0; i < count; i++)
+    {
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; p++)
+        {
+            const glm::vec4 &plane = frustum.planes[p];
+            float d = plane.x * cx[i] + plane.y * cy[i] + plane.z * cz[i] + plane.w;
+            float box_r = fabsf(plane.x) * ex[i] + fabsf(plane.y) * ey[i] + fabsf(plane.z) * ez[i];
+            float r = rad[i] < box_r ? rad[i] : box_r;
+            outside = d < -r;
+        }
+        visible[i] = (unsigned char) !outside;
+    }
+#endif
+}
+
+void InitCullingSystem(SCullingSystem &culling)
+{
+    culling.count = 0;
+    culling.view_count = 0;
+    culling.previous_count = 0;
+    culling.octree_dirty = true;
+    memset(&culling.stats, 0, sizeof(SCullingStats));
+    memset(&culling.totals, 0, sizeof(SCullingStats));
+    culling.frames = 0;
+}
+
+/* Starts a new frame of culling against the frusta of several projection * view matrices. The bounds,
+ * the octree and its traversal are shared, only the plane tests are repeated for each view. */
+void BeginCulling(SCullingSystem &culling, const glm::mat4 *view_projections, unsigned int view_count)
+{
+    if (view_count > CULL_MAX_VIEWS)
+        view_count = CULL_MAX_VIEWS;
+
+    culling.previous_count = culling.count;
+    culling.count = 0;
+    culling.view_count = view_count;
+    for (unsigned int v = 0; v < view_count; v++)
+        culling.frusta[v] = ExtractFrustum(view_projections[v]);
+}
+
+/* Starts a new frame of culling against the frustum of projection * view */
+void BeginCulling(SCullingSystem &culling, const glm::mat4 &view_projection)
+{
+    BeginCulling(culling, &view_projection, 1);
+}
+
+/* Runs the batch kernel for every view in views and sets the bit of each view the object is inside of.
+ * The first view writes the masks directly, so a single view costs exactly one kernel pass. */
+void CullBatchViews(SCullingSystem &culling, const float *const *bounds, unsigned int count,
+                    unsigned int views, unsigned char *visible)
+{
+    culling.view_visible.resize(count);
+
+    bool first = true;
+    for (unsigned int v = 0; v < culling.view_count; v++)
+    {
+        if ((views & (1u << v)) == 0)
+            continue;
+
+        unsigned char *target = first ? visible : culling.view_visible.data();
+        CullBatch(bounds[0], bounds[1], bounds[2], bounds[3], bounds[4], bounds[5], bounds[6],
+                  count, culling.frusta[v], target);
+
+        if (first)
+        {
+            for (unsigned int i = 0; i < count; i++)
+                visible[i] = (unsigned char) (visible[i] << v);
+            first = false;
+        }
+        else
+        {
+            for (unsigned int i = 0; i < count; i++)
+                visible[i] |= (unsigned char) (culling.view_visible[i] << v);
+        }
+    }
+}
+
+/* Transforms object space bounds by the model matrix and appends them, returns the object index */
+unsigned int AddCullingObject(SCullingSystem &culling, const SBounds &bounds, const glm::mat4 &model)
+{
+    unsigned int i = culling.count++;
+
+    // Keep the arrays padded so the kernel can always load full SIMD registers
+    size_t padded = ((culling.count + CULL_LANES - 1) / CULL_LANES) * CULL_LANES;
+    if (culling.center_x.size() < padded)
+    {
+        culling.center_x.resize(padded, 0.f);
+        culling.center_y.resize(padded, 0.f);
+        culling.center_z.resize(padded, 0.f);
+        culling.radius.resize(padded, 0.f);
+        culling.extent_x.resize(padded, 0.f);
+        culling.extent_y.resize(padded, 0.f);
+        culling.extent_z.resize(padded, 0.f);
+        culling.visible.resize(padded, 0);
+    }
+
+    glm::vec4 center = model * glm::vec4(bounds.center, 1.f);
+    glm::vec3 half = (bounds.max - bounds.min) * 0.5f;
+
+    // The world box of a transformed box uses the absolute values of the linear part (Arvo)
+    glm::vec3 extent = glm::vec3(0.f, 0.f, 0.f);
+    float max_scale_squared = 0.f;
+    for (int c = 0; c < 3; c++)
+    {
+        glm::vec3 column = glm::vec3(model[c].x, model[c].y, model[c].z);
+        extent.x += fabsf(column.x) * half[c];
+        extent.y += fabsf(column.y) * half[c];
+        extent.z += fabsf(column.z) * half[c];
+
+        float scale_squared = column.x * column.x + column.y * column.y + column.z * column.z;
+        if (scale_squared > max_scale_squared)
+            max_scale_squared = scale_squared;
+    }
+
+    float radius = bounds.radius * sqrtf(max_scale_squared);
+
+    // Static objects write back the same values, anything else invalidates the octree
+    if (i >= culling.previous_count || culling.center_x[i] != center.x || culling.center_y[i] != center.y ||
+        culling.center_z[i] != center.z || culling.radius[i] != radius)
+        culling.octree_dirty = true;
+
+    culling.center_x[i] = center.x;
+    culling.center_y[i] = center.y;
+    culling.center_z[i] = center.z;
+    culling.radius[i] = radius;
+    culling.extent_x[i] = extent.x;
+    culling.extent_y[i] = extent.y;
+    culling.extent_z[i] = extent.z;
+
+    return i;
+}
+
+/* Sorts the objects into a loose octree where a cell accepts spheres with a radius up to half its size */
+void BuildLooseOctree(SCullingSystem &culling)
+{
+    SLooseOctree &tree = culling.octree;
+    unsigned int n = culling.count;
+
+    // Root cube around every sphere centre
+    glm::vec3 lo = glm::vec3(culling.center_x[0], culling.center_y[0], culling.center_z[0]);
+    glm::vec3 hi = lo;
+    float max_radius = culling.radius[0];
+    for (unsigned int i = 1; i < n; i++)
+    {
+        glm::vec3 c = glm::vec3(culling.center_x[i], culling.center_y[i], culling.center_z[i]);
+        lo = glm::min(lo, c);
+        hi = glm::max(hi, c);
+        max_radius = fmaxf(max_radius, culling.radius[i]);
+    }
+
+    // The root is at least twice the largest radius so that its loose cell contains every sphere
+    glm::vec3 size = hi - lo;
+    tree.root_size = fmaxf(fmaxf(size.x, size.y), fmaxf(size.z, 2.f * max_radius));
+    tree.root_size = fmaxf(tree.root_size, 1e-3f) * 1.001f;
+    tree.root_min = lo;
+
+    // Dense cell storage, level L has (2^L)^3 cells
+    int total_cells = 0;
+    tree.level_offset.resize(CULL_OCTREE_LEVELS);
+    for (int level = 0; level < CULL_OCTREE_LEVELS; level++)
+    {
+        tree.level_offset[level] = total_cells;
+        total_cells += 1 << (3 * level);
+    }
+
+    tree.cell_count.assign(total_cells, 0);
+    tree.tree_count.assign(total_cells, 0);
+    tree.cell_start.assign(total_cells + 1, 0);
+    tree.object_cell.resize(n);
+    tree.objects.resize(n);
+
+    for (unsigned int i = 0; i < n; i++)
+    {
+        // Deepest level whose loose cells (twice the cell size) still contain the sphere
+        int level = 0;
+        float cell_size = tree.root_size;
+        while (level + 1 < CULL_OCTREE_LEVELS && culling.radius[i] <= cell_size * 0.25f)
+        {
+            cell_size *= 0.5f;
+            level++;
+        }
+
+        int res = 1 << level;
+        float inv_cell_size = 1.f / cell_size;
+        int ix = (int) ((culling.center_x[i] - tree.root_min.x) * inv_cell_size);
+        int iy = (int) ((culling.center_y[i] - tree.root_min.y) * inv_cell_size);
+        int iz = (int) ((culling.center_z[i] - tree.root_min.z) * inv_cell_size);
+        ix = ix < 0 ? 0 : (ix >= res ? res - 1 : ix);
+        iy = iy < 0 ? 0 : (iy >= res ? res - 1 : iy);
+        iz = iz < 0 ? 0 : (iz >= res ? res - 1 : iz);
+
+        int cell = tree.level_offset[level] + (iz * res + iy) * res + ix;
+        tree.object_cell[i] = cell;
+        tree.cell_count[cell]++;
+    }
+
+    // Counting sort of the objects by cell
+    for (int c = 0; c < total_cells; c++)
+        tree.cell_start[c + 1] = tree.cell_start[c] + tree.cell_count[c];
+
+    std::vector<unsigned int> cursor(tree.cell_start.begin(), tree.cell_start.end() - 1);
+    for (unsigned int i = 0; i < n; i++)
+        tree.objects[cursor[tree.object_cell[i]]++] = i;
+
+    // Subtree counts bottom-up so that empty branches are never visited
+    for (int c = 0; c < total_cells; c++)
+        tree.tree_count[c] = tree.cell_count[c];
+
+    for (int level = CULL_OCTREE_LEVELS - 1; level > 0; level--)
+    {
+        int res = 1 << level;
+        for (int z = 0; z < res; z++)
+            for (int y = 0; y < res; y++)
+                for (int x = 0; x < res; x++)
+                {
+                    int child = tree.level_offset[level] + (z * res + y) * res + x;
+                    int parent_res = res >> 1;
+                    int parent = tree.level_offset[level - 1] + ((z >> 1) * parent_res + (y >> 1)) * parent_res + (x >> 1);
+                    tree.tree_count[parent] += tree.tree_count[child];
+                }
+    }
+}
+
+/* Marks every object in the subtree of a cell as visible in views without testing it */
+void AcceptOctreeSubtree(SCullingSystem &culling, int level, int x, int y, int z, unsigned int views)
+{
+    SLooseOctree &tree = culling.octree;
+    int res = 1 << level;
+    int cell = tree.level_offset[level] + (z * res + y) * res + x;
+    if (tree.tree_count[cell] == 0)
+        return;
+
+    for (unsigned int k = tree.cell_start[cell]; k < tree.cell_start[cell + 1]; k++)
+        culling.visible[tree.objects[k]] |= (unsigned char) views;
+
+    if (level + 1 < CULL_OCTREE_LEVELS)
+        for (int c = 0; c < 8; c++)
+            AcceptOctreeSubtree(culling, level + 1, 2 * x + (c & 1), 2 * y + ((c >> 1) & 1), 2 * z + (c >> 2), views);
+}
+
+/* Culls the subtree of a cell for the views it may still be partially inside of. The cell is only
+ * skipped when it is outside every view, so the views together act as one combined frustum. */
+void CullOctreeCell(SCullingSystem &culling, int level, int x, int y, int z, unsigned int views)
+{
+    SLooseOctree &tree = culling.octree;
+    int res = 1 << level;
+    int cell = tree.level_offset[level] + (z * res + y) * res + x;
+    if (tree.tree_count[cell] == 0)
+        return;
+
+    // The loose cell is the cell grown by half its size on every side
+    float cell_size = tree.root_size / (float) res;
+    glm::vec3 center = tree.root_min + glm::vec3((float) x + 0.5f, (float) y + 0.5f, (float) z + 0.5f) * cell_size;
+    glm::vec3 extent = glm::vec3(cell_size, cell_size, cell_size);
+
+    unsigned int inside = 0;
+    unsigned int partial = 0;
+    for (unsigned int v = 0; v < culling.view_count; v++)
+    {
+        if ((views & (1u << v)) == 0)
+            continue;
+
+        int result = ClassifyAABB(culling.frusta[v], center, extent);
+        if (result == 2)
+            inside |= 1u << v;
+        else if (result == 1)
+            partial |= 1u << v;
+    }
+
+    if (inside != 0)
+        AcceptOctreeSubtree(culling, level, x, y, z, inside);
+    if (partial == 0)
+        return;
+
+    // Partially visible, test the objects of this cell with the batch kernel
+    unsigned int first = tree.cell_start[cell];
+    unsigned int count = tree.cell_count[cell];
+    if (count > 0)
+    {
+        unsigned int padded = ((count + CULL_LANES - 1) / CULL_LANES) * CULL_LANES;
+        const std::vector<float> *source[7] = {
+                &culling.center_x, &culling.center_y, &culling.center_z, &culling.radius,
+                &culling.extent_x, &culling.extent_y, &culling.extent_z
+        };
+
+        for (int a = 0; a < 7; a++)
+        {
+            culling.gather[a].resize(padded, 0.f);
+            for (unsigned int k = 0; k < count; k++)
+                culling.gather[a][k] = (*source[a])[tree.objects[first + k]];
+        }
+        culling.gather_visible.resize(padded);
+
+        // The objects are gathered once and tested against every partially intersecting view
+        const float *gathered[7];
+        for (int a = 0; a < 7; a++)
+            gathered[a] = culling.gather[a].data();
+        CullBatchViews(culling, gathered, padded, partial, culling.gather_visible.data());
+
+        for (unsigned int k = 0; k < count; k++)
+            culling.visible[tree.objects[first + k]] |= culling.gather_visible[k];
+
+        culling.stats.tested += count;
+    }
+
+    if (level + 1 < CULL_OCTREE_LEVELS)
+        for (int c = 0; c < 8; c++)
+            CullOctreeCell(culling, level + 1, 2 * x + (c & 1), 2 * y + ((c >> 1) & 1), 2 * z + (c >> 2), partial);
+}
+
+/* Culls every object added this frame against every view, small sets go straight through the batch kernel */
+void RunCulling(SCullingSystem &culling)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    SCullingStats &stats = culling.stats;
+    memset(&stats, 0, sizeof(SCullingStats));
+
+    unsigned int n = culling.count;
+    unsigned int all_views = (1u << culling.view_count) - 1u;
+    if (n > 0 && culling.view_count > 0)
+    {
+        if (n < CULL_OCTREE_THRESHOLD)
+        {
+            unsigned int padded = ((n + CULL_LANES - 1) / CULL_LANES) * CULL_LANES;
+            const float *bounds[7] = {
+                    culling.center_x.data(), culling.center_y.data(), culling.center_z.data(), culling.radius.data(),
+                    culling.extent_x.data(), culling.extent_y.data(), culling.extent_z.data()
+            };
+            CullBatchViews(culling, bounds, padded, all_views, culling.visible.data());
+            stats.tested = n;
+        }
+        else
+        {
+            if (culling.octree_dirty || n != culling.previous_count)
+            {
+                BuildLooseOctree(culling);
+                culling.octree_dirty = false;
+            }
+
+            memset(culling.visible.data(), 0, n);
+            CullOctreeCell(culling, 0, 0, 0, 0, all_views);
+        }
+    }
+
+    for (unsigned int i = 0; i < n; i++)
+        stats.visible += culling.visible[i] != 0;
+    stats.culled = n - stats.visible;
+    stats.views = culling.view_count;
+
+    std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+    stats.time_ms = elapsed.count();
+
+    culling.totals.tested += stats.tested;
+    culling.totals.visible += stats.visible;
+    culling.totals.culled += stats.culled;
+    culling.totals.views += stats.views;
+    culling.totals.time_ms += stats.time_ms;
+    culling.frames++;
+}
+
+/* True when the object is inside the frustum of any view */
+bool IsVisible(const SCullingSystem &culling, unsigned int object)
+{
+    return culling.visible[object] != 0;
+}
+
+/* Bit v is set when the object is inside the frustum of view v */
+unsigned int GetVisibleViews(const SCullingSystem &culling, unsigned int object)
+{
+    return culling.visible[object];
+}
+
+void PrintCullingStats(const SCullingSystem &culling)
+{
+    if (culling.frames == 0)
+        return;
+
+    float frames = (float) culling.frames;
+    const SCullingStats &t = culling.totals;
+
+    printf("INFO: Frustum Culling - %u frames, %d-wide SIMD, per frame averages:\n", culling.frames, CULL_LANES);
+    printf("INFO:   views: %.1f, visible in any view: %.1f, culled: %.1f, plane tested: %.1f\n",
+           (float) t.views / frames, (float) t.visible / frames, (float) t.culled / frames, (float) t.tested / frames);
+    printf("INFO:   culling time: %.4f ms\n", t.time_ms / frames);
+}
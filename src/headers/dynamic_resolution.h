@@ -0,0 +1,309 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cmath>
+
+/* ---- OpenGL Headers ---- */
+#include <glad/glad.h>
+
+/* ---- Header Files ---- */
+#include "gl_state.h"
+#include "shader.h"
+#include "memory.h"
+
+/* ---- Definitions ---- */
+// GPU frame times are read back this many frames after they were issued so that reading never stalls
+#define DRS_QUERY_LATENCY 4
+
+// Range of the render scale, applied to both axes of the output size
+#define DRS_MIN_SCALE 0.5f
+#define DRS_MAX_SCALE 1.f
+
+// The scale moves in steps of this size and by at most DRS_MAX_STEP per change
+#define DRS_SCALE_QUANTUM 0.05f
+#define DRS_MAX_STEP 0.15f
+
+// The scale only goes up again once the GPU time drops below this fraction of the target
+#define DRS_HEADROOM 0.8f
+
+// Frames measured at a new scale before it may change again, and the weight of each new measurement
+#define DRS_SETTLE_FRAMES 4
+#define DRS_SMOOTHING 0.25f
+
+// Strength of the sharpening applied by the upscale when the scale is below 1
+#define DRS_SHARPNESS 0.6f
+
+// GPU timestamps around one frame, the scale it was rendered at decides whether the result still applies
+struct SResolutionQueries
+{
+    unsigned int start;
+    unsigned int end;
+    float scale;
+    bool pending;
+};
+
+// The scene renders into the bottom left render_width x render_height region of an FBO the size of the
+// output, so changing the scale never reallocates. The region is then upscaled with sharpening.
+struct SDynamicResolution
+{
+    unsigned int fbo;
+    unsigned int color_texture;
+    unsigned int depth_buffer;
+    int width;
+    int height;
+    int render_width;
+    int render_height;
+
+    float scale;
+    float target_ms;
+    float smoothed_ms;
+    unsigned int settle_frames;
+
+    SResolutionQueries queries[DRS_QUERY_LATENCY];
+    int query;
+
+    unsigned int program;
+    unsigned int vao;
+    int region_loc;
+    int texel_loc;
+    int sharpness_loc;
+
+    unsigned int frames;
+    unsigned int samples;
+    unsigned int samples_dropped;
+    unsigned int over_target;
+    unsigned int changes;
+    double scale_sum;
+    double gpu_ms_sum;
+    float lowest_scale;
+};
+
+/* Allocates the render target for an output of width x height, keeping the current scale */
+bool ResizeDynamicResolution(SDynamicResolution &drs, int width, int height)
+{
+    if (width <= 0 || height <= 0)
+        return false;
+
+    if (drs.fbo == 0)
+    {
+        glGenFramebuffers(1, &drs.fbo);
+        glGenTextures(1, &drs.color_texture);
+        glGenRenderbuffers(1, &drs.depth_buffer);
+    }
+
+    drs.width = width;
+    drs.height = height;
+
+    // Linear filtering does the resampling, the sharpening is done in the shader
+    BindTexture(gl_state, 0, drs.color_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, drs.depth_buffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    BindFramebuffer(gl_state, GL_FRAMEBUFFER, drs.fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, drs.color_texture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, drs.depth_buffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        printf("ERROR: Dynamic Resolution - Framebuffer is incomplete.\n");
+        return false;
+    }
+
+    // RGBA8 colour and a packed depth/stencil buffer
+    ReleaseMemory(memory_tracker, &drs, MEMORY_RENDER_TARGETS);
+    TrackMemory(memory_tracker, "dynamic resolution target", MEMORY_RENDER_TARGETS, MEMORY_GPU, &drs, (size_t) width * height * (4 + 4));
+
+    printf("INFO: Dynamic Resolution - Render target %dx%d\n", width, height);
+    return true;
+}
+
+/* Creates the render target, the upscale shader and the timer queries, needs a current GL context */
+bool InitDynamicResolution(SDynamicResolution &drs, int width, int height, float target_ms)
+{
+    drs.fbo = 0;
+    drs.scale = DRS_MAX_SCALE;
+    drs.target_ms = target_ms;
+    drs.smoothed_ms = 0.f;
+    drs.settle_frames = 0;
+
+    drs.frames = 0;
+    drs.samples = 0;
+    drs.samples_dropped = 0;
+    drs.over_target = 0;
+    drs.changes = 0;
+    drs.scale_sum = 0.0;
+    drs.gpu_ms_sum = 0.0;
+    drs.lowest_scale = DRS_MAX_SCALE;
+
+    for (int i = 0; i < DRS_QUERY_LATENCY; i++)
+    {
+        glGenQueries(1, &drs.queries[i].start);
+        glGenQueries(1, &drs.queries[i].end);
+        drs.queries[i].pending = false;
+    }
+    drs.query = 0;
+
+    drs.program = LoadShader("shaders/upscale.vert", "shaders/upscale.frag");
+    drs.region_loc = glGetUniformLocation(drs.program, "region");
+    drs.texel_loc = glGetUniformLocation(drs.program, "texel");
+    drs.sharpness_loc = glGetUniformLocation(drs.program, "sharpness");
+    UseProgram(gl_state, drs.program);
+    glUniform1i(glGetUniformLocation(drs.program, "Source"), 0);
+
+    // Core profile draws need a VAO even when the vertices come from gl_VertexID
+    glGenVertexArrays(1, &drs.vao);
+
+    printf("INFO: Dynamic Resolution - Target GPU frame time %.2f ms, scale %.2f to %.2f\n", target_ms, DRS_MIN_SCALE, DRS_MAX_SCALE);
+    return ResizeDynamicResolution(drs, width, height);
+}
+
+/* Moves the scale towards the one expected to hit the target. The cost is taken to grow with the
+ * pixel count, so the scale changes with the square root of the time ratio. */
+void UpdateResolutionScale(SDynamicResolution &drs, float gpu_ms, float sample_scale)
+{
+    drs.samples++;
+    drs.gpu_ms_sum += gpu_ms;
+    if (gpu_ms > drs.target_ms)
+        drs.over_target++;
+
+    // Frames still in flight from before the last change say nothing about the current scale
+    if (sample_scale != drs.scale)
+        return;
+
+    drs.smoothed_ms = drs.settle_frames == 0 ? gpu_ms : drs.smoothed_ms + (gpu_ms - drs.smoothed_ms) * DRS_SMOOTHING;
+    drs.settle_frames++;
+    if (drs.settle_frames < DRS_SETTLE_FRAMES)
+        return;
+
+    bool over = drs.smoothed_ms > drs.target_ms;
+    bool under = drs.smoothed_ms < drs.target_ms * DRS_HEADROOM;
+    if (!over && !under)
+        return;
+
+    // Aim for the middle of the band between the headroom and the target
+    float aim_ms = drs.target_ms * (1.f + DRS_HEADROOM) * 0.5f;
+    float desired = drs.scale * sqrtf(aim_ms / fmaxf(drs.smoothed_ms, 1e-3f));
+    desired = fminf(fmaxf(desired, drs.scale - DRS_MAX_STEP), drs.scale + DRS_MAX_STEP);
+    desired = roundf(desired / DRS_SCALE_QUANTUM) * DRS_SCALE_QUANTUM;
+
+    // Rounding must never undo the direction the measurement asked for
+    if (over && desired >= drs.scale)
+        desired = drs.scale - DRS_SCALE_QUANTUM;
+    if (under && desired <= drs.scale)
+        desired = drs.scale + DRS_SCALE_QUANTUM;
+    desired = fminf(fmaxf(desired, DRS_MIN_SCALE), DRS_MAX_SCALE);
+
+    if (desired != drs.scale)
+    {
+        drs.scale = desired;
+        drs.settle_frames = 0;
+        drs.changes++;
+    }
+}
+
+/* Collects the GPU time of the frame issued DRS_QUERY_LATENCY frames ago, then binds the render target
+ * at the current scale and starts timing the new frame */
+void BeginDynamicResolutionFrame(SDynamicResolution &drs)
+{
+    drs.query = (drs.query + 1) % DRS_QUERY_LATENCY;
+    SResolutionQueries &queries = drs.queries[drs.query];
+
+    if (queries.pending)
+    {
+        GLint available = 0;
+        glGetQueryObjectiv(queries.end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 start = 0, end = 0;
+            glGetQueryObjectui64v(queries.start, GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(queries.end, GL_QUERY_RESULT, &end);
+
+            // Some drivers (llvmpipe) report garbage for the very first query, a frame never takes 10 s
+            if (end > start && end - start < 10000000000ull)
+                UpdateResolutionScale(drs, (float) ((double) (end - start) / 1e6), queries.scale);
+            else
+                drs.samples_dropped++;
+        }
+        else
+            drs.samples_dropped++;
+        queries.pending = false;
+    }
+
+    drs.render_width = (int) ((float) drs.width * drs.scale + 0.5f);
+    drs.render_height = (int) ((float) drs.height * drs.scale + 0.5f);
+    if (drs.render_width < 1)
+        drs.render_width = 1;
+    if (drs.render_height < 1)
+        drs.render_height = 1;
+
+    BindFramebuffer(gl_state, GL_FRAMEBUFFER, drs.fbo);
+    SetViewport(gl_state, 0, 0, drs.render_width, drs.render_height);
+
+    glQueryCounter(queries.start, GL_TIMESTAMP);
+    queries.scale = drs.scale;
+
+    drs.frames++;
+    drs.scale_sum += drs.scale;
+    if (drs.scale < drs.lowest_scale)
+        drs.lowest_scale = drs.scale;
+}
+
+/* Upscales the rendered region into the output framebuffer with sharpening and stops the frame timer */
+void EndDynamicResolutionFrame(SDynamicResolution &drs, unsigned int output_fbo)
+{
+    BindFramebuffer(gl_state, GL_FRAMEBUFFER, output_fbo);
+    SetViewport(gl_state, 0, 0, drs.width, drs.height);
+    SetCapability(gl_state, GL_CAP_DEPTH_TEST, false);
+
+    UseProgram(gl_state, drs.program);
+    BindTexture(gl_state, 0, drs.color_texture);
+    BindVertexArray(gl_state, drs.vao);
+    glUniform2f(drs.region_loc, (float) drs.render_width / (float) drs.width, (float) drs.render_height / (float) drs.height);
+    glUniform2f(drs.texel_loc, 1.f / (float) drs.width, 1.f / (float) drs.height);
+    // At full scale the upscale is a plain copy
+    glUniform1f(drs.sharpness_loc, drs.scale < DRS_MAX_SCALE ? DRS_SHARPNESS : 0.f);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    SetCapability(gl_state, GL_CAP_DEPTH_TEST, true);
+
+    SResolutionQueries &queries = drs.queries[drs.query];
+    glQueryCounter(queries.end, GL_TIMESTAMP);
+    queries.pending = true;
+}
+
+void DeleteDynamicResolution(SDynamicResolution &drs)
+{
+    for (int i = 0; i < DRS_QUERY_LATENCY; i++)
+    {
+        glDeleteQueries(1, &drs.queries[i].start);
+        glDeleteQueries(1, &drs.queries[i].end);
+    }
+    glDeleteFramebuffers(1, &drs.fbo);
+    glDeleteTextures(1, &drs.color_texture);
+    glDeleteRenderbuffers(1, &drs.depth_buffer);
+    glDeleteVertexArrays(1, &drs.vao);
+    glDeleteProgram(drs.program);
+    ResetGLState(gl_state);
+    ReleaseMemory(memory_tracker, &drs, MEMORY_RENDER_TARGETS);
+}
+
+void PrintDynamicResolutionStats(const SDynamicResolution &drs)
+{
+    if (drs.frames == 0)
+        return;
+
+    printf("INFO: Dynamic Resolution - %u frames at %dx%d, target %.2f ms:\n", drs.frames, drs.width, drs.height, drs.target_ms);
+    printf("INFO:   scale: %.3f average, %.2f lowest, %.2f last, %u changes\n",
+           drs.scale_sum / (double) drs.frames, drs.lowest_scale, drs.scale, drs.changes);
+    if (drs.samples > 0)
+        printf("INFO:   GPU frame time: %.4f ms average, %u of %u frames over target, %u not ready in time\n",
+               drs.gpu_ms_sum / (double) drs.samples, drs.over_target, drs.samples, drs.samples_dropped);
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstring>
+
+/* ---- OpenGL Headers ---- */
+#include <glad/glad.h>
+
+/* ---- Definitions ---- */
+#define GL_STATE_TEXTURE_UNITS 16
+
+// A cached binding that does not match anything GL could have bound, the next call always goes through
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu
+
+// The GL calls the tracker shadows
+enum EGLStateCall
+{
+    GL_CALL_USE_PROGRAM,
+    GL_CALL_BIND_VERTEX_ARRAY,
+    GL_CALL_BIND_BUFFER,
+    GL_CALL_ACTIVE_TEXTURE,
+    GL_CALL_BIND_TEXTURE,
+    GL_CALL_BIND_FRAMEBUFFER,
+    GL_CALL_ENABLE,
+    GL_CALL_POLYGON_MODE,
+    GL_CALL_CLEAR_COLOR,
+    GL_CALL_VIEWPORT,
+    GL_CALL_COUNT
+};
+
+// Capabilities that are shadowed by glEnable/glDisable
+enum EGLStateCapability
+{
+    GL_CAP_DEPTH_TEST,
+    GL_CAP_BLEND,
+    GL_CAP_CULL_FACE,
+    GL_CAP_SCISSOR_TEST,
+    GL_CAP_MULTISAMPLE,
+    GL_CAP_COUNT
+};
+
+struct SGLStateStats
+{
+    unsigned int issued[GL_CALL_COUNT];
+    unsigned int elided[GL_CALL_COUNT];
+};
+
+// Shadow copy of the context state that rendering code changes. Every change goes through
+// the functions below, which skip the GL call when the value is already set.
+struct SGLState
+{
+    unsigned int program;
+    unsigned int vertex_array;
+    unsigned int array_buffer;
+    unsigned int element_buffer;     // part of the VAO state, forgotten when the VAO changes
+    unsigned int active_texture;
+    unsigned int textures[GL_STATE_TEXTURE_UNITS];
+    unsigned int draw_framebuffer;
+    unsigned int read_framebuffer;
+
+    unsigned char enabled[GL_CAP_COUNT];    // 0, 1 or 2 for unknown
+    unsigned int polygon_mode;
+    float clear_color[4];
+    int viewport[4];
+
+    SGLStateStats stats;
+    SGLStateStats totals;
+    unsigned int frames;
+};
+
+// The context has one state, so every module shares one tracker
+SGLState gl_state;
+
+const char *gl_state_call_names[GL_CALL_COUNT] = {
+    "glUseProgram", "glBindVertexArray", "glBindBuffer", "glActiveTexture", "glBindTexture",
+    "glBindFramebuffer", "glEnable/Disable", "glPolygonMode", "glClearColor", "glViewport"
+};
+
+const GLenum gl_state_capabilities[GL_CAP_COUNT] = {
+    GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_SCISSOR_TEST, GL_MULTISAMPLE
+};
+
+/* Marks every binding as unknown, for after code that changed GL state behind the tracker's back
+ * or deleted bound objects (GL unbinds them and their names may be reused) */
+void ResetGLState(SGLState &state)
+{
+    state.program = GL_STATE_UNKNOWN;
+    state.vertex_array = GL_STATE_UNKNOWN;
+    state.array_buffer = GL_STATE_UNKNOWN;
+    state.element_buffer = GL_STATE_UNKNOWN;
+    state.active_texture = GL_STATE_UNKNOWN;
+    for (int i = 0; i < GL_STATE_TEXTURE_UNITS; i++)
+        state.textures[i] = GL_STATE_UNKNOWN;
+    state.draw_framebuffer = GL_STATE_UNKNOWN;
+    state.read_framebuffer = GL_STATE_UNKNOWN;
+
+    memset(state.enabled, 2, sizeof(state.enabled));
+    state.polygon_mode = GL_STATE_UNKNOWN;
+    for (int i = 0; i < 4; i++)
+    {
+        state.clear_color[i] = -1.f;
+        state.viewport[i] = -1;
+    }
+}
+
+void InitGLState(SGLState &state)
+{
+    ResetGLState(state);
+    memset(&state.stats, 0, sizeof(SGLStateStats));
+    memset(&state.totals, 0, sizeof(SGLStateStats));
+    state.frames = 0;
+}
+
+/* Counts the call and returns whether it has to be issued */
+bool TrackGLCall(SGLState &state, EGLStateCall call, bool changed)
+{
+    if (changed)
+        state.stats.issued[call]++;
+    else
+        state.stats.elided[call]++;
+    return changed;
+}
+
+void UseProgram(SGLState &state, unsigned int program)
+{
+    if (TrackGLCall(state, GL_CALL_USE_PROGRAM, state.program != program))
+    {
+        glUseProgram(program);
+        state.program = program;
+    }
+}
+
+void BindVertexArray(SGLState &state, unsigned int vertex_array)
+{
+    if (TrackGLCall(state, GL_CALL_BIND_VERTEX_ARRAY, state.vertex_array != vertex_array))
+    {
+        glBindVertexArray(vertex_array);
+        state.vertex_array = vertex_array;
+        state.element_buffer = GL_STATE_UNKNOWN;
+    }
+}
+
+void BindBuffer(SGLState &state, GLenum target, unsigned int buffer)
+{
+    unsigned int *bound = NULL;
+    if (target == GL_ARRAY_BUFFER)
+        bound = &state.array_buffer;
+    else if (target == GL_ELEMENT_ARRAY_BUFFER)
+        bound = &state.element_buffer;
+
+    // Other targets are not shadowed and always go through
+    if (TrackGLCall(state, GL_CALL_BIND_BUFFER, bound == NULL || *bound != buffer))
+    {
+        glBindBuffer(target, buffer);
+        if (bound != NULL)
+            *bound = buffer;
+    }
+}
+
+/* Binds a 2D texture to unit (below GL_STATE_TEXTURE_UNITS), only switching the active unit when needed */
+void BindTexture(SGLState &state, unsigned int unit, unsigned int texture)
+{
+    if (!TrackGLCall(state, GL_CALL_BIND_TEXTURE, state.textures[unit] != texture))
+        return;
+
+    if (TrackGLCall(state, GL_CALL_ACTIVE_TEXTURE, state.active_texture != unit))
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        state.active_texture = unit;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    state.textures[unit] = texture;
+}
+
+/* GL_FRAMEBUFFER sets both the draw and the read binding */
+void BindFramebuffer(SGLState &state, GLenum target, unsigned int framebuffer)
+{
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    bool changed = (draw && state.draw_framebuffer != framebuffer) || (read && state.read_framebuffer != framebuffer);
+
+    if (TrackGLCall(state, GL_CALL_BIND_FRAMEBUFFER, changed))
+    {
+        glBindFramebuffer(target, framebuffer);
+        if (draw)
+            state.draw_framebuffer = framebuffer;
+        if (read)
+            state.read_framebuffer = framebuffer;
+    }
+}
+
+void SetCapability(SGLState &state, EGLStateCapability capability, bool enable)
+{
+    unsigned char value = enable ? 1 : 0;
+    if (TrackGLCall(state, GL_CALL_ENABLE, state.enabled[capability] != value))
+    {
+        if (enable)
+            glEnable(gl_state_capabilities[capability]);
+        else
+            glDisable(gl_state_capabilities[capability]);
+        state.enabled[capability] = value;
+    }
+}
+
+void SetPolygonMode(SGLState &state, GLenum mode)
+{
+    if (TrackGLCall(state, GL_CALL_POLYGON_MODE, state.polygon_mode != mode))
+    {
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+        state.polygon_mode = mode;
+    }
+}
+
+void SetClearColor(SGLState &state, float r, float g, float b, float a)
+{
+    bool changed = state.clear_color[0] != r || state.clear_color[1] != g || state.clear_color[2] != b || state.clear_color[3] != a;
+    if (TrackGLCall(state, GL_CALL_CLEAR_COLOR, changed))
+    {
+        glClearColor(r, g, b, a);
+        state.clear_color[0] = r;
+        state.clear_color[1] = g;
+        state.clear_color[2] = b;
+        state.clear_color[3] = a;
+    }
+}
+
+void SetViewport(SGLState &state, int x, int y, int w, int h)
+{
+    bool changed = state.viewport[0] != x || state.viewport[1] != y || state.viewport[2] != w || state.viewport[3] != h;
+    if (TrackGLCall(state, GL_CALL_VIEWPORT, changed))
+    {
+        glViewport(x, y, w, h);
+        state.viewport[0] = x;
+        state.viewport[1] = y;
+        state.viewport[2] = w;
+        state.viewport[3] = h;
+    }
+}
+
+/* Clears the frame counters, calls made during loading are not part of any frame */
+void BeginGLStateFrame(SGLState &state)
+{
+    memset(&state.stats, 0, sizeof(SGLStateStats));
+}
+
+/* Adds the counters of the finished frame to the totals */
+void EndGLStateFrame(SGLState &state)
+{
+    for (int i = 0; i < GL_CALL_COUNT; i++)
+    {
+        state.totals.issued[i] += state.stats.issued[i];
+        state.totals.elided[i] += state.stats.elided[i];
+    }
+    state.frames++;
+}
+
+void PrintGLStateStats(const SGLState &state)
+{
+    if (state.frames == 0)
+        return;
+
+    float frames = (float) state.frames;
+    unsigned int issued = 0, elided = 0;
+
+    printf("INFO: GL State - %u frames, per frame averages of shadowed calls:\n", state.frames);
+    for (int i = 0; i < GL_CALL_COUNT; i++)
+    {
+        if (state.totals.issued[i] == 0 && state.totals.elided[i] == 0)
+            continue;
+        printf("INFO:   %-18s %6.1f issued, %6.1f elided\n", gl_state_call_names[i],
+               (float) state.totals.issued[i] / frames, (float) state.totals.elided[i] / frames);
+        issued += state.totals.issued[i];
+        elided += state.totals.elided[i];
+    }
+    printf("INFO:   total              %6.1f issued, %6.1f elided (%.1f%% of the calls dropped)\n",
+           (float) issued / frames, (float) elided / frames, issued + elided > 0 ? 100.f * (float) elided / (float) (issued + elided) : 0.f);
+}
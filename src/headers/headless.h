@@ -0,0 +1,176 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/* ---- OpenGL Headers ---- */
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+/* ---- Header Files ---- */
+#include "gl_state.h"
+#include "memory.h"
+
+// Offscreen rendering without a window system: an EGL context with no surface (Mesa's surfaceless
+// platform works with llvmpipe on machines without a GPU or display) that draws into an FBO
+struct SHeadlessContext
+{
+    EGLDisplay display;
+    EGLContext context;
+
+    unsigned int fbo;
+    unsigned int color_buffer;
+    unsigned int depth_buffer;
+    int width;
+    int height;
+
+    // Rows of the last frame read back, bottom row first as OpenGL returns them
+    std::vector<unsigned char> pixels;
+};
+
+/* Creates a GL 3.3 core context and makes it current, returns false when EGL cannot provide one */
+bool CreateHeadlessContext(SHeadlessContext &headless)
+{
+    headless.display = EGL_NO_DISPLAY;
+    headless.context = EGL_NO_CONTEXT;
+    headless.fbo = 0;
+
+    // Prefer the surfaceless platform, it needs neither X11 nor a DRM device
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display != NULL)
+        headless.display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (headless.display == EGL_NO_DISPLAY)
+        headless.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (headless.display == EGL_NO_DISPLAY || !eglInitialize(headless.display, &major, &minor))
+    {
+        printf("ERROR: Headless - Could not initialize an EGL display.\n");
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API))
+    {
+        printf("ERROR: Headless - EGL %d.%d has no desktop OpenGL.\n", major, minor);
+        return false;
+    }
+
+    // Nothing is drawn to an EGL surface, so any config that renders desktop GL will do
+    const EGLint config_attributes[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config = NULL;
+    EGLint config_count = 0;
+    if (!eglChooseConfig(headless.display, config_attributes, &config, 1, &config_count) || config_count == 0)
+        config = EGL_NO_CONFIG_KHR;  // accepted by drivers with EGL_KHR_no_config_context
+
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    headless.context = eglCreateContext(headless.display, config, EGL_NO_CONTEXT, context_attributes);
+    if (headless.context == EGL_NO_CONTEXT)
+    {
+        printf("ERROR: Headless - Could not create an OpenGL 3.3 core context (EGL error 0x%x).\n", eglGetError());
+        return false;
+    }
+
+    if (!eglMakeCurrent(headless.display, EGL_NO_SURFACE, EGL_NO_SURFACE, headless.context))
+    {
+        printf("ERROR: Headless - Surfaceless contexts are not supported (EGL error 0x%x).\n", eglGetError());
+        return false;
+    }
+
+    printf("INFO: Headless - EGL %d.%d, %s\n", major, minor, eglQueryString(headless.display, EGL_VENDOR));
+    return true;
+}
+
+/* Creates the FBO the scene renders into and binds it, needs the GL functions to be loaded */
+bool CreateHeadlessFramebuffer(SHeadlessContext &headless, int width, int height)
+{
+    headless.width = width;
+    headless.height = height;
+
+    glGenRenderbuffers(1, &headless.color_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless.color_buffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &headless.depth_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, headless.depth_buffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+    glGenFramebuffers(1, &headless.fbo);
+    BindFramebuffer(gl_state, GL_FRAMEBUFFER, headless.fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headless.color_buffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, headless.depth_buffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        printf("ERROR: Headless - Framebuffer is incomplete.\n");
+        return false;
+    }
+
+    SetViewport(gl_state, 0, 0, width, height);
+    TrackMemory(memory_tracker, "headless framebuffer", MEMORY_RENDER_TARGETS, MEMORY_GPU, &headless,
+                (size_t) width * height * (4 + 4));
+    printf("INFO: Headless - Rendering %dx%d into an FBO, %s\n", width, height, (const char *) glGetString(GL_RENDERER));
+    return true;
+}
+
+/* Reads the finished frame back and writes it as a binary PPM */
+bool WriteHeadlessFramePPM(SHeadlessContext &headless, const char *path)
+{
+    int w = headless.width;
+    int h = headless.height;
+    headless.pixels.resize((size_t) w * h * 3);
+
+    BindFramebuffer(gl_state, GL_READ_FRAMEBUFFER, headless.fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, headless.pixels.data());
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("ERROR: Headless - Could not write %s\n", path);
+        return false;
+    }
+
+    // PPM stores the top row first
+    fprintf(file, "P6\n%d %d\n255\n", w, h);
+    for (int y = h - 1; y >= 0; y--)
+        fwrite(headless.pixels.data() + (size_t) y * w * 3, 1, (size_t) w * 3, file);
+    fclose(file);
+    return true;
+}
+
+void DestroyHeadlessContext(SHeadlessContext &headless)
+{
+    if (headless.fbo != 0)
+    {
+        glDeleteFramebuffers(1, &headless.fbo);
+        glDeleteRenderbuffers(1, &headless.color_buffer);
+        glDeleteRenderbuffers(1, &headless.depth_buffer);
+        ResetGLState(gl_state);
+        ReleaseMemory(memory_tracker, &headless, MEMORY_RENDER_TARGETS);
+        headless.fbo = 0;
+    }
+
+    if (headless.display != EGL_NO_DISPLAY)
+    {
+        eglMakeCurrent(headless.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (headless.context != EGL_NO_CONTEXT)
+            eglDestroyContext(headless.display, headless.context);
+        eglTerminate(headless.display);
+    }
+
+    headless.display = EGL_NO_DISPLAY;
+    headless.context = EGL_NO_CONTEXT;
+}
@@ -0,0 +1,535 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+/* ---- OpenGL Headers ---- */
+#include <glad/glad.h>
+
+/* ---- GLM Includes ---- */
+#ifdef _WIN32
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <glm/glm/gtc/type_ptr.hpp>
+#endif
+
+#ifdef __unix
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#endif
+
+/* ---- Header Files ---- */
+#include "mesh.h"
+#include "shader.h"
+#include "gl_state.h"
+#include "memory.h"
+#include "render_queue.h"
+#include "stream_buffer.h"
+
+// Impostors: a mesh is captured from a ring of yaw angles at a few pitches into an atlas, and instances past
+// the switch distance are drawn as camera facing quads that show the captured view nearest to the camera.
+// The atlas holds the colours in its lower half and camera space normals in its upper half, so the quads
+// are lit like the meshes they replace. Atlases are cached on disk, keyed on the size and modification time
+// of the mesh and texture files.
+
+/* ---- Definitions ---- */
+#define IMPOSTOR_MAGIC   "CGIM"
+#define IMPOSTOR_VERSION 1
+
+// Views captured per mesh, every 360 / IMPOSTOR_YAW_VIEWS degrees around it at pitches from 0 to IMPOSTOR_MAX_PITCH
+#define IMPOSTOR_YAW_VIEWS   8
+#define IMPOSTOR_PITCH_VIEWS 3
+#define IMPOSTOR_MAX_PITCH   60.f
+
+// Texels along the side of one captured view
+#define IMPOSTOR_CELL_SIZE 128
+
+// Colours are grown this many texels into the empty border of each view, so filtering does not pull in black
+#define IMPOSTOR_DILATE_PASSES 2
+
+// One mesh as drawn with one texture
+struct SImpostor
+{
+    int mesh;
+    unsigned int texture;
+    unsigned int atlas;
+
+    // Object space bounding sphere the views are framed on
+    glm::vec3 center;
+    float radius;
+};
+
+struct SImpostorSystem
+{
+    std::vector<SImpostor> impostors;
+
+    // Unit quad of the mesh registry that every impostor draws
+    int quad;
+
+    // Instances whose bounding sphere center is at least this far from the first camera become impostors
+    float switch_distance;
+    const char *cache_directory;
+
+    unsigned int program;
+    int cam_pos_loc;
+    int view_loc;
+    int projection_loc;
+    int light_1_direction_loc, light_1_position_loc, light_1_color_loc;
+    int light_2_direction_loc, light_2_position_loc, light_2_color_loc;
+
+    unsigned int bake_program;
+    int bake_view_loc;
+    int bake_projection_loc;
+    int bake_normals_loc;
+
+    unsigned int baked;
+    unsigned int cached;
+    float bake_ms;
+    float load_ms;
+    size_t atlas_bytes;
+};
+
+/* Registers the quad every impostor is drawn with, must come before the registry is uploaded */
+int RegisterImpostorQuad(SMeshRegistry &registry, EVertexFormat format)
+{
+    // Two triangles over [-1, 1] facing +z, the texture coordinates span the captured view
+    const float corners[6][2] = { { -1.f, -1.f }, { 1.f, -1.f }, { 1.f, 1.f }, { -1.f, -1.f }, { 1.f, 1.f }, { -1.f, 1.f } };
+    float vertices[6 * MESH_VERTEX_FLOATS];
+    for (int v = 0; v < 6; v++)
+    {
+        float *out = vertices + v * MESH_VERTEX_FLOATS;
+        out[0] = corners[v][0];
+        out[1] = corners[v][1];
+        out[2] = 0.f;
+        out[3] = (corners[v][0] + 1.f) * .5f;
+        out[4] = (corners[v][1] + 1.f) * .5f;
+        out[5] = 0.f;
+        out[6] = 0.f;
+        out[7] = 1.f;
+    }
+
+    // The quad turns to face the camera, so it is culled as the box around the sphere it covers
+    SBounds bounds;
+    bounds.min = glm::vec3(-1.f);
+    bounds.max = glm::vec3(1.f);
+    bounds.center = glm::vec3(0.f);
+    bounds.radius = sqrtf(3.f);
+
+    return RegisterMesh(registry, vertices, 6, bounds, format);
+}
+
+/* Direction from the mesh to the camera of a captured view, in object space */
+glm::vec3 ImpostorViewDirection(int column, int row)
+{
+    float yaw = glm::radians(360.f * (float) column / (float) IMPOSTOR_YAW_VIEWS);
+    float pitch = IMPOSTOR_PITCH_VIEWS > 1 ? glm::radians(IMPOSTOR_MAX_PITCH) * (float) row / (float) (IMPOSTOR_PITCH_VIEWS - 1) : 0.f;
+    return glm::vec3(cosf(pitch) * sinf(yaw), sinf(pitch), cosf(pitch) * cosf(yaw));
+}
+
+/* Size and modification time of a source file, a cached atlas is only used while both match */
+bool ImpostorSourceStamp(const char *path, int64_t stamp[2])
+{
+    struct stat info;
+    if (stat(path, &info) != 0)
+        return false;
+
+    stamp[0] = (int64_t) info.st_size;
+    stamp[1] = (int64_t) info.st_mtime;
+    return true;
+}
+
+/* Loads an atlas captured with the current settings from the same sources, false when there is none */
+bool LoadImpostorCache(const char *path, const int64_t stamp[4], int width, int height, std::vector<unsigned char> &pixels)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+
+    char magic[4];
+    uint32_t header[6];
+    int64_t cached_stamp[4];
+    bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, IMPOSTOR_MAGIC, 4) == 0 &&
+              fread(header, sizeof(uint32_t), 6, file) == 6 && fread(cached_stamp, sizeof(int64_t), 4, file) == 4;
+
+    ok = ok && header[0] == IMPOSTOR_VERSION && header[1] == IMPOSTOR_YAW_VIEWS && header[2] == IMPOSTOR_PITCH_VIEWS &&
+         header[3] == IMPOSTOR_CELL_SIZE && header[4] == (uint32_t) width && header[5] == (uint32_t) height &&
+         memcmp(cached_stamp, stamp, sizeof(cached_stamp)) == 0;
+
+    if (ok)
+    {
+        pixels.resize((size_t) width * height * 4);
+        ok = fread(pixels.data(), 1, pixels.size(), file) == pixels.size();
+    }
+
+    fclose(file);
+    return ok;
+}
+
+void SaveImpostorCache(const char *path, const int64_t stamp[4], int width, int height, const std::vector<unsigned char> &pixels)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("ERROR: Impostors - could not write the cache %s\n", path);
+        return;
+    }
+
+    uint32_t header[6] = { IMPOSTOR_VERSION, IMPOSTOR_YAW_VIEWS, IMPOSTOR_PITCH_VIEWS, IMPOSTOR_CELL_SIZE, (uint32_t) width, (uint32_t) height };
+    fwrite(IMPOSTOR_MAGIC, 1, 4, file);
+    fwrite(header, sizeof(uint32_t), 6, file);
+    fwrite(stamp, sizeof(int64_t), 4, file);
+    fwrite(pixels.data(), 1, pixels.size(), file);
+    fclose(file);
+}
+
+/* Gives the empty texels next to covered ones the average colour of their covered neighbours. They stay
+ * below the alpha test, alpha 1 only marks them as filled for the next pass. */
+void DilateImpostorAtlas(std::vector<unsigned char> &pixels, int width, int height)
+{
+    std::vector<unsigned char> source;
+    const int offsets[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+
+    for (int pass = 0; pass < IMPOSTOR_DILATE_PASSES; pass++)
+    {
+        source = pixels;
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                unsigned char *texel = pixels.data() + ((size_t) y * width + x) * 4;
+                if (source[((size_t) y * width + x) * 4 + 3] != 0)
+                    continue;
+
+                int sum[3] = { 0, 0, 0 }, count = 0;
+                for (int n = 0; n < 4; n++)
+                {
+                    int nx = x + offsets[n][0], ny = y + offsets[n][1];
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height)
+                        continue;
+
+                    const unsigned char *neighbour = source.data() + ((size_t) ny * width + nx) * 4;
+                    if (neighbour[3] == 0)
+                        continue;
+                    for (int c = 0; c < 3; c++)
+                        sum[c] += neighbour[c];
+                    count++;
+                }
+
+                if (count == 0)
+                    continue;
+                for (int c = 0; c < 3; c++)
+                    texel[c] = (unsigned char) (sum[c] / count);
+                texel[3] = 1;
+            }
+        }
+    }
+}
+
+/* Renders every view of the mesh into an offscreen atlas and reads it back */
+bool BakeImpostorAtlas(const SImpostorSystem &system, const SMeshRegistry &registry, const SImpostor &impostor,
+                       int width, int height, std::vector<unsigned char> &pixels)
+{
+    // Headless runs draw into a framebuffer of their own and set its viewport once, both are restored afterwards
+    GLint previous_fbo = 0, previous_viewport[4];
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_fbo);
+    glGetIntegerv(GL_VIEWPORT, previous_viewport);
+
+    unsigned int fbo, color, depth;
+    glGenFramebuffers(1, &fbo);
+    glGenTextures(1, &color);
+    glGenRenderbuffers(1, &depth);
+
+    BindTexture(gl_state, 0, color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    BindFramebuffer(gl_state, GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (complete)
+    {
+        SetViewport(gl_state, 0, 0, width, height);
+        SetClearColor(gl_state, 0.f, 0.f, 0.f, 0.f);
+        SetCapability(gl_state, GL_CAP_DEPTH_TEST, true);
+        SetPolygonMode(gl_state, GL_FILL);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // The mesh stays at the origin of its object space and the capture camera moves around it
+        SObjectData object;
+        object.model = glm::mat4(1.f);
+        unsigned int object_buffer;
+        glGenBuffers(1, &object_buffer);
+        BindBuffer(gl_state, GL_UNIFORM_BUFFER, object_buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(SObjectData), &object, GL_STATIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, STREAM_OBJECT_BINDING, object_buffer);
+
+        const SMesh &mesh = registry.meshes[impostor.mesh];
+        UseProgram(gl_state, system.bake_program);
+        BindTexture(gl_state, 0, impostor.texture);
+        BindVertexArray(gl_state, mesh.vao);
+
+        // An orthographic box around the sphere, so every view fills its cell the same way
+        float r = impostor.radius;
+        glm::mat4 projection = glm::ortho(-r, r, -r, r, .5f * r, 3.5f * r);
+        glUniformMatrix4fv(system.bake_projection_loc, 1, GL_FALSE, glm::value_ptr(projection));
+
+        for (int row = 0; row < IMPOSTOR_PITCH_VIEWS; row++)
+        {
+            for (int column = 0; column < IMPOSTOR_YAW_VIEWS; column++)
+            {
+                glm::vec3 eye = impostor.center + ImpostorViewDirection(column, row) * (2.f * r);
+                glm::mat4 view = glm::lookAt(eye, impostor.center, glm::vec3(0.f, 1.f, 0.f));
+                glUniformMatrix4fv(system.bake_view_loc, 1, GL_FALSE, glm::value_ptr(view));
+
+                // Colours in the lower half, normals in the upper half
+                for (int half = 0; half < 2; half++)
+                {
+                    SetViewport(gl_state, column * IMPOSTOR_CELL_SIZE, (half * IMPOSTOR_PITCH_VIEWS + row) * IMPOSTOR_CELL_SIZE,
+                                IMPOSTOR_CELL_SIZE, IMPOSTOR_CELL_SIZE);
+                    glUniform1i(system.bake_normals_loc, half);
+                    glDrawElementsBaseVertex(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_INT,
+                                             (const void *) (sizeof(unsigned int) * (size_t) mesh.first_index), mesh.base_vertex);
+                }
+            }
+        }
+
+        pixels.resize((size_t) width * height * 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+        glDeleteBuffers(1, &object_buffer);
+    }
+    else
+        printf("ERROR: Impostors - Framebuffer is incomplete.\n");
+
+    BindFramebuffer(gl_state, GL_FRAMEBUFFER, (unsigned int) previous_fbo);
+    SetViewport(gl_state, previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteTextures(1, &color);
+    glDeleteRenderbuffers(1, &depth);
+
+    // The bake changed bindings the tracker does not shadow, so it forgets everything
+    ResetGLState(gl_state);
+    return complete;
+}
+
+/* Creates the mipmapped atlas texture, clamped so the views at the edges do not wrap */
+GLuint UploadImpostorAtlas(const std::vector<unsigned char> &pixels, int width, int height)
+{
+    GLuint atlas;
+    glGenTextures(1, &atlas);
+    BindTexture(gl_state, 0, atlas);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glGenerateMipmap(GL_TEXTURE_2D);
+    return atlas;
+}
+
+/* Loads the impostor shaders, needs a current GL context. Atlases are cached in cache_directory. */
+bool InitImpostorSystem(SImpostorSystem &system, int quad, float switch_distance, const char *cache_directory)
+{
+    system.quad = quad;
+    system.switch_distance = switch_distance;
+    system.cache_directory = cache_directory;
+    system.baked = 0;
+    system.cached = 0;
+    system.bake_ms = 0.f;
+    system.load_ms = 0.f;
+    system.atlas_bytes = 0;
+
+    system.program = LoadShader("shaders/impostor.vert", "shaders/impostor.frag");
+    system.bake_program = LoadShader("shaders/vertex.vert", "shaders/impostor_bake.frag");
+    if (system.program == 0 || system.bake_program == 0)
+        return false;
+
+    // Both read their models from the object data, the impostors an array of them
+    glUniformBlockBinding(system.program, glGetUniformBlockIndex(system.program, "ObjectData"), STREAM_OBJECT_BINDING);
+    glUniformBlockBinding(system.bake_program, glGetUniformBlockIndex(system.bake_program, "ObjectData"), STREAM_OBJECT_BINDING);
+
+    system.cam_pos_loc           = glGetUniformLocation(system.program, "camPos");
+    system.view_loc              = glGetUniformLocation(system.program, "view");
+    system.projection_loc        = glGetUniformLocation(system.program, "projection");
+    system.light_1_direction_loc = glGetUniformLocation(system.program, "light_1.lightDirection");
+    system.light_1_position_loc  = glGetUniformLocation(system.program, "light_1.lightPos");
+    system.light_1_color_loc     = glGetUniformLocation(system.program, "light_1.lightColor");
+    system.light_2_direction_loc = glGetUniformLocation(system.program, "light_2.lightDirection");
+    system.light_2_position_loc  = glGetUniformLocation(system.program, "light_2.lightPos");
+    system.light_2_color_loc     = glGetUniformLocation(system.program, "light_2.lightColor");
+
+    system.bake_view_loc       = glGetUniformLocation(system.bake_program, "view");
+    system.bake_projection_loc = glGetUniformLocation(system.bake_program, "projection");
+    system.bake_normals_loc    = glGetUniformLocation(system.bake_program, "bakeNormals");
+
+    // The layout of the atlases never changes
+    UseProgram(gl_state, system.program);
+    glUniform3f(glGetUniformLocation(system.program, "impostorViews"), (float) IMPOSTOR_YAW_VIEWS, (float) IMPOSTOR_PITCH_VIEWS,
+                glm::radians(IMPOSTOR_MAX_PITCH));
+
+#ifdef _WIN32
+    _mkdir(cache_directory);
+#else
+    mkdir(cache_directory, 0755);
+#endif
+    return true;
+}
+
+/* Returns the impostor of a mesh drawn with a texture, capturing its atlas or loading it from the cache the
+ * first time. The mesh must have been uploaded, name identifies the pair in the cache. */
+int AddImpostor(SImpostorSystem &system, const SMeshRegistry &registry, int mesh, unsigned int texture, const char *name,
+                const char *mesh_path, const char *texture_path)
+{
+    for (size_t i = 0; i < system.impostors.size(); i++)
+        if (system.impostors[i].mesh == mesh && system.impostors[i].texture == texture)
+            return (int) i;
+
+    typedef std::chrono::high_resolution_clock clock;
+    clock::time_point start = clock::now();
+
+    // The sphere around the bounding box, which the captured views are framed on
+    const SBounds &bounds = registry.meshes[mesh].bounds;
+    SImpostor impostor;
+    impostor.mesh = mesh;
+    impostor.texture = texture;
+    impostor.center = (bounds.min + bounds.max) * .5f;
+    impostor.radius = glm::length(bounds.max - impostor.center);
+    if (impostor.radius <= 0.f)
+        impostor.radius = 1.f;
+
+    int width = IMPOSTOR_YAW_VIEWS * IMPOSTOR_CELL_SIZE;
+    int height = 2 * IMPOSTOR_PITCH_VIEWS * IMPOSTOR_CELL_SIZE;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.impostor", system.cache_directory, name);
+    int64_t stamp[4];
+    bool stamped = ImpostorSourceStamp(mesh_path, stamp) && ImpostorSourceStamp(texture_path, stamp + 2);
+
+    std::vector<unsigned char> pixels;
+    bool cached = stamped && LoadImpostorCache(path, stamp, width, height, pixels);
+    if (!cached)
+    {
+        if (!BakeImpostorAtlas(system, registry, impostor, width, height, pixels))
+            return -1;
+        DilateImpostorAtlas(pixels, width, height);
+        if (stamped)
+            SaveImpostorCache(path, stamp, width, height, pixels);
+    }
+
+    impostor.atlas = UploadImpostorAtlas(pixels, width, height);
+    system.impostors.push_back(impostor);
+
+    // RGBA8 and its mip chain
+    size_t bytes = (size_t) width * height * 4 * 4 / 3;
+    system.atlas_bytes += bytes;
+    TrackMemory(memory_tracker, "impostor atlas", MEMORY_IMPOSTORS, MEMORY_GPU, &system, bytes);
+
+    float ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    if (cached)
+    {
+        system.cached++;
+        system.load_ms += ms;
+    }
+    else
+    {
+        system.baked++;
+        system.bake_ms += ms;
+    }
+
+    printf("INFO: Impostor %d - %s, %d views %s in %.2f ms\n", (int) system.impostors.size() - 1, name,
+           IMPOSTOR_YAW_VIEWS * IMPOSTOR_PITCH_VIEWS, cached ? "loaded from the cache" : "captured", ms);
+    return (int) system.impostors.size() - 1;
+}
+
+/* Queues the impostor of an instance with the world matrix when it is past the switch distance from camera,
+ * returns false when the full mesh should be drawn instead. Called from the job that builds the commands. */
+bool PushImpostorDraw(SRenderQueue &queue, const SImpostorSystem &system, const SMeshRegistry &registry, int impostor,
+                      const glm::mat4 &world, const glm::vec3 &camera)
+{
+    const SImpostor &entry = system.impostors[impostor];
+    glm::vec3 offset = glm::vec3(world * glm::vec4(entry.center, 1.f)) - camera;
+    if (glm::dot(offset, offset) < system.switch_distance * system.switch_distance)
+        return false;
+
+    // The model maps the quad's [-1, 1] box onto the bounding sphere, the shader turns it to the camera
+    glm::mat4 model = glm::scale(glm::translate(world, entry.center), glm::vec3(entry.radius));
+    const SMesh &quad = registry.meshes[system.quad];
+
+    SDrawCommand &command = PushDrawCommand(queue, system.program, entry.atlas, quad.vao, quad, model);
+    command.instanced = true;
+    command.replaced_index_count = registry.meshes[entry.mesh].index_count;
+    return true;
+}
+
+/* Sets the lights of a frame, like the uniforms of the scene program */
+void SetImpostorLights(const SImpostorSystem &system, const glm::vec3 &light_1_position, const glm::vec3 &light_1_direction,
+                       const glm::vec3 &light_2_position, const glm::vec3 &light_2_direction)
+{
+    UseProgram(gl_state, system.program);
+    glUniform3f(system.light_1_direction_loc, light_1_direction.x, light_1_direction.y, light_1_direction.z);
+    glUniform3f(system.light_1_position_loc, light_1_position.x, light_1_position.y, light_1_position.z);
+    glUniform3f(system.light_1_color_loc, 1.0f, 1.0f, 1.0f);
+    glUniform3f(system.light_2_direction_loc, light_2_direction.x, light_2_direction.y, light_2_direction.z);
+    glUniform3f(system.light_2_position_loc, light_2_position.x, light_2_position.y, light_2_position.z);
+    glUniform3f(system.light_2_color_loc, 1.0f, 1.0f, 1.0f);
+}
+
+/* Sets the camera of a view, the quads turn towards its position */
+void SetImpostorView(const SImpostorSystem &system, const glm::vec3 &position, const glm::mat4 &view, const glm::mat4 &projection)
+{
+    UseProgram(gl_state, system.program);
+    glUniform3f(system.cam_pos_loc, position.x, position.y, position.z);
+    glUniformMatrix4fv(system.view_loc, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(system.projection_loc, 1, GL_FALSE, glm::value_ptr(projection));
+}
+
+void DeleteImpostorSystem(SImpostorSystem &system)
+{
+    for (size_t i = 0; i < system.impostors.size(); i++)
+        glDeleteTextures(1, &system.impostors[i].atlas);
+    system.impostors.clear();
+    glDeleteProgram(system.program);
+    glDeleteProgram(system.bake_program);
+    ResetGLState(gl_state);
+    ReleaseMemory(memory_tracker, &system, MEMORY_IMPOSTORS);
+}
+
+/* The atlases and what the impostors saved in the frames of queue, whose instanced draws are all impostors */
+void PrintImpostorStats(const SImpostorSystem &system, const SRenderQueue &queue)
+{
+    printf("INFO: Impostors - %zu atlases of %dx%d, %d views each, %.2f MB, switching at %.1f m\n", system.impostors.size(),
+           IMPOSTOR_YAW_VIEWS * IMPOSTOR_CELL_SIZE, 2 * IMPOSTOR_PITCH_VIEWS * IMPOSTOR_CELL_SIZE, IMPOSTOR_YAW_VIEWS * IMPOSTOR_PITCH_VIEWS,
+           (double) system.atlas_bytes / (1024.0 * 1024.0), system.switch_distance);
+    printf("INFO:   %u captured in %.2f ms, %u loaded from %s in %.2f ms\n", system.baked, system.bake_ms, system.cached,
+           system.cache_directory, system.load_ms);
+
+    if (queue.frames == 0)
+        return;
+
+    float frames = (float) queue.frames;
+    const SRenderStats &t = queue.totals;
+    float full = (float) (t.triangles + t.triangles_replaced);
+    printf("INFO:   per frame: %.1f impostors in %.1f draw calls (%.1f draw calls saved), %.0f of %.0f triangles saved (%.1f%%)\n",
+           (float) t.instances / frames, (float) t.instanced_draw_calls / frames, (float) (t.instances - t.instanced_draw_calls) / frames,
+           (float) t.triangles_replaced / frames, full / frames, full > 0.f ? 100.f * (float) t.triangles_replaced / full : 0.f);
+}
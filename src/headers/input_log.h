@@ -0,0 +1,216 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+/* ---- Definitions ---- */
+#define INPUT_LOG_MAGIC   "CGIL"
+#define INPUT_LOG_VERSION 1
+
+// Keys the simulation reads, one bit each
+enum EInputKey
+{
+    INPUT_KEY_FORWARD     = 1 << 0,   // W
+    INPUT_KEY_LEFT        = 1 << 1,   // A
+    INPUT_KEY_BACKWARD    = 1 << 2,   // S
+    INPUT_KEY_RIGHT       = 1 << 3,   // D
+    INPUT_KEY_ORBIT_UP    = 1 << 4,   // Up
+    INPUT_KEY_ORBIT_DOWN  = 1 << 5,   // Down
+    INPUT_KEY_ORBIT_LEFT  = 1 << 6,   // Left
+    INPUT_KEY_ORBIT_RIGHT = 1 << 7,   // Right
+    INPUT_KEY_ZOOM_IN     = 1 << 8,   // R
+    INPUT_KEY_ZOOM_OUT    = 1 << 9,   // F
+    INPUT_KEY_TREE_LEFT   = 1 << 10,  // ,
+    INPUT_KEY_TREE_RIGHT  = 1 << 11,  // .
+    INPUT_KEY_MODEL_VIEW  = 1 << 12,  // M
+    INPUT_KEY_FLY_THROUGH = 1 << 13,  // N
+    INPUT_KEY_LIGHT       = 1 << 14   // Space or L
+};
+
+// Everything one fixed timestep tick reads from the user
+struct SInputState
+{
+    uint16_t keys;
+    float mouse_dx;
+    float mouse_dy;
+};
+
+// A tick whose input differs from "same keys as before, no mouse movement"
+struct SInputRecord
+{
+    uint32_t tick;
+    uint16_t keys;
+    float mouse_dx;
+    float mouse_dy;
+};
+
+// Input of a whole run, one state per simulation tick. Only changes are stored, so the file
+// is 14 bytes per key change or mouse movement plus a 20 byte header.
+struct SInputLog
+{
+    std::vector<SInputRecord> records;
+    uint32_t tick_count;
+    uint32_t sim_hz;
+
+    // Replay position
+    uint32_t tick;
+    size_t next_record;
+    uint16_t keys;
+};
+
+void InitInputLog(SInputLog &log, int sim_hz)
+{
+    log.records.clear();
+    log.tick_count = 0;
+    log.sim_hz = (uint32_t) sim_hz;
+    log.tick = 0;
+    log.next_record = 0;
+    log.keys = 0;
+}
+
+/* Appends the input of the next tick */
+void RecordInputTick(SInputLog &log, const SInputState &input)
+{
+    if (input.keys != log.keys || input.mouse_dx != 0.f || input.mouse_dy != 0.f)
+    {
+        SInputRecord record;
+        record.tick = log.tick_count;
+        record.keys = input.keys;
+        record.mouse_dx = input.mouse_dx;
+        record.mouse_dy = input.mouse_dy;
+        log.records.push_back(record);
+        log.keys = input.keys;
+    }
+    log.tick_count++;
+}
+
+bool InputLogFinished(const SInputLog &log)
+{
+    return log.tick >= log.tick_count;
+}
+
+/* Returns the input of the next recorded tick, keys stay held until the next record */
+SInputState ReplayInputTick(SInputLog &log)
+{
+    SInputState input;
+    input.mouse_dx = 0.f;
+    input.mouse_dy = 0.f;
+
+    if (log.next_record < log.records.size() && log.records[log.next_record].tick == log.tick)
+    {
+        const SInputRecord &record = log.records[log.next_record++];
+        log.keys = record.keys;
+        input.mouse_dx = record.mouse_dx;
+        input.mouse_dy = record.mouse_dy;
+    }
+
+    input.keys = log.keys;
+    log.tick++;
+    return input;
+}
+
+/* Fields are written one by one in host byte order, so the file has no padding */
+bool SaveInputLog(const SInputLog &log, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("ERROR: Could not write input log %s\n", path);
+        return false;
+    }
+
+    uint32_t version = INPUT_LOG_VERSION;
+    uint32_t record_count = (uint32_t) log.records.size();
+    fwrite(INPUT_LOG_MAGIC, 1, 4, file);
+    fwrite(&version, sizeof(version), 1, file);
+    fwrite(&log.sim_hz, sizeof(log.sim_hz), 1, file);
+    fwrite(&log.tick_count, sizeof(log.tick_count), 1, file);
+    fwrite(&record_count, sizeof(record_count), 1, file);
+
+    for (size_t i = 0; i < log.records.size(); i++)
+    {
+        const SInputRecord &record = log.records[i];
+        fwrite(&record.tick, sizeof(record.tick), 1, file);
+        fwrite(&record.keys, sizeof(record.keys), 1, file);
+        fwrite(&record.mouse_dx, sizeof(record.mouse_dx), 1, file);
+        fwrite(&record.mouse_dy, sizeof(record.mouse_dy), 1, file);
+    }
+
+    fclose(file);
+    printf("INFO: Input Log - Wrote %u ticks (%.1f s) as %u records to %s\n",
+           log.tick_count, (float) log.tick_count / (float) log.sim_hz, record_count, path);
+    return true;
+}
+
+bool LoadInputLog(SInputLog &log, const char *path, int sim_hz)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        printf("ERROR: Could not open input log %s\n", path);
+        return false;
+    }
+
+    InitInputLog(log, sim_hz);
+
+    char magic[4];
+    uint32_t version = 0, file_hz = 0, record_count = 0;
+    bool ok = fread(magic, 1, 4, file) == 4 && memcmp(magic, INPUT_LOG_MAGIC, 4) == 0 &&
+              fread(&version, sizeof(version), 1, file) == 1 && version == INPUT_LOG_VERSION &&
+              fread(&file_hz, sizeof(file_hz), 1, file) == 1 &&
+              fread(&log.tick_count, sizeof(log.tick_count), 1, file) == 1 &&
+              fread(&record_count, sizeof(record_count), 1, file) == 1;
+
+    for (uint32_t i = 0; ok && i < record_count; i++)
+    {
+        SInputRecord record;
+        ok = fread(&record.tick, sizeof(record.tick), 1, file) == 1 &&
+             fread(&record.keys, sizeof(record.keys), 1, file) == 1 &&
+             fread(&record.mouse_dx, sizeof(record.mouse_dx), 1, file) == 1 &&
+             fread(&record.mouse_dy, sizeof(record.mouse_dy), 1, file) == 1;
+        log.records.push_back(record);
+    }
+    fclose(file);
+
+    if (!ok)
+    {
+        printf("ERROR: %s is not a version %d input log\n", path, INPUT_LOG_VERSION);
+        return false;
+    }
+
+    // The tick length is part of the camera path, a different rate would replay a different run
+    if (file_hz != (uint32_t) sim_hz)
+    {
+        printf("ERROR: %s was recorded at %u Hz, the simulation runs at %d Hz\n", path, file_hz, sim_hz);
+        return false;
+    }
+
+    printf("INFO: Input Log - Replaying %u ticks (%.1f s) from %s\n", log.tick_count, (float) log.tick_count / (float) sim_hz, path);
+    return true;
+}
+
+/* Exact percentiles over every frame of a replay, the histogram buckets are too coarse to compare builds */
+void PrintReplayFrameTimes(std::vector<float> &frame_ms)
+{
+    if (frame_ms.empty())
+        return;
+
+    std::sort(frame_ms.begin(), frame_ms.end());
+    size_t n = frame_ms.size();
+
+    double total = 0.0;
+    for (size_t i = 0; i < n; i++)
+        total += frame_ms[i];
+
+    // Nearest rank percentile
+    float p50 = frame_ms[std::min(n - 1, (size_t) (0.50 * (double) n))];
+    float p95 = frame_ms[std::min(n - 1, (size_t) (0.95 * (double) n))];
+    float p99 = frame_ms[std::min(n - 1, (size_t) (0.99 * (double) n))];
+
+    printf("INFO: Replay - %zu frames, avg %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+           n, total / (double) n, p50, p95, p99, frame_ms[n - 1]);
+}
@@ -0,0 +1,376 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/* ---- Header Files ---- */
+#include "profiler.h"
+
+/* ---- Definitions ---- */
+#define JOB_MAX_WORKERS     16
+#define JOB_GRAPH_MAX_JOBS  32
+#define JOB_MAX_SUCCESSORS  8
+
+struct SJobGraph;
+
+// A unit of work. Jobs of a graph start once all of their dependencies have finished,
+// counter is decremented when the job is done so the submitter can wait on it.
+struct SJob
+{
+    void (*function)(void *data, int index);
+    void *data;
+    int index;
+
+    std::atomic<int> *counter;
+
+    // Only used by jobs that belong to a graph
+    SJobGraph *graph;
+    std::atomic<int> pending;
+    int successors[JOB_MAX_SUCCESSORS];
+    int successor_count;
+    int dependency_count;
+
+    const char *name;
+    float time_ms;
+    float total_ms;
+};
+
+// A fixed task graph, built once and run every frame
+struct SJobGraph
+{
+    SJob jobs[JOB_GRAPH_MAX_JOBS];
+    int job_count;
+
+    // remaining counts the unfinished jobs, running drops to zero once the last one has also
+    // written the graph timings, so a waiter never sees a half finished run
+    std::atomic<int> remaining;
+    std::atomic<int> running;
+    std::chrono::high_resolution_clock::time_point kick_time;
+    float wall_ms;
+    float total_wall_ms;
+    unsigned int runs;
+};
+
+// Each worker owns a deque of runnable jobs. The owner pushes and pops at the back,
+// idle workers steal the oldest job from the front of another worker's deque.
+struct SJobQueue
+{
+    std::mutex mutex;
+    std::deque<SJob *> jobs;
+};
+
+struct SJobSystem
+{
+    // Worker 0 is the thread that created the system, it runs jobs while it waits on them
+    int worker_count;
+    std::vector<std::thread> threads;
+    SJobQueue queues[JOB_MAX_WORKERS];
+
+    // Sleeping workers are woken when queued goes above zero
+    std::atomic<int> queued;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_signal;
+    std::atomic<bool> quit;
+
+    // Time each worker spent running jobs, for the utilization report
+    float busy_ms[JOB_MAX_WORKERS];
+    unsigned int jobs_run[JOB_MAX_WORKERS];
+    unsigned int jobs_stolen[JOB_MAX_WORKERS];
+    std::chrono::high_resolution_clock::time_point start_time;
+};
+
+// Index of the worker the current thread belongs to, and how many jobs it is nested in
+// (a job that waits on a ParallelFor runs other jobs inside itself)
+thread_local int job_worker_index = 0;
+thread_local int job_depth = 0;
+
+void PushJob(SJobSystem &jobs, SJob *job)
+{
+    SJobQueue &queue = jobs.queues[job_worker_index];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(job);
+    }
+
+    jobs.queued.fetch_add(1);
+    {
+        // Taking the lock orders the push before a worker's check of queued, so no wake up is lost
+        std::lock_guard<std::mutex> lock(jobs.sleep_mutex);
+    }
+    jobs.sleep_signal.notify_one();
+}
+
+/* Pops from the own deque first, then tries to steal from the others */
+SJob *TakeJob(SJobSystem &jobs)
+{
+    int self = job_worker_index;
+    {
+        SJobQueue &queue = jobs.queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty())
+        {
+            SJob *job = queue.jobs.back();
+            queue.jobs.pop_back();
+            jobs.queued.fetch_sub(1);
+            return job;
+        }
+    }
+
+    for (int i = 1; i < jobs.worker_count; i++)
+    {
+        SJobQueue &queue = jobs.queues[(self + i) % jobs.worker_count];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.jobs.empty())
+        {
+            SJob *job = queue.jobs.front();
+            queue.jobs.pop_front();
+            jobs.queued.fetch_sub(1);
+            jobs.jobs_stolen[self]++;
+            return job;
+        }
+    }
+
+    return NULL;
+}
+
+void ExecuteJob(SJobSystem &jobs, SJob *job)
+{
+    typedef std::chrono::high_resolution_clock clock;
+
+    clock::time_point start = clock::now();
+    job_depth++;
+    {
+        PROFILE_SCOPE(job->name != NULL ? job->name : "job");
+        job->function(job->data, job->index);
+    }
+    job_depth--;
+    float ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+    // Nested jobs are already part of the time of the job that ran them
+    int self = job_worker_index;
+    if (job_depth == 0)
+        jobs.busy_ms[self] += ms;
+    jobs.jobs_run[self]++;
+
+    SJobGraph *graph = job->graph;
+    if (graph != NULL)
+    {
+        job->time_ms = ms;
+        job->total_ms += ms;
+
+        // Release the successors whose last dependency this was
+        for (int i = 0; i < job->successor_count; i++)
+        {
+            SJob *next = &graph->jobs[job->successors[i]];
+            if (next->pending.fetch_sub(1) == 1)
+                PushJob(jobs, next);
+        }
+
+        if (graph->remaining.fetch_sub(1) == 1)
+        {
+            graph->wall_ms = std::chrono::duration<float, std::milli>(clock::now() - graph->kick_time).count();
+            graph->total_wall_ms += graph->wall_ms;
+            graph->runs++;
+            graph->running = 0;
+        }
+    }
+
+    if (job->counter != NULL)
+        job->counter->fetch_sub(1);
+}
+
+void JobWorker(SJobSystem *jobs, int index)
+{
+    job_worker_index = index;
+
+    while (true)
+    {
+        SJob *job = TakeJob(*jobs);
+        if (job != NULL)
+        {
+            ExecuteJob(*jobs, job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(jobs->sleep_mutex);
+        jobs->sleep_signal.wait(lock, [&] { return jobs->quit.load() || jobs->queued.load() > 0; });
+        if (jobs->quit.load())
+            return;
+    }
+}
+
+/* Starts worker_count - 1 threads, the calling thread is worker 0 */
+void InitJobSystem(SJobSystem &jobs, int worker_count)
+{
+    if (worker_count < 1)
+        worker_count = 1;
+    if (worker_count > JOB_MAX_WORKERS)
+        worker_count = JOB_MAX_WORKERS;
+
+    jobs.worker_count = worker_count;
+    jobs.queued = 0;
+    jobs.quit = false;
+
+    memset(jobs.busy_ms, 0, sizeof(jobs.busy_ms));
+    memset(jobs.jobs_run, 0, sizeof(jobs.jobs_run));
+    memset(jobs.jobs_stolen, 0, sizeof(jobs.jobs_stolen));
+    jobs.start_time = std::chrono::high_resolution_clock::now();
+
+    job_worker_index = 0;
+    for (int i = 1; i < worker_count; i++)
+        jobs.threads.push_back(std::thread(JobWorker, &jobs, i));
+}
+
+void ShutdownJobSystem(SJobSystem &jobs)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs.sleep_mutex);
+        jobs.quit = true;
+    }
+    jobs.sleep_signal.notify_all();
+
+    for (size_t i = 0; i < jobs.threads.size(); i++)
+        jobs.threads[i].join();
+    jobs.threads.clear();
+}
+
+/* Runs queued jobs on the calling thread until counter reaches zero */
+void WaitForCounter(SJobSystem &jobs, std::atomic<int> &counter)
+{
+    while (counter.load() > 0)
+    {
+        SJob *job = TakeJob(jobs);
+        if (job != NULL)
+            ExecuteJob(jobs, job);
+        else
+            std::this_thread::yield();
+    }
+}
+
+/* Calls function(data, i) for every i in [0, count) spread over the workers, returns once all are done */
+void ParallelFor(SJobSystem &jobs, int count, void (*function)(void *data, int index), void *data)
+{
+    if (count <= 0)
+        return;
+
+    std::atomic<int> counter(count);
+    std::vector<SJob> tasks(count);
+    for (int i = 0; i < count; i++)
+    {
+        SJob &task = tasks[i];
+        task.function = function;
+        task.data = data;
+        task.index = i;
+        task.counter = &counter;
+        task.graph = NULL;
+        task.successor_count = 0;
+        task.name = "parallel for";
+    }
+
+    // The last task runs right here, the others are up for stealing
+    for (int i = 0; i < count - 1; i++)
+        PushJob(jobs, &tasks[i]);
+    ExecuteJob(jobs, &tasks[count - 1]);
+
+    WaitForCounter(jobs, counter);
+}
+
+void InitJobGraph(SJobGraph &graph)
+{
+    graph.job_count = 0;
+    graph.remaining = 0;
+    graph.running = 0;
+    graph.wall_ms = 0.f;
+    graph.total_wall_ms = 0.f;
+    graph.runs = 0;
+}
+
+/* Adds a job to the graph and returns its id */
+int AddGraphJob(SJobGraph &graph, const char *name, void (*function)(void *data, int index), void *data)
+{
+    if (graph.job_count >= JOB_GRAPH_MAX_JOBS)
+    {
+        printf("ERROR: Job Graph is full, %s was not added.\n", name);
+        return -1;
+    }
+
+    SJob &job = graph.jobs[graph.job_count];
+    job.function = function;
+    job.data = data;
+    job.index = graph.job_count;
+    job.counter = NULL;
+    job.graph = &graph;
+    job.pending = 0;
+    job.successor_count = 0;
+    job.dependency_count = 0;
+    job.name = name;
+    job.time_ms = 0.f;
+    job.total_ms = 0.f;
+
+    return graph.job_count++;
+}
+
+/* after only starts once before has finished */
+void AddGraphDependency(SJobGraph &graph, int before, int after)
+{
+    SJob &job = graph.jobs[before];
+    if (job.successor_count >= JOB_MAX_SUCCESSORS)
+    {
+        printf("ERROR: Job %s has too many successors.\n", job.name);
+        return;
+    }
+
+    job.successors[job.successor_count++] = after;
+    graph.jobs[after].dependency_count++;
+}
+
+/* Starts every job without dependencies and returns straight away */
+void KickJobGraph(SJobSystem &jobs, SJobGraph &graph)
+{
+    graph.kick_time = std::chrono::high_resolution_clock::now();
+    graph.remaining = graph.job_count;
+    graph.running = 1;
+
+    for (int i = 0; i < graph.job_count; i++)
+        graph.jobs[i].pending = graph.jobs[i].dependency_count;
+
+    for (int i = 0; i < graph.job_count; i++)
+        if (graph.jobs[i].dependency_count == 0)
+            PushJob(jobs, &graph.jobs[i]);
+}
+
+void WaitJobGraph(SJobSystem &jobs, SJobGraph &graph)
+{
+    WaitForCounter(jobs, graph.running);
+}
+
+void PrintJobStats(const SJobSystem &jobs, const SJobGraph &graph)
+{
+    if (graph.runs == 0)
+        return;
+
+    float runs = (float) graph.runs;
+    float wall_ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - jobs.start_time).count();
+
+    printf("INFO: Job System - %d workers, %u graph runs, per frame averages:\n", jobs.worker_count, graph.runs);
+    printf("INFO:   graph wall time: %.4f ms\n", graph.total_wall_ms / runs);
+    for (int i = 0; i < graph.job_count; i++)
+        printf("INFO:   %-16s %.4f ms\n", graph.jobs[i].name, graph.jobs[i].total_ms / runs);
+
+    float busy = 0.f;
+    for (int i = 0; i < jobs.worker_count; i++)
+    {
+        printf("INFO:   worker %d: %5.1f%% busy, %u jobs, %u stolen\n",
+               i, 100.f * jobs.busy_ms[i] / wall_ms, jobs.jobs_run[i], jobs.jobs_stolen[i]);
+        busy += jobs.busy_ms[i];
+    }
+    printf("INFO:   core utilization: %.1f%% of %d workers\n", 100.f * busy / (wall_ms * (float) jobs.worker_count), jobs.worker_count);
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/* ---- Definitions ---- */
+enum EMemoryDomain
+{
+    MEMORY_HOST,
+    MEMORY_GPU,
+    MEMORY_DOMAIN_COUNT
+};
+
+enum EMemoryCategory
+{
+    MEMORY_MESH_SOURCE,     // parsed OBJ arrays, released once registered
+    MEMORY_MESH_STAGING,    // welded vertices and indices waiting for the upload
+    MEMORY_MESH_BUFFERS,
+    MEMORY_TEXTURES,
+    MEMORY_PICKING,
+    MEMORY_COLLISION,
+    MEMORY_OCCLUSION,
+    MEMORY_RENDER_TARGETS,
+    MEMORY_STREAMING,
+    MEMORY_IMPOSTORS,
+    MEMORY_CATEGORY_COUNT
+};
+
+const char *memory_domain_names[MEMORY_DOMAIN_COUNT] = { "host", "GPU" };
+const char *memory_category_names[MEMORY_CATEGORY_COUNT] = {
+    "mesh source", "mesh staging", "mesh buffers", "textures", "picking", "collision", "occlusion",
+    "render targets", "streaming", "impostors"
+};
+
+// One allocation. The owner is the address of whatever frees it, which together with the category
+// identifies the allocation when it is released. GPU sizes are estimates from the formats requested.
+struct SMemoryRecord
+{
+    const char *asset;
+    EMemoryCategory category;
+    EMemoryDomain domain;
+    const void *owner;
+    size_t bytes;
+    bool live;
+};
+
+// Only the thread that loads and shuts down the scene tracks memory, so nothing here is locked
+struct SMemoryTracker
+{
+    std::vector<SMemoryRecord> records;
+
+    size_t live[MEMORY_DOMAIN_COUNT][MEMORY_CATEGORY_COUNT];
+    size_t peak[MEMORY_DOMAIN_COUNT][MEMORY_CATEGORY_COUNT];
+    size_t current[MEMORY_DOMAIN_COUNT];
+    size_t current_peak[MEMORY_DOMAIN_COUNT];
+    size_t released[MEMORY_DOMAIN_COUNT];
+};
+
+// Ownership is a property of the whole program, so every module reports into one tracker
+SMemoryTracker memory_tracker;
+
+/* Records an allocation of bytes made on behalf of owner */
+void TrackMemory(SMemoryTracker &tracker, const char *asset, EMemoryCategory category, EMemoryDomain domain,
+                 const void *owner, size_t bytes)
+{
+    SMemoryRecord record = { asset, category, domain, owner, bytes, true };
+    tracker.records.push_back(record);
+
+    tracker.live[domain][category] += bytes;
+    if (tracker.live[domain][category] > tracker.peak[domain][category])
+        tracker.peak[domain][category] = tracker.live[domain][category];
+
+    tracker.current[domain] += bytes;
+    if (tracker.current[domain] > tracker.current_peak[domain])
+        tracker.current_peak[domain] = tracker.current[domain];
+}
+
+/* Marks every live allocation of owner in category as freed, returns the bytes released */
+size_t ReleaseMemory(SMemoryTracker &tracker, const void *owner, EMemoryCategory category)
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < tracker.records.size(); i++)
+    {
+        SMemoryRecord &record = tracker.records[i];
+        if (!record.live || record.owner != owner || record.category != category)
+            continue;
+
+        record.live = false;
+        tracker.live[record.domain][category] -= record.bytes;
+        tracker.current[record.domain] -= record.bytes;
+        tracker.released[record.domain] += record.bytes;
+        bytes += record.bytes;
+    }
+    return bytes;
+}
+
+/* Hands the live allocations of owner in category over to another category, which then has to free them */
+void TransferMemory(SMemoryTracker &tracker, const void *owner, EMemoryCategory from, EMemoryCategory to)
+{
+    for (size_t i = 0; i < tracker.records.size(); i++)
+    {
+        SMemoryRecord &record = tracker.records[i];
+        if (!record.live || record.owner != owner || record.category != from)
+            continue;
+
+        tracker.live[record.domain][from] -= record.bytes;
+        tracker.live[record.domain][to] += record.bytes;
+        if (tracker.live[record.domain][to] > tracker.peak[record.domain][to])
+            tracker.peak[record.domain][to] = tracker.live[record.domain][to];
+        record.category = to;
+    }
+}
+
+/* Live bytes per category and per asset, with the peaks reached while loading */
+void PrintMemoryReport(const SMemoryTracker &tracker, const char *when)
+{
+    const double mb = 1024.0 * 1024.0;
+
+    printf("INFO: Memory - %s: host %.2f MB (peak %.2f MB, %.2f MB released), GPU %.2f MB (peak %.2f MB)\n", when,
+           (double) tracker.current[MEMORY_HOST] / mb, (double) tracker.current_peak[MEMORY_HOST] / mb,
+           (double) tracker.released[MEMORY_HOST] / mb,
+           (double) tracker.current[MEMORY_GPU] / mb, (double) tracker.current_peak[MEMORY_GPU] / mb);
+
+    for (int c = 0; c < MEMORY_CATEGORY_COUNT; c++)
+    {
+        if (tracker.peak[MEMORY_HOST][c] == 0 && tracker.peak[MEMORY_GPU][c] == 0)
+            continue;
+        printf("INFO:   %-15s host %8.2f MB (peak %8.2f MB), GPU %8.2f MB (peak %8.2f MB)\n", memory_category_names[c],
+               (double) tracker.live[MEMORY_HOST][c] / mb, (double) tracker.peak[MEMORY_HOST][c] / mb,
+               (double) tracker.live[MEMORY_GPU][c] / mb, (double) tracker.peak[MEMORY_GPU][c] / mb);
+    }
+
+    // Assets are listed in the order they were first allocated, records of the same asset are summed
+    std::vector<const char *> assets;
+    for (size_t i = 0; i < tracker.records.size(); i++)
+    {
+        const SMemoryRecord &record = tracker.records[i];
+        if (!record.live)
+            continue;
+
+        bool listed = false;
+        for (size_t a = 0; a < assets.size() && !listed; a++)
+            listed = strcmp(assets[a], record.asset) == 0;
+        if (!listed)
+            assets.push_back(record.asset);
+    }
+
+    for (size_t a = 0; a < assets.size(); a++)
+    {
+        size_t bytes[MEMORY_DOMAIN_COUNT] = { 0, 0 };
+        for (size_t i = 0; i < tracker.records.size(); i++)
+        {
+            const SMemoryRecord &record = tracker.records[i];
+            if (record.live && strcmp(record.asset, assets[a]) == 0)
+                bytes[record.domain] += record.bytes;
+        }
+        printf("INFO:     %-28s host %8.1f KB, GPU %8.1f KB\n", assets[a], (double) bytes[MEMORY_HOST] / 1024.0,
+               (double) bytes[MEMORY_GPU] / 1024.0);
+    }
+}
+
+/* Reports every allocation that is still live, call once everything has been shut down */
+bool CheckMemoryLeaks(const SMemoryTracker &tracker)
+{
+    unsigned int leaks = 0;
+    for (size_t i = 0; i < tracker.records.size(); i++)
+    {
+        const SMemoryRecord &record = tracker.records[i];
+        if (!record.live)
+            continue;
+
+        printf("ERROR: Memory - %s (%s, %s) was never released, %.1f KB\n", record.asset,
+               memory_category_names[record.category], memory_domain_names[record.domain], (double) record.bytes / 1024.0);
+        leaks++;
+    }
+
+    if (leaks == 0)
+        printf("INFO: Memory - all %zu tracked allocations were released\n", tracker.records.size());
+    return leaks == 0;
+}
@@ -0,0 +1,566 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <climits>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+/* ---- OpenGL Headers ---- */
+#include <glad/glad.h>
+
+/* ---- Header Files ---- */
+#include "parser.h"
+#include "gl_state.h"
+#include "memory.h"
+#include "vertex_layout.h"
+
+/* ---- Definitions ---- */
+// The CPU staging keeps the parser's layout, see vertex_layout.h
+#define MESH_VERTEX_FLOATS VERTEX_SOURCE_FLOATS
+
+// Vertices and indices a streamed mesh pool starts with, it at least doubles whenever a mesh does not fit
+#define MESH_STREAM_POOL_VERTICES 65536
+#define MESH_STREAM_POOL_INDICES (3 * MESH_STREAM_POOL_VERTICES)
+
+// A mesh is a range of the shared index buffer, its indices are relative to base_vertex.
+// base_vertex indexes the CPU staging until the upload and the vertex buffer of its format after it.
+struct SMesh
+{
+    int base_vertex;
+    int first_index;
+    int index_count;
+    int vertex_count;
+
+    // Layout of the mesh on the GPU and the VAO that draws it, 0 until the upload
+    EVertexFormat format;
+    unsigned int vao;
+
+    // Object space bounds from the parser, used for culling
+    SBounds bounds;
+
+    // Occluder proxy of the mesh in the occlusion system, -1 when it does not occlude
+    int occluder;
+};
+
+// Meshes of the same vertex format share a vertex buffer and the VAO that describes it
+struct SMeshPool
+{
+    unsigned int vao;
+    unsigned int vbo;
+    unsigned int vertex_count;
+};
+
+// A run of vertices or indices in a streamed mesh pool
+struct SMeshRange
+{
+    unsigned int first;
+    unsigned int count;
+};
+
+// Streamed meshes of the same vertex format are suballocated from growable buffers that are kept apart
+// from the resident ones, which are sized once at the upload. They share the pool's VAO, so consecutive
+// streamed draws merge into multi-draw calls like the resident ones.
+struct SMeshStreamPool
+{
+    unsigned int vao;
+    unsigned int vbo;
+    unsigned int ebo;
+    unsigned int vertex_capacity;
+    unsigned int index_capacity;
+
+    // Free runs sorted by first, neighbouring runs are merged
+    std::vector<SMeshRange> free_vertices;
+    std::vector<SMeshRange> free_indices;
+
+    unsigned int meshes;
+    unsigned int vertex_count;
+    unsigned int index_count;
+    unsigned int grows;
+};
+
+// Where a streamed mesh lives in the pool of its format, an empty index range when nothing is allocated
+struct SMeshAllocation
+{
+    EVertexFormat format;
+    SMeshRange vertices;
+    SMeshRange indices;
+};
+
+// All meshes are suballocated into one vertex buffer per format and a single index buffer,
+// streamed meshes into the stream pool of their format
+struct SMeshRegistry
+{
+    SMeshPool pools[VERTEX_FORMAT_COUNT];
+    unsigned int ebo;
+
+    SMeshStreamPool stream_pools[VERTEX_FORMAT_COUNT];
+
+    std::vector<SMesh> meshes;
+
+    // CPU staging, released once the registry has been uploaded
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+
+    bool uploaded;
+};
+
+// Used to weld the identical vertices that the parser emits for every triangle corner
+struct SVertexKey
+{
+    float v[MESH_VERTEX_FLOATS];
+
+    bool operator==(const SVertexKey &other) const
+    {
+        return memcmp(v, other.v, sizeof(v)) == 0;
+    }
+};
+
+struct SVertexKeyHash
+{
+    size_t operator()(const SVertexKey &key) const
+    {
+        // FNV-1a over the raw bytes of the vertex
+        const unsigned char *bytes = (const unsigned char *) key.v;
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(key.v); i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return (size_t) hash;
+    }
+};
+
+void InitMeshRegistry(SMeshRegistry &registry)
+{
+    for (int f = 0; f < VERTEX_FORMAT_COUNT; f++)
+    {
+        registry.pools[f].vao = 0;
+        registry.pools[f].vbo = 0;
+        registry.pools[f].vertex_count = 0;
+
+        SMeshStreamPool &stream_pool = registry.stream_pools[f];
+        stream_pool.vao = stream_pool.vbo = stream_pool.ebo = 0;
+        stream_pool.vertex_capacity = stream_pool.index_capacity = 0;
+        stream_pool.free_vertices.clear();
+        stream_pool.free_indices.clear();
+        stream_pool.meshes = stream_pool.vertex_count = stream_pool.index_count = 0;
+        stream_pool.grows = 0;
+    }
+    registry.ebo = 0;
+    registry.uploaded = false;
+}
+
+/* Welds an array of interleaved vertices (three per triangle) into the registry's staging and returns the
+ * mesh id. Nothing is tracked or printed, so a registry local to a loader thread can use it too. */
+int WeldMesh(SMeshRegistry &registry, const float *vertices, unsigned int vertex_count, const SBounds &bounds,
+             EVertexFormat format)
+{
+    SMesh mesh;
+    mesh.base_vertex = (int) (registry.vertices.size() / MESH_VERTEX_FLOATS);
+    mesh.first_index = (int) registry.indices.size();
+    mesh.index_count = (int) vertex_count;
+    mesh.bounds = bounds;
+    mesh.occluder = -1;
+    mesh.format = format;
+    mesh.vao = 0;
+
+    // Build a local index buffer, each unique vertex is stored once
+    std::unordered_map<SVertexKey, unsigned int, SVertexKeyHash> unique;
+    unique.reserve(vertex_count);
+
+    unsigned int local_count = 0;
+    for (unsigned int i = 0; i < vertex_count; i++)
+    {
+        SVertexKey key;
+        memcpy(key.v, vertices + i * MESH_VERTEX_FLOATS, sizeof(key.v));
+
+        std::pair<std::unordered_map<SVertexKey, unsigned int, SVertexKeyHash>::iterator, bool> found =
+                unique.insert(std::make_pair(key, local_count));
+
+        if (found.second)
+        {
+            registry.vertices.insert(registry.vertices.end(), key.v, key.v + MESH_VERTEX_FLOATS);
+            local_count++;
+        }
+
+        registry.indices.push_back(found.first->second);
+    }
+
+    mesh.vertex_count = (int) local_count;
+    registry.meshes.push_back(mesh);
+    return (int) registry.meshes.size() - 1;
+}
+
+/* Appends a mesh from an array of interleaved vertices (three per triangle) and returns its id,
+ * the vertices are packed into the given format when the registry is uploaded */
+int RegisterMesh(SMeshRegistry &registry, const float *vertices, unsigned int vertex_count, const SBounds &bounds,
+                 EVertexFormat format)
+{
+    if (registry.uploaded)
+    {
+        printf("ERROR: Mesh Registry has already been uploaded.\n");
+        return -1;
+    }
+
+    int id = WeldMesh(registry, vertices, vertex_count, bounds, format);
+    unsigned int local_count = (unsigned int) registry.meshes[id].vertex_count;
+
+    TrackMemory(memory_tracker, "mesh registry", MEMORY_MESH_STAGING, MEMORY_HOST, &registry,
+                sizeof(float) * local_count * MESH_VERTEX_FLOATS + sizeof(unsigned int) * vertex_count);
+
+    printf("INFO: Registered Mesh %d - %u vertices welded to %u, %s format\n",
+           id, vertex_count, local_count, vertex_formats[format].name);
+
+    return id;
+}
+
+/* Appends an empty slot for a mesh that is streamed in later, it draws nothing until UploadStreamedMesh */
+int ReserveMesh(SMeshRegistry &registry)
+{
+    if (registry.uploaded)
+    {
+        printf("ERROR: Mesh Registry has already been uploaded.\n");
+        return -1;
+    }
+
+    SMesh mesh;
+    mesh.base_vertex = 0;
+    mesh.first_index = 0;
+    mesh.index_count = 0;
+    mesh.vertex_count = 0;
+    mesh.format = VERTEX_FORMAT_FULL;
+    mesh.vao = 0;
+    mesh.bounds.min = mesh.bounds.max = mesh.bounds.center = glm::vec3(0.f);
+    mesh.bounds.radius = 0.f;
+    mesh.occluder = -1;
+    registry.meshes.push_back(mesh);
+    return (int) registry.meshes.size() - 1;
+}
+
+/* Registers an n x n grid of quads, two triangles each, as a bumpy 100 x 100 terrain for the benchmarks */
+int RegisterBenchmarkTerrain(SMeshRegistry &registry, int n)
+{
+    SMesh mesh;
+    mesh.base_vertex = (int) (registry.vertices.size() / MESH_VERTEX_FLOATS);
+    mesh.first_index = (int) registry.indices.size();
+    mesh.vertex_count = (n + 1) * (n + 1);
+    mesh.index_count = n * n * 6;
+    mesh.occluder = -1;
+    mesh.format = VERTEX_FORMAT_FULL;
+    mesh.vao = 0;
+
+    registry.vertices.resize(registry.vertices.size() + (size_t) mesh.vertex_count * MESH_VERTEX_FLOATS, 0.f);
+    for (int z = 0; z <= n; z++)
+    {
+        for (int x = 0; x <= n; x++)
+        {
+            float *v = registry.vertices.data() + ((size_t) mesh.base_vertex + (size_t) z * (n + 1) + x) * MESH_VERTEX_FLOATS;
+            float fx = (float) x / (float) n, fz = (float) z / (float) n;
+            v[0] = fx * 100.f - 50.f;
+            v[1] = 4.f * sinf(fx * 17.f) * cosf(fz * 13.f) + (float) (rand() % 100) * 0.002f;
+            v[2] = fz * 100.f - 50.f;
+        }
+    }
+    registry.indices.reserve(registry.indices.size() + mesh.index_count);
+    for (int z = 0; z < n; z++)
+    {
+        for (int x = 0; x < n; x++)
+        {
+            unsigned int a = z * (n + 1) + x, b = a + 1, c = a + n + 1, d = c + 1;
+            unsigned int quad[6] = { a, c, b, b, c, d };
+            registry.indices.insert(registry.indices.end(), quad, quad + 6);
+        }
+    }
+
+    registry.meshes.push_back(mesh);
+    return (int) registry.meshes.size() - 1;
+}
+
+/* Packs every mesh into the vertex buffer of its format, creates a VAO per format used and the
+ * shared index buffer, then frees the CPU staging */
+void UploadMeshRegistry(SMeshRegistry &registry)
+{
+    // Place each mesh in its pool, base_vertex switches from the staging to the pool
+    std::vector<unsigned char> packed[VERTEX_FORMAT_COUNT];
+    for (size_t m = 0; m < registry.meshes.size(); m++)
+    {
+        SMesh &mesh = registry.meshes[m];
+        SMeshPool &pool = registry.pools[mesh.format];
+        const SVertexFormatInfo &info = vertex_formats[mesh.format];
+
+        size_t offset = (size_t) pool.vertex_count * info.stride;
+        packed[mesh.format].resize(offset + (size_t) mesh.vertex_count * info.stride);
+        info.pack(registry.vertices.data() + (size_t) mesh.base_vertex * MESH_VERTEX_FLOATS, (size_t) mesh.vertex_count,
+                  packed[mesh.format].data() + offset);
+
+        mesh.base_vertex = (int) pool.vertex_count;
+        pool.vertex_count += (unsigned int) mesh.vertex_count;
+    }
+
+    glGenBuffers(1, &registry.ebo);
+
+    size_t vertex_bytes = 0;
+    for (int f = 0; f < VERTEX_FORMAT_COUNT; f++)
+    {
+        SMeshPool &pool = registry.pools[f];
+        if (pool.vertex_count == 0)
+            continue;
+
+        glGenVertexArrays(1, &pool.vao);
+        glGenBuffers(1, &pool.vbo);
+
+        BindVertexArray(gl_state, pool.vao);
+        BindBuffer(gl_state, GL_ARRAY_BUFFER, pool.vbo);
+        glBufferData(GL_ARRAY_BUFFER, (long) packed[f].size(), packed[f].data(), GL_STATIC_DRAW);
+
+        // The element buffer binding is part of the VAO state, every pool draws from the same one
+        BindBuffer(gl_state, GL_ELEMENT_ARRAY_BUFFER, registry.ebo);
+        if (vertex_bytes == 0)
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (long) (sizeof(unsigned int) * registry.indices.size()), registry.indices.data(), GL_STATIC_DRAW);
+
+        vertex_formats[f].setup(0);
+        vertex_bytes += packed[f].size();
+
+        printf("INFO: Uploaded Mesh Pool - %s format, %u vertices of %u bytes\n",
+               vertex_formats[f].name, pool.vertex_count, vertex_formats[f].stride);
+    }
+
+    // Reserved slots keep no VAO until they are streamed in
+    for (size_t m = 0; m < registry.meshes.size(); m++)
+        if (registry.meshes[m].index_count > 0)
+            registry.meshes[m].vao = registry.pools[registry.meshes[m].format].vao;
+
+    BindVertexArray(gl_state, 0);
+    BindBuffer(gl_state, GL_ARRAY_BUFFER, 0);
+
+    TrackMemory(memory_tracker, "mesh registry", MEMORY_MESH_BUFFERS, MEMORY_GPU, &registry,
+                vertex_bytes + sizeof(unsigned int) * registry.indices.size());
+
+    printf("INFO: Uploaded Mesh Registry - %d meshes, %.2f MB vertices (%.2f MB as floats), %.2f MB indices\n",
+           (int) registry.meshes.size(), (double) vertex_bytes / (1024.0 * 1024.0),
+           (double) (sizeof(float) * registry.vertices.size()) / (1024.0 * 1024.0),
+           (double) (sizeof(unsigned int) * registry.indices.size()) / (1024.0 * 1024.0));
+
+    std::vector<float>().swap(registry.vertices);
+    std::vector<unsigned int>().swap(registry.indices);
+    ReleaseMemory(memory_tracker, &registry, MEMORY_MESH_STAGING);
+    registry.uploaded = true;
+}
+
+/* Frees the GL objects when the registry was uploaded, otherwise the CPU staging that would have been */
+void DeleteMeshRegistry(SMeshRegistry &registry)
+{
+    if (registry.uploaded)
+    {
+        for (int f = 0; f < VERTEX_FORMAT_COUNT; f++)
+        {
+            SMeshPool &pool = registry.pools[f];
+            if (pool.vertex_count == 0)
+                continue;
+            glDeleteVertexArrays(1, &pool.vao);
+            glDeleteBuffers(1, &pool.vbo);
+            pool.vertex_count = 0;
+        }
+        glDeleteBuffers(1, &registry.ebo);
+
+        for (int f = 0; f < VERTEX_FORMAT_COUNT; f++)
+        {
+            SMeshStreamPool &pool = registry.stream_pools[f];
+            if (pool.vao == 0)
+                continue;
+            glDeleteVertexArrays(1, &pool.vao);
+            glDeleteBuffers(1, &pool.vbo);
+            glDeleteBuffers(1, &pool.ebo);
+            ReleaseMemory(memory_tracker, &pool, MEMORY_STREAMING);
+            pool.vao = pool.vbo = pool.ebo = 0;
+            pool.vertex_capacity = pool.index_capacity = 0;
+        }
+        ResetGLState(gl_state);
+        ReleaseMemory(memory_tracker, &registry, MEMORY_MESH_BUFFERS);
+    }
+
+    std::vector<float>().swap(registry.vertices);
+    std::vector<unsigned int>().swap(registry.indices);
+    ReleaseMemory(memory_tracker, &registry, MEMORY_MESH_STAGING);
+
+    registry.meshes.clear();
+    registry.uploaded = false;
+}
+
+/* First fit from a sorted free list, UINT_MAX when no run is large enough */
+unsigned int AllocateMeshRange(std::vector<SMeshRange> &free_ranges, unsigned int count)
+{
+    for (size_t i = 0; i < free_ranges.size(); i++)
+    {
+        SMeshRange &range = free_ranges[i];
+        if (range.count < count)
+            continue;
+
+        unsigned int first = range.first;
+        range.first += count;
+        range.count -= count;
+        if (range.count == 0)
+            free_ranges.erase(free_ranges.begin() + (long) i);
+        return first;
+    }
+    return UINT_MAX;
+}
+
+/* Returns a run to a sorted free list, merging it with the runs it touches */
+void FreeMeshRange(std::vector<SMeshRange> &free_ranges, SMeshRange range)
+{
+    size_t i = 0;
+    while (i < free_ranges.size() && free_ranges[i].first < range.first)
+        i++;
+    free_ranges.insert(free_ranges.begin() + (long) i, range);
+
+    if (i + 1 < free_ranges.size() && free_ranges[i].first + free_ranges[i].count == free_ranges[i + 1].first)
+    {
+        free_ranges[i].count += free_ranges[i + 1].count;
+        free_ranges.erase(free_ranges.begin() + (long) (i + 1));
+    }
+    if (i > 0 && free_ranges[i - 1].first + free_ranges[i - 1].count == free_ranges[i].first)
+    {
+        free_ranges[i - 1].count += free_ranges[i].count;
+        free_ranges.erase(free_ranges.begin() + (long) i);
+    }
+}
+
+/* Moves the contents of a pool buffer into a larger one and returns it. The old buffer is deleted,
+ * GL keeps it alive for the draws already issued that read it. */
+unsigned int GrowMeshPoolBuffer(unsigned int buffer, size_t old_bytes, size_t bytes)
+{
+    unsigned int grown;
+    glGenBuffers(1, &grown);
+    BindBuffer(gl_state, GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, (long) bytes, NULL, GL_STATIC_DRAW);
+    if (buffer != 0)
+    {
+        BindBuffer(gl_state, GL_COPY_READ_BUFFER, buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (long) old_bytes);
+        glDeleteBuffers(1, &buffer);
+    }
+    return grown;
+}
+
+/* Grows the buffers of a stream pool so that vertex_count vertices and index_count indices fit past the
+ * current end, and points the pool's VAO at the new buffers */
+void GrowMeshStreamPool(SMeshStreamPool &pool, EVertexFormat format, unsigned int vertex_count, unsigned int index_count)
+{
+    const SVertexFormatInfo &info = vertex_formats[format];
+    if (pool.vao == 0)
+        glGenVertexArrays(1, &pool.vao);
+
+    if (vertex_count > 0)
+    {
+        unsigned int capacity = std::max(std::max((unsigned int) MESH_STREAM_POOL_VERTICES, 2 * pool.vertex_capacity),
+                                         pool.vertex_capacity + vertex_count);
+        pool.vbo = GrowMeshPoolBuffer(pool.vbo, (size_t) pool.vertex_capacity * info.stride, (size_t) capacity * info.stride);
+        SMeshRange added = { pool.vertex_capacity, capacity - pool.vertex_capacity };
+        FreeMeshRange(pool.free_vertices, added);
+        pool.vertex_capacity = capacity;
+    }
+    if (index_count > 0)
+    {
+        unsigned int capacity = std::max(std::max((unsigned int) MESH_STREAM_POOL_INDICES, 2 * pool.index_capacity),
+                                         pool.index_capacity + index_count);
+        pool.ebo = GrowMeshPoolBuffer(pool.ebo, sizeof(unsigned int) * pool.index_capacity, sizeof(unsigned int) * capacity);
+        SMeshRange added = { pool.index_capacity, capacity - pool.index_capacity };
+        FreeMeshRange(pool.free_indices, added);
+        pool.index_capacity = capacity;
+    }
+    pool.grows++;
+
+    // The deleted buffers may have been bound anywhere
+    ResetGLState(gl_state);
+    BindVertexArray(gl_state, pool.vao);
+    BindBuffer(gl_state, GL_ARRAY_BUFFER, pool.vbo);
+    BindBuffer(gl_state, GL_ELEMENT_ARRAY_BUFFER, pool.ebo);
+    info.setup(0);
+    BindVertexArray(gl_state, 0);
+    BindBuffer(gl_state, GL_ARRAY_BUFFER, 0);
+
+    ReleaseMemory(memory_tracker, &pool, MEMORY_STREAMING);
+    TrackMemory(memory_tracker, "streamed mesh pool", MEMORY_STREAMING, MEMORY_GPU, &pool,
+                (size_t) pool.vertex_capacity * info.stride + sizeof(unsigned int) * pool.index_capacity);
+
+    printf("INFO: Mesh Stream Pool - %s format grown to %u vertices and %u indices\n", info.name,
+           pool.vertex_capacity, pool.index_capacity);
+}
+
+/* Copies vertices already packed in format into the stream pool of the format and points a reserved slot
+ * at them. Returns the allocation for FreeStreamedMesh. */
+SMeshAllocation UploadStreamedMesh(SMeshRegistry &registry, int mesh, const unsigned char *packed, unsigned int vertex_count,
+                                   const unsigned int *indices, unsigned int index_count, const SBounds &bounds, EVertexFormat format)
+{
+    SMeshStreamPool &pool = registry.stream_pools[format];
+    const SVertexFormatInfo &info = vertex_formats[format];
+
+    SMeshAllocation allocation;
+    allocation.format = format;
+    allocation.vertices.count = vertex_count;
+    allocation.indices.count = index_count;
+
+    allocation.vertices.first = AllocateMeshRange(pool.free_vertices, vertex_count);
+    allocation.indices.first = AllocateMeshRange(pool.free_indices, index_count);
+    if (allocation.vertices.first == UINT_MAX || allocation.indices.first == UINT_MAX)
+    {
+        GrowMeshStreamPool(pool, format, allocation.vertices.first == UINT_MAX ? vertex_count : 0,
+                           allocation.indices.first == UINT_MAX ? index_count : 0);
+        if (allocation.vertices.first == UINT_MAX)
+            allocation.vertices.first = AllocateMeshRange(pool.free_vertices, vertex_count);
+        if (allocation.indices.first == UINT_MAX)
+            allocation.indices.first = AllocateMeshRange(pool.free_indices, index_count);
+    }
+
+    // The element buffer is only bound through the VAO, which is left unbound for whoever draws next
+    BindBuffer(gl_state, GL_ARRAY_BUFFER, pool.vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, (long) allocation.vertices.first * info.stride, (long) vertex_count * info.stride, packed);
+    BindBuffer(gl_state, GL_ARRAY_BUFFER, 0);
+    BindBuffer(gl_state, GL_COPY_WRITE_BUFFER, pool.ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (long) (sizeof(unsigned int) * allocation.indices.first),
+                    (long) (sizeof(unsigned int) * index_count), indices);
+
+    pool.meshes++;
+    pool.vertex_count += vertex_count;
+    pool.index_count += index_count;
+
+    SMesh &slot = registry.meshes[mesh];
+    slot.base_vertex = (int) allocation.vertices.first;
+    slot.first_index = (int) allocation.indices.first;
+    slot.index_count = (int) index_count;
+    slot.vertex_count = (int) vertex_count;
+    slot.format = format;
+    slot.vao = pool.vao;
+    slot.bounds = bounds;
+    return allocation;
+}
+
+/* Empties a streamed slot again, its ranges stay allocated until FreeStreamedMesh */
+void EvictStreamedMesh(SMeshRegistry &registry, int mesh)
+{
+    SMesh &slot = registry.meshes[mesh];
+    slot.index_count = 0;
+    slot.vertex_count = 0;
+    slot.vao = 0;
+}
+
+/* Hands the ranges of an evicted mesh back to its pool, once no frame in flight draws it */
+void FreeStreamedMesh(SMeshRegistry &registry, SMeshAllocation &allocation)
+{
+    SMeshStreamPool &pool = registry.stream_pools[allocation.format];
+    FreeMeshRange(pool.free_vertices, allocation.vertices);
+    FreeMeshRange(pool.free_indices, allocation.indices);
+
+    pool.meshes--;
+    pool.vertex_count -= allocation.vertices.count;
+    pool.index_count -= allocation.indices.count;
+    allocation.vertices.count = allocation.indices.count = 0;
+}
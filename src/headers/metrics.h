@@ -0,0 +1,377 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+#ifdef __unix
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <signal.h>
+    #include <cerrno>
+#endif
+
+/* ---- Definitions ---- */
+#define METRICS_SEGMENT_NAME "/comp3011_metrics"
+#define METRICS_MAGIC 0x4d455452u      // "METR"
+#define METRICS_VERSION 1u
+
+#define METRICS_MAX 48
+#define METRICS_NAME_LENGTH 40
+#define METRICS_HISTOGRAM_BUCKETS 34
+
+// Snapshots are copied into the segment at most this often, the registry itself is updated every frame
+#define METRICS_PUBLISH_INTERVAL_MS 100.0
+
+enum EMetricKind
+{
+    METRIC_COUNTER,     // only ever increases
+    METRIC_GAUGE,       // last value set
+    METRIC_HISTOGRAM    // fixed width buckets, the last one collects everything above
+};
+
+const char *metric_kind_names[3] = { "counter", "gauge", "histogram" };
+
+// Plain data so that the same layout is used in the process and in the shared segment
+struct SMetricValue
+{
+    char name[METRICS_NAME_LENGTH];
+    unsigned int kind;
+    unsigned int bucket_count;
+    double value;                   // counter total, gauge value or sum of the histogram samples
+    unsigned long long count;       // histogram samples
+    double bucket_width;
+    unsigned int buckets[METRICS_HISTOGRAM_BUCKETS];
+};
+
+// The publisher is the only writer. It makes sequence odd while it copies a snapshot in and even
+// again afterwards, a reader retries whenever it saw an odd or changed sequence, so neither side
+// ever waits on the other.
+struct SMetricsSegment
+{
+    unsigned int magic;
+    unsigned int version;
+    std::atomic<unsigned int> sequence;
+    unsigned int closed;
+    int pid;
+    unsigned int metric_count;
+    unsigned long long publishes;
+    SMetricValue metrics[METRICS_MAX];
+};
+
+// Registry of the render loop and the asset loaders, updated from the main thread only
+struct SMetrics
+{
+    SMetricValue metrics[METRICS_MAX];
+    unsigned int metric_count;
+
+    const char *segment_name;
+    SMetricsSegment *segment;
+    std::chrono::steady_clock::time_point last_publish;
+
+    unsigned int publishes;
+    float publish_us;
+};
+
+SMetrics metrics;
+
+void InitMetrics(SMetrics &registry)
+{
+    memset(registry.metrics, 0, sizeof(registry.metrics));
+    registry.metric_count = 0;
+    registry.segment_name = NULL;
+    registry.segment = NULL;
+    registry.last_publish = std::chrono::steady_clock::now();
+    registry.publishes = 0;
+    registry.publish_us = 0.f;
+}
+
+/* Adds a metric and returns its id, -1 when the registry is full */
+int AddMetric(SMetrics &registry, const char *name, EMetricKind kind, double bucket_width, unsigned int bucket_count)
+{
+    if (registry.metric_count >= METRICS_MAX)
+    {
+        printf("ERROR: Metrics - no room for %s, raise METRICS_MAX\n", name);
+        return -1;
+    }
+
+    SMetricValue &metric = registry.metrics[registry.metric_count];
+    memset(&metric, 0, sizeof(SMetricValue));
+    strncpy(metric.name, name, METRICS_NAME_LENGTH - 1);
+    metric.kind = (unsigned int) kind;
+    metric.bucket_width = bucket_width;
+    metric.bucket_count = bucket_count < METRICS_HISTOGRAM_BUCKETS ? bucket_count : METRICS_HISTOGRAM_BUCKETS;
+    return (int) registry.metric_count++;
+}
+
+int AddCounter(SMetrics &registry, const char *name)
+{
+    return AddMetric(registry, name, METRIC_COUNTER, 0.0, 0);
+}
+
+int AddGauge(SMetrics &registry, const char *name)
+{
+    return AddMetric(registry, name, METRIC_GAUGE, 0.0, 0);
+}
+
+int AddHistogram(SMetrics &registry, const char *name, double bucket_width, unsigned int bucket_count)
+{
+    return AddMetric(registry, name, METRIC_HISTOGRAM, bucket_width, bucket_count);
+}
+
+inline void IncrementCounter(SMetrics &registry, int id, double amount)
+{
+    if (id >= 0)
+        registry.metrics[id].value += amount;
+}
+
+inline void SetGauge(SMetrics &registry, int id, double value)
+{
+    if (id >= 0)
+        registry.metrics[id].value = value;
+}
+
+inline void RecordHistogram(SMetrics &registry, int id, double value)
+{
+    if (id < 0)
+        return;
+
+    SMetricValue &metric = registry.metrics[id];
+    int bucket = (int) (value / metric.bucket_width);
+    bucket = bucket < 0 ? 0 : (bucket >= (int) metric.bucket_count ? (int) metric.bucket_count - 1 : bucket);
+    metric.buckets[bucket]++;
+    metric.value += value;
+    metric.count++;
+}
+
+/* Upper edge of the bucket that holds the given fraction of the samples */
+double MetricPercentile(const SMetricValue &metric, double fraction)
+{
+    if (metric.count == 0)
+        return 0.0;
+
+    unsigned long long target = (unsigned long long) ceil(fraction * (double) metric.count);
+    unsigned long long seen = 0;
+    for (unsigned int b = 0; b < metric.bucket_count; b++)
+    {
+        seen += metric.buckets[b];
+        if (seen >= target)
+            return (double) (b + 1) * metric.bucket_width;
+    }
+    return (double) metric.bucket_count * metric.bucket_width;
+}
+
+/* Creates the shared memory segment the registry is published into */
+bool OpenMetricsSegment(SMetrics &registry, const char *name)
+{
+#ifdef __unix
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        printf("ERROR: Metrics - could not create shared memory %s\n", name);
+        return false;
+    }
+
+    if (ftruncate(fd, sizeof(SMetricsSegment)) != 0)
+    {
+        printf("ERROR: Metrics - could not size shared memory %s\n", name);
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    void *mapping = mmap(NULL, sizeof(SMetricsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        printf("ERROR: Metrics - could not map shared memory %s\n", name);
+        shm_unlink(name);
+        return false;
+    }
+
+    SMetricsSegment *segment = (SMetricsSegment *) mapping;
+    segment->sequence.store(0, std::memory_order_relaxed);
+    segment->closed = 0;
+    segment->pid = (int) getpid();
+    segment->metric_count = 0;
+    segment->publishes = 0;
+    segment->version = METRICS_VERSION;
+    // A reader that finds the magic can trust the rest of the header
+    std::atomic_thread_fence(std::memory_order_release);
+    segment->magic = METRICS_MAGIC;
+
+    registry.segment_name = name;
+    registry.segment = segment;
+    printf("INFO: Metrics - publishing %u metrics to shared memory %s every %.0f ms\n",
+           registry.metric_count, name, METRICS_PUBLISH_INTERVAL_MS);
+    return true;
+#else
+    (void) registry;
+    printf("ERROR: Metrics - shared memory publishing of %s needs a POSIX system\n", name);
+    return false;
+#endif
+}
+
+/* Copies a snapshot of the registry into the segment, at most every METRICS_PUBLISH_INTERVAL_MS unless forced */
+void PublishMetrics(SMetrics &registry, bool force)
+{
+    if (registry.segment == NULL)
+        return;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!force && std::chrono::duration<double, std::milli>(now - registry.last_publish).count() < METRICS_PUBLISH_INTERVAL_MS)
+        return;
+    registry.last_publish = now;
+
+    SMetricsSegment &segment = *registry.segment;
+    unsigned int sequence = segment.sequence.load(std::memory_order_relaxed);
+    segment.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(segment.metrics, registry.metrics, sizeof(SMetricValue) * registry.metric_count);
+    segment.metric_count = registry.metric_count;
+    segment.publishes++;
+
+    segment.sequence.store(sequence + 2, std::memory_order_release);
+
+    registry.publishes++;
+    registry.publish_us += std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - now).count();
+}
+
+/* Publishes the final values, tells readers the run is over and removes the segment */
+void CloseMetrics(SMetrics &registry)
+{
+    if (registry.segment == NULL)
+        return;
+
+    PublishMetrics(registry, true);
+    registry.segment->closed = 1;
+    std::atomic_thread_fence(std::memory_order_release);
+
+#ifdef __unix
+    munmap(registry.segment, sizeof(SMetricsSegment));
+    shm_unlink(registry.segment_name);
+#endif
+    registry.segment = NULL;
+}
+
+void PrintMetricsStats(const SMetrics &registry)
+{
+    if (registry.publishes == 0)
+        return;
+
+    printf("INFO: Metrics - %u snapshots of %u metrics published, %.2f us per snapshot\n",
+           registry.publishes, registry.metric_count, registry.publish_us / (float) registry.publishes);
+}
+
+/* Prints one snapshot, histograms as sample count, mean and percentiles */
+void PrintMetricsSnapshot(const SMetricsSegment &snapshot)
+{
+    printf("---- pid %d, snapshot %llu ----\n", snapshot.pid, snapshot.publishes);
+    for (unsigned int i = 0; i < snapshot.metric_count && i < METRICS_MAX; i++)
+    {
+        const SMetricValue &metric = snapshot.metrics[i];
+        if (metric.kind == METRIC_HISTOGRAM)
+        {
+            // Percentiles in the last bucket are only known to be above its lower edge
+            double overflow = (double) (metric.bucket_count - 1) * metric.bucket_width;
+            double p[3] = { MetricPercentile(metric, 0.5), MetricPercentile(metric, 0.95), MetricPercentile(metric, 0.99) };
+            printf("%-32s %-9s n %llu, mean %.3f, p50 %s%.1f, p95 %s%.1f, p99 %s%.1f\n", metric.name, metric_kind_names[metric.kind],
+                   metric.count, metric.count > 0 ? metric.value / (double) metric.count : 0.0,
+                   p[0] > overflow ? ">" : "", p[0] > overflow ? overflow : p[0],
+                   p[1] > overflow ? ">" : "", p[1] > overflow ? overflow : p[1],
+                   p[2] > overflow ? ">" : "", p[2] > overflow ? overflow : p[2]);
+        }
+        else
+            printf("%-32s %-9s %.3f\n", metric.name, metric.kind < 3 ? metric_kind_names[metric.kind] : "?", metric.value);
+    }
+}
+
+/* The command line reader: maps the segment read only and prints a consistent snapshot every
+ * interval_ms until the publisher closes it, or count times when count > 0 */
+int ReadMetricsSegment(const char *name, int interval_ms, int count)
+{
+#ifdef __unix
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        printf("ERROR: Metrics - no shared memory %s, start the renderer with --metrics first\n", name);
+        return -1;
+    }
+
+    void *mapping = mmap(NULL, sizeof(SMetricsSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        printf("ERROR: Metrics - could not map shared memory %s\n", name);
+        return -1;
+    }
+
+    const SMetricsSegment *segment = (const SMetricsSegment *) mapping;
+    if (segment->magic != METRICS_MAGIC || segment->version != METRICS_VERSION)
+    {
+        printf("ERROR: Metrics - %s is not a version %u metrics segment\n", name, METRICS_VERSION);
+        munmap(mapping, sizeof(SMetricsSegment));
+        return -1;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    SMetricsSegment *snapshot = new SMetricsSegment;
+    unsigned int retries = 0;
+    for (int printed = 0; count <= 0 || printed < count; printed++)
+    {
+        // Copy until the sequence was even and unchanged across the copy
+        for (;;)
+        {
+            unsigned int before = segment->sequence.load(std::memory_order_acquire);
+            if ((before & 1u) == 0)
+            {
+                snapshot->pid = segment->pid;
+                snapshot->publishes = segment->publishes;
+                snapshot->metric_count = segment->metric_count;
+                memcpy(snapshot->metrics, segment->metrics, sizeof(snapshot->metrics));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (segment->sequence.load(std::memory_order_relaxed) == before)
+                    break;
+            }
+            retries++;
+            std::this_thread::yield();
+        }
+
+        PrintMetricsSnapshot(*snapshot);
+        fflush(stdout);
+
+        if (segment->closed)
+        {
+            printf("INFO: Metrics - publisher %d closed %s\n", snapshot->pid, name);
+            break;
+        }
+        // A publisher that crashed leaves the segment behind without closing it
+        if (kill(snapshot->pid, 0) != 0 && errno == ESRCH)
+        {
+            printf("ERROR: Metrics - publisher %d exited without closing %s\n", snapshot->pid, name);
+            shm_unlink(name);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+    }
+
+    if (retries > 0)
+        printf("INFO: Metrics - %u copies were retried while a snapshot was being published\n", retries);
+
+    delete snapshot;
+    munmap(mapping, sizeof(SMetricsSegment));
+    return 0;
+#else
+    (void) interval_ms;
+    (void) count;
+    printf("ERROR: Metrics - reading shared memory %s needs a POSIX system\n", name);
+    return -1;
+#endif
+}
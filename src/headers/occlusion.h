@@ -0,0 +1,963 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <map>
+#include <array>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/* ---- SIMD Intrinsics ---- */
+// Pixels are rasterized 4 at a time with SSE, without it the scalar path is used
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define OCC_SIMD 1
+#else
+    #define OCC_SIMD 0
+#endif
+
+/* ---- GLM Includes ---- */
+#ifdef _WIN32
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#endif
+
+#ifdef __unix
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#endif
+
+/* ---- Header Files ---- */
+#include "parser.h"
+#include "jobs.h"
+#include "memory.h"
+
+// This system does not touch OpenGL, it only needs the parsed vertex data and the matrices,
+// so it can be driven and checked without a GPU or a context.
+
+/* ---- Definitions ---- */
+// Size of the software depth buffer and of the tiles it is split into
+#define OCC_WIDTH  256
+#define OCC_HEIGHT 144
+#define OCC_TILE_W 32
+#define OCC_TILE_H 16
+#define OCC_TILES_X (OCC_WIDTH / OCC_TILE_W)
+#define OCC_TILES_Y (OCC_HEIGHT / OCC_TILE_H)
+#define OCC_TILE_PIXELS (OCC_TILE_W * OCC_TILE_H)
+
+// Levels of the hierarchical depth pyramid, level 0 is half the depth buffer resolution
+#define OCC_HIZ_LEVELS 5
+
+// With validation on, every this many frames the full meshes are rasterized too, to measure how accurate
+// the proxies are. It stalls those frames, so it is off unless asked for.
+#define OCC_VALIDATE_INTERVAL 120
+
+// Share of a mesh's surface area its occluder proxy keeps, in its largest triangles
+#define OCC_PROXY_COVERAGE 0.75f
+
+// Low poly occluder made of the largest triangles of a mesh
+struct SOccluderProxy
+{
+    std::vector<float> positions;     // x, y, z per vertex
+    std::vector<unsigned int> indices;
+
+    // The full mesh (8 floats per vertex, 3 vertices per triangle), only read for validation.
+    // The proxy owns it from AddOccluderProxy on and frees it in ShutdownOcclusionSystem.
+    float *source_vertices;
+    unsigned int source_vertex_count;
+};
+
+struct SOccluderInstance
+{
+    int proxy;
+    glm::mat4 model;
+};
+
+// Triangle after projection, in pixels with depth in [0, 1]
+struct SOccluderTriangle
+{
+    float x[3];
+    float y[3];
+    float z[3];
+    int min_x, min_y, max_x, max_y;
+};
+
+struct SOcclusionStats
+{
+    unsigned int occluder_triangles;
+    unsigned int rasterized_triangles;
+    unsigned int occludees;
+    unsigned int occluded;
+
+    float setup_ms;
+    float raster_ms;
+    float hiz_ms;
+    float test_ms;
+    float total_ms;
+
+    // Filled in on validation frames only, compared against the full meshes
+    unsigned int validations;
+    unsigned int false_occluded; // hidden by the proxies but visible with the full meshes
+    unsigned int missed;         // visible with the proxies but hidden by the full meshes
+};
+
+struct SOcclusionSystem
+{
+    std::vector<SOccluderProxy> proxies;
+
+    // Per frame input
+    glm::mat4 view_projection;
+    std::vector<SOccluderInstance> instances;
+    std::vector<glm::vec3> occludee_center;
+    std::vector<glm::vec3> occludee_extent;
+    std::vector<unsigned char> occluded;
+
+    // Triangle setup output and per tile bins of triangle indices
+    std::vector<SOccluderTriangle> triangles;
+    std::vector<unsigned int> bins[OCC_TILES_X * OCC_TILES_Y];
+
+    // Depth buffer stored tile by tile so that each thread writes to its own memory
+    std::vector<float> depth;
+    // Max depth pyramid, level l is (OCC_WIDTH >> (l + 1)) x (OCC_HEIGHT >> (l + 1))
+    std::vector<float> hiz[OCC_HIZ_LEVELS];
+    int hiz_width[OCC_HIZ_LEVELS];
+    int hiz_height[OCC_HIZ_LEVELS];
+
+    // When set, tiles are rasterized by the job system's workers instead of the threads below
+    SJobSystem *jobs;
+
+    // Compare the proxies against the full meshes every OCC_VALIDATE_INTERVAL frames
+    bool validate;
+
+    // Persistent workers that rasterize tiles alongside the calling thread
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start_signal;
+    std::condition_variable done_signal;
+    unsigned int generation;
+    int busy_workers;
+    bool quit;
+    std::atomic<int> next_tile;
+
+    SOcclusionStats stats;
+    SOcclusionStats totals;
+    unsigned int frames;
+};
+
+/* Builds a low poly proxy from the largest triangles of a mesh, taken in order of decreasing area until
+ * they make up coverage of its total area. Every proxy triangle is one of the mesh's own, so the proxy
+ * covers a subset of the mesh's pixels at exactly its depth and never hides what the mesh would not.
+ * Takes ownership of the malloc'ed vertices, which validation rasterizes in full. */
+int AddOccluderProxy(SOcclusionSystem &occlusion, float *vertices, unsigned int vertex_count, float coverage)
+{
+    SOccluderProxy proxy;
+    proxy.source_vertices = vertices;
+    proxy.source_vertex_count = vertex_count;
+
+    unsigned int triangle_count = vertex_count / 3;
+    std::vector<float> areas(triangle_count);
+    std::vector<unsigned int> order(triangle_count);
+    float total_area = 0.f;
+    for (unsigned int t = 0; t < triangle_count; t++)
+    {
+        const float *v = vertices + (size_t) t * 3 * 8;
+        glm::vec3 a(v[0], v[1], v[2]), b(v[8], v[9], v[10]), c(v[16], v[17], v[18]);
+        areas[t] = 0.5f * glm::length(glm::cross(b - a, c - a));
+        total_area += areas[t];
+        order[t] = t;
+    }
+    std::stable_sort(order.begin(), order.end(), [&areas](unsigned int l, unsigned int r) { return areas[l] > areas[r]; });
+
+    // Corners are welded on their exact position, the proxy keeps the mesh's own coordinates
+    std::map<std::array<float, 3>, unsigned int> welded;
+    float kept_area = 0.f;
+    for (unsigned int k = 0; k < triangle_count && kept_area < coverage * total_area; k++)
+    {
+        unsigned int t = order[k];
+        if (areas[t] <= 0.f)
+            break;
+        kept_area += areas[t];
+
+        for (int corner = 0; corner < 3; corner++)
+        {
+            const float *v = vertices + ((size_t) t * 3 + corner) * 8;
+            std::array<float, 3> position = { { v[0], v[1], v[2] } };
+            std::pair<std::map<std::array<float, 3>, unsigned int>::iterator, bool> found =
+                    welded.insert(std::make_pair(position, (unsigned int) proxy.positions.size() / 3));
+            if (found.second)
+                proxy.positions.insert(proxy.positions.end(), position.begin(), position.end());
+            proxy.indices.push_back(found.first->second);
+        }
+    }
+
+    TransferMemory(memory_tracker, vertices, MEMORY_MESH_SOURCE, MEMORY_OCCLUSION);
+    TrackMemory(memory_tracker, "occluder proxies", MEMORY_OCCLUSION, MEMORY_HOST, &occlusion,
+                sizeof(float) * proxy.positions.capacity() + sizeof(unsigned int) * proxy.indices.capacity());
+
+    printf("INFO: Occluder Proxy %d - %u triangles reduced to %u covering %.1f%% of the area\n",
+           (int) occlusion.proxies.size(), triangle_count, (unsigned int) proxy.indices.size() / 3,
+           total_area > 0.f ? 100.f * kept_area / total_area : 0.f);
+
+    occlusion.proxies.push_back(proxy);
+    return (int) occlusion.proxies.size() - 1;
+}
+
+/* Clips a clip space triangle against the near plane (z >= -w), emitting up to two triangles */
+int ClipNearPlane(const glm::vec4 in[3], glm::vec4 out[6])
+{
+    glm::vec4 polygon[4];
+    int n = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        const glm::vec4 &a = in[i];
+        const glm::vec4 &b = in[(i + 1) % 3];
+        float da = a.z + a.w;
+        float db = b.z + b.w;
+
+        if (da >= 0.f)
+            polygon[n++] = a;
+        if ((da >= 0.f) != (db >= 0.f))
+        {
+            float t = da / (da - db);
+            polygon[n++] = a + (b - a) * t;
+        }
+    }
+
+    if (n < 3)
+        return 0;
+
+    out[0] = polygon[0];
+    out[1] = polygon[1];
+    out[2] = polygon[2];
+    if (n == 3)
+        return 1;
+
+    out[3] = polygon[0];
+    out[4] = polygon[2];
+    out[5] = polygon[3];
+    return 2;
+}
+
+/* Projects a triangle to pixels and appends it if it covers any pixel centre on screen */
+void SetupOccluderTriangle(SOcclusionSystem &occlusion, const glm::vec4 clip[3])
+{
+    SOccluderTriangle tri;
+    for (int i = 0; i < 3; i++)
+    {
+        float inv_w = 1.f / clip[i].w;
+        tri.x[i] = (clip[i].x * inv_w * 0.5f + 0.5f) * (float) OCC_WIDTH;
+        tri.y[i] = (0.5f - clip[i].y * inv_w * 0.5f) * (float) OCC_HEIGHT;
+        tri.z[i] = clip[i].z * inv_w * 0.5f + 0.5f;
+    }
+
+    // Orient every triangle the same way so the edge functions are positive inside,
+    // occluders are rasterized double sided since the island is an open surface
+    float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.y[1] - tri.y[0]) * (tri.x[2] - tri.x[0]);
+    if (area == 0.f)
+        return;
+    if (area < 0.f)
+    {
+        std::swap(tri.x[1], tri.x[2]);
+        std::swap(tri.y[1], tri.y[2]);
+        std::swap(tri.z[1], tri.z[2]);
+    }
+
+    float min_x = fminf(tri.x[0], fminf(tri.x[1], tri.x[2]));
+    float max_x = fmaxf(tri.x[0], fmaxf(tri.x[1], tri.x[2]));
+    float min_y = fminf(tri.y[0], fminf(tri.y[1], tri.y[2]));
+    float max_y = fmaxf(tri.y[0], fmaxf(tri.y[1], tri.y[2]));
+
+    if (max_x < 0.f || max_y < 0.f || min_x >= (float) OCC_WIDTH || min_y >= (float) OCC_HEIGHT)
+        return;
+
+    tri.min_x = std::max(0, (int) floorf(min_x));
+    tri.min_y = std::max(0, (int) floorf(min_y));
+    tri.max_x = std::min(OCC_WIDTH - 1, (int) ceilf(max_x));
+    tri.max_y = std::min(OCC_HEIGHT - 1, (int) ceilf(max_y));
+
+    unsigned int index = (unsigned int) occlusion.triangles.size();
+    occlusion.triangles.push_back(tri);
+
+    // Bin the triangle into every tile its bounding box touches
+    for (int ty = tri.min_y / OCC_TILE_H; ty <= tri.max_y / OCC_TILE_H; ty++)
+        for (int tx = tri.min_x / OCC_TILE_W; tx <= tri.max_x / OCC_TILE_W; tx++)
+            occlusion.bins[ty * OCC_TILES_X + tx].push_back(index);
+}
+
+/* Transforms, clips and bins the triangles of one mesh, positions are read with the given stride.
+ * Returns how many triangles were inside the side planes. */
+unsigned int SetupOccluderMesh(SOcclusionSystem &occlusion, const glm::mat4 &mvp, const float *positions, int stride,
+                       const unsigned int *indices, unsigned int triangle_count)
+{
+    unsigned int inside = 0;
+    for (unsigned int t = 0; t < triangle_count; t++)
+    {
+        glm::vec4 clip[3];
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int v = indices != NULL ? indices[t * 3 + k] : t * 3 + k;
+            const float *p = positions + (size_t) v * stride;
+            clip[k] = mvp * glm::vec4(p[0], p[1], p[2], 1.f);
+        }
+
+        // Trivially reject triangles outside one of the side planes
+        bool outside = false;
+        for (int axis = 0; axis < 2 && !outside; axis++)
+        {
+            outside = (clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w) ||
+                      (clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w);
+        }
+        if (outside)
+            continue;
+
+        inside++;
+
+        if (clip[0].z + clip[0].w >= 0.f && clip[1].z + clip[1].w >= 0.f && clip[2].z + clip[2].w >= 0.f)
+        {
+            SetupOccluderTriangle(occlusion, clip);
+            continue;
+        }
+
+        glm::vec4 clipped[6];
+        int count = ClipNearPlane(clip, clipped);
+        for (int i = 0; i < count; i++)
+            SetupOccluderTriangle(occlusion, clipped + i * 3);
+    }
+    return inside;
+}
+
+/* Rasterizes every triangle binned to a tile into that tile's part of the depth buffer */
+void RasterizeOccluderTile(SOcclusionSystem &occlusion, int tile)
+{
+    float *tile_depth = occlusion.depth.data() + (size_t) tile * OCC_TILE_PIXELS;
+    for (int i = 0; i < OCC_TILE_PIXELS; i++)
+        tile_depth[i] = 1.f;
+
+    int tile_x0 = (tile % OCC_TILES_X) * OCC_TILE_W;
+    int tile_y0 = (tile / OCC_TILES_X) * OCC_TILE_H;
+
+    const std::vector<unsigned int> &bin = occlusion.bins[tile];
+    for (size_t b = 0; b < bin.size(); b++)
+    {
+        const SOccluderTriangle &tri = occlusion.triangles[bin[b]];
+
+        int x0 = std::max(tri.min_x, tile_x0);
+        int x1 = std::min(tri.max_x, tile_x0 + OCC_TILE_W - 1);
+        int y0 = std::max(tri.min_y, tile_y0);
+        int y1 = std::min(tri.max_y, tile_y0 + OCC_TILE_H - 1);
+        if (x0 > x1 || y0 > y1)
+            continue;
+
+        // Edge functions E(x, y) = A x + B y + C, positive inside for each edge v0v1, v1v2, v2v0
+        float A[3], B[3], C[3];
+        for (int e = 0; e < 3; e++)
+        {
+            int a = e, c = (e + 1) % 3;
+            A[e] = -(tri.y[c] - tri.y[a]);
+            B[e] = tri.x[c] - tri.x[a];
+            C[e] = -(A[e] * tri.x[a] + B[e] * tri.y[a]);
+        }
+
+        // Screen space plane of the depth, z(x, y) = z0 + dzdx (x - x0) + dzdy (y - y0)
+        float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) - (tri.y[1] - tri.y[0]) * (tri.x[2] - tri.x[0]);
+        float dzdx = ((tri.z[1] - tri.z[0]) * (tri.y[2] - tri.y[0]) - (tri.z[2] - tri.z[0]) * (tri.y[1] - tri.y[0])) / area;
+        float dzdy = ((tri.z[2] - tri.z[0]) * (tri.x[1] - tri.x[0]) - (tri.z[1] - tri.z[0]) * (tri.x[2] - tri.x[0])) / area;
+        float zc = tri.z[0] - dzdx * tri.x[0] - dzdy * tri.y[0];
+
+#if OCC_SIMD
+        // Align the span to the 4 pixel groups of the tile
+        x0 &= ~3;
+
+        __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        __m128 zero = _mm_setzero_ps();
+
+        for (int y = y0; y <= y1; y++)
+        {
+            float py = (float) y + 0.5f;
+            float *row = tile_depth + (y - tile_y0) * OCC_TILE_W;
+
+            for (int x = x0; x <= x1; x += 4)
+            {
+                __m128 px = _mm_add_ps(_mm_set1_ps((float) x), lane);
+
+                __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[0]), px), _mm_set1_ps(B[0] * py + C[0]));
+                __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[1]), px), _mm_set1_ps(B[1] * py + C[1]));
+                __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[2]), px), _mm_set1_ps(B[2] * py + C[2]));
+
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+
+                __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(dzdx), px), _mm_set1_ps(dzdy * py + zc));
+                __m128 d = _mm_loadu_ps(row + (x - tile_x0));
+                __m128 closer = _mm_and_ps(inside, _mm_cmplt_ps(z, d));
+                d = _mm_or_ps(_mm_and_ps(closer, z), _mm_andnot_ps(closer, d));
+                _mm_storeu_ps(row + (x - tile_x0), d);
+            }
+        }
+#else
+        for (int y = y0; y <= y1; y++)
+        {
+            float py = (float) y + 0.5f;
+            float *row = tile_depth + (y - tile_y0) * OCC_TILE_W;
+
+            for (int x = x0; x <= x1; x++)
+            {
+                float px = (float) x + 0.5f;
+                if (A[0] * px + B[0] * py + C[0] < 0.f || A[1] * px + B[1] * py + C[1] < 0.f ||
+                    A[2] * px + B[2] * py + C[2] < 0.f)
+                    continue;
+
+                float z = dzdx * px + dzdy * py + zc;
+                if (z < row[x - tile_x0])
+                    row[x - tile_x0] = z;
+            }
+        }
+#endif
+    }
+}
+
+/* Takes tiles from the shared counter until there are none left */
+void RasterizeOccluderTiles(SOcclusionSystem &occlusion)
+{
+    while (true)
+    {
+        int tile = occlusion.next_tile.fetch_add(1);
+        if (tile >= OCC_TILES_X * OCC_TILES_Y)
+            break;
+        RasterizeOccluderTile(occlusion, tile);
+    }
+}
+
+void OcclusionWorker(SOcclusionSystem *occlusion)
+{
+    unsigned int seen_generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(occlusion->mutex);
+            occlusion->start_signal.wait(lock, [&] { return occlusion->quit || occlusion->generation != seen_generation; });
+            if (occlusion->quit)
+                return;
+            seen_generation = occlusion->generation;
+        }
+
+        RasterizeOccluderTiles(*occlusion);
+
+        std::lock_guard<std::mutex> lock(occlusion->mutex);
+        if (--occlusion->busy_workers == 0)
+            occlusion->done_signal.notify_one();
+    }
+}
+
+void RasterizeOccluderTilesJob(void *data, int)
+{
+    RasterizeOccluderTiles(*(SOcclusionSystem *) data);
+}
+
+/* Rasterizes all binned triangles on the workers and the calling thread */
+void RasterizeOccluders(SOcclusionSystem &occlusion)
+{
+    occlusion.next_tile = 0;
+
+    // One job per worker, each takes tiles from the shared counter
+    if (occlusion.jobs != NULL)
+    {
+        ParallelFor(*occlusion.jobs, occlusion.jobs->worker_count, RasterizeOccluderTilesJob, &occlusion);
+        return;
+    }
+
+    if (!occlusion.workers.empty())
+    {
+        std::lock_guard<std::mutex> lock(occlusion.mutex);
+        occlusion.busy_workers = (int) occlusion.workers.size();
+        occlusion.generation++;
+        occlusion.start_signal.notify_all();
+    }
+
+    RasterizeOccluderTiles(occlusion);
+
+    if (!occlusion.workers.empty())
+    {
+        std::unique_lock<std::mutex> lock(occlusion.mutex);
+        occlusion.done_signal.wait(lock, [&] { return occlusion.busy_workers == 0; });
+    }
+}
+
+float OcclusionDepthAt(const SOcclusionSystem &occlusion, int x, int y)
+{
+    int tile = (y / OCC_TILE_H) * OCC_TILES_X + (x / OCC_TILE_W);
+    return occlusion.depth[(size_t) tile * OCC_TILE_PIXELS + (y % OCC_TILE_H) * OCC_TILE_W + (x % OCC_TILE_W)];
+}
+
+/* Builds the max depth pyramid, a texel holds the farthest depth of the pixels below it */
+void BuildHiZ(SOcclusionSystem &occlusion)
+{
+    for (int level = 0; level < OCC_HIZ_LEVELS; level++)
+    {
+        int w = occlusion.hiz_width[level];
+        int h = occlusion.hiz_height[level];
+        std::vector<float> &dst = occlusion.hiz[level];
+
+        for (int y = 0; y < h; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                float m = 0.f;
+                for (int k = 0; k < 4; k++)
+                {
+                    // Odd sizes fold the last row/column into the texel before it
+                    int sx = 2 * x + (k & 1);
+                    int sy = 2 * y + (k >> 1);
+
+                    if (level == 0)
+                    {
+                        sx = std::min(sx, OCC_WIDTH - 1);
+                        sy = std::min(sy, OCC_HEIGHT - 1);
+                        m = fmaxf(m, OcclusionDepthAt(occlusion, sx, sy));
+                    }
+                    else
+                    {
+                        int pw = occlusion.hiz_width[level - 1];
+                        int ph = occlusion.hiz_height[level - 1];
+                        sx = std::min(sx, pw - 1);
+                        sy = std::min(sy, ph - 1);
+                        m = fmaxf(m, occlusion.hiz[level - 1][sy * pw + sx]);
+                    }
+                }
+                dst[y * w + x] = m;
+            }
+        }
+    }
+}
+
+/* Returns true when the world box is behind the depth in the pyramid over its whole screen rectangle */
+bool TestOccludee(const SOcclusionSystem &occlusion, const glm::vec3 &center, const glm::vec3 &extent, bool full_resolution)
+{
+    float min_x = 1e30f, min_y = 1e30f, max_x = -1e30f, max_y = -1e30f;
+    float min_z = 1e30f;
+
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner = center + glm::vec3((i & 1) ? extent.x : -extent.x,
+                                              (i & 2) ? extent.y : -extent.y,
+                                              (i & 4) ? extent.z : -extent.z);
+        glm::vec4 clip = occlusion.view_projection * glm::vec4(corner, 1.f);
+
+        // Boxes that reach through the near plane are always drawn
+        if (clip.z < -clip.w || clip.w <= 1e-5f)
+            return false;
+
+        float inv_w = 1.f / clip.w;
+        float sx = (clip.x * inv_w * 0.5f + 0.5f) * (float) OCC_WIDTH;
+        float sy = (0.5f - clip.y * inv_w * 0.5f) * (float) OCC_HEIGHT;
+        float sz = clip.z * inv_w * 0.5f + 0.5f;
+
+        min_x = fminf(min_x, sx);
+        max_x = fmaxf(max_x, sx);
+        min_y = fminf(min_y, sy);
+        max_y = fmaxf(max_y, sy);
+        min_z = fminf(min_z, sz);
+    }
+
+    int x0 = std::max(0, (int) floorf(min_x));
+    int y0 = std::max(0, (int) floorf(min_y));
+    int x1 = std::min(OCC_WIDTH - 1, (int) floorf(max_x));
+    int y1 = std::min(OCC_HEIGHT - 1, (int) floorf(max_y));
+    if (x0 > x1 || y0 > y1)
+        return false;
+
+    if (full_resolution)
+    {
+        for (int y = y0; y <= y1; y++)
+            for (int x = x0; x <= x1; x++)
+                if (OcclusionDepthAt(occlusion, x, y) >= min_z)
+                    return false;
+        return true;
+    }
+
+    // Pick the level where the rectangle covers only a few texels
+    int span = std::max(x1 - x0, y1 - y0);
+    int level = 0;
+    while (level + 1 < OCC_HIZ_LEVELS && (span >> (level + 1)) > 2)
+        level++;
+
+    int shift = level + 1;
+    int w = occlusion.hiz_width[level];
+    int h = occlusion.hiz_height[level];
+    const std::vector<float> &hiz = occlusion.hiz[level];
+
+    for (int y = std::min(y0 >> shift, h - 1); y <= std::min(y1 >> shift, h - 1); y++)
+        for (int x = std::min(x0 >> shift, w - 1); x <= std::min(x1 >> shift, w - 1); x++)
+            if (hiz[y * w + x] >= min_z)
+                return false;
+
+    return true;
+}
+
+void InitOcclusionSystem(SOcclusionSystem &occlusion, int threads)
+{
+    occlusion.depth.assign((size_t) OCC_TILES_X * OCC_TILES_Y * OCC_TILE_PIXELS, 1.f);
+
+    for (int level = 0; level < OCC_HIZ_LEVELS; level++)
+    {
+        occlusion.hiz_width[level] = std::max(1, (OCC_WIDTH + (1 << (level + 1)) - 1) >> (level + 1));
+        occlusion.hiz_height[level] = std::max(1, (OCC_HEIGHT + (1 << (level + 1)) - 1) >> (level + 1));
+        occlusion.hiz[level].assign((size_t) occlusion.hiz_width[level] * occlusion.hiz_height[level], 1.f);
+    }
+
+    occlusion.jobs = NULL;
+    occlusion.validate = false;
+    occlusion.generation = 0;
+    occlusion.busy_workers = 0;
+    occlusion.quit = false;
+    occlusion.next_tile = 0;
+
+    // The calling thread also rasterizes, so it counts as one of the threads
+    for (int i = 1; i < threads; i++)
+        occlusion.workers.push_back(std::thread(OcclusionWorker, &occlusion));
+
+    memset(&occlusion.stats, 0, sizeof(SOcclusionStats));
+    memset(&occlusion.totals, 0, sizeof(SOcclusionStats));
+    occlusion.frames = 0;
+
+    size_t bytes = sizeof(float) * occlusion.depth.capacity();
+    for (int level = 0; level < OCC_HIZ_LEVELS; level++)
+        bytes += sizeof(float) * occlusion.hiz[level].capacity();
+    TrackMemory(memory_tracker, "occlusion depth", MEMORY_OCCLUSION, MEMORY_HOST, &occlusion.depth, bytes);
+}
+
+void ShutdownOcclusionSystem(SOcclusionSystem &occlusion)
+{
+    {
+        std::lock_guard<std::mutex> lock(occlusion.mutex);
+        occlusion.quit = true;
+        occlusion.start_signal.notify_all();
+    }
+
+    for (size_t i = 0; i < occlusion.workers.size(); i++)
+        occlusion.workers[i].join();
+    occlusion.workers.clear();
+
+    for (size_t i = 0; i < occlusion.proxies.size(); i++)
+    {
+        ReleaseMemory(memory_tracker, occlusion.proxies[i].source_vertices, MEMORY_OCCLUSION);
+        free(occlusion.proxies[i].source_vertices);
+    }
+    std::vector<SOccluderProxy>().swap(occlusion.proxies);
+    ReleaseMemory(memory_tracker, &occlusion, MEMORY_OCCLUSION);
+
+    std::vector<float>().swap(occlusion.depth);
+    for (int level = 0; level < OCC_HIZ_LEVELS; level++)
+        std::vector<float>().swap(occlusion.hiz[level]);
+    ReleaseMemory(memory_tracker, &occlusion.depth, MEMORY_OCCLUSION);
+}
+
+void BeginOcclusion(SOcclusionSystem &occlusion, const glm::mat4 &view_projection)
+{
+    occlusion.view_projection = view_projection;
+    occlusion.instances.clear();
+    occlusion.occludee_center.clear();
+    occlusion.occludee_extent.clear();
+}
+
+void AddOccluderInstance(SOcclusionSystem &occlusion, int proxy, const glm::mat4 &model)
+{
+    SOccluderInstance instance;
+    instance.proxy = proxy;
+    instance.model = model;
+    occlusion.instances.push_back(instance);
+}
+
+/* Adds a world space box to test, returns the occludee index */
+unsigned int AddOccludee(SOcclusionSystem &occlusion, const glm::vec3 &center, const glm::vec3 &extent)
+{
+    occlusion.occludee_center.push_back(center);
+    occlusion.occludee_extent.push_back(extent);
+    return (unsigned int) occlusion.occludee_center.size() - 1;
+}
+
+/* Rasterizes either the proxies or the full meshes of every occluder instance and builds the pyramid */
+void RenderOcclusionDepth(SOcclusionSystem &occlusion, bool full_meshes)
+{
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+
+    occlusion.triangles.clear();
+    for (int b = 0; b < OCC_TILES_X * OCC_TILES_Y; b++)
+        occlusion.bins[b].clear();
+
+    unsigned int occluder_triangles = 0;
+    for (size_t i = 0; i < occlusion.instances.size(); i++)
+    {
+        const SOccluderInstance &instance = occlusion.instances[i];
+        const SOccluderProxy &proxy = occlusion.proxies[instance.proxy];
+        glm::mat4 mvp = occlusion.view_projection * instance.model;
+
+        if (full_meshes)
+            occluder_triangles += SetupOccluderMesh(occlusion, mvp, proxy.source_vertices, 8, NULL, proxy.source_vertex_count / 3);
+        else
+            occluder_triangles += SetupOccluderMesh(occlusion, mvp, proxy.positions.data(), 3, proxy.indices.data(),
+                                                    (unsigned int) proxy.indices.size() / 3);
+    }
+
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+    RasterizeOccluders(occlusion);
+    std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+    BuildHiZ(occlusion);
+    std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
+
+    // The stats measure the proxies, the full meshes of a validation pass are not counted
+    if (!full_meshes)
+    {
+        occlusion.stats.occluder_triangles = occluder_triangles;
+        occlusion.stats.rasterized_triangles = (unsigned int) occlusion.triangles.size();
+        occlusion.stats.setup_ms = std::chrono::duration<float, std::milli>(t1 - t0).count();
+        occlusion.stats.raster_ms = std::chrono::duration<float, std::milli>(t2 - t1).count();
+        occlusion.stats.hiz_ms = std::chrono::duration<float, std::milli>(t3 - t2).count();
+    }
+}
+
+/* Rasterizes the occluders and tests every occludee against the pyramid */
+void RunOcclusion(SOcclusionSystem &occlusion)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    SOcclusionStats &stats = occlusion.stats;
+    memset(&stats, 0, sizeof(SOcclusionStats));
+
+    RenderOcclusionDepth(occlusion, false);
+
+    std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+
+    size_t n = occlusion.occludee_center.size();
+    occlusion.occluded.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        occlusion.occluded[i] = (unsigned char) TestOccludee(occlusion, occlusion.occludee_center[i], occlusion.occludee_extent[i], false);
+        stats.occluded += occlusion.occluded[i];
+    }
+    stats.occludees = (unsigned int) n;
+
+    std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+    stats.test_ms = std::chrono::duration<float, std::milli>(t1 - t0).count();
+    stats.total_ms = std::chrono::duration<float, std::milli>(t1 - start).count();
+
+    // Validation is not part of the measured cost, it rasterizes the full meshes and compares the results
+    if (occlusion.validate && occlusion.frames % OCC_VALIDATE_INTERVAL == 0)
+    {
+        RenderOcclusionDepth(occlusion, true);
+
+        for (size_t i = 0; i < n; i++)
+        {
+            bool reference = TestOccludee(occlusion, occlusion.occludee_center[i], occlusion.occludee_extent[i], true);
+            if (occlusion.occluded[i] && !reference)
+                stats.false_occluded++;
+            if (!occlusion.occluded[i] && reference)
+                stats.missed++;
+        }
+        stats.validations = 1;
+    }
+
+    SOcclusionStats &t = occlusion.totals;
+    t.occluder_triangles += stats.occluder_triangles;
+    t.rasterized_triangles += stats.rasterized_triangles;
+    t.occludees += stats.occludees;
+    t.occluded += stats.occluded;
+    t.setup_ms += stats.setup_ms;
+    t.raster_ms += stats.raster_ms;
+    t.hiz_ms += stats.hiz_ms;
+    t.test_ms += stats.test_ms;
+    t.total_ms += stats.total_ms;
+    t.validations += stats.validations;
+    t.false_occluded += stats.false_occluded;
+    t.missed += stats.missed;
+    occlusion.frames++;
+}
+
+bool IsOccluded(const SOcclusionSystem &occlusion, unsigned int occludee)
+{
+    return occlusion.occluded[occludee] != 0;
+}
+
+void PrintOcclusionStats(const SOcclusionSystem &occlusion)
+{
+    if (occlusion.frames == 0)
+        return;
+
+    float frames = (float) occlusion.frames;
+    const SOcclusionStats &t = occlusion.totals;
+
+    printf("INFO: Occlusion Culling - %u frames, %dx%d depth, %d threads, per frame averages:\n",
+           occlusion.frames, OCC_WIDTH, OCC_HEIGHT,
+           occlusion.jobs != NULL ? occlusion.jobs->worker_count : (int) occlusion.workers.size() + 1);
+    printf("INFO:   occluder triangles: %.1f, rasterized: %.1f\n",
+           (float) t.occluder_triangles / frames, (float) t.rasterized_triangles / frames);
+    printf("INFO:   occludees: %.1f, occluded: %.1f\n", (float) t.occludees / frames, (float) t.occluded / frames);
+    printf("INFO:   setup %.4f ms, raster %.4f ms, hi-z %.4f ms, test %.4f ms, total %.4f ms\n",
+           t.setup_ms / frames, t.raster_ms / frames, t.hiz_ms / frames, t.test_ms / frames, t.total_ms / frames);
+
+    if (t.validations > 0)
+        printf("INFO:   accuracy over %u validations against full meshes: %u false occlusions, %u missed occlusions\n",
+               t.validations, t.false_occluded, t.missed);
+}
+
+/* Appends the two triangles of a quad to a vertex array of 8 floats per vertex, only the positions are set */
+void AppendOcclusionQuad(std::vector<float> &vertices, const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &d)
+{
+    const glm::vec3 *corners[6] = { &a, &b, &c, &a, &c, &d };
+    for (int i = 0; i < 6; i++)
+    {
+        float vertex[8] = { corners[i]->x, corners[i]->y, corners[i]->z, 0.f, 0.f, 0.f, 0.f, 1.f };
+        vertices.insert(vertices.end(), vertex, vertex + 8);
+    }
+}
+
+/* Hands a vertex array to the occlusion system as a proxy, in the malloc'ed form the parser produces */
+int AddBenchmarkOccluder(SOcclusionSystem &occlusion, const std::vector<float> &vertices)
+{
+    size_t bytes = sizeof(float) * vertices.size();
+    float *copy = (float *) malloc(bytes);
+    memcpy(copy, vertices.data(), bytes);
+    TrackMemory(memory_tracker, "occlusion benchmark", MEMORY_MESH_SOURCE, MEMORY_HOST, copy, bytes);
+    return AddOccluderProxy(occlusion, copy, (unsigned int) (vertices.size() / 8), OCC_PROXY_COVERAGE);
+}
+
+/* Self-check and benchmark without a GPU. A wall in front of the camera has to hide exactly the boxes
+ * behind it. Then occludee_count random boxes are tested over a bumpy terrain seen at a grazing angle,
+ * the proxy result is compared against the full mesh and the cost per frame is measured. */
+int BenchmarkOcclusion(int occludee_count)
+{
+    srand(1234);
+    typedef std::chrono::high_resolution_clock clock;
+    int threads = (int) std::max(1u, std::min(8u, std::thread::hardware_concurrency()));
+
+    glm::mat4 projection = glm::perspective(glm::radians(60.f), (float) OCC_WIDTH / (float) OCC_HEIGHT, 0.1f, 200.f);
+    int failures = 0;
+
+    // A wall over [-4, 4] x [-4, 4] at z = 0, seen from 5 m in front of it
+    {
+        SOcclusionSystem occlusion;
+        InitOcclusionSystem(occlusion, threads);
+
+        std::vector<float> wall;
+        AppendOcclusionQuad(wall, glm::vec3(-4.f, -4.f, 0.f), glm::vec3(4.f, -4.f, 0.f), glm::vec3(4.f, 4.f, 0.f), glm::vec3(-4.f, 4.f, 0.f));
+        int proxy = AddBenchmarkOccluder(occlusion, wall);
+
+        BeginOcclusion(occlusion, projection * glm::lookAt(glm::vec3(0.f, 0.f, 5.f), glm::vec3(0.f), glm::vec3(0.f, 1.f, 0.f)));
+        AddOccluderInstance(occlusion, proxy, glm::mat4(1.f));
+
+        struct SOcclusionCase
+        {
+            const char *name;
+            glm::vec3 center;
+            bool occluded;
+        };
+        const SOcclusionCase cases[] = {
+            { "behind the wall",            glm::vec3(0.f, 0.f, -3.f),   true  },
+            { "behind a corner",            glm::vec3(3.f, 3.f, -1.f),   true  },
+            { "far behind the wall",        glm::vec3(-1.f, 1.f, -40.f), true  },
+            { "in front of the wall",       glm::vec3(0.f, 0.f, 2.f),    false },
+            { "through the wall",           glm::vec3(0.f, 0.f, 0.f),    false },
+            { "beside the wall",            glm::vec3(7.5f, 0.f, -3.f),  false },
+            { "across the edge",            glm::vec3(6.4f, 0.f, -3.f),  false },
+            { "through the near plane",     glm::vec3(0.f, 0.f, 5.f),    false },
+        };
+        const int case_count = (int) (sizeof(cases) / sizeof(cases[0]));
+        for (int i = 0; i < case_count; i++)
+            AddOccludee(occlusion, cases[i].center, glm::vec3(0.25f));
+
+        RunOcclusion(occlusion);
+        for (int i = 0; i < case_count; i++)
+        {
+            bool full = TestOccludee(occlusion, cases[i].center, glm::vec3(0.25f), true);
+            if (IsOccluded(occlusion, (unsigned int) i) != cases[i].occluded || full != cases[i].occluded)
+            {
+                printf("ERROR: Occlusion Benchmark - box %s is %s, expected %s\n", cases[i].name,
+                       IsOccluded(occlusion, (unsigned int) i) ? "occluded" : "visible", cases[i].occluded ? "occluded" : "visible");
+                failures++;
+            }
+        }
+        printf("INFO: Occlusion Benchmark - wall: %d of %d boxes as expected\n", case_count - failures, case_count);
+
+        ShutdownOcclusionSystem(occlusion);
+    }
+
+    // A 100 x 100 m terrain of 128 x 128 quads, with boxes scattered just above it
+    SOcclusionSystem occlusion;
+    InitOcclusionSystem(occlusion, threads);
+
+    const int n = 128;
+    std::vector<float> terrain;
+    terrain.reserve((size_t) n * n * 6 * 8);
+    for (int z = 0; z < n; z++)
+    {
+        for (int x = 0; x < n; x++)
+        {
+            glm::vec3 corners[4];
+            for (int c = 0; c < 4; c++)
+            {
+                float fx = (float) (x + (c == 1 || c == 2)) / (float) n, fz = (float) (z + (c >= 2)) / (float) n;
+                corners[c] = glm::vec3(fx * 100.f - 50.f, 4.f * sinf(fx * 17.f) * cosf(fz * 13.f), fz * 100.f - 50.f);
+            }
+            AppendOcclusionQuad(terrain, corners[0], corners[1], corners[2], corners[3]);
+        }
+    }
+    int proxy = AddBenchmarkOccluder(occlusion, terrain);
+
+    glm::mat4 view_projection = projection * glm::lookAt(glm::vec3(0.f, 3.f, 50.f), glm::vec3(0.f, 0.f, 0.f), glm::vec3(0.f, 1.f, 0.f));
+    std::vector<glm::vec3> centers(occludee_count);
+    for (int i = 0; i < occludee_count; i++)
+    {
+        float x = (float) (rand() % 10000) * 0.01f - 50.f;
+        float z = (float) (rand() % 10000) * 0.01f - 50.f;
+        float fx = (x + 50.f) * 0.01f, fz = (z + 50.f) * 0.01f;
+        centers[i] = glm::vec3(x, 4.f * sinf(fx * 17.f) * cosf(fz * 13.f) + 0.5f, z);
+    }
+
+    const int frames = 100;
+    float total_ms = 0.f;
+    for (int f = 0; f <= frames; f++)
+    {
+        // The first frame is validated against the full mesh and not timed
+        occlusion.validate = f == 0;
+        BeginOcclusion(occlusion, view_projection);
+        AddOccluderInstance(occlusion, proxy, glm::mat4(1.f));
+        for (int i = 0; i < occludee_count; i++)
+            AddOccludee(occlusion, centers[i], glm::vec3(0.3f));
+
+        clock::time_point start = clock::now();
+        RunOcclusion(occlusion);
+        if (f > 0)
+            total_ms += std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    }
+
+    const SOcclusionStats &first = occlusion.totals;
+    const SOcclusionStats &stats = occlusion.stats;
+    printf("INFO: Occlusion Benchmark - terrain: %u proxy triangles, %d boxes, %u occluded, %d threads\n",
+           stats.occluder_triangles, occludee_count, stats.occluded, threads);
+    printf("INFO:   cost:  %.3f ms per frame (setup %.3f, raster %.3f, hi-z %.3f, test %.3f in the last frame)\n",
+           total_ms / (float) frames, stats.setup_ms, stats.raster_ms, stats.hiz_ms, stats.test_ms);
+    printf("INFO:   check: %u false occlusions, %u missed occlusions against the full mesh\n", first.false_occluded, first.missed);
+    if (first.false_occluded > 0)
+    {
+        printf("ERROR: Occlusion Benchmark - the proxy hides %u boxes the full mesh does not\n", first.false_occluded);
+        failures++;
+    }
+    if (stats.occluded == 0)
+    {
+        printf("ERROR: Occlusion Benchmark - the terrain hides none of the boxes\n");
+        failures++;
+    }
+
+    ShutdownOcclusionSystem(occlusion);
+    return failures == 0 ? 0 : -1;
+}
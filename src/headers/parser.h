@@ -4,6 +4,7 @@
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
+#include <cmath> // for sqrtf
 #include <vector> // for std::vector
 #include <utility> // for std::pair
 
@@ -18,9 +19,30 @@
 #include <glm/vec3.hpp>
 #endif
 
+/* ---- Definitions ---- */
+// Threads the normal generation runs on at most, and the fewest items worth giving each of them
+#define OBJ_MAX_THREADS 16
+#define OBJ_MIN_CHUNK 4096
+
+/* ---- Structures ---- */
+// Object space bounding volumes of a parsed mesh, the sphere is centred on the box
+struct SBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 center;
+    float radius;
+};
+
 /* ---- Function Prototypes ---- */
 std::pair<float *, unsigned int> parse_OBJ(const char *file_path);
+std::pair<float *, unsigned int> parse_OBJ(const char *file_path, SBounds *bounds);
 void process_file_OBJ(const char *file_path);
+void process_stream_OBJ(FILE *obj_file);
+void generate_normals_OBJ(unsigned int threads);
 void process_data_OBJ();
+SBounds compute_bounds_OBJ();
 float *create_vertices();
+unsigned int threads_OBJ();
+int benchmark_OBJ(unsigned int triangle_count);
 
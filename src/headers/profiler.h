@@ -0,0 +1,388 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include <atomic>
+
+/* ---- OpenGL Headers ---- */
+#include <glad/glad.h>
+
+/* ---- Definitions ---- */
+// Events kept in the ring, a longer run overwrites the oldest ones (power of two)
+#define PROFILER_RING_SIZE     (1 << 16)
+// GPU timings are read back this many frames after they were issued so that reading never stalls
+#define PROFILER_GPU_LATENCY   4
+#define PROFILER_GPU_QUERIES   64
+
+// Thread id the GPU track is exported under
+#define PROFILER_GPU_THREAD    1000
+
+struct SProfileEvent
+{
+    // Index + 1 of the event in the slot, zero while a writer is filling it in
+    std::atomic<uint64_t> sequence;
+
+    const char *name;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    int thread;
+};
+
+// The queries of one frame, reused PROFILER_GPU_LATENCY frames later
+struct SGpuFrameQueries
+{
+    unsigned int anchor;                            // GL_TIMESTAMP at the start of the frame
+    unsigned int queries[PROFILER_GPU_QUERIES];     // GL_TIME_ELAPSED, one per scope
+    const char *names[PROFILER_GPU_QUERIES];
+    int count;
+    bool pending;
+};
+
+struct SProfiler
+{
+    // Lock free multi producer ring, writers claim a slot with one fetch_add
+    SProfileEvent *events;
+    std::atomic<uint64_t> write_index;
+
+    std::chrono::steady_clock::time_point start_time;
+    std::atomic<int> thread_count;
+
+    // GPU timer queries, only used from the thread that owns the GL context
+    bool gpu_enabled;
+    SGpuFrameQueries gpu_frames[PROFILER_GPU_LATENCY];
+    int gpu_frame;
+    bool gpu_scope_open;
+    int64_t gpu_offset_ns;      // GL timestamp to profiler clock
+    unsigned int gpu_frames_read;
+    unsigned int gpu_frames_dropped;
+    unsigned int gpu_scopes_dropped;
+    uint64_t gpu_total_ns;
+};
+
+// The profiler scopes record into, NULL while profiling is off so that a scope costs one branch
+SProfiler *active_profiler = NULL;
+
+// Small id of the calling thread, handed out on its first event
+thread_local int profile_thread_id = -1;
+
+uint64_t ProfilerNow(const SProfiler &profiler)
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profiler.start_time).count();
+}
+
+int ProfilerThreadId(SProfiler &profiler)
+{
+    if (profile_thread_id < 0)
+        profile_thread_id = profiler.thread_count.fetch_add(1);
+    return profile_thread_id;
+}
+
+/* Appends a finished scope, safe to call from any thread */
+void RecordProfileEvent(SProfiler &profiler, const char *name, uint64_t start_ns, uint64_t duration_ns, int thread)
+{
+    uint64_t index = profiler.write_index.fetch_add(1, std::memory_order_relaxed);
+    SProfileEvent &event = profiler.events[index & (PROFILER_RING_SIZE - 1)];
+
+    event.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name = name;
+    event.start_ns = start_ns;
+    event.duration_ns = duration_ns;
+    event.thread = thread;
+    event.sequence.store(index + 1, std::memory_order_release);
+}
+
+/* Records the enclosing block as one CPU event while active_profiler is set */
+struct SProfileScope
+{
+    const char *name;
+    uint64_t start_ns;
+
+    SProfileScope(const char *scope_name);
+    ~SProfileScope();
+};
+
+/* For straight line code where a block would end the lifetime of what it creates, pairs with EndProfileEvent */
+uint64_t BeginProfileEvent()
+{
+    return active_profiler != NULL ? ProfilerNow(*active_profiler) : 0;
+}
+
+void EndProfileEvent(const char *name, uint64_t start_ns)
+{
+    if (active_profiler != NULL)
+        RecordProfileEvent(*active_profiler, name, start_ns, ProfilerNow(*active_profiler) - start_ns, ProfilerThreadId(*active_profiler));
+}
+
+SProfileScope::SProfileScope(const char *scope_name)
+{
+    name = scope_name;
+    start_ns = BeginProfileEvent();
+}
+
+SProfileScope::~SProfileScope()
+{
+    EndProfileEvent(name, start_ns);
+}
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) SProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+
+/* Starts recording CPU scopes, the calling thread becomes thread 0 */
+void InitProfiler(SProfiler &profiler)
+{
+    profiler.events = new SProfileEvent[PROFILER_RING_SIZE];
+    for (int i = 0; i < PROFILER_RING_SIZE; i++)
+        profiler.events[i].sequence = 0;
+    profiler.write_index = 0;
+    profiler.start_time = std::chrono::steady_clock::now();
+    profiler.thread_count = 0;
+
+    profiler.gpu_enabled = false;
+    profiler.gpu_frame = 0;
+    profiler.gpu_scope_open = false;
+    profiler.gpu_offset_ns = 0;
+    profiler.gpu_frames_read = 0;
+    profiler.gpu_frames_dropped = 0;
+    profiler.gpu_scopes_dropped = 0;
+    profiler.gpu_total_ns = 0;
+
+    ProfilerThreadId(profiler);
+    active_profiler = &profiler;
+}
+
+/* Creates the timer queries, needs the GL context to be current on the calling thread */
+void InitGpuProfiler(SProfiler &profiler)
+{
+    for (int i = 0; i < PROFILER_GPU_LATENCY; i++)
+    {
+        SGpuFrameQueries &frame = profiler.gpu_frames[i];
+        glGenQueries(1, &frame.anchor);
+        glGenQueries(PROFILER_GPU_QUERIES, frame.queries);
+        frame.count = 0;
+        frame.pending = false;
+    }
+
+    // GL timestamps count from an arbitrary origin, line them up with the profiler clock once
+    GLint64 gl_now = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gl_now);
+    profiler.gpu_offset_ns = (int64_t) ProfilerNow(profiler) - (int64_t) gl_now;
+    profiler.gpu_enabled = true;
+}
+
+/* Turns the queries of a finished frame into events. Returns false without waiting when the GPU is not done yet. */
+bool ReadGpuFrame(SProfiler &profiler, SGpuFrameQueries &frame)
+{
+    if (frame.count == 0)
+    {
+        frame.pending = false;
+        return true;
+    }
+
+    // Queries complete in order, so the last one being ready means all of them are
+    GLint available = 0;
+    glGetQueryObjectiv(frame.queries[frame.count - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+
+    GLuint64 anchor = 0;
+    glGetQueryObjectui64v(frame.anchor, GL_QUERY_RESULT, &anchor);
+
+    // Only durations are measured, so the scopes are laid out back to back from the start of the frame
+    uint64_t start_ns = (uint64_t) ((int64_t) anchor + profiler.gpu_offset_ns);
+    uint64_t now_ns = ProfilerNow(profiler);
+    for (int i = 0; i < frame.count; i++)
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &elapsed);
+
+        // Some drivers (llvmpipe) report garbage for the very first query, nothing can take longer than the run so far
+        if ((uint64_t) elapsed > now_ns)
+        {
+            profiler.gpu_scopes_dropped++;
+            continue;
+        }
+
+        RecordProfileEvent(profiler, frame.names[i], start_ns, (uint64_t) elapsed, PROFILER_GPU_THREAD);
+        start_ns += (uint64_t) elapsed;
+        profiler.gpu_total_ns += (uint64_t) elapsed;
+    }
+
+    frame.pending = false;
+    profiler.gpu_frames_read++;
+    return true;
+}
+
+/* Collects the GPU timings of the frame issued PROFILER_GPU_LATENCY frames ago and starts a new one */
+void BeginGpuFrame(SProfiler &profiler)
+{
+    if (!profiler.gpu_enabled)
+        return;
+
+    profiler.gpu_frame = (profiler.gpu_frame + 1) % PROFILER_GPU_LATENCY;
+    SGpuFrameQueries &frame = profiler.gpu_frames[profiler.gpu_frame];
+
+    // A GPU that is still this far behind loses that frame's timings rather than stalling the CPU
+    if (frame.pending && !ReadGpuFrame(profiler, frame))
+        profiler.gpu_frames_dropped++;
+
+    frame.count = 0;
+    frame.pending = true;
+    glQueryCounter(frame.anchor, GL_TIMESTAMP);
+}
+
+/* Times the GL commands up to EndGpuScope. Timer queries cannot nest, a scope inside another is ignored. */
+void BeginGpuScope(SProfiler &profiler, const char *name)
+{
+    if (!profiler.gpu_enabled)
+        return;
+
+    SGpuFrameQueries &frame = profiler.gpu_frames[profiler.gpu_frame];
+    if (profiler.gpu_scope_open || frame.count >= PROFILER_GPU_QUERIES)
+    {
+        profiler.gpu_scopes_dropped++;
+        return;
+    }
+
+    frame.names[frame.count] = name;
+    glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.count]);
+    profiler.gpu_scope_open = true;
+}
+
+void EndGpuScope(SProfiler &profiler)
+{
+    if (!profiler.gpu_enabled || !profiler.gpu_scope_open)
+        return;
+
+    glEndQuery(GL_TIME_ELAPSED);
+    profiler.gpu_frames[profiler.gpu_frame].count++;
+    profiler.gpu_scope_open = false;
+}
+
+#define PROFILE_GPU_BEGIN(name) do { if (active_profiler != NULL) BeginGpuScope(*active_profiler, name); } while (0)
+#define PROFILE_GPU_END()       do { if (active_profiler != NULL) EndGpuScope(*active_profiler); } while (0)
+
+/* Copies the events still in the ring, oldest first. Events a writer is busy with are left out. */
+void CollectProfileEvents(SProfiler &profiler, std::vector<SProfileEvent *> &events)
+{
+    uint64_t end = profiler.write_index.load(std::memory_order_acquire);
+    uint64_t begin = end > PROFILER_RING_SIZE ? end - PROFILER_RING_SIZE : 0;
+
+    events.clear();
+    for (uint64_t i = begin; i < end; i++)
+    {
+        SProfileEvent *event = &profiler.events[i & (PROFILER_RING_SIZE - 1)];
+        if (event->sequence.load(std::memory_order_acquire) == i + 1)
+            events.push_back(event);
+    }
+}
+
+/* Writes the events as Chrome trace_event JSON, load it in chrome://tracing or Perfetto */
+bool WriteChromeTrace(SProfiler &profiler, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        printf("ERROR: Profiler - Could not write %s\n", path);
+        return false;
+    }
+
+    std::vector<SProfileEvent *> events;
+    CollectProfileEvents(profiler, events);
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    // Name the tracks, thread 0 is the one that started the profiler
+    int threads = profiler.thread_count.load();
+    for (int i = 0; i < threads; i++)
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}},\n",
+                i, i == 0 ? "Main Thread" : "Worker", i);
+    if (profiler.gpu_enabled)
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"GPU\"}},\n", PROFILER_GPU_THREAD);
+
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const SProfileEvent &event = *events[i];
+        fprintf(file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}%s\n",
+                event.name, event.thread == PROFILER_GPU_THREAD ? "gpu" : "cpu", event.thread,
+                (double) event.start_ns / 1000.0, (double) event.duration_ns / 1000.0, i + 1 < events.size() ? "," : "");
+    }
+
+    fprintf(file, "]}\n");
+    fclose(file);
+
+    printf("INFO: Profiler - Wrote %zu events to %s\n", events.size(), path);
+    return true;
+}
+
+/* Prints the time of each scope name over the events still in the ring, averaged over the
+ * frame_scope events among them so that a ring that wrapped around still gives per frame numbers */
+void PrintProfilerStats(SProfiler &profiler, const char *frame_scope)
+{
+    std::vector<SProfileEvent *> events;
+    CollectProfileEvents(profiler, events);
+
+    // Scope names are string literals, so the pointer identifies the scope
+    std::vector<const char *> names;
+    std::vector<bool> gpu;
+    std::vector<uint64_t> totals;
+    std::vector<unsigned int> counts;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        bool is_gpu = events[i]->thread == PROFILER_GPU_THREAD;
+        size_t n = 0;
+        while (n < names.size() && (names[n] != events[i]->name || gpu[n] != is_gpu))
+            n++;
+        if (n == names.size())
+        {
+            names.push_back(events[i]->name);
+            gpu.push_back(is_gpu);
+            totals.push_back(0);
+            counts.push_back(0);
+        }
+        totals[n] += events[i]->duration_ns;
+        counts[n]++;
+    }
+
+    unsigned int frames = 0;
+    for (size_t n = 0; n < names.size(); n++)
+        if (!gpu[n] && strcmp(names[n], frame_scope) == 0)
+            frames = counts[n];
+    if (frames == 0)
+        return;
+
+    uint64_t written = profiler.write_index.load();
+    printf("INFO: Profiler - %llu events recorded, %zu kept, %d threads, per frame over %u frames:\n",
+           (unsigned long long) written, events.size(), profiler.thread_count.load(), frames);
+    for (size_t n = 0; n < names.size(); n++)
+        printf("INFO:   %s %-20s %9.4f ms %7.1f calls\n", gpu[n] ? "gpu" : "cpu", names[n],
+               (double) totals[n] / 1e6 / (double) frames, (double) counts[n] / (double) frames);
+
+    if (profiler.gpu_enabled)
+        printf("INFO:   gpu frames read: %u, dropped as not ready: %u, scopes dropped: %u, avg gpu time %.4f ms\n",
+               profiler.gpu_frames_read, profiler.gpu_frames_dropped, profiler.gpu_scopes_dropped,
+               profiler.gpu_frames_read > 0 ? (double) profiler.gpu_total_ns / 1e6 / (double) profiler.gpu_frames_read : 0.0);
+}
+
+void ShutdownProfiler(SProfiler &profiler)
+{
+    if (active_profiler == &profiler)
+        active_profiler = NULL;
+
+    if (profiler.gpu_enabled)
+    {
+        for (int i = 0; i < PROFILER_GPU_LATENCY; i++)
+        {
+            glDeleteQueries(1, &profiler.gpu_frames[i].anchor);
+            glDeleteQueries(PROFILER_GPU_QUERIES, profiler.gpu_frames[i].queries);
+        }
+    }
+
+    delete[] profiler.events;
+    profiler.events = NULL;
+}
@@ -0,0 +1,676 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* ---- OpenGL Headers ---- */
+#include <glad/glad.h>
+
+/* ---- GLM Includes ---- */
+#ifdef _WIN32
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/type_ptr.hpp>
+#endif
+
+#ifdef __unix
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#endif
+
+/* ---- Header Files ---- */
+#include "mesh.h"
+#include "culling.h"
+#include "occlusion.h"
+#include "profiler.h"
+#include "gl_state.h"
+#include "stream_buffer.h"
+
+/* ---- Definitions ---- */
+// Layout of the 64-bit sort key, most significant field first, so that sorting the keys
+// groups draws by program, then texture, then VAO, and finally orders them front-to-back
+//  [63..56] program | [55..40] texture | [39..24] VAO | [23..0] depth bucket
+#define RQ_PROGRAM_BITS 8
+#define RQ_TEXTURE_BITS 16
+#define RQ_VAO_BITS     16
+#define RQ_DEPTH_BITS   24
+
+#define RQ_DEPTH_SHIFT   0
+#define RQ_VAO_SHIFT     (RQ_DEPTH_SHIFT + RQ_DEPTH_BITS)
+#define RQ_TEXTURE_SHIFT (RQ_VAO_SHIFT + RQ_VAO_BITS)
+#define RQ_PROGRAM_SHIFT (RQ_TEXTURE_SHIFT + RQ_TEXTURE_BITS)
+
+#define RQ_FIELD(value, bits) ((uint64_t) (value) & ((1ull << (bits)) - 1ull))
+
+// Most draws merged into one instanced draw, the object data array of an instanced shader has this many entries.
+// The whole array is allocated and bound for every run, GL leaves a block backed by a shorter range undefined.
+#define RQ_MAX_INSTANCES 64
+
+// Object data offset of a draw whose data did not fit into the stream buffer region, it uploads its own
+#define RQ_OBJECT_OVERFLOW ((GLintptr) -2)
+
+// The payload of a single draw, the key only decides the order in which payloads are issued
+struct SDrawCommand
+{
+    unsigned int program;
+    unsigned int texture;
+    unsigned int vao;
+
+    // Range of the shared index buffer of the mesh registry
+    int base_vertex;
+    int first_index;
+    int index_count;
+    int vertex_count;
+
+    glm::mat4 model;
+    SBounds bounds;
+    int occluder;
+
+    // Consecutive instanced draws with the same program, texture and VAO become one instanced draw call,
+    // their shader reads its model from an array of object data indexed by gl_InstanceID
+    bool instanced;
+
+    // Index count of the mesh this draw stands in for, such as the full mesh behind an impostor, 0 otherwise
+    int replaced_index_count;
+};
+
+// Per draw data of the ObjectData uniform block (std140), streamed every frame
+struct SObjectData
+{
+    glm::mat4 model;
+};
+
+// Counters for a single frame, "elided" counts the binds that were skipped because the
+// previous draw in the sorted order already had the same object bound
+struct SRenderStats
+{
+    unsigned int draws;
+    unsigned int draw_calls;
+    unsigned int views;
+
+    unsigned int program_binds;
+    unsigned int program_binds_elided;
+    unsigned int texture_binds;
+    unsigned int texture_binds_elided;
+    unsigned int vao_binds;
+    unsigned int vao_binds_elided;
+
+    // Draws issued as instances and the instanced draw calls they took
+    unsigned int instances;
+    unsigned int instanced_draw_calls;
+
+    // Triangles drawn, and those left out because a cheaper draw stood in for its mesh
+    unsigned int triangles;
+    unsigned int triangles_replaced;
+};
+
+struct SRenderQueue
+{
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> indices;
+    std::vector<SDrawCommand> commands;
+
+    // Ping-pong storage for the radix sort so that no allocation happens per frame
+    std::vector<uint64_t> scratch_keys;
+    std::vector<uint32_t> scratch_indices;
+
+    // Arguments of the multi-draw batch that is currently being gathered
+    std::vector<GLsizei> batch_counts;
+    std::vector<const void *> batch_offsets;
+    std::vector<GLint> batch_base_vertices;
+
+    // Stream buffer offset of the object data of each sorted draw
+    std::vector<GLintptr> object_offsets;
+
+    // Length of the instanced run each sorted draw starts, 0 inside a run and for the other draws
+    std::vector<unsigned int> instance_counts;
+
+    // Views each command is visible in, bit v for view v, indexed like commands
+    std::vector<unsigned char> view_masks;
+    unsigned int view_count;
+
+    // View matrix and depth range used to compute the depth bucket of each draw
+    glm::mat4 view;
+    float near_plane;
+    float far_plane;
+
+    SRenderStats stats;
+    SRenderStats totals;
+    unsigned int frames;
+};
+
+void InitRenderQueue(SRenderQueue &queue, float near_plane, float far_plane)
+{
+    queue.keys.reserve(64);
+    queue.indices.reserve(64);
+    queue.commands.reserve(64);
+
+    queue.view = glm::mat4(1.f);
+    queue.view_count = 1;
+    queue.near_plane = near_plane;
+    queue.far_plane = far_plane;
+
+    memset(&queue.stats, 0, sizeof(SRenderStats));
+    memset(&queue.totals, 0, sizeof(SRenderStats));
+    queue.frames = 0;
+}
+
+/* Clears the previous frame and sets the view used for the depth buckets */
+void BeginRenderQueue(SRenderQueue &queue, const glm::mat4 &view)
+{
+    queue.keys.clear();
+    queue.indices.clear();
+    queue.commands.clear();
+
+    queue.view = view;
+}
+
+/* Builds the sort key for a draw, depth is the view space distance in front of the camera */
+uint64_t MakeSortKey(unsigned int program, unsigned int texture, unsigned int vao, float depth, float near_plane, float far_plane)
+{
+    // Map the depth range linearly onto the bucket range, nearer objects get smaller buckets
+    float t = (depth - near_plane) / (far_plane - near_plane);
+    if (t < 0.f)
+        t = 0.f;
+    if (t > 1.f)
+        t = 1.f;
+
+    uint64_t depth_bucket = (uint64_t) (t * (float) ((1u << RQ_DEPTH_BITS) - 1u));
+
+    return (RQ_FIELD(program, RQ_PROGRAM_BITS) << RQ_PROGRAM_SHIFT) |
+           (RQ_FIELD(texture, RQ_TEXTURE_BITS) << RQ_TEXTURE_SHIFT) |
+           (RQ_FIELD(vao, RQ_VAO_BITS) << RQ_VAO_SHIFT) |
+           (RQ_FIELD(depth_bucket, RQ_DEPTH_BITS) << RQ_DEPTH_SHIFT);
+}
+
+/* Adds a draw to the queue, nothing is sent to OpenGL until the queue is submitted */
+SDrawCommand &PushDrawCommand(SRenderQueue &queue, unsigned int program, unsigned int texture, unsigned int vao,
+                              const SMesh &mesh, const glm::mat4 &model)
+{
+    // Depth of the object origin in view space, the camera looks down -z
+    glm::vec4 view_pos = queue.view * model[3];
+    float depth = -view_pos.z;
+
+    SDrawCommand command;
+    command.program = program;
+    command.texture = texture;
+    command.vao = vao;
+    command.base_vertex = mesh.base_vertex;
+    command.first_index = mesh.first_index;
+    command.index_count = mesh.index_count;
+    command.vertex_count = mesh.vertex_count;
+    command.model = model;
+    command.bounds = mesh.bounds;
+    command.occluder = mesh.occluder;
+    command.instanced = false;
+    command.replaced_index_count = 0;
+
+    queue.keys.push_back(MakeSortKey(program, texture, vao, depth, queue.near_plane, queue.far_plane));
+    queue.indices.push_back((uint32_t) queue.commands.size());
+    queue.commands.push_back(command);
+    return queue.commands.back();
+}
+
+/* Drops the draws whose bounds are outside the frustum of every view and records the views each
+ * remaining draw is visible in, must be called before sorting. The commands are shared by all views. */
+void CullRenderQueue(SRenderQueue &queue, SCullingSystem &culling, const glm::mat4 *view_projections, unsigned int view_count)
+{
+    BeginCulling(culling, view_projections, view_count);
+    queue.view_count = culling.view_count;
+
+    for (size_t i = 0; i < queue.commands.size(); i++)
+        AddCullingObject(culling, queue.commands[i].bounds, queue.commands[i].model);
+
+    RunCulling(culling);
+
+    queue.view_masks.resize(queue.commands.size());
+    for (size_t i = 0; i < queue.commands.size(); i++)
+        queue.view_masks[i] = (unsigned char) GetVisibleViews(culling, (unsigned int) i);
+
+    // Compact the keys in place, the commands themselves stay where they are
+    size_t kept = 0;
+    for (size_t i = 0; i < queue.keys.size(); i++)
+    {
+        if (queue.view_masks[queue.indices[i]] != 0)
+        {
+            queue.keys[kept] = queue.keys[i];
+            queue.indices[kept] = queue.indices[i];
+            kept++;
+        }
+    }
+
+    queue.keys.resize(kept);
+    queue.indices.resize(kept);
+}
+
+/* Drops the draws whose bounds are outside the view frustum, must be called before sorting */
+void CullRenderQueue(SRenderQueue &queue, SCullingSystem &culling, const glm::mat4 &view_projection)
+{
+    CullRenderQueue(queue, culling, &view_projection, 1);
+}
+
+/* Drops the draws hidden behind the occluders, must follow CullRenderQueue which provides the world bounds.
+ * Only the draws that survived frustum culling are rasterized as occluders or tested. The occluders are
+ * rendered from the first view, so with several views a hidden draw only loses that view and is kept
+ * while any other view still sees it. */
+void OcclusionCullRenderQueue(SRenderQueue &queue, const SCullingSystem &culling, SOcclusionSystem &occlusion,
+                              const glm::mat4 &view_projection)
+{
+    BeginOcclusion(occlusion, view_projection);
+
+    for (size_t i = 0; i < queue.indices.size(); i++)
+    {
+        unsigned int c = queue.indices[i];
+        const SDrawCommand &command = queue.commands[c];
+
+        if (command.occluder >= 0 && (queue.view_masks[c] & 1u) != 0)
+            AddOccluderInstance(occlusion, command.occluder, command.model);
+
+        AddOccludee(occlusion,
+                    glm::vec3(culling.center_x[c], culling.center_y[c], culling.center_z[c]),
+                    glm::vec3(culling.extent_x[c], culling.extent_y[c], culling.extent_z[c]));
+    }
+
+    RunOcclusion(occlusion);
+
+    size_t kept = 0;
+    for (size_t i = 0; i < queue.keys.size(); i++)
+    {
+        if (IsOccluded(occlusion, (unsigned int) i))
+            queue.view_masks[queue.indices[i]] &= (unsigned char) ~1u;
+
+        if (queue.view_masks[queue.indices[i]] != 0)
+        {
+            queue.keys[kept] = queue.keys[i];
+            queue.indices[kept] = queue.indices[i];
+            kept++;
+        }
+    }
+
+    queue.keys.resize(kept);
+    queue.indices.resize(kept);
+}
+
+/* LSD radix sort of the keys (8 bits per pass), the command indices are moved alongside */
+void SortRenderQueue(SRenderQueue &queue)
+{
+    size_t n = queue.keys.size();
+    if (n < 2)
+        return;
+
+    queue.scratch_keys.resize(n);
+    queue.scratch_indices.resize(n);
+
+    uint64_t *src_keys = queue.keys.data();
+    uint32_t *src_indices = queue.indices.data();
+    uint64_t *dst_keys = queue.scratch_keys.data();
+    uint32_t *dst_indices = queue.scratch_indices.data();
+
+    for (int pass = 0; pass < 8; pass++)
+    {
+        int shift = pass * 8;
+
+        size_t histogram[256];
+        memset(histogram, 0, sizeof(histogram));
+
+        for (size_t i = 0; i < n; i++)
+            histogram[(src_keys[i] >> shift) & 0xFF]++;
+
+        // Skip the pass when every key has the same digit, it would only copy the data
+        if (histogram[(src_keys[0] >> shift) & 0xFF] == n)
+            continue;
+
+        // Exclusive prefix sum gives the output offset of each digit
+        size_t offset = 0;
+        for (int d = 0; d < 256; d++)
+        {
+            size_t c = histogram[d];
+            histogram[d] = offset;
+            offset += c;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            size_t dst = histogram[(src_keys[i] >> shift) & 0xFF]++;
+            dst_keys[dst] = src_keys[i];
+            dst_indices[dst] = src_indices[i];
+        }
+
+        uint64_t *tmp_keys = src_keys;
+        src_keys = dst_keys;
+        dst_keys = tmp_keys;
+
+        uint32_t *tmp_indices = src_indices;
+        src_indices = dst_indices;
+        dst_indices = tmp_indices;
+    }
+
+    // An odd number of executed passes leaves the result in the scratch buffers
+    if (src_keys != queue.keys.data())
+    {
+        queue.keys.swap(queue.scratch_keys);
+        queue.indices.swap(queue.scratch_indices);
+    }
+}
+
+/* Sends the gathered batch as one draw call, a single draw does not need the multi-draw path */
+void FlushDrawBatch(SRenderQueue &queue)
+{
+    GLsizei n = (GLsizei) queue.batch_counts.size();
+    if (n == 0)
+        return;
+
+    // Every draw call gets its own GPU timer
+    PROFILE_GPU_BEGIN("draw call");
+    if (n == 1)
+        glDrawElementsBaseVertex(GL_TRIANGLES, queue.batch_counts[0], GL_UNSIGNED_INT,
+                                 queue.batch_offsets[0], queue.batch_base_vertices[0]);
+    else
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, queue.batch_counts.data(), GL_UNSIGNED_INT,
+                                      queue.batch_offsets.data(), n, queue.batch_base_vertices.data());
+    PROFILE_GPU_END();
+
+    queue.stats.draw_calls++;
+
+    for (GLsizei i = 0; i < n; i++)
+        queue.stats.triangles += (unsigned int) queue.batch_counts[i] / 3;
+
+    queue.batch_counts.clear();
+    queue.batch_offsets.clear();
+    queue.batch_base_vertices.clear();
+}
+
+/* True when an instanced draw can join the run of first */
+bool SameInstancedState(const SDrawCommand &first, const SDrawCommand &command)
+{
+    return command.instanced && command.program == first.program && command.texture == first.texture &&
+           command.vao == first.vao && command.first_index == first.first_index && command.base_vertex == first.base_vertex &&
+           command.index_count == first.index_count;
+}
+
+/* Region size that fits the object data of a frame of draw_count draws, instanced_count of which may be
+ * drawn instanced from instanced_kinds different meshes. Every allocation is padded to the uniform
+ * buffer offset alignment, which is 256 bytes on many drivers. */
+GLsizeiptr ObjectStreamRegionSize(size_t draw_count, size_t instanced_count, size_t instanced_kinds)
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    GLsizeiptr single = ((GLsizeiptr) sizeof(SObjectData) + alignment - 1) / alignment * alignment;
+    GLsizeiptr run = ((GLsizeiptr) (sizeof(SObjectData) * RQ_MAX_INSTANCES) + alignment - 1) / alignment * alignment;
+    size_t runs = std::min(instanced_count, instanced_kinds + instanced_count / RQ_MAX_INSTANCES);
+    return std::max((GLsizeiptr) (64 * 1024), single * (GLsizeiptr) draw_count + run * (GLsizeiptr) runs);
+}
+
+/* Writes the object data of the sorted draws into the stream buffer, a draw with the same model matrix
+ * as the one before it shares its data. Draws that do not fit into the region get the offset
+ * RQ_OBJECT_OVERFLOW and upload their own data when they are issued. */
+void StreamObjectData(SRenderQueue &queue, SStreamBuffer &stream)
+{
+    size_t n = queue.indices.size();
+    queue.object_offsets.resize(n);
+    queue.instance_counts.assign(n, 0);
+
+    const glm::mat4 *current_model = NULL;
+    GLintptr current_offset = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        const SDrawCommand &command = queue.commands[queue.indices[i]];
+
+        // An instanced run writes the models of all its draws into one array of RQ_MAX_INSTANCES entries
+        if (command.instanced)
+        {
+            size_t end = i + 1;
+            while (end < n && end - i < RQ_MAX_INSTANCES && SameInstancedState(command, queue.commands[queue.indices[end]]))
+                end++;
+
+            SStreamAllocation allocation = StreamAllocate(stream, (GLsizeiptr) (sizeof(SObjectData) * RQ_MAX_INSTANCES), stream.uniform_alignment);
+            SObjectData *objects = (SObjectData *) allocation.data;
+            for (size_t k = i; k < end; k++)
+            {
+                if (objects != NULL)
+                    objects[k - i].model = queue.commands[queue.indices[k]].model;
+                queue.object_offsets[k] = objects != NULL ? allocation.offset : RQ_OBJECT_OVERFLOW;
+            }
+            queue.instance_counts[i] = (unsigned int) (end - i);
+
+            current_model = NULL;
+            i = end - 1;
+            continue;
+        }
+
+        if (current_model == NULL || memcmp(current_model, &command.model, sizeof(glm::mat4)) != 0)
+        {
+            SStreamAllocation allocation = StreamAllocate(stream, sizeof(SObjectData), stream.uniform_alignment);
+            if (allocation.data == NULL)
+            {
+                queue.object_offsets[i] = RQ_OBJECT_OVERFLOW;
+                current_model = NULL;
+                continue;
+            }
+
+            SObjectData *object = (SObjectData *) allocation.data;
+            object->model = command.model;
+            current_model = &command.model;
+            current_offset = allocation.offset;
+        }
+
+        queue.object_offsets[i] = current_offset;
+    }
+
+    // The draws below read the data, so it has to reach the GPU first
+    FlushStreamBuffer(stream);
+}
+
+/* Issues the sorted draws visible in a view, only binding a program/texture/VAO when it differs from the
+ * previous draw. Consecutive draws that share all state including the object data are merged into one multi-draw. */
+void IssueRenderQueueView(SRenderQueue &queue, SStreamBuffer &stream, unsigned int view)
+{
+    SRenderStats &stats = queue.stats;
+    unsigned char view_bit = (unsigned char) (1u << view);
+
+    // Zero is never a valid object to bind here, so the first draw always binds everything
+    unsigned int current_program = 0;
+    unsigned int current_texture = 0;
+    unsigned int current_vao = 0;
+    GLintptr current_offset = -1;
+
+    for (size_t i = 0; i < queue.indices.size(); i++)
+    {
+        const SDrawCommand &command = queue.commands[queue.indices[i]];
+
+        // An instanced run is drawn whole in every view that sees one of its draws, the GPU clips the others
+        unsigned int instances = 0;
+        if (command.instanced)
+        {
+            unsigned int count = queue.instance_counts[i];
+            for (unsigned int k = 0; k < count && instances == 0; k++)
+                if ((queue.view_masks[queue.indices[i + k]] & view_bit) != 0)
+                    instances = count;
+            if (instances == 0)
+                continue;
+        }
+        else if ((queue.view_masks[queue.indices[i]] & view_bit) == 0)
+            continue;
+
+        bool overflow = queue.object_offsets[i] == RQ_OBJECT_OVERFLOW;
+        bool same_model = !overflow && queue.object_offsets[i] == current_offset;
+
+        // Any state change ends the current batch, as does an instanced draw
+        if (command.program != current_program || command.texture != current_texture ||
+            command.vao != current_vao || !same_model || instances > 0)
+            FlushDrawBatch(queue);
+
+        if (command.program != current_program)
+        {
+            UseProgram(gl_state, command.program);
+            current_program = command.program;
+            stats.program_binds++;
+        }
+        else
+            stats.program_binds_elided++;
+
+        if (command.texture != current_texture)
+        {
+            BindTexture(gl_state, 0, command.texture);
+            current_texture = command.texture;
+            stats.texture_binds++;
+        }
+        else
+            stats.texture_binds_elided++;
+
+        if (command.vao != current_vao)
+        {
+            BindVertexArray(gl_state, command.vao);
+            current_vao = command.vao;
+            stats.vao_binds++;
+        }
+        else
+            stats.vao_binds_elided++;
+
+        if (instances > 0)
+        {
+            current_offset = -1;
+            if (overflow)
+            {
+                SObjectData objects[RQ_MAX_INSTANCES] = {};
+                for (unsigned int k = 0; k < instances; k++)
+                    objects[k].model = queue.commands[queue.indices[i + k]].model;
+                unsigned int buffer = StreamOverflowUpload(stream, objects, (GLsizeiptr) sizeof(objects));
+                glBindBufferRange(GL_UNIFORM_BUFFER, STREAM_OBJECT_BINDING, buffer, 0, (GLsizeiptr) sizeof(objects));
+            }
+            else
+                glBindBufferRange(GL_UNIFORM_BUFFER, STREAM_OBJECT_BINDING, stream.buffer, queue.object_offsets[i],
+                                  (GLsizeiptr) (sizeof(SObjectData) * RQ_MAX_INSTANCES));
+
+            PROFILE_GPU_BEGIN("draw call");
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.index_count, GL_UNSIGNED_INT,
+                                              (const void *) (sizeof(unsigned int) * (size_t) command.first_index),
+                                              (GLsizei) instances, command.base_vertex);
+            PROFILE_GPU_END();
+
+            for (unsigned int k = 0; k < instances; k++)
+            {
+                const SDrawCommand &instance = queue.commands[queue.indices[i + k]];
+                if (instance.replaced_index_count > instance.index_count)
+                    stats.triangles_replaced += (unsigned int) (instance.replaced_index_count - instance.index_count) / 3;
+            }
+            stats.triangles += (unsigned int) command.index_count / 3 * instances;
+            stats.draws += instances;
+            stats.instances += instances;
+            stats.draw_calls++;
+            stats.instanced_draw_calls++;
+
+            // The other draws of the run were part of this one
+            i += instances - 1;
+            continue;
+        }
+
+        if (overflow)
+        {
+            // Not batched with anything, the next draw rebinds the stream buffer
+            current_offset = -1;
+            SObjectData object;
+            object.model = command.model;
+            unsigned int buffer = StreamOverflowUpload(stream, &object, sizeof(SObjectData));
+            glBindBufferRange(GL_UNIFORM_BUFFER, STREAM_OBJECT_BINDING, buffer, 0, sizeof(SObjectData));
+        }
+        else if (!same_model)
+        {
+            current_offset = queue.object_offsets[i];
+            glBindBufferRange(GL_UNIFORM_BUFFER, STREAM_OBJECT_BINDING, stream.buffer, current_offset, sizeof(SObjectData));
+        }
+
+        if (command.replaced_index_count > command.index_count)
+            stats.triangles_replaced += (unsigned int) (command.replaced_index_count - command.index_count) / 3;
+
+        queue.batch_counts.push_back(command.index_count);
+        queue.batch_offsets.push_back((const void *) (sizeof(unsigned int) * (size_t) command.first_index));
+        queue.batch_base_vertices.push_back(command.base_vertex);
+        stats.draws++;
+    }
+
+    FlushDrawBatch(queue);
+    stats.views++;
+}
+
+// Called before the draws of each view are issued, sets the viewport and the camera of that view
+typedef void (*SRenderViewFn)(void *data, int view);
+
+/* Issues the culled and sorted draws once for every view. The object data is streamed once and shared,
+ * so a view only adds its own draw calls. */
+void SubmitRenderQueue(SRenderQueue &queue, SStreamBuffer &stream, SRenderViewFn begin_view, void *data)
+{
+    SRenderStats &stats = queue.stats;
+    memset(&stats, 0, sizeof(SRenderStats));
+
+    StreamObjectData(queue, stream);
+
+    for (unsigned int v = 0; v < queue.view_count; v++)
+    {
+        if (begin_view != NULL)
+            begin_view(data, (int) v);
+        IssueRenderQueueView(queue, stream, v);
+    }
+
+    queue.totals.draws += stats.draws;
+    queue.totals.draw_calls += stats.draw_calls;
+    queue.totals.views += stats.views;
+    queue.totals.program_binds += stats.program_binds;
+    queue.totals.program_binds_elided += stats.program_binds_elided;
+    queue.totals.texture_binds += stats.texture_binds;
+    queue.totals.texture_binds_elided += stats.texture_binds_elided;
+    queue.totals.vao_binds += stats.vao_binds;
+    queue.totals.vao_binds_elided += stats.vao_binds_elided;
+    queue.totals.instances += stats.instances;
+    queue.totals.instanced_draw_calls += stats.instanced_draw_calls;
+    queue.totals.triangles += stats.triangles;
+    queue.totals.triangles_replaced += stats.triangles_replaced;
+    queue.frames++;
+}
+
+/* Issues the culled and sorted draws of a queue with a single view */
+void SubmitRenderQueue(SRenderQueue &queue, SStreamBuffer &stream)
+{
+    SubmitRenderQueue(queue, stream, NULL, NULL);
+}
+
+/* Adds the totals of another queue, used when several queues take turns submitting frames */
+void AccumulateRenderQueueStats(SRenderQueue &queue, const SRenderQueue &other)
+{
+    queue.totals.draws += other.totals.draws;
+    queue.totals.draw_calls += other.totals.draw_calls;
+    queue.totals.views += other.totals.views;
+    queue.totals.program_binds += other.totals.program_binds;
+    queue.totals.program_binds_elided += other.totals.program_binds_elided;
+    queue.totals.texture_binds += other.totals.texture_binds;
+    queue.totals.texture_binds_elided += other.totals.texture_binds_elided;
+    queue.totals.vao_binds += other.totals.vao_binds;
+    queue.totals.vao_binds_elided += other.totals.vao_binds_elided;
+    queue.totals.instances += other.totals.instances;
+    queue.totals.instanced_draw_calls += other.totals.instanced_draw_calls;
+    queue.totals.triangles += other.totals.triangles;
+    queue.totals.triangles_replaced += other.totals.triangles_replaced;
+    queue.frames += other.frames;
+}
+
+void PrintRenderQueueStats(const SRenderQueue &queue)
+{
+    if (queue.frames == 0)
+        return;
+
+    float frames = (float) queue.frames;
+    const SRenderStats &t = queue.totals;
+
+    printf("INFO: Render Queue - %u frames, per frame averages:\n", queue.frames);
+    printf("INFO:   draws: %.1f in %.1f draw calls over %.1f views\n", (float) t.draws / frames, (float) t.draw_calls / frames, (float) t.views / frames);
+    printf("INFO:   program binds: %.1f issued, %.1f elided\n", (float) t.program_binds / frames, (float) t.program_binds_elided / frames);
+    printf("INFO:   texture binds: %.1f issued, %.1f elided\n", (float) t.texture_binds / frames, (float) t.texture_binds_elided / frames);
+    printf("INFO:   VAO binds:     %.1f issued, %.1f elided\n", (float) t.vao_binds / frames, (float) t.vao_binds_elided / frames);
+    printf("INFO:   triangles:     %.0f drawn, %.0f replaced by cheaper draws\n", (float) t.triangles / frames, (float) t.triangles_replaced / frames);
+    if (t.instances > 0)
+        printf("INFO:   instanced:     %.1f draws in %.1f draw calls\n", (float) t.instances / frames, (float) t.instanced_draw_calls / frames);
+}
@@ -0,0 +1,538 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+/* ---- GLM Includes ---- */
+#ifdef _WIN32
+#include <glm/glm/glm.hpp>
+#endif
+
+#ifdef __unix
+#include <glm/glm.hpp>
+#endif
+
+// Scene description: the meshes, textures, placed instances and lights of a world. Scenes are written
+// as text and compiled to a binary file that loads without parsing, both produce the same SScene.
+//
+// Text format, one statement per line, # starts a comment:
+//   chunk_size <metres>                   side of the square streaming chunks, 0 keeps everything resident
+//   stream_radius <metres>                chunks closer than this to the active camera are streamed in
+//   light <1|2> <px py pz> <dx dy dz>     position and direction of a light
+//   mesh <name> <file.obj> [occluder] [solid] [impostor]
+//   texture <name> <file.bmp> [mipmaps]
+//   instance <mesh> <texture> <x y z> <yaw degrees> <scale> [spin] [input] [global]
+// Instances spin a quarter turn every 2*pi seconds, follow the tree keys (input) or stay resident
+// whatever the camera does (global). Distant instances of impostor meshes are drawn as camera facing quads.
+
+/* ---- Definitions ---- */
+#define SCENE_MAGIC   "CGSC"
+#define SCENE_VERSION 2
+
+#define SCENE_NAME_LENGTH 32
+#define SCENE_PATH_LENGTH 128
+#define SCENE_LIGHTS 2
+
+// Most tokens on one line of the text format
+#define SCENE_MAX_TOKENS 16
+
+enum ESceneInstanceFlag
+{
+    SCENE_INSTANCE_SPIN   = 1 << 0,
+    SCENE_INSTANCE_INPUT  = 1 << 1,
+    SCENE_INSTANCE_GLOBAL = 1 << 2
+};
+
+struct SSceneMesh
+{
+    char name[SCENE_NAME_LENGTH];
+    char path[SCENE_PATH_LENGTH];
+    bool occluder;
+    bool solid;
+    bool impostor;
+};
+
+struct SSceneTexture
+{
+    char name[SCENE_NAME_LENGTH];
+    char path[SCENE_PATH_LENGTH];
+    bool mipmaps;
+};
+
+struct SSceneInstance
+{
+    int mesh;
+    int texture;
+    glm::vec3 position;
+    float yaw;
+    float scale;
+    uint32_t flags;
+
+    // Streaming chunk, -1 for the global instances
+    int chunk;
+};
+
+// A cell of the chunk grid, its instances are instances[first_instance, first_instance + instance_count)
+struct SSceneChunk
+{
+    int x;
+    int z;
+    int first_instance;
+    int instance_count;
+};
+
+struct SSceneLight
+{
+    glm::vec3 position;
+    glm::vec3 direction;
+};
+
+// Instances are sorted by chunk, the global ones first
+struct SScene
+{
+    std::vector<SSceneMesh> meshes;
+    std::vector<SSceneTexture> textures;
+    std::vector<SSceneInstance> instances;
+    std::vector<SSceneChunk> chunks;
+    SSceneLight lights[SCENE_LIGHTS];
+
+    float chunk_size;
+    float stream_radius;
+};
+
+void InitScene(SScene &scene)
+{
+    scene.meshes.clear();
+    scene.textures.clear();
+    scene.instances.clear();
+    scene.chunks.clear();
+    scene.lights[0].position = glm::vec3(0.f, 4.f, 0.f);
+    scene.lights[0].direction = glm::vec3(0.f, -1.f, 0.f);
+    scene.lights[1].position = glm::vec3(0.f, 8.f, 0.f);
+    scene.lights[1].direction = glm::vec3(0.f, -1.f, 0.f);
+    scene.chunk_size = 0.f;
+    scene.stream_radius = 0.f;
+}
+
+/* Index of the mesh or texture called name, -1 when there is none */
+template <typename T>
+int FindSceneEntry(const std::vector<T> &entries, const char *name)
+{
+    for (size_t i = 0; i < entries.size(); i++)
+        if (strcmp(entries[i].name, name) == 0)
+            return (int) i;
+    return -1;
+}
+
+/* Chunk cell of a point, floor division so the cells either side of 0 are the same size */
+inline int SceneChunkCell(float value, float chunk_size)
+{
+    return (int) floorf(value / chunk_size);
+}
+
+/* Sorts the instances by chunk and builds the chunk list. Without a chunk size every instance is global. */
+void PartitionScene(SScene &scene)
+{
+    for (size_t i = 0; i < scene.instances.size(); i++)
+        if (scene.chunk_size <= 0.f)
+            scene.instances[i].flags |= SCENE_INSTANCE_GLOBAL;
+
+    // Keyed on the cell, stable so instances keep their authored order within a chunk
+    std::vector<std::pair<int, int> > cells(scene.instances.size());
+    for (size_t i = 0; i < scene.instances.size(); i++)
+    {
+        const SSceneInstance &instance = scene.instances[i];
+        bool global = (instance.flags & SCENE_INSTANCE_GLOBAL) != 0;
+        cells[i] = global ? std::make_pair(INT32_MIN, INT32_MIN) :
+                   std::make_pair(SceneChunkCell(instance.position.x, scene.chunk_size), SceneChunkCell(instance.position.z, scene.chunk_size));
+    }
+
+    std::vector<int> order(scene.instances.size());
+    for (size_t i = 0; i < order.size(); i++)
+        order[i] = (int) i;
+    std::stable_sort(order.begin(), order.end(), [&cells](int a, int b) { return cells[a] < cells[b]; });
+
+    std::vector<SSceneInstance> sorted(scene.instances.size());
+    scene.chunks.clear();
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        sorted[i] = scene.instances[order[i]];
+        if (sorted[i].flags & SCENE_INSTANCE_GLOBAL)
+        {
+            sorted[i].chunk = -1;
+            continue;
+        }
+
+        const std::pair<int, int> &cell = cells[order[i]];
+        if (scene.chunks.empty() || scene.chunks.back().x != cell.first || scene.chunks.back().z != cell.second)
+        {
+            SSceneChunk chunk = { cell.first, cell.second, (int) i, 0 };
+            scene.chunks.push_back(chunk);
+        }
+        scene.chunks.back().instance_count++;
+        sorted[i].chunk = (int) scene.chunks.size() - 1;
+    }
+    scene.instances.swap(sorted);
+}
+
+/* Makes every instance global, for renderers that load the whole scene up front */
+void KeepSceneResident(SScene &scene)
+{
+    for (size_t i = 0; i < scene.instances.size(); i++)
+    {
+        scene.instances[i].flags |= SCENE_INSTANCE_GLOBAL;
+        scene.instances[i].chunk = -1;
+    }
+    scene.chunks.clear();
+}
+
+/* Splits a line into whitespace separated tokens in place, a # ends the line */
+int TokenizeSceneLine(char *line, char *tokens[SCENE_MAX_TOKENS])
+{
+    int count = 0;
+    char *c = line;
+    while (*c != '\0' && *c != '#' && count < SCENE_MAX_TOKENS)
+    {
+        while (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')
+            c++;
+        if (*c == '\0' || *c == '#')
+            break;
+
+        tokens[count++] = c;
+        while (*c != '\0' && *c != '#' && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n')
+            c++;
+        if (*c == '#')
+            *c = '\0';
+        else if (*c != '\0')
+            *c++ = '\0';
+    }
+    return count;
+}
+
+/* Copies a name or path token, false when it does not fit */
+bool CopySceneToken(char *out, size_t size, const char *token)
+{
+    if (strlen(token) >= size)
+        return false;
+    strcpy(out, token);
+    return true;
+}
+
+/* Parses a number token, false when it is not one */
+bool ParseSceneFloat(const char *token, float &value)
+{
+    char *end = NULL;
+    value = strtof(token, &end);
+    return end != token && *end == '\0';
+}
+
+/* Reads the text format, errors name the file and line */
+bool ParseSceneText(SScene &scene, FILE *file, const char *path)
+{
+    char line[512];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        line_number++;
+
+        char *tokens[SCENE_MAX_TOKENS];
+        int count = TokenizeSceneLine(line, tokens);
+        if (count == 0)
+            continue;
+
+        const char *keyword = tokens[0];
+        bool ok = true;
+        if (strcmp(keyword, "chunk_size") == 0 && count == 2)
+        {
+            ok = ParseSceneFloat(tokens[1], scene.chunk_size) && scene.chunk_size >= 0.f;
+        }
+        else if (strcmp(keyword, "stream_radius") == 0 && count == 2)
+        {
+            ok = ParseSceneFloat(tokens[1], scene.stream_radius) && scene.stream_radius >= 0.f;
+        }
+        else if (strcmp(keyword, "light") == 0 && count == 8)
+        {
+            int light = atoi(tokens[1]) - 1;
+            ok = light >= 0 && light < SCENE_LIGHTS;
+            for (int k = 0; ok && k < 3; k++)
+                ok = ParseSceneFloat(tokens[2 + k], scene.lights[light].position[k]) &&
+                     ParseSceneFloat(tokens[5 + k], scene.lights[light].direction[k]);
+        }
+        else if (strcmp(keyword, "mesh") == 0 && count >= 3)
+        {
+            SSceneMesh mesh;
+            mesh.occluder = false;
+            mesh.solid = false;
+            mesh.impostor = false;
+            ok = FindSceneEntry(scene.meshes, tokens[1]) < 0 && CopySceneToken(mesh.name, sizeof(mesh.name), tokens[1]) &&
+                 CopySceneToken(mesh.path, sizeof(mesh.path), tokens[2]);
+            for (int t = 3; ok && t < count; t++)
+            {
+                if (strcmp(tokens[t], "occluder") == 0)
+                    mesh.occluder = true;
+                else if (strcmp(tokens[t], "solid") == 0)
+                    mesh.solid = true;
+                else if (strcmp(tokens[t], "impostor") == 0)
+                    mesh.impostor = true;
+                else
+                    ok = false;
+            }
+            if (ok)
+                scene.meshes.push_back(mesh);
+        }
+        else if (strcmp(keyword, "texture") == 0 && (count == 3 || count == 4))
+        {
+            SSceneTexture texture;
+            texture.mipmaps = count == 4 && strcmp(tokens[3], "mipmaps") == 0;
+            ok = (count == 3 || texture.mipmaps) && FindSceneEntry(scene.textures, tokens[1]) < 0 &&
+                 CopySceneToken(texture.name, sizeof(texture.name), tokens[1]) &&
+                 CopySceneToken(texture.path, sizeof(texture.path), tokens[2]);
+            if (ok)
+                scene.textures.push_back(texture);
+        }
+        else if (strcmp(keyword, "instance") == 0 && count >= 8)
+        {
+            SSceneInstance instance;
+            instance.mesh = FindSceneEntry(scene.meshes, tokens[1]);
+            instance.texture = FindSceneEntry(scene.textures, tokens[2]);
+            instance.flags = 0;
+            instance.chunk = -1;
+            ok = instance.mesh >= 0 && instance.texture >= 0 &&
+                 ParseSceneFloat(tokens[3], instance.position.x) && ParseSceneFloat(tokens[4], instance.position.y) &&
+                 ParseSceneFloat(tokens[5], instance.position.z) && ParseSceneFloat(tokens[6], instance.yaw) &&
+                 ParseSceneFloat(tokens[7], instance.scale);
+            for (int t = 8; ok && t < count; t++)
+            {
+                if (strcmp(tokens[t], "spin") == 0)
+                    instance.flags |= SCENE_INSTANCE_SPIN;
+                else if (strcmp(tokens[t], "input") == 0)
+                    instance.flags |= SCENE_INSTANCE_INPUT;
+                else if (strcmp(tokens[t], "global") == 0)
+                    instance.flags |= SCENE_INSTANCE_GLOBAL;
+                else
+                    ok = false;
+            }
+            if (ok)
+                scene.instances.push_back(instance);
+        }
+        else
+        {
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            printf("ERROR: Scene - %s:%d: could not read \"%s\" statement\n", path, line_number, keyword);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Reads the compiled format, every record is read field by field as SaveSceneBinary writes it */
+bool ReadSceneBinary(SScene &scene, FILE *file)
+{
+    uint32_t version = 0, mesh_count = 0, texture_count = 0, instance_count = 0, chunk_count = 0;
+    bool ok = fread(&version, sizeof(version), 1, file) == 1 && version == SCENE_VERSION &&
+              fread(&scene.chunk_size, sizeof(float), 1, file) == 1 &&
+              fread(&scene.stream_radius, sizeof(float), 1, file) == 1 &&
+              fread(&mesh_count, sizeof(uint32_t), 1, file) == 1 &&
+              fread(&texture_count, sizeof(uint32_t), 1, file) == 1 &&
+              fread(&instance_count, sizeof(uint32_t), 1, file) == 1 &&
+              fread(&chunk_count, sizeof(uint32_t), 1, file) == 1;
+
+    for (int l = 0; ok && l < SCENE_LIGHTS; l++)
+        ok = fread(&scene.lights[l].position[0], sizeof(float), 3, file) == 3 &&
+             fread(&scene.lights[l].direction[0], sizeof(float), 3, file) == 3;
+
+    scene.meshes.resize(ok ? mesh_count : 0);
+    for (uint32_t i = 0; ok && i < mesh_count; i++)
+    {
+        SSceneMesh &mesh = scene.meshes[i];
+        uint8_t flags = 0;
+        ok = fread(mesh.name, 1, SCENE_NAME_LENGTH, file) == SCENE_NAME_LENGTH &&
+             fread(mesh.path, 1, SCENE_PATH_LENGTH, file) == SCENE_PATH_LENGTH && fread(&flags, 1, 1, file) == 1;
+        mesh.occluder = (flags & 1) != 0;
+        mesh.solid = (flags & 2) != 0;
+        mesh.impostor = (flags & 4) != 0;
+        mesh.name[SCENE_NAME_LENGTH - 1] = mesh.path[SCENE_PATH_LENGTH - 1] = '\0';
+    }
+
+    scene.textures.resize(ok ? texture_count : 0);
+    for (uint32_t i = 0; ok && i < texture_count; i++)
+    {
+        SSceneTexture &texture = scene.textures[i];
+        uint8_t flags = 0;
+        ok = fread(texture.name, 1, SCENE_NAME_LENGTH, file) == SCENE_NAME_LENGTH &&
+             fread(texture.path, 1, SCENE_PATH_LENGTH, file) == SCENE_PATH_LENGTH && fread(&flags, 1, 1, file) == 1;
+        texture.mipmaps = (flags & 1) != 0;
+        texture.name[SCENE_NAME_LENGTH - 1] = texture.path[SCENE_PATH_LENGTH - 1] = '\0';
+    }
+
+    scene.instances.resize(ok ? instance_count : 0);
+    for (uint32_t i = 0; ok && i < instance_count; i++)
+    {
+        SSceneInstance &instance = scene.instances[i];
+        int32_t mesh = 0, texture = 0, chunk = 0;
+        ok = fread(&mesh, sizeof(int32_t), 1, file) == 1 && fread(&texture, sizeof(int32_t), 1, file) == 1 &&
+             fread(&instance.position[0], sizeof(float), 3, file) == 3 && fread(&instance.yaw, sizeof(float), 1, file) == 1 &&
+             fread(&instance.scale, sizeof(float), 1, file) == 1 && fread(&instance.flags, sizeof(uint32_t), 1, file) == 1 &&
+             fread(&chunk, sizeof(int32_t), 1, file) == 1 &&
+             mesh >= 0 && mesh < (int32_t) mesh_count && texture >= 0 && texture < (int32_t) texture_count &&
+             chunk >= -1 && chunk < (int32_t) chunk_count;
+        instance.mesh = mesh;
+        instance.texture = texture;
+        instance.chunk = chunk;
+    }
+
+    scene.chunks.resize(ok ? chunk_count : 0);
+    for (uint32_t i = 0; ok && i < chunk_count; i++)
+    {
+        SSceneChunk &chunk = scene.chunks[i];
+        int32_t values[4];
+        ok = fread(values, sizeof(int32_t), 4, file) == 4 && values[2] >= 0 && values[3] >= 0 &&
+             (uint32_t) values[2] + (uint32_t) values[3] <= instance_count;
+        chunk.x = values[0];
+        chunk.z = values[1];
+        chunk.first_instance = values[2];
+        chunk.instance_count = values[3];
+    }
+    return ok;
+}
+
+/* Loads a scene in either format, the compiled one is recognised by its magic */
+bool LoadScene(SScene &scene, const char *path)
+{
+    InitScene(scene);
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        printf("ERROR: Could not open scene %s\n", path);
+        return false;
+    }
+
+    char magic[4];
+    bool binary = fread(magic, 1, 4, file) == 4 && memcmp(magic, SCENE_MAGIC, 4) == 0;
+    bool ok;
+    if (binary)
+    {
+        ok = ReadSceneBinary(scene, file);
+        if (!ok)
+            printf("ERROR: %s is not a version %d compiled scene\n", path, SCENE_VERSION);
+    }
+    else
+    {
+        rewind(file);
+        ok = ParseSceneText(scene, file, path);
+        if (ok)
+            PartitionScene(scene);
+    }
+    fclose(file);
+
+    if (!ok)
+        return false;
+
+    printf("INFO: Scene - %s (%s): %d meshes, %d textures, %d instances in %d chunks of %.1f m\n", path,
+           binary ? "compiled" : "text", (int) scene.meshes.size(), (int) scene.textures.size(),
+           (int) scene.instances.size(), (int) scene.chunks.size(), scene.chunk_size);
+    return true;
+}
+
+/* Writes the compiled format: a header, the lights, then fixed size mesh, texture, instance and chunk
+ * records in host byte order. Instances are already partitioned, so loading it is a straight read. */
+bool SaveSceneBinary(const SScene &scene, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("ERROR: Could not write scene %s\n", path);
+        return false;
+    }
+
+    uint32_t version = SCENE_VERSION;
+    uint32_t counts[4] = { (uint32_t) scene.meshes.size(), (uint32_t) scene.textures.size(),
+                           (uint32_t) scene.instances.size(), (uint32_t) scene.chunks.size() };
+    fwrite(SCENE_MAGIC, 1, 4, file);
+    fwrite(&version, sizeof(version), 1, file);
+    fwrite(&scene.chunk_size, sizeof(float), 1, file);
+    fwrite(&scene.stream_radius, sizeof(float), 1, file);
+    fwrite(counts, sizeof(uint32_t), 4, file);
+
+    for (int l = 0; l < SCENE_LIGHTS; l++)
+    {
+        fwrite(&scene.lights[l].position[0], sizeof(float), 3, file);
+        fwrite(&scene.lights[l].direction[0], sizeof(float), 3, file);
+    }
+
+    // Names and paths are written at their full size, zero padded, so nothing of the stack is written out
+    for (size_t i = 0; i < scene.meshes.size(); i++)
+    {
+        const SSceneMesh &mesh = scene.meshes[i];
+        char name[SCENE_NAME_LENGTH] = { 0 }, path_field[SCENE_PATH_LENGTH] = { 0 };
+        memcpy(name, mesh.name, strnlen(mesh.name, SCENE_NAME_LENGTH - 1));
+        memcpy(path_field, mesh.path, strnlen(mesh.path, SCENE_PATH_LENGTH - 1));
+        uint8_t flags = (uint8_t) ((mesh.occluder ? 1 : 0) | (mesh.solid ? 2 : 0) | (mesh.impostor ? 4 : 0));
+        fwrite(name, 1, SCENE_NAME_LENGTH, file);
+        fwrite(path_field, 1, SCENE_PATH_LENGTH, file);
+        fwrite(&flags, 1, 1, file);
+    }
+
+    for (size_t i = 0; i < scene.textures.size(); i++)
+    {
+        const SSceneTexture &texture = scene.textures[i];
+        char name[SCENE_NAME_LENGTH] = { 0 }, path_field[SCENE_PATH_LENGTH] = { 0 };
+        memcpy(name, texture.name, strnlen(texture.name, SCENE_NAME_LENGTH - 1));
+        memcpy(path_field, texture.path, strnlen(texture.path, SCENE_PATH_LENGTH - 1));
+        uint8_t flags = texture.mipmaps ? 1 : 0;
+        fwrite(name, 1, SCENE_NAME_LENGTH, file);
+        fwrite(path_field, 1, SCENE_PATH_LENGTH, file);
+        fwrite(&flags, 1, 1, file);
+    }
+
+    for (size_t i = 0; i < scene.instances.size(); i++)
+    {
+        const SSceneInstance &instance = scene.instances[i];
+        int32_t mesh = instance.mesh, texture = instance.texture, chunk = instance.chunk;
+        fwrite(&mesh, sizeof(int32_t), 1, file);
+        fwrite(&texture, sizeof(int32_t), 1, file);
+        fwrite(&instance.position[0], sizeof(float), 3, file);
+        fwrite(&instance.yaw, sizeof(float), 1, file);
+        fwrite(&instance.scale, sizeof(float), 1, file);
+        fwrite(&instance.flags, sizeof(uint32_t), 1, file);
+        fwrite(&chunk, sizeof(int32_t), 1, file);
+    }
+
+    for (size_t i = 0; i < scene.chunks.size(); i++)
+    {
+        const SSceneChunk &chunk = scene.chunks[i];
+        int32_t values[4] = { chunk.x, chunk.z, chunk.first_instance, chunk.instance_count };
+        fwrite(values, sizeof(int32_t), 4, file);
+    }
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    if (!ok)
+    {
+        printf("ERROR: Could not write scene %s\n", path);
+        return false;
+    }
+
+    printf("INFO: Scene - Compiled %d instances in %d chunks to %s\n", (int) scene.instances.size(), (int) scene.chunks.size(), path);
+    return true;
+}
+
+/* Compiles a text scene into the binary format */
+int CompileScene(const char *text_path, const char *binary_path)
+{
+    SScene scene;
+    if (!LoadScene(scene, text_path))
+        return -1;
+    return SaveSceneBinary(scene, binary_path) ? 0 : -1;
+}
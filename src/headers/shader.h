@@ -14,10 +14,19 @@ unsigned int LoadShader(const char *vertexShaderFile, const char *fragmentShader
     int success;
     char infoLog[512];
 
+    // Read both sources before creating any GL objects, so a missing file leaves nothing behind
+    char *vertexShaderSource = read_file(vertexShaderFile);
+    char *fragmentShaderSource = read_file(fragmentShaderFile);
+    if (vertexShaderSource == NULL || fragmentShaderSource == NULL)
+    {
+        printf("ERROR: Shader Program <%s, %s> could not be read.\n", vertexShaderFile, fragmentShaderFile);
+        free(vertexShaderSource);
+        free(fragmentShaderSource);
+        return 0;
+    }
+
     // Create Vertex Shader Object and get its reference
     unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    // Read Vertex Shader file and store in Vertex Shader source
-    char *vertexShaderSource = read_file(vertexShaderFile);
     // Attach Vertex Shader source to the Vertex Shader Object
     glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
     // Compile the Vertex Shader into machine code
@@ -34,8 +43,6 @@ unsigned int LoadShader(const char *vertexShaderFile, const char *fragmentShader
 
     // Create Fragment Shader Object and get its reference
     unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    // Read Fragment Shader file and store in Fragment Shader source
-    char *fragmentShaderSource = read_file(fragmentShaderFile);
     // Attach Fragment Shader source to the Fragment Shader Object
     glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
     // Compile the Fragment Shader into machine code
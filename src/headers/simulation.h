@@ -0,0 +1,236 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <vector>
+
+/* ---- GLM Includes ---- */
+#ifdef _WIN32
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <glm/glm/gtc/quaternion.hpp>
+#endif
+
+#ifdef __unix
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#endif
+
+/* ---- Header Files ---- */
+#include "jobs.h"
+#include "mesh.h"
+#include "render_queue.h"
+#include "impostor.h"
+#include "transform.h"
+#include "animation.h"
+
+/* ---- Definitions ---- */
+// Cameras drawn in one frame, split screen and picture-in-picture use two
+#define MAX_FRAME_VIEWS 2
+
+struct SViewCamera
+{
+    glm::vec3 position;
+    glm::vec3 front;
+    glm::vec3 up;
+};
+
+// Camera and tree state at the end of a fixed timestep tick, the frame shows a blend of the last two ticks
+struct SViewState
+{
+    SViewCamera cameras[MAX_FRAME_VIEWS];
+    float tree_angle;
+};
+
+SViewState InterpolateViewState(const SViewState &previous, const SViewState &current, float alpha)
+{
+    SViewState state;
+    for (int v = 0; v < MAX_FRAME_VIEWS; v++)
+    {
+        state.cameras[v].position = glm::mix(previous.cameras[v].position, current.cameras[v].position, alpha);
+        state.cameras[v].front = glm::normalize(glm::mix(previous.cameras[v].front, current.cameras[v].front, alpha));
+        state.cameras[v].up = glm::normalize(glm::mix(previous.cameras[v].up, current.cameras[v].up, alpha));
+    }
+    state.tree_angle = glm::mix(previous.tree_angle, current.tree_angle, alpha);
+    return state;
+}
+
+// Everything the simulation needs from the main thread, copied once per frame so that
+// input callbacks can keep changing the globals while the jobs run
+struct SFrameInput
+{
+    // The cameras of the frame, each drawn into a viewport given as (x, y, width, height) fractions of the framebuffer
+    unsigned int view_count;
+    SViewCamera cameras[MAX_FRAME_VIEWS];
+    glm::vec4 viewports[MAX_FRAME_VIEWS];
+
+    // Width over height of the framebuffer the views are drawn into
+    float aspect;
+
+    glm::vec3 light_1_direction;
+    glm::vec3 light_1_position;
+    glm::vec3 light_2_direction;
+    glm::vec3 light_2_position;
+
+    float tree_angle;
+    float dt;
+};
+
+// One frame in flight. Two of these alternate: the jobs fill one while the main thread submits the other.
+struct SFrameState
+{
+    SFrameInput input;
+
+    glm::mat4 views[MAX_FRAME_VIEWS];
+    glm::mat4 projections[MAX_FRAME_VIEWS];
+    glm::mat4 view_projections[MAX_FRAME_VIEWS];
+
+    SRenderQueue queue;
+};
+
+// mesh is -1 while the object is hidden, impostor is -1 when it is always drawn in full
+struct SSceneObject
+{
+    unsigned int texture;
+    int mesh;
+    int node;
+    int impostor;
+};
+
+// Shared state of the simulation jobs, frame points at the frame state being built
+struct SSimulation
+{
+    SFrameState *frame;
+
+    STransformSystem *transforms;
+    SAnimationSystem *animation;
+    SCullingSystem *culling;
+    SOcclusionSystem *occlusion;
+    const SMeshRegistry *meshes;
+    unsigned int program;
+
+    // Stands in for the distant objects that have an impostor, NULL draws everything in full
+    const SImpostorSystem *impostors;
+
+    std::vector<SSceneObject> objects;
+
+    // Nodes turned about y by the input tree angle
+    std::vector<int> input_nodes;
+};
+
+void InitFrameState(SFrameState &frame)
+{
+    frame.input = SFrameInput();
+    frame.input.view_count = 1;
+    frame.input.aspect = 1.f;
+    for (int v = 0; v < MAX_FRAME_VIEWS; v++)
+    {
+        frame.views[v] = glm::mat4(1.f);
+        frame.projections[v] = glm::mat4(1.f);
+        frame.view_projections[v] = glm::mat4(1.f);
+    }
+    InitRenderQueue(frame.queue, .1f, 200.f);
+}
+
+/* ---- Simulation Jobs ---- */
+// Each job only touches the systems named in its graph stage, the graph edges keep them ordered
+
+void SimulateInputJob(void *data, int)
+{
+    SSimulation &sim = *(SSimulation *) data;
+    SFrameState &frame = *sim.frame;
+
+    for (unsigned int v = 0; v < frame.input.view_count; v++)
+    {
+        const SViewCamera &camera = frame.input.cameras[v];
+        const glm::vec4 &viewport = frame.input.viewports[v];
+
+        frame.views[v] = glm::lookAt(camera.position, camera.position + camera.front, camera.up);
+        frame.projections[v] = glm::perspective(glm::radians(45.f), frame.input.aspect * viewport.z / viewport.w, .1f, 200.f);
+        frame.view_projections[v] = frame.projections[v] * frame.views[v];
+    }
+}
+
+void SimulateAnimationJob(void *data, int)
+{
+    SSimulation &sim = *(SSimulation *) data;
+    UpdateAnimations(*sim.animation, *sim.transforms, sim.frame->input.dt);
+}
+
+void SimulateTransformsJob(void *data, int)
+{
+    SSimulation &sim = *(SSimulation *) data;
+
+    glm::quat rotation = glm::angleAxis(glm::radians(sim.frame->input.tree_angle), glm::vec3(0.0f, 1.0f, 0.0f));
+    for (size_t i = 0; i < sim.input_nodes.size(); i++)
+        SetTransformRotation(*sim.transforms, sim.input_nodes[i], rotation);
+
+    UpdateTransforms(*sim.transforms);
+}
+
+void BuildCommandsJob(void *data, int)
+{
+    SSimulation &sim = *(SSimulation *) data;
+    SFrameState &frame = *sim.frame;
+
+    // The commands are built once for every view, the first view decides the front-to-back order
+    // and which objects are far enough away to be drawn as impostors
+    BeginRenderQueue(frame.queue, frame.views[0]);
+    for (size_t i = 0; i < sim.objects.size(); i++)
+    {
+        const SSceneObject &object = sim.objects[i];
+        if (object.mesh < 0)
+            continue;   // an instance of a chunk that is not streamed in
+        const glm::mat4 &world = GetWorldMatrix(*sim.transforms, object.node);
+        if (object.impostor >= 0 && sim.impostors != NULL &&
+            PushImpostorDraw(frame.queue, *sim.impostors, *sim.meshes, object.impostor, world, frame.input.cameras[0].position))
+            continue;
+        const SMesh &mesh = sim.meshes->meshes[object.mesh];
+        PushDrawCommand(frame.queue, sim.program, object.texture, mesh.vao, mesh, world);
+    }
+}
+
+void FrustumCullJob(void *data, int)
+{
+    SSimulation &sim = *(SSimulation *) data;
+    CullRenderQueue(sim.frame->queue, *sim.culling, sim.frame->view_projections, sim.frame->input.view_count);
+}
+
+void OcclusionCullJob(void *data, int)
+{
+    SSimulation &sim = *(SSimulation *) data;
+    OcclusionCullRenderQueue(sim.frame->queue, *sim.culling, *sim.occlusion, sim.frame->view_projections[0]);
+}
+
+void SortCommandsJob(void *data, int)
+{
+    SSimulation &sim = *(SSimulation *) data;
+    SortRenderQueue(sim.frame->queue);
+}
+
+/* Builds the per frame task graph:
+ *   input ----------+
+ *                   +--> transforms --> commands --> frustum cull --> occlusion cull --> sort
+ *   animation ------+
+ * Input and animation touch disjoint state so they run side by side. Every view of the frame shares the
+ * transforms, commands, culling pass and sort, only the view matrices and the submission are per view. */
+void BuildSimulationGraph(SJobGraph &graph, SSimulation &sim)
+{
+    InitJobGraph(graph);
+
+    int input      = AddGraphJob(graph, "input", SimulateInputJob, &sim);
+    int animation  = AddGraphJob(graph, "animation", SimulateAnimationJob, &sim);
+    int transforms = AddGraphJob(graph, "transforms", SimulateTransformsJob, &sim);
+    int commands   = AddGraphJob(graph, "commands", BuildCommandsJob, &sim);
+    int frustum    = AddGraphJob(graph, "frustum cull", FrustumCullJob, &sim);
+    int occlusion  = AddGraphJob(graph, "occlusion cull", OcclusionCullJob, &sim);
+    int sort       = AddGraphJob(graph, "sort", SortCommandsJob, &sim);
+
+    AddGraphDependency(graph, input, transforms);
+    AddGraphDependency(graph, animation, transforms);
+    AddGraphDependency(graph, transforms, commands);
+    AddGraphDependency(graph, commands, frustum);
+    AddGraphDependency(graph, frustum, occlusion);
+    AddGraphDependency(graph, occlusion, sort);
+}
@@ -0,0 +1,1039 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+/* ---- SIMD Intrinsics ---- */
+// Edge functions and the depth test run 4 pixels at a time with SSE, without it the scalar path is used
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define SOFT_SIMD 1
+#else
+    #define SOFT_SIMD 0
+#endif
+
+/* ---- GLM Includes ---- */
+#ifdef _WIN32
+#include <glm/glm/glm.hpp>
+#endif
+
+#ifdef __unix
+#include <glm/glm.hpp>
+#endif
+
+/* ---- Header Files ---- */
+#include "bitmap.h"
+#include "mesh.h"
+#include "jobs.h"
+#include "memory.h"
+#include "profiler.h"
+#include "simulation.h"
+
+// A CPU implementation of the scene's vertex and fragment shaders. It reads the same mesh registry,
+// bitmaps and frame state as the GL path and never touches OpenGL, so it needs no context at all.
+
+/* ---- Definitions ---- */
+// Screen tiles, each one is rasterized and shaded by a single worker
+#define SOFT_TILE_W 64
+#define SOFT_TILE_H 32
+#define SOFT_TILE_PIXELS (SOFT_TILE_W * SOFT_TILE_H)
+
+// Triangle setup is split into this many chunks with their own bins. The count does not depend on the
+// number of workers, so the order of the triangles in every tile and with it the image never changes.
+#define SOFT_SETUP_CHUNKS 32
+
+// Vertices transformed by one job
+#define SOFT_VERTEX_BATCH 4096
+
+// Interpolated per vertex: texture (2), world position (3), normal (3), the outputs of vertex.vert
+#define SOFT_ATTRIBUTES 8
+
+// A visibility buffer entry is the setup chunk in the top 8 bits and the triangle within it below
+#define SOFT_CHUNK_SHIFT 24
+#define SOFT_NO_TRIANGLE 0xFFFFFFFFu
+
+// Constants of fragment.frag
+#define SOFT_AMBIENT 0.01f
+#define SOFT_SPOT_CUTOFF_DEGREES 15.f
+
+struct SSoftTexture
+{
+    int width;
+    int height;
+    bool filtered;  // bilinear for the mipmapped textures, nearest for the others
+    std::vector<unsigned char> texels;  // RGB, bottom row first like glTexImage2D
+};
+
+struct SSoftVertex
+{
+    glm::vec4 clip;
+    float attributes[SOFT_ATTRIBUTES];
+};
+
+// Triangle after projection, in pixels with depth in [0, 1]
+struct SSoftTriangle
+{
+    // Edge functions E(x, y) = A x + B y + C, scaled by the inverse area so that they are barycentrics
+    float A[3], B[3], C[3];
+
+    // Screen space plane of the depth, z(x, y) = dzdx x + dzdy y + zc
+    float dzdx, dzdy, zc;
+
+    // 1/w and the attributes divided by w at each corner, for perspective correct interpolation
+    float inv_w[3];
+    float attributes[3][SOFT_ATTRIBUTES];
+
+    int min_x, min_y, max_x, max_y;
+    int texture;
+};
+
+// A queued draw with the ranges it occupies in the per frame arrays
+struct SSoftDraw
+{
+    int first_vertex;
+    int vertex_count;
+    int first_triangle;
+    int triangle_count;
+    int first_index;
+    int base_vertex;
+    int texture;
+    glm::mat4 model;
+};
+
+struct SSoftVertexBatch
+{
+    int draw;
+    int first;
+    int count;
+};
+
+// Triangles set up by one chunk and, per tile, the indices of those that touch it
+struct SSoftSetupChunk
+{
+    std::vector<SSoftTriangle> triangles;
+    std::vector<std::vector<unsigned int> > bins;
+};
+
+struct SSoftStats
+{
+    unsigned int draws;
+    unsigned int vertices;
+    unsigned int triangles;
+    unsigned int setup_triangles;   // after rejection and near plane clipping
+    unsigned int binned;            // tile bin entries
+    unsigned int pixels;            // covered pixels, each is shaded once
+
+    float vertex_ms;
+    float setup_ms;
+    float raster_ms;
+    float total_ms;
+};
+
+struct SSoftRenderer
+{
+    int width;
+    int height;
+    int tiles_x;
+    int tiles_y;
+
+    // RGB, top row first
+    std::vector<unsigned char> color;
+    unsigned char clear_color[3];
+
+    std::vector<SSoftTexture> textures;
+
+    // Stages run on these workers
+    SJobSystem *jobs;
+
+    // Per frame input
+    const SMeshRegistry *meshes;
+    glm::mat4 view_projection;
+    glm::vec3 camera_position;
+    glm::vec3 spot_position;
+    glm::vec3 spot_direction;   // normalized, pointing away from the light
+    float spot_cutoff;          // cosine of the cut off angle
+    glm::vec3 point_position;
+
+    std::vector<SSoftDraw> draws;
+    std::vector<SSoftVertexBatch> vertex_batches;
+    std::vector<SSoftVertex> vertices;
+    int triangle_count;
+    SSoftSetupChunk chunks[SOFT_SETUP_CHUNKS];
+
+    std::atomic<int> next_tile;
+    std::atomic<unsigned int> pixels;
+
+    SSoftStats stats;
+    SSoftStats totals;
+    unsigned int frames;
+};
+
+void InitSoftwareRenderer(SSoftRenderer &soft, int width, int height)
+{
+    soft.width = width;
+    soft.height = height;
+    soft.tiles_x = (width + SOFT_TILE_W - 1) / SOFT_TILE_W;
+    soft.tiles_y = (height + SOFT_TILE_H - 1) / SOFT_TILE_H;
+    soft.color.assign((size_t) width * height * 3, 0);
+    TrackMemory(memory_tracker, "software framebuffer", MEMORY_RENDER_TARGETS, MEMORY_HOST, &soft.color, soft.color.size());
+    soft.jobs = NULL;
+    soft.meshes = NULL;
+    soft.triangle_count = 0;
+
+    for (int c = 0; c < SOFT_SETUP_CHUNKS; c++)
+        soft.chunks[c].bins.resize((size_t) soft.tiles_x * soft.tiles_y);
+
+    // Background color of the GL path
+    soft.clear_color[0] = (unsigned char) (0.05f * 255.f + 0.5f);
+    soft.clear_color[1] = (unsigned char) (0.15f * 255.f + 0.5f);
+    soft.clear_color[2] = (unsigned char) (0.5f * 255.f + 0.5f);
+
+    soft.next_tile = 0;
+    soft.pixels = 0;
+
+    memset(&soft.stats, 0, sizeof(SSoftStats));
+    memset(&soft.totals, 0, sizeof(SSoftStats));
+    soft.frames = 0;
+
+    printf("INFO: Software Renderer - %dx%d, %dx%d tiles of %dx%d pixels, %s edge functions\n",
+           width, height, soft.tiles_x, soft.tiles_y, SOFT_TILE_W, SOFT_TILE_H, SOFT_SIMD ? "SSE" : "scalar");
+}
+
+/* Loads a bitmap for the software renderer and returns its id, 0 is never used so it can stand in
+ * for a GL texture name in the draw commands */
+unsigned int LoadSoftwareTexture(SSoftRenderer &soft, const char *filename, bool filtered)
+{
+    unsigned char *pxls = NULL;
+    BITMAPINFOHEADER info;
+    BITMAPFILEHEADER file;
+    loadbitmap(filename, pxls, &info, &file);
+
+    SSoftTexture texture;
+    texture.width = 0;
+    texture.height = 0;
+    texture.filtered = filtered;
+
+    if (pxls != NULL)
+    {
+        texture.width = info.biWidth;
+        texture.height = info.biHeight;
+        texture.texels.assign(pxls, pxls + (size_t) info.biWidth * info.biHeight * 3);
+    }
+    delete[] pxls;
+
+    TrackMemory(memory_tracker, filename, MEMORY_TEXTURES, MEMORY_HOST, &soft.textures, texture.texels.size());
+    soft.textures.push_back(texture);
+    return (unsigned int) soft.textures.size();
+}
+
+/* Frees the textures and the per frame buffers */
+void DeleteSoftwareRenderer(SSoftRenderer &soft)
+{
+    std::vector<SSoftTexture>().swap(soft.textures);
+    ReleaseMemory(memory_tracker, &soft.textures, MEMORY_TEXTURES);
+
+    std::vector<unsigned char>().swap(soft.color);
+    ReleaseMemory(memory_tracker, &soft.color, MEMORY_RENDER_TARGETS);
+
+    std::vector<SSoftDraw>().swap(soft.draws);
+    std::vector<SSoftVertexBatch>().swap(soft.vertex_batches);
+    std::vector<SSoftVertex>().swap(soft.vertices);
+}
+
+/* GL_REPEAT of a texel coordinate */
+inline int SoftWrap(int i, int size)
+{
+    i %= size;
+    return i < 0 ? i + size : i;
+}
+
+inline glm::vec3 SoftTexel(const SSoftTexture &texture, int x, int y)
+{
+    const unsigned char *t = texture.texels.data() + ((size_t) y * texture.width + x) * 3;
+    return glm::vec3((float) t[0], (float) t[1], (float) t[2]) * (1.f / 255.f);
+}
+
+glm::vec3 SampleSoftTexture(const SSoftRenderer &soft, int id, float u, float v)
+{
+    // An incomplete GL texture samples as black
+    if (id <= 0 || id > (int) soft.textures.size())
+        return glm::vec3(0.f);
+    const SSoftTexture &texture = soft.textures[id - 1];
+    if (texture.texels.empty())
+        return glm::vec3(0.f);
+
+    float x = u * (float) texture.width;
+    float y = v * (float) texture.height;
+
+    if (!texture.filtered)
+        return SoftTexel(texture, SoftWrap((int) floorf(x), texture.width), SoftWrap((int) floorf(y), texture.height));
+
+    x -= 0.5f;
+    y -= 0.5f;
+    float fx = floorf(x);
+    float fy = floorf(y);
+    float tx = x - fx;
+    float ty = y - fy;
+
+    int x0 = SoftWrap((int) fx, texture.width);
+    int y0 = SoftWrap((int) fy, texture.height);
+    int x1 = x0 + 1 < texture.width ? x0 + 1 : 0;
+    int y1 = y0 + 1 < texture.height ? y0 + 1 : 0;
+
+    glm::vec3 bottom = SoftTexel(texture, x0, y0) * (1.f - tx) + SoftTexel(texture, x1, y0) * tx;
+    glm::vec3 top = SoftTexel(texture, x0, y1) * (1.f - tx) + SoftTexel(texture, x1, y1) * tx;
+    return bottom * (1.f - ty) + top * ty;
+}
+
+/* Transforms one batch of vertices, the work of vertex.vert */
+void TransformSoftVertices(SSoftRenderer &soft, const SSoftVertexBatch &batch)
+{
+    const SSoftDraw &draw = soft.draws[batch.draw];
+    glm::mat4 mvp = soft.view_projection * draw.model;
+    glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(draw.model)));
+
+    const float *source = soft.meshes->vertices.data() + (size_t) (draw.base_vertex + batch.first) * MESH_VERTEX_FLOATS;
+    SSoftVertex *out = soft.vertices.data() + draw.first_vertex + batch.first;
+
+    for (int i = 0; i < batch.count; i++, source += MESH_VERTEX_FLOATS, out++)
+    {
+        glm::vec4 position(source[0], source[1], source[2], 1.f);
+        glm::vec4 world = draw.model * position;
+        glm::vec3 normal = normal_matrix * glm::vec3(source[5], source[6], source[7]);
+
+        out->clip = mvp * position;
+        out->attributes[0] = source[3];
+        out->attributes[1] = source[4];
+        out->attributes[2] = world.x;
+        out->attributes[3] = world.y;
+        out->attributes[4] = world.z;
+        out->attributes[5] = normal.x;
+        out->attributes[6] = normal.y;
+        out->attributes[7] = normal.z;
+    }
+}
+
+void TransformSoftVerticesJob(void *data, int index)
+{
+    PROFILE_SCOPE("soft vertices");
+    SSoftRenderer &soft = *(SSoftRenderer *) data;
+    TransformSoftVertices(soft, soft.vertex_batches[index]);
+}
+
+inline SSoftVertex LerpSoftVertex(const SSoftVertex &a, const SSoftVertex &b, float t)
+{
+    SSoftVertex v;
+    v.clip = a.clip + (b.clip - a.clip) * t;
+    for (int k = 0; k < SOFT_ATTRIBUTES; k++)
+        v.attributes[k] = a.attributes[k] + (b.attributes[k] - a.attributes[k]) * t;
+    return v;
+}
+
+/* Clips a triangle against the near plane (z >= -w) like ClipNearPlane, carrying the attributes along */
+int ClipSoftTriangle(const SSoftVertex *in[3], SSoftVertex out[6])
+{
+    SSoftVertex polygon[4];
+    int n = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        const SSoftVertex &a = *in[i];
+        const SSoftVertex &b = *in[(i + 1) % 3];
+        float da = a.clip.z + a.clip.w;
+        float db = b.clip.z + b.clip.w;
+
+        if (da >= 0.f)
+            polygon[n++] = a;
+        if ((da >= 0.f) != (db >= 0.f))
+            polygon[n++] = LerpSoftVertex(a, b, da / (da - db));
+    }
+
+    if (n < 3)
+        return 0;
+
+    out[0] = polygon[0];
+    out[1] = polygon[1];
+    out[2] = polygon[2];
+    if (n == 3)
+        return 1;
+
+    out[3] = polygon[0];
+    out[4] = polygon[2];
+    out[5] = polygon[3];
+    return 2;
+}
+
+/* Projects a triangle to pixels and bins it if its bounds touch the screen */
+void SetupSoftTriangle(SSoftRenderer &soft, SSoftSetupChunk &chunk, const SSoftVertex *v[3], int texture)
+{
+    float x[3], y[3], z[3], inv_w[3];
+    for (int i = 0; i < 3; i++)
+    {
+        inv_w[i] = 1.f / v[i]->clip.w;
+        x[i] = (v[i]->clip.x * inv_w[i] * 0.5f + 0.5f) * (float) soft.width;
+        y[i] = (0.5f - v[i]->clip.y * inv_w[i] * 0.5f) * (float) soft.height;
+        z[i] = v[i]->clip.z * inv_w[i] * 0.5f + 0.5f;
+    }
+
+    // Face culling is off in the GL path, so both windings are drawn: the corners are reordered to
+    // make the edge functions positive inside
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (area == 0.f)
+        return;
+
+    int order[3] = { 0, 1, 2 };
+    if (area < 0.f)
+    {
+        order[1] = 2;
+        order[2] = 1;
+        area = -area;
+    }
+
+    float min_x = fminf(x[0], fminf(x[1], x[2]));
+    float max_x = fmaxf(x[0], fmaxf(x[1], x[2]));
+    float min_y = fminf(y[0], fminf(y[1], y[2]));
+    float max_y = fmaxf(y[0], fmaxf(y[1], y[2]));
+
+    if (max_x < 0.f || max_y < 0.f || min_x >= (float) soft.width || min_y >= (float) soft.height)
+        return;
+
+    SSoftTriangle tri;
+    tri.min_x = std::max(0, (int) floorf(min_x));
+    tri.min_y = std::max(0, (int) floorf(min_y));
+    tri.max_x = std::min(soft.width - 1, (int) ceilf(max_x));
+    tri.max_y = std::min(soft.height - 1, (int) ceilf(max_y));
+    tri.texture = texture;
+
+    float inv_area = 1.f / area;
+    for (int e = 0; e < 3; e++)
+    {
+        int a = order[e], c = order[(e + 1) % 3];
+        tri.A[e] = -(y[c] - y[a]) * inv_area;
+        tri.B[e] = (x[c] - x[a]) * inv_area;
+        tri.C[e] = -(tri.A[e] * x[a] + tri.B[e] * y[a]);
+    }
+
+    // Edge e is zero along corner e to e + 1, so it is the barycentric of corner e + 2
+    tri.dzdx = tri.dzdy = tri.zc = 0.f;
+    for (int i = 0; i < 3; i++)
+    {
+        int e = (i + 1) % 3;
+        float zi = z[order[i]];
+        tri.dzdx += tri.A[e] * zi;
+        tri.dzdy += tri.B[e] * zi;
+        tri.zc += tri.C[e] * zi;
+
+        tri.inv_w[i] = inv_w[order[i]];
+        for (int k = 0; k < SOFT_ATTRIBUTES; k++)
+            tri.attributes[i][k] = v[order[i]]->attributes[k] * inv_w[order[i]];
+    }
+
+    unsigned int index = (unsigned int) chunk.triangles.size();
+    chunk.triangles.push_back(tri);
+
+    for (int ty = tri.min_y / SOFT_TILE_H; ty <= tri.max_y / SOFT_TILE_H; ty++)
+        for (int tx = tri.min_x / SOFT_TILE_W; tx <= tri.max_x / SOFT_TILE_W; tx++)
+            chunk.bins[ty * soft.tiles_x + tx].push_back(index);
+}
+
+/* Rejects, clips and bins one chunk of the frame's triangles */
+void SetupSoftChunk(SSoftRenderer &soft, int index)
+{
+    SSoftSetupChunk &chunk = soft.chunks[index];
+    chunk.triangles.clear();
+    for (size_t b = 0; b < chunk.bins.size(); b++)
+        chunk.bins[b].clear();
+
+    int begin = (int) ((long long) soft.triangle_count * index / SOFT_SETUP_CHUNKS);
+    int end = (int) ((long long) soft.triangle_count * (index + 1) / SOFT_SETUP_CHUNKS);
+
+    const unsigned int *indices = soft.meshes->indices.data();
+
+    size_t d = 0;
+    while (d + 1 < soft.draws.size() && soft.draws[d + 1].first_triangle <= begin)
+        d++;
+
+    for (int t = begin; t < end; t++)
+    {
+        while (t >= soft.draws[d].first_triangle + soft.draws[d].triangle_count)
+            d++;
+        const SSoftDraw &draw = soft.draws[d];
+
+        const unsigned int *corner = indices + draw.first_index + (size_t) (t - draw.first_triangle) * 3;
+        const SSoftVertex *v[3];
+        for (int k = 0; k < 3; k++)
+            v[k] = &soft.vertices[draw.first_vertex + corner[k]];
+
+        // Trivially reject triangles outside one of the side planes or the far plane
+        bool outside = false;
+        for (int axis = 0; axis < 2 && !outside; axis++)
+        {
+            outside = (v[0]->clip[axis] > v[0]->clip.w && v[1]->clip[axis] > v[1]->clip.w && v[2]->clip[axis] > v[2]->clip.w) ||
+                      (v[0]->clip[axis] < -v[0]->clip.w && v[1]->clip[axis] < -v[1]->clip.w && v[2]->clip[axis] < -v[2]->clip.w);
+        }
+        if (outside || (v[0]->clip.z > v[0]->clip.w && v[1]->clip.z > v[1]->clip.w && v[2]->clip.z > v[2]->clip.w))
+            continue;
+
+        if (v[0]->clip.z + v[0]->clip.w >= 0.f && v[1]->clip.z + v[1]->clip.w >= 0.f && v[2]->clip.z + v[2]->clip.w >= 0.f)
+        {
+            SetupSoftTriangle(soft, chunk, v, draw.texture);
+            continue;
+        }
+
+        SSoftVertex clipped[6];
+        int count = ClipSoftTriangle(v, clipped);
+        for (int i = 0; i < count; i++)
+        {
+            const SSoftVertex *c[3] = { &clipped[i * 3], &clipped[i * 3 + 1], &clipped[i * 3 + 2] };
+            SetupSoftTriangle(soft, chunk, c, draw.texture);
+        }
+    }
+}
+
+void SetupSoftChunkJob(void *data, int index)
+{
+    PROFILE_SCOPE("soft setup");
+    SetupSoftChunk(*(SSoftRenderer *) data, index);
+}
+
+/* Depth tests every triangle binned to a tile, leaving the nearest triangle of each pixel in ids */
+void RasterizeSoftTile(const SSoftRenderer &soft, int tile, float *depth, unsigned int *ids)
+{
+    for (int i = 0; i < SOFT_TILE_PIXELS; i++)
+    {
+        depth[i] = 1.f;
+        ids[i] = SOFT_NO_TRIANGLE;
+    }
+
+    int tile_x0 = (tile % soft.tiles_x) * SOFT_TILE_W;
+    int tile_y0 = (tile / soft.tiles_x) * SOFT_TILE_H;
+
+    // Chunks in order, and triangles in order within each, so that ties resolve as in the draw order
+    for (int c = 0; c < SOFT_SETUP_CHUNKS; c++)
+    {
+        const SSoftSetupChunk &chunk = soft.chunks[c];
+        const std::vector<unsigned int> &bin = chunk.bins[tile];
+
+        for (size_t b = 0; b < bin.size(); b++)
+        {
+            const SSoftTriangle &tri = chunk.triangles[bin[b]];
+            unsigned int id = ((unsigned int) c << SOFT_CHUNK_SHIFT) | bin[b];
+
+            int x0 = std::max(tri.min_x, tile_x0);
+            int x1 = std::min(tri.max_x, tile_x0 + SOFT_TILE_W - 1);
+            int y0 = std::max(tri.min_y, tile_y0);
+            int y1 = std::min(tri.max_y, tile_y0 + SOFT_TILE_H - 1);
+            if (x0 > x1 || y0 > y1)
+                continue;
+
+#if SOFT_SIMD
+            // Align the span to the 4 pixel groups of the tile
+            x0 = tile_x0 + ((x0 - tile_x0) & ~3);
+
+            __m128 lane = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            __m128 zero = _mm_setzero_ps();
+            __m128i id4 = _mm_set1_epi32((int) id);
+
+            for (int y = y0; y <= y1; y++)
+            {
+                float py = (float) y + 0.5f;
+                float *depth_row = depth + (y - tile_y0) * SOFT_TILE_W - tile_x0;
+                unsigned int *id_row = ids + (y - tile_y0) * SOFT_TILE_W - tile_x0;
+
+                __m128 row0 = _mm_set1_ps(tri.B[0] * py + tri.C[0]);
+                __m128 row1 = _mm_set1_ps(tri.B[1] * py + tri.C[1]);
+                __m128 row2 = _mm_set1_ps(tri.B[2] * py + tri.C[2]);
+                __m128 rowz = _mm_set1_ps(tri.dzdy * py + tri.zc);
+
+                for (int x = x0; x <= x1; x += 4)
+                {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float) x), lane);
+
+                    __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.A[0]), px), row0);
+                    __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.A[1]), px), row1);
+                    __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.A[2]), px), row2);
+
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                    if (_mm_movemask_ps(inside) == 0)
+                        continue;
+
+                    __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.dzdx), px), rowz);
+                    __m128 d = _mm_loadu_ps(depth_row + x);
+                    __m128 closer = _mm_and_ps(inside, _mm_cmplt_ps(z, d));
+                    if (_mm_movemask_ps(closer) == 0)
+                        continue;
+
+                    _mm_storeu_ps(depth_row + x, _mm_or_ps(_mm_and_ps(closer, z), _mm_andnot_ps(closer, d)));
+
+                    __m128i mask = _mm_castps_si128(closer);
+                    __m128i old = _mm_loadu_si128((const __m128i *) (id_row + x));
+                    _mm_storeu_si128((__m128i *) (id_row + x), _mm_or_si128(_mm_and_si128(mask, id4), _mm_andnot_si128(mask, old)));
+                }
+            }
+#else
+            for (int y = y0; y <= y1; y++)
+            {
+                float py = (float) y + 0.5f;
+                float *depth_row = depth + (y - tile_y0) * SOFT_TILE_W - tile_x0;
+                unsigned int *id_row = ids + (y - tile_y0) * SOFT_TILE_W - tile_x0;
+
+                for (int x = x0; x <= x1; x++)
+                {
+                    float px = (float) x + 0.5f;
+                    if (tri.A[0] * px + tri.B[0] * py + tri.C[0] < 0.f || tri.A[1] * px + tri.B[1] * py + tri.C[1] < 0.f ||
+                        tri.A[2] * px + tri.B[2] * py + tri.C[2] < 0.f)
+                        continue;
+
+                    float z = tri.dzdx * px + tri.dzdy * py + tri.zc;
+                    if (z < depth_row[x])
+                    {
+                        depth_row[x] = z;
+                        id_row[x] = id;
+                    }
+                }
+            }
+#endif
+        }
+    }
+}
+
+inline float SoftAttenuation(float distance)
+{
+    return 1.f / (1.5f + 0.05f * distance + 0.02f * distance * distance);
+}
+
+/* Perspective correct attributes of a triangle at a pixel centre, stored stride floats apart */
+inline void InterpolateSoftAttributes(const SSoftTriangle &tri, float px, float py, float *a, int stride)
+{
+    float b[3];
+    for (int e = 0; e < 3; e++)
+        b[(e + 2) % 3] = tri.A[e] * px + tri.B[e] * py + tri.C[e];
+
+    float w = 1.f / (b[0] * tri.inv_w[0] + b[1] * tri.inv_w[1] + b[2] * tri.inv_w[2]);
+    for (int k = 0; k < SOFT_ATTRIBUTES; k++)
+        a[k * stride] = (b[0] * tri.attributes[0][k] + b[1] * tri.attributes[1][k] + b[2] * tri.attributes[2][k]) * w;
+}
+
+inline unsigned char SoftUnorm8(float c)
+{
+    return (unsigned char) (std::min(std::max(c, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+/* The lighting of fragment.frag for one pixel centre of a triangle, written to out as RGB8 */
+void ShadeSoftPixel(const SSoftRenderer &soft, const SSoftTriangle &tri, float px, float py, unsigned char *out)
+{
+    float a[SOFT_ATTRIBUTES];
+    InterpolateSoftAttributes(tri, px, py, a, 1);
+
+    glm::vec3 position(a[2], a[3], a[4]);
+    glm::vec3 normal = glm::normalize(glm::vec3(a[5], a[6], a[7]));
+    glm::vec3 to_camera = glm::normalize(soft.camera_position - position);
+
+    // Spot light, shininess 16
+    glm::vec3 to_light = soft.spot_position - position;
+    float distance = glm::length(to_light);
+    to_light = to_light / distance;
+    float n_dot_l = glm::dot(normal, to_light);
+    float attenuation = SoftAttenuation(distance);
+    float spot = SOFT_AMBIENT * attenuation;
+    if (glm::dot(to_light, -soft.spot_direction) > soft.spot_cutoff)
+    {
+        // reflect(-L, N) = 2 (N.L) N - L
+        float r = std::max(glm::dot(to_camera, normal * (2.f * n_dot_l) - to_light), 0.f);
+        float r2 = r * r, r4 = r2 * r2, r8 = r4 * r4;
+        spot = (SOFT_AMBIENT + std::max(n_dot_l, 0.f) + r8 * r8) * attenuation;
+    }
+
+    // Positional light, shininess 64
+    to_light = soft.point_position - position;
+    distance = glm::length(to_light);
+    to_light = to_light / distance;
+    n_dot_l = glm::dot(normal, to_light);
+    float r = std::max(glm::dot(to_camera, normal * (2.f * n_dot_l) - to_light), 0.f);
+    float r2 = r * r, r4 = r2 * r2, r8 = r4 * r4, r16 = r8 * r8, r32 = r16 * r16;
+    float point = (SOFT_AMBIENT + std::max(n_dot_l, 0.f) + r32 * r32) * SoftAttenuation(distance);
+
+    glm::vec3 color = SampleSoftTexture(soft, tri.texture, a[0], a[1]) * (spot + point);
+    out[0] = SoftUnorm8(color.x);
+    out[1] = SoftUnorm8(color.y);
+    out[2] = SoftUnorm8(color.z);
+}
+
+#if SOFT_SIMD
+inline __m128 SoftDot4(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+}
+
+/* Lighting of ShadeSoftPixel for 4 pixels, a holds each attribute for the 4 lanes */
+__m128 LightSoftQuad(const SSoftRenderer &soft, const float a[SOFT_ATTRIBUTES][4])
+{
+    __m128 one = _mm_set1_ps(1.f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 ambient = _mm_set1_ps(SOFT_AMBIENT);
+
+    __m128 px = _mm_load_ps(a[2]), py = _mm_load_ps(a[3]), pz = _mm_load_ps(a[4]);
+    __m128 nx = _mm_load_ps(a[5]), ny = _mm_load_ps(a[6]), nz = _mm_load_ps(a[7]);
+
+    __m128 scale = _mm_div_ps(one, _mm_sqrt_ps(SoftDot4(nx, ny, nz, nx, ny, nz)));
+    nx = _mm_mul_ps(nx, scale);
+    ny = _mm_mul_ps(ny, scale);
+    nz = _mm_mul_ps(nz, scale);
+
+    __m128 cx = _mm_sub_ps(_mm_set1_ps(soft.camera_position.x), px);
+    __m128 cy = _mm_sub_ps(_mm_set1_ps(soft.camera_position.y), py);
+    __m128 cz = _mm_sub_ps(_mm_set1_ps(soft.camera_position.z), pz);
+    scale = _mm_div_ps(one, _mm_sqrt_ps(SoftDot4(cx, cy, cz, cx, cy, cz)));
+    cx = _mm_mul_ps(cx, scale);
+    cy = _mm_mul_ps(cy, scale);
+    cz = _mm_mul_ps(cz, scale);
+
+    // Light 0 is the spot light with shininess 16, light 1 the positional light with shininess 64
+    __m128 result = zero;
+    for (int light = 0; light < 2; light++)
+    {
+        const glm::vec3 &position = light == 0 ? soft.spot_position : soft.point_position;
+        __m128 lx = _mm_sub_ps(_mm_set1_ps(position.x), px);
+        __m128 ly = _mm_sub_ps(_mm_set1_ps(position.y), py);
+        __m128 lz = _mm_sub_ps(_mm_set1_ps(position.z), pz);
+        __m128 distance = _mm_sqrt_ps(SoftDot4(lx, ly, lz, lx, ly, lz));
+        scale = _mm_div_ps(one, distance);
+        lx = _mm_mul_ps(lx, scale);
+        ly = _mm_mul_ps(ly, scale);
+        lz = _mm_mul_ps(lz, scale);
+
+        __m128 attenuation = _mm_div_ps(one, _mm_add_ps(_mm_set1_ps(1.5f), _mm_mul_ps(distance,
+                _mm_add_ps(_mm_set1_ps(0.05f), _mm_mul_ps(_mm_set1_ps(0.02f), distance)))));
+
+        // reflect(-L, N) = 2 (N.L) N - L
+        __m128 n_dot_l = SoftDot4(nx, ny, nz, lx, ly, lz);
+        __m128 twice = _mm_add_ps(n_dot_l, n_dot_l);
+        __m128 r = _mm_max_ps(SoftDot4(cx, cy, cz, _mm_sub_ps(_mm_mul_ps(nx, twice), lx),
+                _mm_sub_ps(_mm_mul_ps(ny, twice), ly), _mm_sub_ps(_mm_mul_ps(nz, twice), lz)), zero);
+        r = _mm_mul_ps(r, r);
+        r = _mm_mul_ps(r, r);
+        r = _mm_mul_ps(r, r);
+        r = _mm_mul_ps(r, r);
+        if (light == 1)
+        {
+            r = _mm_mul_ps(r, r);
+            r = _mm_mul_ps(r, r);
+        }
+
+        __m128 lit = _mm_mul_ps(_mm_add_ps(_mm_add_ps(ambient, _mm_max_ps(n_dot_l, zero)), r), attenuation);
+        if (light == 0)
+        {
+            // Outside the cone only the ambient term is left
+            __m128 theta = _mm_sub_ps(zero, SoftDot4(lx, ly, lz, _mm_set1_ps(soft.spot_direction.x),
+                    _mm_set1_ps(soft.spot_direction.y), _mm_set1_ps(soft.spot_direction.z)));
+            __m128 inside = _mm_cmpgt_ps(theta, _mm_set1_ps(soft.spot_cutoff));
+            lit = _mm_or_ps(_mm_and_ps(inside, lit), _mm_andnot_ps(inside, _mm_mul_ps(ambient, attenuation)));
+        }
+        result = _mm_add_ps(result, lit);
+    }
+    return result;
+}
+#endif
+
+/* Shades each pixel of a tile once, with the triangle the depth test left there */
+unsigned int ShadeSoftTile(SSoftRenderer &soft, int tile, const unsigned int *ids)
+{
+    int tile_x0 = (tile % soft.tiles_x) * SOFT_TILE_W;
+    int tile_y0 = (tile / soft.tiles_x) * SOFT_TILE_H;
+    int tile_w = std::min(SOFT_TILE_W, soft.width - tile_x0);
+    int tile_h = std::min(SOFT_TILE_H, soft.height - tile_y0);
+
+    unsigned int shaded = 0;
+#if SOFT_SIMD
+    // Groups of 4 pixels in a row are lit together, whichever triangles they belong to
+    alignas(16) float a[SOFT_ATTRIBUTES][4];
+    alignas(16) float light[4];
+
+    for (int y = 0; y < tile_h; y++)
+    {
+        unsigned char *row = soft.color.data() + ((size_t) (tile_y0 + y) * soft.width + tile_x0) * 3;
+        const unsigned int *id_row = ids + y * SOFT_TILE_W;
+        float py = (float) (tile_y0 + y) + 0.5f;
+
+        for (int x = 0; x < tile_w; x += 4)
+        {
+            int lanes = std::min(4, tile_w - x);
+            int covered = -1;
+            for (int i = 0; i < lanes; i++)
+            {
+                unsigned int id = id_row[x + i];
+                if (id == SOFT_NO_TRIANGLE)
+                    continue;
+
+                const SSoftTriangle &tri = soft.chunks[id >> SOFT_CHUNK_SHIFT].triangles[id & ((1u << SOFT_CHUNK_SHIFT) - 1u)];
+                InterpolateSoftAttributes(tri, (float) (tile_x0 + x + i) + 0.5f, py, &a[0][i], 4);
+                covered = i;
+            }
+
+            // Lanes without a triangle borrow a covered lane's attributes so the math stays finite
+            if (covered >= 0)
+            {
+                for (int i = 0; i < 4; i++)
+                    if (i >= lanes || id_row[x + i] == SOFT_NO_TRIANGLE)
+                        for (int k = 0; k < SOFT_ATTRIBUTES; k++)
+                            a[k][i] = a[k][covered];
+                _mm_store_ps(light, LightSoftQuad(soft, a));
+            }
+
+            for (int i = 0; i < lanes; i++)
+            {
+                unsigned char *out = row + (x + i) * 3;
+                unsigned int id = id_row[x + i];
+                if (id == SOFT_NO_TRIANGLE)
+                {
+                    out[0] = soft.clear_color[0];
+                    out[1] = soft.clear_color[1];
+                    out[2] = soft.clear_color[2];
+                    continue;
+                }
+
+                const SSoftTriangle &tri = soft.chunks[id >> SOFT_CHUNK_SHIFT].triangles[id & ((1u << SOFT_CHUNK_SHIFT) - 1u)];
+                glm::vec3 color = SampleSoftTexture(soft, tri.texture, a[0][i], a[1][i]) * light[i];
+                out[0] = SoftUnorm8(color.x);
+                out[1] = SoftUnorm8(color.y);
+                out[2] = SoftUnorm8(color.z);
+                shaded++;
+            }
+        }
+    }
+#else
+    for (int y = 0; y < tile_h; y++)
+    {
+        unsigned char *out = soft.color.data() + ((size_t) (tile_y0 + y) * soft.width + tile_x0) * 3;
+        const unsigned int *id_row = ids + y * SOFT_TILE_W;
+
+        for (int x = 0; x < tile_w; x++, out += 3)
+        {
+            unsigned int id = id_row[x];
+            if (id == SOFT_NO_TRIANGLE)
+            {
+                out[0] = soft.clear_color[0];
+                out[1] = soft.clear_color[1];
+                out[2] = soft.clear_color[2];
+                continue;
+            }
+
+            const SSoftTriangle &tri = soft.chunks[id >> SOFT_CHUNK_SHIFT].triangles[id & ((1u << SOFT_CHUNK_SHIFT) - 1u)];
+            ShadeSoftPixel(soft, tri, (float) (tile_x0 + x) + 0.5f, (float) (tile_y0 + y) + 0.5f, out);
+            shaded++;
+        }
+    }
+#endif
+    return shaded;
+}
+
+/* Takes tiles from the shared counter until there are none left */
+void RenderSoftTilesJob(void *data, int)
+{
+    PROFILE_SCOPE("soft tiles");
+    SSoftRenderer &soft = *(SSoftRenderer *) data;
+
+    // Visibility buffer of the tile being worked on, small enough to stay in the worker's cache
+    alignas(16) float depth[SOFT_TILE_PIXELS];
+    alignas(16) unsigned int ids[SOFT_TILE_PIXELS];
+
+    unsigned int shaded = 0;
+    while (true)
+    {
+        int tile = soft.next_tile.fetch_add(1);
+        if (tile >= soft.tiles_x * soft.tiles_y)
+            break;
+
+        RasterizeSoftTile(soft, tile, depth, ids);
+        shaded += ShadeSoftTile(soft, tile, ids);
+    }
+    soft.pixels.fetch_add(shaded);
+}
+
+/* Renders the culled and sorted draws of a frame into soft.color */
+void RenderSoftwareFrame(SSoftRenderer &soft, const SMeshRegistry &meshes, const SFrameState &frame)
+{
+    typedef std::chrono::high_resolution_clock clock;
+    clock::time_point start = clock::now();
+
+    SSoftStats &stats = soft.stats;
+    memset(&stats, 0, sizeof(SSoftStats));
+
+    soft.meshes = &meshes;
+    soft.view_projection = frame.view_projections[0];
+    soft.camera_position = frame.input.cameras[0].position;
+    soft.spot_position = frame.input.light_1_position;
+    soft.spot_direction = glm::normalize(frame.input.light_1_direction);
+    soft.spot_cutoff = cosf(glm::radians(SOFT_SPOT_CUTOFF_DEGREES));
+    soft.point_position = frame.input.light_2_position;
+
+    // Lay the draws out one after another in the vertex and triangle arrays
+    const SRenderQueue &queue = frame.queue;
+    soft.draws.clear();
+    soft.vertex_batches.clear();
+    int vertex_count = 0;
+    soft.triangle_count = 0;
+
+    for (size_t i = 0; i < queue.indices.size(); i++)
+    {
+        const SDrawCommand &command = queue.commands[queue.indices[i]];
+
+        SSoftDraw draw;
+        draw.first_vertex = vertex_count;
+        draw.vertex_count = command.vertex_count;
+        draw.first_triangle = soft.triangle_count;
+        draw.triangle_count = command.index_count / 3;
+        draw.first_index = command.first_index;
+        draw.base_vertex = command.base_vertex;
+        draw.texture = (int) command.texture;
+        draw.model = command.model;
+
+        for (int first = 0; first < draw.vertex_count; first += SOFT_VERTEX_BATCH)
+        {
+            SSoftVertexBatch batch = { (int) soft.draws.size(), first, std::min(SOFT_VERTEX_BATCH, draw.vertex_count - first) };
+            soft.vertex_batches.push_back(batch);
+        }
+
+        soft.draws.push_back(draw);
+        vertex_count += draw.vertex_count;
+        soft.triangle_count += draw.triangle_count;
+    }
+    soft.vertices.resize(vertex_count);
+
+    stats.draws = (unsigned int) soft.draws.size();
+    stats.vertices = (unsigned int) vertex_count;
+    stats.triangles = (unsigned int) soft.triangle_count;
+
+    SJobSystem &jobs = *soft.jobs;
+
+    clock::time_point stage_start = clock::now();
+    ParallelFor(jobs, (int) soft.vertex_batches.size(), TransformSoftVerticesJob, &soft);
+    clock::time_point stage_end = clock::now();
+    stats.vertex_ms = std::chrono::duration<float, std::milli>(stage_end - stage_start).count();
+
+    stage_start = stage_end;
+    ParallelFor(jobs, SOFT_SETUP_CHUNKS, SetupSoftChunkJob, &soft);
+    stage_end = clock::now();
+    stats.setup_ms = std::chrono::duration<float, std::milli>(stage_end - stage_start).count();
+
+    for (int c = 0; c < SOFT_SETUP_CHUNKS; c++)
+    {
+        stats.setup_triangles += (unsigned int) soft.chunks[c].triangles.size();
+        for (size_t b = 0; b < soft.chunks[c].bins.size(); b++)
+            stats.binned += (unsigned int) soft.chunks[c].bins[b].size();
+    }
+
+    // One job per worker, each takes tiles from the shared counter
+    stage_start = stage_end;
+    soft.next_tile = 0;
+    soft.pixels = 0;
+    ParallelFor(jobs, jobs.worker_count, RenderSoftTilesJob, &soft);
+    stage_end = clock::now();
+    stats.raster_ms = std::chrono::duration<float, std::milli>(stage_end - stage_start).count();
+    stats.pixels = soft.pixels.load();
+
+    stats.total_ms = std::chrono::duration<float, std::milli>(stage_end - start).count();
+
+    SSoftStats &t = soft.totals;
+    t.draws += stats.draws;
+    t.vertices += stats.vertices;
+    t.triangles += stats.triangles;
+    t.setup_triangles += stats.setup_triangles;
+    t.binned += stats.binned;
+    t.pixels += stats.pixels;
+    t.vertex_ms += stats.vertex_ms;
+    t.setup_ms += stats.setup_ms;
+    t.raster_ms += stats.raster_ms;
+    t.total_ms += stats.total_ms;
+    soft.frames++;
+}
+
+bool WriteSoftwareFramePPM(const SSoftRenderer &soft, const char *path)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("ERROR: Software Renderer - Could not write %s\n", path);
+        return false;
+    }
+
+    fprintf(file, "P6\n%d %d\n255\n", soft.width, soft.height);
+    fwrite(soft.color.data(), 1, soft.color.size(), file);
+    fclose(file);
+    return true;
+}
+
+void PrintSoftwareStats(const SSoftRenderer &soft)
+{
+    if (soft.frames == 0)
+        return;
+
+    float frames = (float) soft.frames;
+    const SSoftStats &t = soft.totals;
+    float screen = (float) soft.width * (float) soft.height;
+    float total_ms = t.total_ms / frames;
+
+    printf("INFO: Software Renderer - %u frames at %dx%d, %d workers, per frame averages:\n",
+           soft.frames, soft.width, soft.height, soft.jobs != NULL ? soft.jobs->worker_count : 1);
+    printf("INFO:   draws: %.1f, vertices: %.1f, triangles: %.1f, after clipping: %.1f, tile bin entries: %.1f\n",
+           (float) t.draws / frames, (float) t.vertices / frames, (float) t.triangles / frames,
+           (float) t.setup_triangles / frames, (float) t.binned / frames);
+    printf("INFO:   pixels shaded: %.1f (%.1f%% of the screen)\n", (float) t.pixels / frames, 100.f * (float) t.pixels / (frames * screen));
+    printf("INFO:   vertex %.3f ms, setup %.3f ms, raster and shade %.3f ms, total %.3f ms (%.1f Mpixels/s)\n",
+           t.vertex_ms / frames, t.setup_ms / frames, t.raster_ms / frames, total_ms,
+           total_ms > 0.f ? screen / (total_ms * 1000.f) : 0.f);
+}
+
+/* Renders frame again on job systems of 1, 2, 4 ... max_workers workers and prints how the frame time scales */
+void BenchmarkSoftwareScaling(SSoftRenderer &soft, const SMeshRegistry &meshes, const SFrameState &frame, int max_workers, int iterations)
+{
+    SJobSystem *frame_jobs = soft.jobs;
+    SSoftStats totals = soft.totals;
+    unsigned int frames = soft.frames;
+
+    max_workers = std::max(1, std::min(max_workers, JOB_MAX_WORKERS));
+    float single_ms = 0.f;
+    float screen = (float) soft.width * (float) soft.height;
+
+    printf("INFO: Software Renderer Scaling - %dx%d, %d frames per run, %u hardware threads\n",
+           soft.width, soft.height, iterations, std::thread::hardware_concurrency());
+
+    for (int workers = 1; ; workers = std::min(workers * 2, max_workers))
+    {
+        SJobSystem *jobs = new SJobSystem;
+        InitJobSystem(*jobs, workers);
+        soft.jobs = jobs;
+
+        // The first frame warms up the allocations of the bins
+        RenderSoftwareFrame(soft, meshes, frame);
+
+        typedef std::chrono::high_resolution_clock clock;
+        clock::time_point start = clock::now();
+        for (int i = 0; i < iterations; i++)
+            RenderSoftwareFrame(soft, meshes, frame);
+        float ms = std::chrono::duration<float, std::milli>(clock::now() - start).count() / (float) iterations;
+
+        ShutdownJobSystem(*jobs);
+        delete jobs;
+
+        if (workers == 1)
+            single_ms = ms;
+        printf("INFO:   %2d workers: %8.3f ms per frame, %7.1f Mpixels/s, %5.2fx speedup\n",
+               workers, ms, screen / (ms * 1000.f), single_ms / ms);
+
+        if (workers == max_workers)
+            break;
+    }
+
+    soft.jobs = frame_jobs;
+    soft.totals = totals;
+    soft.frames = frames;
+}
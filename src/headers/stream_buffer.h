@@ -0,0 +1,251 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+
+/* ---- OpenGL Headers ---- */
+#include <glad/glad.h>
+
+/* ---- Header Files ---- */
+#include "gl_state.h"
+#include "memory.h"
+
+/* ---- Definitions ---- */
+// Frames that can be in flight, each writes its own region of the buffer
+#define STREAM_FRAMES 3
+
+// Uniform block binding the per draw object data is read from
+#define STREAM_OBJECT_BINDING 0
+
+struct SStreamAllocation
+{
+    void *data;          // write only, NULL when the region is full
+    GLintptr offset;     // byte offset into the buffer, for glBindBufferRange or attribute pointers
+};
+
+struct SStreamStats
+{
+    unsigned int frames;
+    unsigned int allocations;
+    unsigned int overflows;
+    unsigned int overflow_uploads;
+    unsigned int maps;
+    unsigned long long bytes;
+
+    unsigned int fence_waits;
+    float fence_wait_ms;
+};
+
+// A ring over one GL buffer, split into STREAM_FRAMES regions. Frame N writes region N % STREAM_FRAMES
+// through unsynchronized mappings, the fence placed after its draws keeps frame N + STREAM_FRAMES
+// from overwriting the region before the GPU has read it.
+struct SStreamBuffer
+{
+    unsigned int buffer;
+    GLenum target;
+    GLsizeiptr region_size;
+
+    // Offset alignment glBindBufferRange needs for uniform blocks
+    GLintptr uniform_alignment;
+
+    int region;
+    GLsync fences[STREAM_FRAMES];
+
+    // Bump allocator within the current region, the mapping covers [map_start, region end)
+    GLintptr head;
+    GLintptr map_start;
+    unsigned char *mapped;
+
+    // Separate buffer the data that did not fit into a region is uploaded to, one draw at a time
+    unsigned int overflow_buffer;
+    GLsizeiptr overflow_size;
+
+    SStreamStats stats;
+};
+
+/* Creates the buffer, region_size bytes for each frame in flight */
+void InitStreamBuffer(SStreamBuffer &stream, GLenum target, GLsizeiptr region_size)
+{
+    stream.target = target;
+    stream.region_size = region_size;
+    stream.region = 0;
+    stream.head = 0;
+    stream.map_start = 0;
+    stream.mapped = NULL;
+    stream.overflow_buffer = 0;
+    stream.overflow_size = 0;
+    for (int i = 0; i < STREAM_FRAMES; i++)
+        stream.fences[i] = 0;
+    memset(&stream.stats, 0, sizeof(SStreamStats));
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    stream.uniform_alignment = (GLintptr) alignment;
+
+    glGenBuffers(1, &stream.buffer);
+    BindBuffer(gl_state, target, stream.buffer);
+    glBufferData(target, region_size * STREAM_FRAMES, NULL, GL_STREAM_DRAW);
+    TrackMemory(memory_tracker, "object stream", MEMORY_STREAMING, MEMORY_GPU, &stream, (size_t) region_size * STREAM_FRAMES);
+
+    printf("INFO: Stream Buffer - %d x %.1f KB regions\n", STREAM_FRAMES, (double) region_size / 1024.0);
+}
+
+/* Moves to the next region, waiting only if the GPU is still reading it from STREAM_FRAMES frames ago */
+void BeginStreamFrame(SStreamBuffer &stream)
+{
+    stream.region = (stream.region + 1) % STREAM_FRAMES;
+    stream.head = stream.region_size * stream.region;
+    stream.map_start = stream.head;
+
+    GLsync &fence = stream.fences[stream.region];
+    if (fence != 0)
+    {
+        // The common case, the GPU finished that frame long ago and the check does not block
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            typedef std::chrono::high_resolution_clock clock;
+            clock::time_point start = clock::now();
+
+            while (result == GL_TIMEOUT_EXPIRED)
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+            stream.stats.fence_waits++;
+            stream.stats.fence_wait_ms += std::chrono::duration<float, std::milli>(clock::now() - start).count();
+        }
+
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    stream.stats.frames++;
+}
+
+/* Returns size bytes of the current region at an offset that is a multiple of alignment (a power of two).
+ * The memory must be written before FlushStreamBuffer and not read. */
+SStreamAllocation StreamAllocate(SStreamBuffer &stream, GLsizeiptr size, GLintptr alignment)
+{
+    SStreamAllocation allocation;
+    allocation.data = NULL;
+    allocation.offset = 0;
+
+    GLintptr region_end = stream.region_size * (stream.region + 1);
+    GLintptr offset = (stream.head + alignment - 1) & ~(alignment - 1);
+    if (offset + size > region_end)
+    {
+        stream.stats.overflows++;
+        return allocation;
+    }
+
+    // No other frame touches this region and the fence said the GPU is done with it, so the mapping
+    // needs no synchronization and the old contents can be thrown away
+    if (stream.mapped == NULL)
+    {
+        BindBuffer(gl_state, stream.target, stream.buffer);
+        stream.map_start = offset;
+        stream.mapped = (unsigned char *) glMapBufferRange(stream.target, offset, region_end - offset,
+                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+        stream.stats.maps++;
+
+        if (stream.mapped == NULL)
+        {
+            printf("ERROR: Stream Buffer - Could not map the buffer.\n");
+            stream.stats.overflows++;
+            return allocation;
+        }
+    }
+
+    allocation.data = stream.mapped + (offset - stream.map_start);
+    allocation.offset = offset;
+    stream.head = offset + size;
+
+    stream.stats.allocations++;
+    stream.stats.bytes += (unsigned long long) size;
+    return allocation;
+}
+
+/* Makes everything written so far visible to the GPU, must happen before the draws that read it.
+ * Allocating again afterwards maps the rest of the region. */
+void FlushStreamBuffer(SStreamBuffer &stream)
+{
+    if (stream.mapped == NULL)
+        return;
+
+    BindBuffer(gl_state, stream.target, stream.buffer);
+    glFlushMappedBufferRange(stream.target, 0, stream.head - stream.map_start);
+    glUnmapBuffer(stream.target);
+    stream.mapped = NULL;
+}
+
+/* Fallback for data that did not fit into the region: uploads size bytes into the overflow buffer and
+ * returns it, to be bound at offset 0 for one draw. Every upload orphans the previous contents, so the
+ * driver keeps them for the draws already issued. */
+unsigned int StreamOverflowUpload(SStreamBuffer &stream, const void *data, GLsizeiptr size)
+{
+    if (stream.overflow_buffer == 0)
+        glGenBuffers(1, &stream.overflow_buffer);
+
+    if (size > stream.overflow_size)
+    {
+        if (stream.overflow_size > 0)
+            ReleaseMemory(memory_tracker, &stream.overflow_buffer, MEMORY_STREAMING);
+        stream.overflow_size = size;
+        TrackMemory(memory_tracker, "object stream overflow", MEMORY_STREAMING, MEMORY_GPU, &stream.overflow_buffer, (size_t) size);
+    }
+
+    BindBuffer(gl_state, stream.target, stream.overflow_buffer);
+    glBufferData(stream.target, stream.overflow_size, NULL, GL_STREAM_DRAW);
+    glBufferSubData(stream.target, 0, size, data);
+
+    stream.stats.overflow_uploads++;
+    return stream.overflow_buffer;
+}
+
+/* Fences the region after the last draw of the frame that reads it */
+void EndStreamFrame(SStreamBuffer &stream)
+{
+    FlushStreamBuffer(stream);
+    stream.fences[stream.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void DeleteStreamBuffer(SStreamBuffer &stream)
+{
+    FlushStreamBuffer(stream);
+    for (int i = 0; i < STREAM_FRAMES; i++)
+    {
+        if (stream.fences[i] != 0)
+            glDeleteSync(stream.fences[i]);
+        stream.fences[i] = 0;
+    }
+
+    glDeleteBuffers(1, &stream.buffer);
+    if (stream.overflow_buffer != 0)
+    {
+        glDeleteBuffers(1, &stream.overflow_buffer);
+        ReleaseMemory(memory_tracker, &stream.overflow_buffer, MEMORY_STREAMING);
+    }
+    stream.overflow_buffer = 0;
+    stream.overflow_size = 0;
+    ResetGLState(gl_state);
+    ReleaseMemory(memory_tracker, &stream, MEMORY_STREAMING);
+}
+
+void PrintStreamStats(const SStreamBuffer &stream)
+{
+    const SStreamStats &s = stream.stats;
+    if (s.frames == 0)
+        return;
+
+    float frames = (float) s.frames;
+    printf("INFO: Stream Buffer - %u frames, %d regions of %.1f KB, per frame averages:\n",
+           s.frames, STREAM_FRAMES, (double) stream.region_size / 1024.0);
+    printf("INFO:   allocations: %.1f, %.1f bytes, %.1f maps, %u overflows in total\n",
+           (float) s.allocations / frames, (float) s.bytes / frames, (float) s.maps / frames, s.overflows);
+    printf("INFO:   fence waits: %u of %u frames (%.1f%%), %.4f ms waited per frame\n",
+           s.fence_waits, s.frames, 100.f * (float) s.fence_waits / frames, s.fence_wait_ms / frames);
+    if (s.overflows > 0)
+        printf("ERROR: Stream Buffer - regions overflowed %u times, %u draws fell back to uploading their own data\n",
+               s.overflows, s.overflow_uploads);
+}
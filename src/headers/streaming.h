@@ -0,0 +1,746 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/* ---- OpenGL Headers ---- */
+#include <glad/glad.h>
+
+/* ---- GLM Includes ---- */
+#ifdef _WIN32
+#include <glm/glm/glm.hpp>
+#endif
+
+#ifdef __unix
+#include <glm/glm.hpp>
+#endif
+
+/* ---- Header Files ---- */
+#include "scene.h"
+#include "parser.h"
+#include "bitmap.h"
+#include "texture.h"
+#include "gl_state.h"
+#include "memory.h"
+#include "mesh.h"
+#include "bvh.h"
+#include "collision.h"
+#include "simulation.h"
+
+// Chunked world streaming. Meshes and textures that only chunked instances use are loaded on a thread of
+// their own when a chunk comes within the stream radius of the active camera, and unloaded when no chunk
+// that is wanted uses them any more. The loader parses, welds, packs and builds the picking and collision
+// structures; the render thread only uploads, at the point between frames where no job reads the scene.
+// A chunk's instances are drawn, picked and collided with once every asset it needs is resident.
+
+/* ---- Definitions ---- */
+// Assets handed to the loader at once, the nearest chunks are requested first as the camera moves
+#define STREAM_MAX_IN_FLIGHT 4
+
+// GL objects of evicted assets are deleted this many frames later, the frames in flight still draw them
+#define STREAM_RETIRE_FRAMES 2
+
+// Chunks that are resident or loading stay wanted up to this many stream radii away, so a camera
+// moving along a chunk border does not load and unload the same chunk every frame
+#define STREAM_HYSTERESIS 1.25f
+
+enum EStreamAssetKind
+{
+    STREAM_MESH,
+    STREAM_TEXTURE
+};
+
+enum EStreamAssetState
+{
+    STREAM_UNLOADED,
+    STREAM_LOADING,
+    STREAM_RESIDENT,
+    STREAM_FAILED
+};
+
+// What the loader thread produces for one asset
+struct SSceneStreamLoad
+{
+    int asset;
+    bool ok;
+    float load_ms;
+
+    // Meshes, packed in the vertex format they are uploaded in
+    std::vector<unsigned char> packed;
+    std::vector<unsigned int> indices;
+    unsigned int vertex_count;
+    EVertexFormat format;
+    SBounds bounds;
+    SMeshBvh bvh;
+    SCollisionGrid grid;
+
+    // Textures
+    unsigned char *pixels;
+    int width;
+    int height;
+};
+
+// A streamed mesh or texture, index is its place in the scene's list and in the mesh registry
+struct SSceneStreamAsset
+{
+    EStreamAssetKind kind;
+    int index;
+    const char *path;
+    bool mipmaps;
+    bool solid;
+
+    EStreamAssetState state;
+    bool wanted;
+
+    // Host and GPU bytes while resident, estimated from the file size until the first load
+    size_t bytes;
+
+    SMeshAllocation allocation;
+    GLuint texture;
+};
+
+struct SSceneStreamChunk
+{
+    bool wanted;
+    bool resident;
+    float distance;
+
+    // Streamed assets the instances of the chunk need
+    std::vector<int> assets;
+};
+
+// Mesh ranges and GL textures waiting for the frames that still draw them
+struct SSceneStreamRetired
+{
+    unsigned int frame;
+    SMeshAllocation allocation;
+    GLuint texture;
+};
+
+struct SSceneStreamStats
+{
+    unsigned int asset_loads;
+    unsigned int asset_evictions;
+    unsigned int chunk_loads;
+    unsigned int chunk_evictions;
+    unsigned int failed_loads;
+    unsigned int discarded_loads;       // finished after their chunks had moved out of range
+    unsigned int budget_limited;        // frames where the budget kept a chunk within range from loading
+    unsigned int updates;
+    float update_ms;
+    float load_ms;
+    size_t peak_bytes;
+};
+
+struct SSceneStreamer
+{
+    const SScene *scene;
+    SMeshRegistry *registry;
+    SSceneBvh *bvh;
+    SCollisionWorld *collision;
+    std::vector<SSceneObject> *objects;     // one per scene instance, in the same order
+
+    std::vector<int> object_collision;      // collision instance of each object, -1 when it is not solid
+    std::vector<int> mesh_assets;           // asset of each scene mesh, -1 when it stays resident
+    std::vector<int> texture_assets;        // asset of each scene texture, -1 when it stays resident
+    std::vector<GLuint> resident_textures;  // GL textures of the resident scene textures
+
+    std::vector<SSceneStreamAsset> assets;
+    std::vector<SSceneStreamChunk> chunks;
+    std::vector<SSceneStreamRetired> retired;
+
+    float radius;
+    size_t budget;
+    size_t resident_bytes;
+    bool full_vertices;
+    unsigned int frame;
+    int in_flight;
+    int resident_chunks;
+
+    // Loader thread, requests and results are handed over under the mutex
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable request_signal;
+    std::condition_variable done_signal;
+    std::deque<int> requests;
+    std::vector<SSceneStreamLoad *> completed;
+    bool quit;
+
+    SSceneStreamStats stats;
+};
+
+/* Size of a file on disk, the first estimate of what an asset costs resident */
+size_t StreamFileSize(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return 0;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fclose(file);
+    return size > 0 ? (size_t) size : 0;
+}
+
+/* Parses, welds and packs a mesh, builds its picking hierarchy and its collision grid when it is solid.
+ * Runs on the loader thread, which is the only thread that parses once the scene has started. */
+void LoadStreamMesh(SSceneStreamLoad &load, const SSceneStreamAsset &asset, bool full_vertices)
+{
+    std::pair<float *, unsigned int> parsed = parse_OBJ(asset.path, &load.bounds);
+    if (parsed.first == NULL || parsed.second == 0)
+    {
+        free(parsed.first);
+        load.ok = false;
+        return;
+    }
+
+    load.format = full_vertices ? VERTEX_FORMAT_FULL : SelectVertexFormat(parsed.first, parsed.second);
+
+    SMeshRegistry local;
+    InitMeshRegistry(local);
+    WeldMesh(local, parsed.first, parsed.second, load.bounds, load.format);
+    free(parsed.first);
+
+    BuildMeshBvh(load.bvh, local, 0, NULL);
+    if (asset.solid)
+        BuildCollisionGrid(load.grid, local, 0);
+
+    const SVertexFormatInfo &info = vertex_formats[load.format];
+    load.vertex_count = (unsigned int) local.meshes[0].vertex_count;
+    load.packed.resize((size_t) load.vertex_count * info.stride);
+    info.pack(local.vertices.data(), load.vertex_count, load.packed.data());
+    load.indices.swap(local.indices);
+    load.ok = true;
+}
+
+/* Decodes a bitmap, the upload happens on the render thread */
+void LoadStreamTexture(SSceneStreamLoad &load, const SSceneStreamAsset &asset)
+{
+    BITMAPINFOHEADER info;
+    BITMAPFILEHEADER file;
+    load.pixels = NULL;
+    loadbitmap(asset.path, load.pixels, &info, &file);
+    load.ok = load.pixels != NULL;
+    load.width = load.ok ? (int) info.biWidth : 0;
+    load.height = load.ok ? (int) info.biHeight : 0;
+}
+
+void StreamLoaderThread(SSceneStreamer *streamer)
+{
+    while (true)
+    {
+        int asset_index;
+        {
+            std::unique_lock<std::mutex> lock(streamer->mutex);
+            streamer->request_signal.wait(lock, [streamer] { return streamer->quit || !streamer->requests.empty(); });
+            if (streamer->quit)
+                return;
+            asset_index = streamer->requests.front();
+            streamer->requests.pop_front();
+        }
+
+        // The asset's description does not change while it is loading
+        const SSceneStreamAsset &asset = streamer->assets[asset_index];
+        typedef std::chrono::high_resolution_clock clock;
+        clock::time_point start = clock::now();
+
+        SSceneStreamLoad *load = new SSceneStreamLoad();
+        load->asset = asset_index;
+        load->pixels = NULL;
+        {
+            PROFILE_SCOPE(asset.kind == STREAM_MESH ? "stream mesh" : "stream texture");
+            if (asset.kind == STREAM_MESH)
+                LoadStreamMesh(*load, asset, streamer->full_vertices);
+            else
+                LoadStreamTexture(*load, asset);
+        }
+        load->load_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(streamer->mutex);
+            streamer->completed.push_back(load);
+        }
+        streamer->done_signal.notify_all();
+    }
+}
+
+/* Frees what the loader produced for an asset that is not integrated */
+void DeleteStreamLoad(SSceneStreamLoad *load)
+{
+    delete[] load->pixels;
+    delete load;
+}
+
+/* Sets up streaming for the chunked instances of a scene. The registry holds a reserved slot for every
+ * streamed mesh, objects has one entry per instance and resident_textures the GL texture of every scene
+ * texture that is not streamed. Every chunk starts out hidden. */
+void InitSceneStreamer(SSceneStreamer &streamer, const SScene &scene, SMeshRegistry &registry, SSceneBvh &bvh,
+                       SCollisionWorld &collision, std::vector<SSceneObject> &objects, const std::vector<int> &collision_objects,
+                       const std::vector<GLuint> &resident_textures, float budget_mb, bool full_vertices)
+{
+    streamer.scene = &scene;
+    streamer.registry = &registry;
+    streamer.bvh = &bvh;
+    streamer.collision = &collision;
+    streamer.objects = &objects;
+    streamer.resident_textures = resident_textures;
+    streamer.radius = scene.stream_radius > 0.f ? scene.stream_radius : 2.f * scene.chunk_size;
+    streamer.budget = (size_t) ((double) budget_mb * 1024.0 * 1024.0);
+    streamer.resident_bytes = 0;
+    streamer.full_vertices = full_vertices;
+    streamer.frame = 0;
+    streamer.in_flight = 0;
+    streamer.resident_chunks = 0;
+    streamer.quit = false;
+    memset(&streamer.stats, 0, sizeof(SSceneStreamStats));
+
+    streamer.object_collision.assign(objects.size(), -1);
+    for (size_t c = 0; c < collision_objects.size(); c++)
+        streamer.object_collision[collision_objects[c]] = (int) c;
+
+    // An asset is streamed when no global instance uses it
+    std::vector<bool> mesh_global(scene.meshes.size(), false), texture_global(scene.textures.size(), false);
+    for (size_t i = 0; i < scene.instances.size(); i++)
+    {
+        const SSceneInstance &instance = scene.instances[i];
+        if (instance.chunk < 0)
+            mesh_global[instance.mesh] = texture_global[instance.texture] = true;
+    }
+
+    streamer.assets.clear();
+    streamer.mesh_assets.assign(scene.meshes.size(), -1);
+    for (size_t m = 0; m < scene.meshes.size(); m++)
+    {
+        if (mesh_global[m])
+            continue;
+        SSceneStreamAsset asset;
+        memset(&asset, 0, sizeof(asset));
+        asset.kind = STREAM_MESH;
+        asset.index = (int) m;
+        asset.path = scene.meshes[m].path;
+        asset.solid = scene.meshes[m].solid;
+        asset.bytes = StreamFileSize(asset.path);
+        streamer.mesh_assets[m] = (int) streamer.assets.size();
+        streamer.assets.push_back(asset);
+    }
+
+    streamer.texture_assets.assign(scene.textures.size(), -1);
+    for (size_t t = 0; t < scene.textures.size(); t++)
+    {
+        if (texture_global[t])
+            continue;
+        SSceneStreamAsset asset;
+        memset(&asset, 0, sizeof(asset));
+        asset.kind = STREAM_TEXTURE;
+        asset.index = (int) t;
+        asset.path = scene.textures[t].path;
+        asset.mipmaps = scene.textures[t].mipmaps;
+        asset.bytes = StreamFileSize(asset.path);
+        streamer.texture_assets[t] = (int) streamer.assets.size();
+        streamer.assets.push_back(asset);
+    }
+
+    streamer.chunks.assign(scene.chunks.size(), SSceneStreamChunk());
+    for (size_t c = 0; c < scene.chunks.size(); c++)
+    {
+        SSceneStreamChunk &chunk = streamer.chunks[c];
+        chunk.wanted = chunk.resident = false;
+        chunk.distance = 0.f;
+
+        const SSceneChunk &source = scene.chunks[c];
+        for (int i = source.first_instance; i < source.first_instance + source.instance_count; i++)
+        {
+            const SSceneInstance &instance = scene.instances[i];
+            int needs[2] = { streamer.mesh_assets[instance.mesh], streamer.texture_assets[instance.texture] };
+            for (int k = 0; k < 2; k++)
+                if (needs[k] >= 0 && std::find(chunk.assets.begin(), chunk.assets.end(), needs[k]) == chunk.assets.end())
+                    chunk.assets.push_back(needs[k]);
+
+            // Hidden until the chunk is resident
+            (*streamer.objects)[i].mesh = -1;
+            bvh.instances[i].mesh = -1;
+            if (streamer.object_collision[i] >= 0)
+                collision.instances[streamer.object_collision[i]].grid = -1;
+        }
+    }
+
+    streamer.thread = std::thread(StreamLoaderThread, &streamer);
+
+    printf("INFO: Streaming - %d chunks, %d streamed assets, radius %.1f m, budget %.1f MB\n", (int) streamer.chunks.size(),
+           (int) streamer.assets.size(), streamer.radius, budget_mb);
+}
+
+/* Shows or hides the instances of a chunk in the draws, picking and collision */
+void SetStreamChunkVisible(SSceneStreamer &streamer, int chunk_index, bool visible)
+{
+    const SScene &scene = *streamer.scene;
+    const SSceneChunk &chunk = scene.chunks[chunk_index];
+    for (int i = chunk.first_instance; i < chunk.first_instance + chunk.instance_count; i++)
+    {
+        const SSceneInstance &instance = scene.instances[i];
+        SSceneObject &object = (*streamer.objects)[i];
+        int texture_asset = streamer.texture_assets[instance.texture];
+
+        object.mesh = visible ? instance.mesh : -1;
+        object.texture = texture_asset >= 0 ? streamer.assets[texture_asset].texture : streamer.resident_textures[instance.texture];
+        streamer.bvh->instances[i].mesh = object.mesh;
+
+        int collision_instance = streamer.object_collision[i];
+        if (collision_instance >= 0)
+        {
+            SCollisionInstance &target = streamer.collision->instances[collision_instance];
+            target.grid = visible ? streamer.collision->mesh_grids[instance.mesh] : -1;
+            UpdateCollisionInstance(*streamer.collision, collision_instance, target.model);
+        }
+    }
+
+    streamer.chunks[chunk_index].resident = visible;
+    streamer.resident_chunks += visible ? 1 : -1;
+}
+
+/* Uploads a finished load and makes the asset resident */
+void IntegrateStreamLoad(SSceneStreamer &streamer, SSceneStreamLoad &load)
+{
+    SSceneStreamAsset &asset = streamer.assets[load.asset];
+    size_t host_bytes = 0, gpu_bytes = 0;
+
+    if (asset.kind == STREAM_MESH)
+    {
+        asset.allocation = UploadStreamedMesh(*streamer.registry, asset.index, load.packed.data(), load.vertex_count,
+                                              load.indices.data(), (unsigned int) load.indices.size(), load.bounds, load.format);
+        gpu_bytes = load.packed.size() + sizeof(unsigned int) * load.indices.size();
+
+        // Swapped in, the empty structures the slot held go out with the load
+        SMeshBvh &mesh_bvh = streamer.bvh->meshes[asset.index];
+        std::swap(mesh_bvh, load.bvh);
+        host_bytes += sizeof(SBvhNode) * mesh_bvh.bvh.nodes.capacity() + sizeof(unsigned int) * mesh_bvh.bvh.indices.capacity() +
+                      sizeof(SBvhTriangle) * mesh_bvh.triangles.capacity();
+
+        int grid_index = streamer.collision->mesh_grids[asset.index];
+        if (grid_index >= 0)
+        {
+            SCollisionGrid &grid = streamer.collision->grids[grid_index];
+            std::swap(grid, load.grid);
+            host_bytes += sizeof(unsigned int) * (grid.cell_start.capacity() + grid.cell_triangles.capacity()) +
+                          sizeof(SCollisionTriangle) * grid.triangles.capacity();
+        }
+    }
+    else
+    {
+        asset.texture = upload_texture(load.pixels, load.width, load.height, asset.mipmaps);
+        gpu_bytes = (size_t) load.width * (size_t) load.height * 4;
+        if (asset.mipmaps)
+            gpu_bytes = gpu_bytes * 4 / 3;
+    }
+
+    TrackMemory(memory_tracker, asset.path, MEMORY_STREAMING, MEMORY_HOST, &asset, host_bytes);
+    // A mesh's GPU bytes are tracked with the stream pool it was allocated from
+    if (asset.kind == STREAM_TEXTURE)
+        TrackMemory(memory_tracker, asset.path, MEMORY_STREAMING, MEMORY_GPU, &asset, gpu_bytes);
+
+    asset.bytes = host_bytes + gpu_bytes;
+    asset.state = STREAM_RESIDENT;
+    streamer.resident_bytes += asset.bytes;
+    streamer.stats.peak_bytes = std::max(streamer.stats.peak_bytes, streamer.resident_bytes);
+    streamer.stats.asset_loads++;
+    streamer.stats.load_ms += load.load_ms;
+}
+
+/* Unloads a resident asset whose chunks have all been hidden. Picking and collision run on this thread
+ * and drop their copies now, the mesh ranges and textures wait until the frames in flight no longer draw them. */
+void EvictStreamAsset(SSceneStreamer &streamer, SSceneStreamAsset &asset)
+{
+    SSceneStreamRetired retired;
+    retired.frame = streamer.frame;
+    retired.allocation = asset.allocation;
+    retired.texture = asset.texture;
+    streamer.retired.push_back(retired);
+
+    if (asset.kind == STREAM_MESH)
+    {
+        EvictStreamedMesh(*streamer.registry, asset.index);
+        SMeshBvh empty_bvh = SMeshBvh();
+        std::swap(streamer.bvh->meshes[asset.index], empty_bvh);
+
+        int grid_index = streamer.collision->mesh_grids[asset.index];
+        if (grid_index >= 0)
+        {
+            SCollisionGrid empty_grid = SCollisionGrid();
+            std::swap(streamer.collision->grids[grid_index], empty_grid);
+        }
+    }
+
+    asset.allocation.vertices.count = asset.allocation.indices.count = 0;
+    asset.texture = 0;
+    asset.state = STREAM_UNLOADED;
+    ReleaseMemory(memory_tracker, &asset, MEMORY_STREAMING);
+    streamer.resident_bytes -= asset.bytes;
+    streamer.stats.asset_evictions++;
+}
+
+/* Frees the retired mesh ranges and textures that no frame in flight draws any more, or all of them */
+void DeleteRetiredStreamObjects(SSceneStreamer &streamer, bool all)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < streamer.retired.size(); i++)
+    {
+        SSceneStreamRetired &retired = streamer.retired[i];
+        if (!all && streamer.frame - retired.frame < STREAM_RETIRE_FRAMES)
+        {
+            streamer.retired[kept++] = retired;
+            continue;
+        }
+
+        if (retired.allocation.indices.count != 0)
+            FreeStreamedMesh(*streamer.registry, retired.allocation);
+        if (retired.texture != 0)
+            glDeleteTextures(1, &retired.texture);
+    }
+
+    // Texture names are free to be handed out again, so nothing the tracker remembers can be trusted
+    if (kept != streamer.retired.size())
+        ResetGLState(gl_state);
+    streamer.retired.resize(kept);
+}
+
+/* Integrates every finished load, the ones nothing wants any more are dropped */
+void CollectStreamLoads(SSceneStreamer &streamer)
+{
+    std::vector<SSceneStreamLoad *> completed;
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+        completed.swap(streamer.completed);
+    }
+
+    for (size_t i = 0; i < completed.size(); i++)
+    {
+        SSceneStreamLoad *load = completed[i];
+        SSceneStreamAsset &asset = streamer.assets[load->asset];
+        streamer.in_flight--;
+
+        if (!load->ok)
+        {
+            printf("ERROR: Streaming - could not load %s, the chunks that use it stay hidden\n", asset.path);
+            asset.state = STREAM_FAILED;
+            streamer.stats.failed_loads++;
+        }
+        else if (!asset.wanted)
+        {
+            asset.state = STREAM_UNLOADED;
+            streamer.stats.discarded_loads++;
+        }
+        else
+        {
+            IntegrateStreamLoad(streamer, *load);
+        }
+        DeleteStreamLoad(load);
+    }
+}
+
+/* Distance in the ground plane from a point to the square of a chunk, 0 inside it */
+float StreamChunkDistance(const SSceneChunk &chunk, float chunk_size, const glm::vec3 &point)
+{
+    float min_x = (float) chunk.x * chunk_size, min_z = (float) chunk.z * chunk_size;
+    float dx = std::max(0.f, std::max(min_x - point.x, point.x - (min_x + chunk_size)));
+    float dz = std::max(0.f, std::max(min_z - point.z, point.z - (min_z + chunk_size)));
+    return sqrtf(dx * dx + dz * dz);
+}
+
+/* Picks the chunks to keep, nearest first, for as long as their assets fit into the budget */
+void PlanStreamChunks(SSceneStreamer &streamer, const glm::vec3 &camera)
+{
+    const SScene &scene = *streamer.scene;
+    std::vector<int> order(streamer.chunks.size());
+    for (size_t c = 0; c < streamer.chunks.size(); c++)
+    {
+        streamer.chunks[c].distance = StreamChunkDistance(scene.chunks[c], scene.chunk_size, camera);
+        streamer.chunks[c].wanted = false;
+        order[c] = (int) c;
+    }
+    std::sort(order.begin(), order.end(), [&streamer](int a, int b) { return streamer.chunks[a].distance < streamer.chunks[b].distance; });
+
+    for (size_t a = 0; a < streamer.assets.size(); a++)
+        streamer.assets[a].wanted = false;
+
+    size_t planned = 0;
+    bool limited = false;
+    for (size_t o = 0; o < order.size() && !limited; o++)
+    {
+        SSceneStreamChunk &chunk = streamer.chunks[order[o]];
+        bool started = chunk.resident;
+        for (size_t a = 0; a < chunk.assets.size() && !started; a++)
+            started = streamer.assets[chunk.assets[a]].state != STREAM_UNLOADED;
+        if (chunk.distance > streamer.radius * (started ? STREAM_HYSTERESIS : 1.f))
+            continue;
+
+        size_t extra = 0;
+        for (size_t a = 0; a < chunk.assets.size(); a++)
+            if (!streamer.assets[chunk.assets[a]].wanted)
+                extra += streamer.assets[chunk.assets[a]].bytes;
+
+        // The nearest chunk is always kept, so a budget smaller than one chunk still shows something
+        if (planned > 0 && planned + extra > streamer.budget)
+        {
+            limited = true;
+            break;
+        }
+
+        chunk.wanted = true;
+        planned += extra;
+        for (size_t a = 0; a < chunk.assets.size(); a++)
+            streamer.assets[chunk.assets[a]].wanted = true;
+    }
+
+    if (limited)
+        streamer.stats.budget_limited++;
+}
+
+/* Hands the missing assets of the wanted chunks to the loader, nearest chunk first */
+void RequestStreamAssets(SSceneStreamer &streamer)
+{
+    std::vector<int> order;
+    for (size_t c = 0; c < streamer.chunks.size(); c++)
+        if (streamer.chunks[c].wanted && !streamer.chunks[c].resident)
+            order.push_back((int) c);
+    std::sort(order.begin(), order.end(), [&streamer](int a, int b) { return streamer.chunks[a].distance < streamer.chunks[b].distance; });
+
+    int requested = 0;
+    for (size_t o = 0; o < order.size() && streamer.in_flight < STREAM_MAX_IN_FLIGHT; o++)
+    {
+        const SSceneStreamChunk &chunk = streamer.chunks[order[o]];
+        for (size_t a = 0; a < chunk.assets.size() && streamer.in_flight < STREAM_MAX_IN_FLIGHT; a++)
+        {
+            SSceneStreamAsset &asset = streamer.assets[chunk.assets[a]];
+            if (asset.state != STREAM_UNLOADED)
+                continue;
+
+            asset.state = STREAM_LOADING;
+            streamer.in_flight++;
+            requested++;
+            std::lock_guard<std::mutex> lock(streamer.mutex);
+            streamer.requests.push_back(chunk.assets[a]);
+        }
+    }
+
+    if (requested > 0)
+        streamer.request_signal.notify_one();
+}
+
+/* Runs between frames, while no job reads the scene: integrates finished loads, hides the chunks that are
+ * out of range or over budget and unloads what only they used, requests what the chunks in range still
+ * miss and shows the chunks whose assets are all resident. With wait set it blocks until the chunks in
+ * range are complete, which keeps headless runs and replays reproducible. */
+void UpdateSceneStreaming(SSceneStreamer &streamer, const glm::vec3 &camera, bool wait)
+{
+    typedef std::chrono::high_resolution_clock clock;
+    clock::time_point start = clock::now();
+    PROFILE_SCOPE("scene streaming");
+
+    DeleteRetiredStreamObjects(streamer, false);
+
+    while (true)
+    {
+        CollectStreamLoads(streamer);
+        PlanStreamChunks(streamer, camera);
+
+        for (size_t c = 0; c < streamer.chunks.size(); c++)
+        {
+            if (streamer.chunks[c].resident && !streamer.chunks[c].wanted)
+            {
+                SetStreamChunkVisible(streamer, (int) c, false);
+                streamer.stats.chunk_evictions++;
+            }
+        }
+        for (size_t a = 0; a < streamer.assets.size(); a++)
+            if (streamer.assets[a].state == STREAM_RESIDENT && !streamer.assets[a].wanted)
+                EvictStreamAsset(streamer, streamer.assets[a]);
+
+        RequestStreamAssets(streamer);
+
+        for (size_t c = 0; c < streamer.chunks.size(); c++)
+        {
+            SSceneStreamChunk &chunk = streamer.chunks[c];
+            if (!chunk.wanted || chunk.resident)
+                continue;
+
+            bool complete = true;
+            for (size_t a = 0; a < chunk.assets.size() && complete; a++)
+                complete = streamer.assets[chunk.assets[a]].state == STREAM_RESIDENT;
+            if (complete)
+            {
+                SetStreamChunkVisible(streamer, (int) c, true);
+                streamer.stats.chunk_loads++;
+            }
+        }
+
+        if (!wait || streamer.in_flight == 0)
+            break;
+
+        std::unique_lock<std::mutex> lock(streamer.mutex);
+        streamer.done_signal.wait(lock, [&streamer] { return !streamer.completed.empty(); });
+    }
+
+    streamer.frame++;
+    streamer.stats.updates++;
+    streamer.stats.update_ms += std::chrono::duration<float, std::milli>(clock::now() - start).count();
+}
+
+/* Stops the loader and unloads everything that was streamed in, call before the registry, the picking
+ * and the collision structures are deleted */
+void ShutdownSceneStreamer(SSceneStreamer &streamer)
+{
+    {
+        std::lock_guard<std::mutex> lock(streamer.mutex);
+        streamer.quit = true;
+    }
+    streamer.request_signal.notify_all();
+    streamer.thread.join();
+
+    for (size_t i = 0; i < streamer.completed.size(); i++)
+        DeleteStreamLoad(streamer.completed[i]);
+    streamer.completed.clear();
+    streamer.requests.clear();
+
+    for (size_t c = 0; c < streamer.chunks.size(); c++)
+        if (streamer.chunks[c].resident)
+            SetStreamChunkVisible(streamer, (int) c, false);
+    for (size_t a = 0; a < streamer.assets.size(); a++)
+        if (streamer.assets[a].state == STREAM_RESIDENT)
+            EvictStreamAsset(streamer, streamer.assets[a]);
+
+    // No frame is drawn after this
+    DeleteRetiredStreamObjects(streamer, true);
+}
+
+void PrintSceneStreamingStats(const SSceneStreamer &streamer)
+{
+    const SSceneStreamStats &s = streamer.stats;
+    const double mb = 1024.0 * 1024.0;
+
+    printf("INFO: Streaming - %u updates, %.4f ms per update, %d of %d chunks resident at the end\n", s.updates,
+           s.updates > 0 ? s.update_ms / (float) s.updates : 0.f, streamer.resident_chunks, (int) streamer.chunks.size());
+    printf("INFO:   assets: %u loaded (%.2f ms each on the loader), %u evicted, %u discarded, %u failed\n", s.asset_loads,
+           s.asset_loads > 0 ? s.load_ms / (float) s.asset_loads : 0.f, s.asset_evictions, s.discarded_loads, s.failed_loads);
+    printf("INFO:   chunks: %u shown, %u hidden, resident %.2f MB (peak %.2f MB) of a %.2f MB budget, %u updates budget limited\n",
+           s.chunk_loads, s.chunk_evictions, (double) streamer.resident_bytes / mb, (double) s.peak_bytes / mb,
+           (double) streamer.budget / mb, s.budget_limited);
+
+    for (int f = 0; f < VERTEX_FORMAT_COUNT; f++)
+    {
+        const SMeshStreamPool &pool = streamer.registry->stream_pools[f];
+        if (pool.vao == 0)
+            continue;
+        printf("INFO:   %s mesh pool: %u meshes in %u of %u vertices and %u of %u indices, %u free runs, grown %u times\n",
+               vertex_formats[f].name, pool.meshes, pool.vertex_count, pool.vertex_capacity, pool.index_count, pool.index_capacity,
+               (unsigned int) (pool.free_vertices.size() + pool.free_indices.size()), pool.grows);
+    }
+}
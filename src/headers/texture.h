@@ -8,15 +8,13 @@
 
 /* ---- Header Files ---- */
 #include "bitmap.h"
+#include "gl_state.h"
 
 GLuint setup_texture(const char *filename)
 {
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_BLEND);
-
     GLuint texObject;
     glGenTextures(1, &texObject);
-    glBindTexture(GL_TEXTURE_2D, texObject);
+    BindTexture(gl_state, 0, texObject);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -33,20 +31,14 @@ GLuint setup_texture(const char *filename)
 
     delete[] pxls;
 
-    glDisable(GL_TEXTURE_2D);
-    glDisable(GL_BLEND);
-
     return texObject;
 }
 
 GLuint setup_mipmaps(const char *filename)
 {
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_BLEND);
-
     GLuint texObject;
     glGenTextures(1, &texObject);
-    glBindTexture(GL_TEXTURE_2D, texObject);
+    BindTexture(gl_state, 0, texObject);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -65,20 +57,36 @@ GLuint setup_mipmaps(const char *filename)
 
     delete[] pxls;
 
-    glDisable(GL_TEXTURE_2D);
-    glDisable(GL_BLEND);
+    return texObject;
+}
+
+// Creates a texture from pixels decoded elsewhere, such as on a streaming thread. Mipmapped textures
+// are filtered like setup_mipmaps, the others use nearest sampling like setup_texture.
+GLuint upload_texture(const unsigned char *pxls, int width, int height, bool mipmaps)
+{
+    GLuint texObject;
+    glGenTextures(1, &texObject);
+    BindTexture(gl_state, 0, texObject);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mipmaps ? GL_LINEAR : GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST);
+
+    if (pxls != NULL)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, pxls);
+
+    if (mipmaps)
+        glGenerateMipmap(GL_TEXTURE_2D);
 
     return texObject;
 }
 
 GLuint setup_mipmaps(const char *filename[], int n)
 {
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_BLEND);
-
     GLuint texObject;
     glGenTextures(1, &texObject);
-    glBindTexture(GL_TEXTURE_2D, texObject);
+    BindTexture(gl_state, 0, texObject);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -101,9 +109,6 @@ GLuint setup_mipmaps(const char *filename[], int n)
         delete[] pxls[c];
     }
 
-    glDisable(GL_TEXTURE_2D);
-    glDisable(GL_BLEND);
-
     return texObject;
 }
 
@@ -0,0 +1,213 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+
+/* ---- Definitions ---- */
+// Simulation rate of the fixed timestep loop
+#define SIM_HZ 120
+// At most this many ticks are run per frame, a longer stall is dropped instead of catching up
+#define SIM_MAX_TICKS 8
+
+// Frame time histogram, FRAME_BUCKET_MS wide buckets, the last one collects everything slower
+#define FRAME_BUCKET_MS 1.f
+#define FRAME_BUCKETS   34
+
+// Accumulates real time and hands it out in whole SIM_HZ ticks
+struct SFixedTimestep
+{
+    double step;
+    double accumulator;
+    unsigned long long ticks;
+    unsigned int dropped_ticks;
+};
+
+enum EPacingMode
+{
+    PACING_VSYNC,
+    PACING_UNCAPPED,
+    PACING_TARGET_FPS
+};
+
+struct SFramePacer
+{
+    EPacingMode mode;
+    float target_fps;
+    std::chrono::high_resolution_clock::time_point next_frame;
+};
+
+struct SFrameTimeHistogram
+{
+    unsigned int buckets[FRAME_BUCKETS];
+    unsigned int count;
+    float total_ms;
+    float min_ms;
+    float max_ms;
+};
+
+void InitFixedTimestep(SFixedTimestep &timestep, int hz)
+{
+    timestep.step = 1.0 / (double) hz;
+    timestep.accumulator = 0.0;
+    timestep.ticks = 0;
+    timestep.dropped_ticks = 0;
+}
+
+/* Adds the real time of a frame and returns how many ticks to simulate */
+int AdvanceFixedTimestep(SFixedTimestep &timestep, double frame_seconds)
+{
+    timestep.accumulator += frame_seconds;
+
+    int ticks = (int) (timestep.accumulator / timestep.step);
+    if (ticks > SIM_MAX_TICKS)
+    {
+        timestep.dropped_ticks += (unsigned int) (ticks - SIM_MAX_TICKS);
+        timestep.accumulator -= (double) (ticks - SIM_MAX_TICKS) * timestep.step;
+        ticks = SIM_MAX_TICKS;
+    }
+
+    timestep.accumulator -= (double) ticks * timestep.step;
+    timestep.ticks += (unsigned long long) ticks;
+    return ticks;
+}
+
+/* How far the frame is between the previous and the latest tick, in [0, 1) */
+float FixedTimestepAlpha(const SFixedTimestep &timestep)
+{
+    return (float) (timestep.accumulator / timestep.step);
+}
+
+/* Simulation time the rendered frame shows, one tick behind so it can interpolate towards the latest */
+double FixedTimestepRenderTime(const SFixedTimestep &timestep)
+{
+    return ((double) timestep.ticks - 1.0 + timestep.accumulator / timestep.step) * timestep.step;
+}
+
+/* Parses "vsync", "uncapped" or a frame rate such as "144" */
+void InitFramePacer(SFramePacer &pacer, const char *mode)
+{
+    pacer.mode = PACING_VSYNC;
+    pacer.target_fps = 0.f;
+
+    if (mode != NULL && strcmp(mode, "uncapped") == 0)
+        pacer.mode = PACING_UNCAPPED;
+    else if (mode != NULL && strcmp(mode, "vsync") != 0)
+    {
+        float fps = (float) atof(mode);
+        if (fps > 0.f)
+        {
+            pacer.mode = PACING_TARGET_FPS;
+            pacer.target_fps = fps;
+        }
+        else
+            printf("ERROR: Unknown Pacing Mode %s, using vsync.\n", mode);
+    }
+
+    pacer.next_frame = std::chrono::high_resolution_clock::now();
+
+    if (pacer.mode == PACING_TARGET_FPS)
+        printf("INFO: Frame Pacing - target %.1f fps\n", pacer.target_fps);
+    else
+        printf("INFO: Frame Pacing - %s\n", pacer.mode == PACING_VSYNC ? "vsync" : "uncapped");
+}
+
+/* Holds the frame back until its slot for the target frame rate, does nothing in the other modes */
+void PaceFrame(SFramePacer &pacer)
+{
+    if (pacer.mode != PACING_TARGET_FPS)
+        return;
+
+    typedef std::chrono::high_resolution_clock clock;
+    clock::duration period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / pacer.target_fps));
+
+    pacer.next_frame += period;
+    clock::time_point now = clock::now();
+
+    // Fell behind by more than a frame, start counting again from now rather than rushing
+    if (pacer.next_frame < now - period)
+    {
+        pacer.next_frame = now;
+        return;
+    }
+
+    // Sleep for most of the wait, the scheduler is too coarse for the last millisecond so spin that
+    clock::time_point sleep_until = pacer.next_frame - std::chrono::milliseconds(1);
+    if (sleep_until > now)
+        std::this_thread::sleep_until(sleep_until);
+    while (clock::now() < pacer.next_frame)
+        std::this_thread::yield();
+}
+
+void InitFrameTimeHistogram(SFrameTimeHistogram &histogram)
+{
+    memset(histogram.buckets, 0, sizeof(histogram.buckets));
+    histogram.count = 0;
+    histogram.total_ms = 0.f;
+    histogram.min_ms = 1e9f;
+    histogram.max_ms = 0.f;
+}
+
+void AddFrameTime(SFrameTimeHistogram &histogram, float ms)
+{
+    int bucket = (int) (ms / FRAME_BUCKET_MS);
+    if (bucket >= FRAME_BUCKETS)
+        bucket = FRAME_BUCKETS - 1;
+    histogram.buckets[bucket]++;
+
+    histogram.count++;
+    histogram.total_ms += ms;
+    if (ms < histogram.min_ms)
+        histogram.min_ms = ms;
+    if (ms > histogram.max_ms)
+        histogram.max_ms = ms;
+}
+
+/* Upper edge of the bucket that holds the given fraction of the frames */
+float FrameTimePercentile(const SFrameTimeHistogram &histogram, float fraction)
+{
+    unsigned int target = (unsigned int) (fraction * (float) histogram.count);
+    unsigned int seen = 0;
+    for (int i = 0; i < FRAME_BUCKETS; i++)
+    {
+        seen += histogram.buckets[i];
+        if (seen > target)
+            return i == FRAME_BUCKETS - 1 ? histogram.max_ms : (float) (i + 1) * FRAME_BUCKET_MS;
+    }
+    return histogram.max_ms;
+}
+
+void PrintFrameTimeHistogram(const SFrameTimeHistogram &histogram)
+{
+    if (histogram.count == 0)
+        return;
+
+    float avg = histogram.total_ms / (float) histogram.count;
+    printf("INFO: Frame Times - %u frames, avg %.3f ms (%.1f fps), min %.3f ms, max %.3f ms, p50 <= %.0f ms, p99 <= %.0f ms\n",
+           histogram.count, avg, 1000.f / avg, histogram.min_ms, histogram.max_ms,
+           FrameTimePercentile(histogram, .5f), FrameTimePercentile(histogram, .99f));
+
+    unsigned int largest = 0;
+    for (int i = 0; i < FRAME_BUCKETS; i++)
+        if (histogram.buckets[i] > largest)
+            largest = histogram.buckets[i];
+
+    for (int i = 0; i < FRAME_BUCKETS; i++)
+    {
+        if (histogram.buckets[i] == 0)
+            continue;
+
+        char bar[51];
+        int length = (int) (50.f * (float) histogram.buckets[i] / (float) largest);
+        memset(bar, '#', length);
+        bar[length] = '\0';
+
+        if (i == FRAME_BUCKETS - 1)
+            printf("INFO:   >= %2.0f ms %7u %s\n", i * FRAME_BUCKET_MS, histogram.buckets[i], bar);
+        else
+            printf("INFO:   %2.0f-%2.0f ms %7u %s\n", i * FRAME_BUCKET_MS, (i + 1) * FRAME_BUCKET_MS, histogram.buckets[i], bar);
+    }
+}
@@ -0,0 +1,248 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+
+/* ---- GLM Includes ---- */
+#ifdef _WIN32
+#include <glm/glm/glm.hpp>
+#include <glm/glm/gtc/matrix_transform.hpp>
+#include <glm/glm/gtc/quaternion.hpp>
+#endif
+
+#ifdef __unix
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#endif
+
+// Scene graph stored as parallel arrays. A node is always added after its parent, so a single
+// front-to-back pass over the arrays sees every parent before its children.
+struct STransformSystem
+{
+    std::vector<glm::vec3> position;
+    std::vector<glm::quat> rotation;
+    std::vector<glm::vec3> scale;
+    std::vector<int> parent;
+
+    std::vector<glm::mat4> world;
+
+    // dirty: the local values changed, updated_pass: the last pass that rewrote the world matrix
+    std::vector<unsigned char> dirty;
+    std::vector<unsigned int> updated_pass;
+    unsigned int pass;
+
+    // Nothing before this node is dirty, so the update pass can start here
+    int first_dirty;
+
+    unsigned int last_updated;
+};
+
+void InitTransformSystem(STransformSystem &transforms, int capacity)
+{
+    transforms.position.reserve(capacity);
+    transforms.rotation.reserve(capacity);
+    transforms.scale.reserve(capacity);
+    transforms.parent.reserve(capacity);
+    transforms.world.reserve(capacity);
+    transforms.dirty.reserve(capacity);
+    transforms.updated_pass.reserve(capacity);
+
+    transforms.pass = 0;
+    transforms.first_dirty = 0;
+    transforms.last_updated = 0;
+}
+
+void MarkTransformDirty(STransformSystem &transforms, int node)
+{
+    transforms.dirty[node] = 1;
+    if (node < transforms.first_dirty)
+        transforms.first_dirty = node;
+}
+
+/* Adds a node below parent (-1 for a root) and returns its index */
+int AddTransformNode(STransformSystem &transforms, int parent, const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    int node = (int) transforms.position.size();
+    if (parent >= node)
+    {
+        printf("ERROR: Transform Node Parent %d Must Be Added Before Its Children.\n", parent);
+        parent = -1;
+    }
+
+    transforms.position.push_back(position);
+    transforms.rotation.push_back(rotation);
+    transforms.scale.push_back(scale);
+    transforms.parent.push_back(parent);
+    transforms.world.push_back(glm::mat4(1.f));
+    transforms.dirty.push_back(0);
+    transforms.updated_pass.push_back(0);
+
+    MarkTransformDirty(transforms, node);
+    return node;
+}
+
+/* The setters only dirty the node when the value actually changes */
+void SetTransformPosition(STransformSystem &transforms, int node, const glm::vec3 &position)
+{
+    if (transforms.position[node] == position)
+        return;
+    transforms.position[node] = position;
+    MarkTransformDirty(transforms, node);
+}
+
+void SetTransformRotation(STransformSystem &transforms, int node, const glm::quat &rotation)
+{
+    const glm::quat &r = transforms.rotation[node];
+    if (r.x == rotation.x && r.y == rotation.y && r.z == rotation.z && r.w == rotation.w)
+        return;
+    transforms.rotation[node] = rotation;
+    MarkTransformDirty(transforms, node);
+}
+
+void SetTransformScale(STransformSystem &transforms, int node, const glm::vec3 &scale)
+{
+    if (transforms.scale[node] == scale)
+        return;
+    transforms.scale[node] = scale;
+    MarkTransformDirty(transforms, node);
+}
+
+/* Local matrix translate * rotate * scale, the same order the scene used with glm::translate/rotate/scale */
+glm::mat4 ComposeTransform(const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale)
+{
+    glm::mat4 m = glm::mat4_cast(rotation);
+    m[0] *= scale.x;
+    m[1] *= scale.y;
+    m[2] *= scale.z;
+    m[3] = glm::vec4(position, 1.f);
+    return m;
+}
+
+/* Recomputes the world matrices of the dirty nodes and their descendants, returns how many were rewritten */
+unsigned int UpdateTransforms(STransformSystem &transforms)
+{
+    int n = (int) transforms.position.size();
+    unsigned int count = 0;
+    unsigned int pass = ++transforms.pass;
+
+    for (int i = transforms.first_dirty; i < n; i++)
+    {
+        int p = transforms.parent[i];
+
+        // A node is recomputed when it changed itself or its parent was rewritten earlier in this pass
+        bool parent_updated = p >= 0 && transforms.updated_pass[p] == pass;
+        if (!transforms.dirty[i] && !parent_updated)
+            continue;
+
+        glm::mat4 local = ComposeTransform(transforms.position[i], transforms.rotation[i], transforms.scale[i]);
+        transforms.world[i] = p >= 0 ? transforms.world[p] * local : local;
+
+        transforms.dirty[i] = 0;
+        transforms.updated_pass[i] = pass;
+        count++;
+    }
+
+    transforms.first_dirty = n;
+    transforms.last_updated = count;
+    return count;
+}
+
+const glm::mat4 &GetWorldMatrix(const STransformSystem &transforms, int node)
+{
+    return transforms.world[node];
+}
+
+/* Benchmark: a random hierarchy of node_count nodes, fully dirty, partly dirty and clean updates,
+ * against rebuilding every matrix from scratch each frame the way the scene used to */
+int BenchmarkTransforms(int node_count)
+{
+    const int frames = 100;
+    srand(1234);
+
+    STransformSystem transforms;
+    InitTransformSystem(transforms, node_count);
+
+    for (int i = 0; i < node_count; i++)
+    {
+        // Roughly 1 in 64 nodes is a root, the rest hang below a random earlier node
+        int parent = (i == 0 || rand() % 64 == 0) ? -1 : rand() % i;
+        float angle = (float) (rand() % 360);
+        AddTransformNode(transforms, parent,
+                         glm::vec3((float) (rand() % 100) * 0.1f, 0.f, (float) (rand() % 100) * 0.1f),
+                         glm::angleAxis(glm::radians(angle), glm::vec3(0.f, 1.f, 0.f)),
+                         glm::vec3(1.f, 1.f, 1.f));
+    }
+
+    typedef std::chrono::high_resolution_clock clock;
+
+    // Every node dirty
+    float full_ms = 0.f;
+    unsigned int full_count = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        for (int i = 0; i < node_count; i++)
+            MarkTransformDirty(transforms, i);
+
+        clock::time_point start = clock::now();
+        full_count = UpdateTransforms(transforms);
+        full_ms += std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    }
+
+    // 1% of the nodes change each frame, their subtrees follow
+    float partial_ms = 0.f;
+    unsigned int partial_count = 0;
+    for (int f = 0; f < frames; f++)
+    {
+        for (int k = 0; k < node_count / 100; k++)
+        {
+            int node = rand() % node_count;
+            SetTransformRotation(transforms, node, glm::angleAxis(glm::radians((float) f), glm::vec3(0.f, 1.f, 0.f)));
+        }
+
+        clock::time_point start = clock::now();
+        partial_count += UpdateTransforms(transforms);
+        partial_ms += std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    }
+
+    // Nothing changes
+    float clean_ms = 0.f;
+    for (int f = 0; f < frames; f++)
+    {
+        clock::time_point start = clock::now();
+        UpdateTransforms(transforms);
+        clean_ms += std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    }
+
+    // Baseline: every local matrix built with glm::translate/rotate/scale and multiplied by its parent
+    std::vector<glm::mat4> naive(node_count);
+    float naive_ms = 0.f;
+    for (int f = 0; f < frames; f++)
+    {
+        clock::time_point start = clock::now();
+        for (int i = 0; i < node_count; i++)
+        {
+            glm::mat4 local = glm::mat4(1.f);
+            local = glm::translate(local, transforms.position[i]);
+            local = local * glm::mat4_cast(transforms.rotation[i]);
+            local = glm::scale(local, transforms.scale[i]);
+
+            int p = transforms.parent[i];
+            naive[i] = p >= 0 ? naive[p] * local : local;
+        }
+        naive_ms += std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    }
+
+    printf("INFO: Transform Benchmark - %d nodes, %d frames each\n", node_count, frames);
+    printf("INFO:   all dirty:      %.3f ms/frame (%u nodes, %.0f nodes/ms)\n",
+           full_ms / frames, full_count, (float) full_count * frames / full_ms);
+    printf("INFO:   1%% dirty:       %.3f ms/frame (%.0f nodes updated with subtrees)\n",
+           partial_ms / frames, (float) partial_count / frames);
+    printf("INFO:   clean:          %.3f ms/frame\n", clean_ms / frames);
+    printf("INFO:   naive rebuild:  %.3f ms/frame\n", naive_ms / frames);
+
+    return 0;
+}
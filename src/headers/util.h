@@ -3,6 +3,7 @@
 /* ---- Standard Library ---- */
 #include <iostream>
 #include <cstdio>
+#include <cstdlib>
 
 /* ---- Definitions ---- */
 #ifdef __unix
@@ -31,11 +32,18 @@ char *read_file(const char *filename)
 
     char *bfr = (char *) malloc(sizeof(char) * (size + 1));
     if (bfr == NULL)
+    {
+        fclose(f);
         return NULL;
+    }
 
     long ret = fread(bfr, 1, size, f);
+    fclose(f);
     if (ret != size)
+    {
+        free(bfr);
         return NULL;
+    }
 
     bfr[size] = '\0';
     return bfr;
@@ -0,0 +1,268 @@
+#pragma once
+
+/* ---- Standard Library ---- */
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+/* ---- OpenGL Headers ---- */
+#include <glad/glad.h>
+
+/* ---- Definitions ---- */
+// Interleaved layout produced by create_vertices: position (3), texture (2), normal (3).
+// Every GPU layout is packed from this one, attribute locations follow vertex.vert.
+#define VERTEX_SOURCE_FLOATS 8
+
+enum EVertexSemantic
+{
+    VERTEX_POSITION,    // location 0, source floats 0-2
+    VERTEX_TEXCOORD,    // location 1, source floats 3-4
+    VERTEX_NORMAL       // location 2, source floats 5-7
+};
+
+constexpr int VertexSourceOffset(int semantic)
+{
+    return semantic == VERTEX_POSITION ? 0 : (semantic == VERTEX_TEXCOORD ? 3 : 5);
+}
+
+/* Round to nearest even conversion to a 16 bit float, values past the half range become infinity */
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int exponent = (int) ((bits >> 23) & 0xffu) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffffu;
+
+    if (exponent >= 31)
+        return (uint16_t) (sign | 0x7c00u | (((bits & 0x7f800000u) == 0x7f800000u && mantissa != 0) ? 0x200u : 0u));
+
+    if (exponent <= 0)
+    {
+        // Subnormal half, or zero when the value is too small for one
+        if (exponent < -10)
+            return (uint16_t) sign;
+        mantissa |= 0x800000u;
+        uint32_t shift = (uint32_t) (14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1u);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (rest > midpoint || (rest == midpoint && (half & 1u)))
+            half++;
+        return (uint16_t) (sign | half);
+    }
+
+    uint32_t half = sign | ((uint32_t) exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+        half++;     // a carry into the exponent is still the correctly rounded value
+    return (uint16_t) half;
+}
+
+// Attribute encodings. Each one knows its GL description and how to pack its source floats.
+
+struct VertexFloat3
+{
+    static const GLint components = 3;
+    static const GLenum type = GL_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+    static const unsigned int size = 12;
+
+    static inline void Pack(const float *in, unsigned char *out)
+    {
+        memcpy(out, in, 12);
+    }
+};
+
+struct VertexFloat2
+{
+    static const GLint components = 2;
+    static const GLenum type = GL_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+    static const unsigned int size = 8;
+
+    static inline void Pack(const float *in, unsigned char *out)
+    {
+        memcpy(out, in, 8);
+    }
+};
+
+// Texture coordinates outside [0, 1], which repeat
+struct VertexHalf2
+{
+    static const GLint components = 2;
+    static const GLenum type = GL_HALF_FLOAT;
+    static const GLboolean normalized = GL_FALSE;
+    static const unsigned int size = 4;
+
+    static inline void Pack(const float *in, unsigned char *out)
+    {
+        uint16_t h[2] = { FloatToHalf(in[0]), FloatToHalf(in[1]) };
+        memcpy(out, h, 4);
+    }
+};
+
+// Texture coordinates within [0, 1], 1/65535 steps
+struct VertexUnorm16x2
+{
+    static const GLint components = 2;
+    static const GLenum type = GL_UNSIGNED_SHORT;
+    static const GLboolean normalized = GL_TRUE;
+    static const unsigned int size = 4;
+
+    static inline void Pack(const float *in, unsigned char *out)
+    {
+        uint16_t u[2];
+        for (int i = 0; i < 2; i++)
+        {
+            float c = in[i] < 0.f ? 0.f : (in[i] > 1.f ? 1.f : in[i]);
+            u[i] = (uint16_t) (c * 65535.f + 0.5f);
+        }
+        memcpy(out, u, 4);
+    }
+};
+
+// Directions in 10 bits per component, the shader renormalizes them
+struct VertexSnorm10x3
+{
+    static const GLint components = 4;
+    static const GLenum type = GL_INT_2_10_10_10_REV;
+    static const GLboolean normalized = GL_TRUE;
+    static const unsigned int size = 4;
+
+    static inline void Pack(const float *in, unsigned char *out)
+    {
+        float length = sqrtf(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]);
+        float scale = length > 0.f ? 511.f / length : 0.f;
+
+        uint32_t packed = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            int c = (int) lroundf(in[i] * scale);
+            c = c < -511 ? -511 : (c > 511 ? 511 : c);
+            packed |= ((uint32_t) c & 0x3ffu) << (10 * i);
+        }
+        memcpy(out, &packed, 4);
+    }
+};
+
+// An attribute is an encoding bound to a semantic
+template <int Semantic, typename Format>
+struct VertexAttr
+{
+    static const int semantic = Semantic;
+    typedef Format format;
+};
+
+template <typename Format> using Position = VertexAttr<VERTEX_POSITION, Format>;
+template <typename Format> using Texcoord = VertexAttr<VERTEX_TEXCOORD, Format>;
+template <typename Format> using Normal = VertexAttr<VERTEX_NORMAL, Format>;
+
+// Offsets are the running sum of the sizes before each attribute, so the recursion carries the
+// offset of its first attribute and every call below inlines to straight line code
+template <unsigned int Offset, typename... Attrs>
+struct VertexAttrList;
+
+template <unsigned int Offset>
+struct VertexAttrList<Offset>
+{
+    static const unsigned int end = Offset;
+
+    static inline void Pack(const float *, unsigned char *) {}
+    static inline void Setup(GLsizei, size_t) {}
+};
+
+template <unsigned int Offset, typename First, typename... Rest>
+struct VertexAttrList<Offset, First, Rest...>
+{
+    typedef typename First::format Format;
+    typedef VertexAttrList<Offset + Format::size, Rest...> Next;
+    static const unsigned int end = Next::end;
+
+    static inline void Pack(const float *source, unsigned char *out)
+    {
+        Format::Pack(source + VertexSourceOffset(First::semantic), out + Offset);
+        Next::Pack(source, out);
+    }
+
+    static inline void Setup(GLsizei stride, size_t base)
+    {
+        glVertexAttribPointer(First::semantic, Format::components, Format::type, Format::normalized, stride, (void *) (base + Offset));
+        glEnableVertexAttribArray(First::semantic);
+        Next::Setup(stride, base);
+    }
+};
+
+/* Stride, offsets, GL types and normalization of an interleaved vertex, all known at compile time.
+ * The stride is padded to 4 bytes, which keeps every attribute aligned. */
+template <typename... Attrs>
+struct VertexLayout
+{
+    typedef VertexAttrList<0, Attrs...> List;
+    static const unsigned int stride = (List::end + 3u) & ~3u;
+
+    /* Packs count source vertices (VERTEX_SOURCE_FLOATS each) into out, stride bytes each */
+    static void Pack(const float *source, size_t count, unsigned char *out)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            List::Pack(source + i * VERTEX_SOURCE_FLOATS, out + i * stride);
+            for (unsigned int pad = List::end; pad < stride; pad++)
+                out[i * stride + pad] = 0;
+        }
+    }
+
+    /* Points the attributes of the bound VAO at the bound vertex buffer, starting at base bytes */
+    static void Setup(size_t base)
+    {
+        List::Setup((GLsizei) stride, base);
+    }
+};
+
+// The layouts a mesh can be registered with
+typedef VertexLayout<Position<VertexFloat3>, Texcoord<VertexFloat2>, Normal<VertexFloat3> > VertexLayoutFull;
+typedef VertexLayout<Position<VertexFloat3>, Texcoord<VertexUnorm16x2>, Normal<VertexSnorm10x3> > VertexLayoutCompact;
+typedef VertexLayout<Position<VertexFloat3>, Texcoord<VertexHalf2>, Normal<VertexSnorm10x3> > VertexLayoutCompactTiled;
+
+enum EVertexFormat
+{
+    VERTEX_FORMAT_FULL,             // 32 bytes, the source floats as they are
+    VERTEX_FORMAT_COMPACT,          // 20 bytes, texture coordinates within [0, 1]
+    VERTEX_FORMAT_COMPACT_TILED,    // 20 bytes, texture coordinates that repeat
+    VERTEX_FORMAT_COUNT
+};
+
+// What the registry needs of a layout at run time, one indirect call per mesh rather than per vertex
+struct SVertexFormatInfo
+{
+    const char *name;
+    unsigned int stride;
+    void (*pack)(const float *source, size_t count, unsigned char *out);
+    void (*setup)(size_t base);
+};
+
+template <typename Layout>
+SVertexFormatInfo MakeVertexFormatInfo(const char *name)
+{
+    SVertexFormatInfo info = { name, Layout::stride, &Layout::Pack, &Layout::Setup };
+    return info;
+}
+
+const SVertexFormatInfo vertex_formats[VERTEX_FORMAT_COUNT] = {
+    MakeVertexFormatInfo<VertexLayoutFull>("full"),
+    MakeVertexFormatInfo<VertexLayoutCompact>("compact"),
+    MakeVertexFormatInfo<VertexLayoutCompactTiled>("compact tiled"),
+};
+
+/* The smallest layout that keeps the texture coordinates of the vertices exact enough */
+EVertexFormat SelectVertexFormat(const float *vertices, unsigned int vertex_count)
+{
+    for (unsigned int i = 0; i < vertex_count; i++)
+    {
+        const float *uv = vertices + (size_t) i * VERTEX_SOURCE_FLOATS + VertexSourceOffset(VERTEX_TEXCOORD);
+        if (uv[0] < 0.f || uv[0] > 1.f || uv[1] < 0.f || uv[1] > 1.f)
+            return VERTEX_FORMAT_COMPACT_TILED;
+    }
+    return VERTEX_FORMAT_COMPACT;
+}
@@ -3,10 +3,13 @@
 /* ---- OpenGL Headers ---- */
 #include <GLFW/glfw3.h>
 
+/* ---- Header Files ---- */
+#include "gl_state.h"
+
 void framebuffer_size_callback(GLFWwindow *window, int w, int h)
 {
     // Specify the viewport of OpenGL in the Window
-    glViewport(0, 0, w, h);
+    SetViewport(gl_state, 0, 0, w, h);
 }
 
 GLFWwindow *Create_Window(int w, int h, const char *title)
@@ -20,8 +23,8 @@ GLFWwindow *Create_Window(int w, int h, const char *title)
     // Tell GLFW we are using the CORE profile, meaning we only have the modern functions
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    // Multi Sampling
-    glfwWindowHint(GLFW_SAMPLES, 16);
+    // The window itself is single sampled, anti-aliasing is done offscreen (see antialiasing.h)
+    glfwWindowHint(GLFW_SAMPLES, 0);
 
     // Step 3 - Create a window
     GLFWwindow *window = glfwCreateWindow(w, h, title, NULL, NULL);
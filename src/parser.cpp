@@ -7,18 +7,37 @@
 #define fopen_s(pFile, filename, mode) ((*(pFile)) = fopen((filename), (mode))) == NULL
 #endif
 
+/* ---- Standard Library ---- */
+#include <chrono> // for the benchmark timings
+#include <thread> // for std::thread
+
 /* ---- Header Files ---- */
 #include "headers/parser.h"
 
+// one corner of a face with its OBJ indices resolved to 1-based, 0 when the corner has no texture or normal
+struct SFaceCorner
+{
+    unsigned int pos;
+    unsigned int tex;
+    unsigned int nor;
+};
+
 // temporary vectors to store the vertex contents of the .obj file
 std::vector<glm::vec3> temp_vec_v_positions;  // vertex positions (x, y, z)
 std::vector<glm::vec2> temp_vec_v_textures;   // vertex textures (u, v)
 std::vector<glm::vec3> temp_vec_v_normals;    // vertex normals (x, y, z)
 
+// smooth normals generated for each vertex position, for the corners that do not have a normal
+std::vector<glm::vec3> temp_vec_v_generated_normals;
+
 // indices from the face/triangle values
 std::vector<unsigned int> v_pos_indices; // indices for vertex positions
-std::vector<unsigned int> v_tex_indices; // indices for vertex textures
-std::vector<unsigned int> v_nor_indices; // indices for vertex normals
+std::vector<unsigned int> v_tex_indices; // indices for vertex textures, 0 for none
+std::vector<unsigned int> v_nor_indices; // indices for vertex normals, 0 for a generated normal
+
+// corners read without a normal, and faces that could not be used
+unsigned int missing_normals = 0;
+unsigned int skipped_faces = 0;
 
 // final vectors with vertex content in the correct order as per the face/triangle indices values
 std::vector<glm::vec3> v_positions; // all the positions in the correct order
@@ -27,16 +46,62 @@ std::vector<glm::vec3> v_normals; // all the normals in the correct order
 
 // output tuple
 std::pair<float *, unsigned int> parse_OBJ(const char *file_path)
+{
+    return parse_OBJ(file_path, nullptr);
+}
+
+// output tuple, also fills in the bounding volumes of the mesh when bounds is not null
+std::pair<float *, unsigned int> parse_OBJ(const char *file_path, SBounds *bounds)
 {
     process_file_OBJ(file_path);
+
+    // smooth normals for the files, or the corners, that came without any
+    if (missing_normals > 0)
+        generate_normals_OBJ(threads_OBJ());
+
     process_data_OBJ();
 
     unsigned int vertices_triangles = v_positions.size();
     printf("TRIANGLES: %u\n", vertices_triangles);
 
+    // the bounds have to be taken before create_vertices clears the vectors
+    if (bounds != nullptr)
+        *bounds = compute_bounds_OBJ();
+
     return std::make_pair(create_vertices(), vertices_triangles);
 }
 
+// threads the parallel stages use, one per core up to OBJ_MAX_THREADS
+unsigned int threads_OBJ()
+{
+    unsigned int cores = std::thread::hardware_concurrency();
+    if (cores == 0)
+        return 1;
+
+    return cores < OBJ_MAX_THREADS ? cores : OBJ_MAX_THREADS;
+}
+
+// runs fn over [0, count) split into one contiguous chunk for each thread, the calling thread takes the first
+void parallel_chunks_OBJ(unsigned int count, unsigned int threads, void (*fn)(unsigned int, unsigned int, void *), void *data)
+{
+    // small inputs are not worth starting threads for
+    if (threads <= 1 || count < threads * OBJ_MIN_CHUNK)
+    {
+        fn(0, count, data);
+        return;
+    }
+
+    unsigned int chunk = (count + threads - 1) / threads;
+    std::vector<std::thread> workers;
+    for (unsigned int begin = chunk; begin < count; begin += chunk)
+        workers.push_back(std::thread(fn, begin, begin + chunk < count ? begin + chunk : count, data));
+
+    fn(0, chunk, data);
+
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
 void process_file_OBJ(const char *file_path)
 {
     printf("INFO: Loading OBJ file: %s...\n", file_path);
@@ -52,104 +117,399 @@ void process_file_OBJ(const char *file_path)
         return;
     }
 
-    // PROCESSING THE FILE
-    // read the file, line by line, until the end
-    while(true)
+    process_stream_OBJ(obj_file);
+    fclose(obj_file);
+
+    if (skipped_faces > 0)
+        printf("ERROR: Skipped %u Faces with Missing or Out of Range Indices.\n", skipped_faces);
+
+    printf("INFO: Successfully Loaded File!\n");
+}
+
+// reads one line of any length into line, without the line break. returns false at the end of the file
+bool read_line_OBJ(FILE *obj_file, std::vector<char> &line)
+{
+    line.resize(256);
+    size_t length = 0;
+
+    while (fgets(line.data() + length, (int) (line.size() - length), obj_file) != nullptr)
     {
-        // assume that each line won’t exceed 128 chars
-        char line_buffer[128];
+        length += strlen(line.data() + length);
+        if (length > 0 && line[length - 1] == '\n')
+        {
+            line[--length] = '\0';
+            return true;
+        }
+
+        // the line did not fit, so grow the buffer and read the rest of it
+        if (length + 1 == line.size())
+            line.resize(line.size() * 2);
+        else
+            return true;
+    }
 
-        // read the first word of the line
-        int word_buffer = fscanf(obj_file, "%s", line_buffer);
+    return length > 0;
+}
+
+// turns an OBJ index into a 1-based index, negative indices count back from the last element read.
+// returns 0 when the index is missing or out of range
+unsigned int resolve_index_OBJ(long index, size_t count)
+{
+    if (index < 0)
+        index += (long) count + 1;
+
+    if (index <= 0 || (size_t) index > count)
+        return 0;
+
+    return (unsigned int) index;
+}
 
-        // exit loop when End Of File
-        if (word_buffer == EOF)
+// parses one face corner, v, v/vt, v//vn or v/vt/vn, and moves cursor past it. returns false if it is malformed
+bool parse_corner_OBJ(char *&cursor, SFaceCorner &corner)
+{
+    char *end;
+    corner.pos = resolve_index_OBJ(strtol(cursor, &end, 10), temp_vec_v_positions.size());
+    if (end == cursor || corner.pos == 0)
+        return false;
+
+    corner.tex = 0;
+    corner.nor = 0;
+    cursor = end;
+
+    if (*cursor == '/')
+    {
+        cursor++;
+
+        // v//vn leaves the texture out
+        if (*cursor != '/')
         {
-            break;
+            corner.tex = resolve_index_OBJ(strtol(cursor, &end, 10), temp_vec_v_textures.size());
+            if (end == cursor || corner.tex == 0)
+                return false;
+            cursor = end;
         }
 
-        // else: parse the line
+        if (*cursor == '/')
+        {
+            cursor++;
+            corner.nor = resolve_index_OBJ(strtol(cursor, &end, 10), temp_vec_v_normals.size());
+            if (end == cursor || corner.nor == 0)
+                return false;
+            cursor = end;
+        }
+    }
+
+    // the corner has to end at a separator
+    return *cursor == '\0' || *cursor == ' ' || *cursor == '\t' || *cursor == '\r';
+}
+
+void add_triangle_OBJ(const SFaceCorner &a, const SFaceCorner &b, const SFaceCorner &c)
+{
+    const SFaceCorner *corners[3] = { &a, &b, &c };
+    for (int k = 0; k < 3; k++)
+    {
+        v_pos_indices.push_back(corners[k]->pos);
+        v_tex_indices.push_back(corners[k]->tex);
+        v_nor_indices.push_back(corners[k]->nor);
+
+        if (corners[k]->nor == 0)
+            missing_normals++;
+    }
+}
+
+// twice the signed area of the 2D triangle abc, positive when it winds counter clockwise
+float signed_area_OBJ(const glm::vec2 &a, const glm::vec2 &b, const glm::vec2 &c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+}
+
+// splits a polygon into triangles: a fan when it is convex, ear clipping when it is not
+void triangulate_face_OBJ(const std::vector<SFaceCorner> &corners)
+{
+    unsigned int n = corners.size();
+    if (n == 3)
+    {
+        add_triangle_OBJ(corners[0], corners[1], corners[2]);
+        return;
+    }
+
+    // Newell's normal of the polygon, its largest axis is dropped to flatten the polygon into 2D
+    glm::vec3 normal(0.f, 0.f, 0.f);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const glm::vec3 &p = temp_vec_v_positions[corners[i].pos - 1];
+        const glm::vec3 &q = temp_vec_v_positions[corners[(i + 1) % n].pos - 1];
+        normal.x += (p.y - q.y) * (p.z + q.z);
+        normal.y += (p.z - q.z) * (p.x + q.x);
+        normal.z += (p.x - q.x) * (p.y + q.y);
+    }
+
+    int drop = 2;
+    if (fabsf(normal.x) > fabsf(normal.y) && fabsf(normal.x) > fabsf(normal.z))
+        drop = 0;
+    else if (fabsf(normal.y) > fabsf(normal.z))
+        drop = 1;
+
+    // projected so that the polygon winds counter clockwise
+    float flip = normal[drop] < 0.f ? -1.f : 1.f;
+    std::vector<glm::vec2> points(n);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        const glm::vec3 &p = temp_vec_v_positions[corners[i].pos - 1];
+        points[i] = glm::vec2(p[(drop + 1) % 3], p[(drop + 2) % 3] * flip);
+    }
+
+    bool convex = true;
+    for (unsigned int i = 0; i < n && convex; i++)
+        convex = signed_area_OBJ(points[i], points[(i + 1) % n], points[(i + 2) % n]) >= 0.f;
+
+    if (convex)
+    {
+        for (unsigned int i = 1; i + 1 < n; i++)
+            add_triangle_OBJ(corners[0], corners[i], corners[i + 1]);
+        return;
+    }
+
+    // ear clipping: cut off a convex corner whose triangle holds no other corner, until a triangle is left
+    std::vector<unsigned int> remaining(n);
+    for (unsigned int i = 0; i < n; i++)
+        remaining[i] = i;
+
+    while (remaining.size() > 3)
+    {
+        unsigned int m = remaining.size();
+        bool clipped = false;
+
+        for (unsigned int i = 0; i < m && !clipped; i++)
+        {
+            unsigned int a = remaining[(i + m - 1) % m], b = remaining[i], c = remaining[(i + 1) % m];
+            if (signed_area_OBJ(points[a], points[b], points[c]) <= 0.f)
+                continue;
+
+            bool empty = true;
+            for (unsigned int j = 0; j < m && empty; j++)
+            {
+                unsigned int p = remaining[j];
+                if (p == a || p == b || p == c)
+                    continue;
+
+                empty = signed_area_OBJ(points[a], points[b], points[p]) < 0.f ||
+                        signed_area_OBJ(points[b], points[c], points[p]) < 0.f ||
+                        signed_area_OBJ(points[c], points[a], points[p]) < 0.f;
+            }
+
+            if (empty)
+            {
+                add_triangle_OBJ(corners[a], corners[b], corners[c]);
+                remaining.erase(remaining.begin() + i);
+                clipped = true;
+            }
+        }
+
+        // self intersecting or degenerate polygons have no ear left, the rest becomes a fan
+        if (!clipped)
+            break;
+    }
+
+    for (unsigned int i = 1; i + 1 < remaining.size(); i++)
+        add_triangle_OBJ(corners[remaining[0]], corners[remaining[i]], corners[remaining[i + 1]]);
+}
+
+void process_stream_OBJ(FILE *obj_file)
+{
+    missing_normals = 0;
+    skipped_faces = 0;
+
+    std::vector<char> line;
+    std::vector<SFaceCorner> corners;
+
+    // PROCESSING THE FILE
+    // read the file, line by line, until the end
+    while (read_line_OBJ(obj_file, line))
+    {
+        char *cursor = line.data();
+        while (*cursor == ' ' || *cursor == '\t')
+            cursor++;
+
         // deal with the vertices first (v, vt, vn) values, and add them to respective temp vectors
+        // every other statement (comments, groups, materials, smoothing groups) is ignored
 
         // if the first word of the line is “v”, then the rest has to be 3 floats for the vertex position
         // so create a glm::vec3 out of them, and add it to the temp vector.
-        if (strcmp(line_buffer, "v") == 0)
+        if (cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == '\t'))
         {
             glm::vec3 vertex_pos;
-            fscanf(obj_file, "%f %f %f\n", &vertex_pos.x, &vertex_pos.y, &vertex_pos.z);
+            cursor += 2;
+            vertex_pos.x = strtof(cursor, &cursor);
+            vertex_pos.y = strtof(cursor, &cursor);
+            vertex_pos.z = strtof(cursor, &cursor);
 
             temp_vec_v_positions.push_back(vertex_pos);
         }
-        // if it’s not a “v” but a “vt”, then the rest has to be 2 floats for the vertex texture
+        // if it’s a “vt”, then the rest has to be 2 floats for the vertex texture
         // so create a glm::vec2 out of them, and add it to the temp vector.
-        else if(strcmp(line_buffer, "vt") == 0)
+        else if (cursor[0] == 'v' && cursor[1] == 't' && (cursor[2] == ' ' || cursor[2] == '\t'))
         {
             glm::vec2 vertex_tex;
-            fscanf(obj_file, "%f %f\n", &vertex_tex.x, &vertex_tex.y);
+            cursor += 3;
+            vertex_tex.x = strtof(cursor, &cursor);
+            vertex_tex.y = strtof(cursor, &cursor);
 
             temp_vec_v_textures.push_back(vertex_tex);
         }
-        // if it’s not a “v” or a “vt”, it must be a "vn", and the rest has to be 3 floats for the vertex normals
+        // if it’s a "vn", the rest has to be 3 floats for the vertex normals
         // so create a glm::vec3 out of them, and add it to the temp vector.
-        else if(strcmp(line_buffer, "vn") == 0)
+        else if (cursor[0] == 'v' && cursor[1] == 'n' && (cursor[2] == ' ' || cursor[2] == '\t'))
         {
             glm::vec3 vertex_nor;
-            fscanf(obj_file, "%f %f %f\n", &vertex_nor.x, &vertex_nor.y, &vertex_nor.z);
+            cursor += 3;
+            vertex_nor.x = strtof(cursor, &cursor);
+            vertex_nor.y = strtof(cursor, &cursor);
+            vertex_nor.z = strtof(cursor, &cursor);
 
             temp_vec_v_normals.push_back(vertex_nor);
         }
-        // now the “f”, which is more difficult.
-        // code is in fact very similar to the previous one, except there is more data to read.
-
-        // so what we do here is simply change the “shape” of the data.
-        // from a string, we construct a set of std::vectors.
-        // But it’s not enough, we have to put this into a form that OpenGL understands.
-        // By removing the indexes and having plain glm::vec3 instead.
-        // This operation is called indexing.
-        else if (strcmp(line_buffer, "f") == 0)
+        // now the “f”, a polygon of three or more corners in any of the forms v, v/vt, v//vn or v/vt/vn.
+        // it is triangulated here and its indices are kept, process_data_OBJ turns them into plain
+        // vertices later on. This operation is called indexing.
+        else if (cursor[0] == 'f' && (cursor[1] == ' ' || cursor[1] == '\t'))
+        {
+            corners.clear();
+            cursor += 2;
+
+            bool valid = true;
+            while (valid)
+            {
+                while (*cursor == ' ' || *cursor == '\t' || *cursor == '\r')
+                    cursor++;
+                if (*cursor == '\0')
+                    break;
+
+                SFaceCorner corner;
+                valid = parse_corner_OBJ(cursor, corner);
+                corners.push_back(corner);
+            }
+
+            if (!valid || corners.size() < 3)
+            {
+                skipped_faces++;
+                continue;
+            }
+
+            triangulate_face_OBJ(corners);
+        }
+    }
+}
+
+// angle weighted normals of the corners of triangles [begin, end), written to corner_normals
+void corner_normals_OBJ(unsigned int begin, unsigned int end, void *data)
+{
+    glm::vec3 *corner_normals = (glm::vec3 *) data;
+
+    for (unsigned int t = begin; t < end; t++)
+    {
+        glm::vec3 p[3];
+        for (int k = 0; k < 3; k++)
+            p[k] = temp_vec_v_positions[v_pos_indices[t * 3 + k] - 1];
+
+        // face normal from the cross product of two edges
+        glm::vec3 e1(p[1].x - p[0].x, p[1].y - p[0].y, p[1].z - p[0].z);
+        glm::vec3 e2(p[2].x - p[0].x, p[2].y - p[0].y, p[2].z - p[0].z);
+        glm::vec3 face(e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x);
+        float face_length = sqrtf(face.x * face.x + face.y * face.y + face.z * face.z);
+
+        for (int k = 0; k < 3; k++)
         {
-            //std::string vertex1, vertex2, vertex3;
-            unsigned int v_pos_index[3], v_tex_index[3], v_nor_index[3];
-
-            int matches = fscanf(
-                    obj_file,
-                    "%d/%d/%d %d/%d/%d %d/%d/%d\n",
-                    &v_pos_index[0], &v_tex_index[0], &v_nor_index[0],
-                    &v_pos_index[1], &v_tex_index[1], &v_nor_index[1],
-                    &v_pos_index[2], &v_tex_index[2], &v_nor_index[2]
-            );
-
-            if (matches != 9)
+            // the angle of the triangle at this corner, so a vertex shared by many thin triangles is not
+            // pulled towards them
+            const glm::vec3 &o = p[k], &a = p[(k + 1) % 3], &b = p[(k + 2) % 3];
+            glm::vec3 u(a.x - o.x, a.y - o.y, a.z - o.z);
+            glm::vec3 v(b.x - o.x, b.y - o.y, b.z - o.z);
+            float lengths = sqrtf((u.x * u.x + u.y * u.y + u.z * u.z) * (v.x * v.x + v.y * v.y + v.z * v.z));
+
+            float weight = 0.f;
+            if (face_length > 0.f && lengths > 0.f)
             {
-                printf("ERROR: File Cannot be Parsed.\n");
-                printf("INFO: Ensure Only Triangles Are Used in OBJ File.\n");
-                return;
+                float cosine = (u.x * v.x + u.y * v.y + u.z * v.z) / lengths;
+                weight = acosf(cosine < -1.f ? -1.f : (cosine > 1.f ? 1.f : cosine)) / face_length;
             }
 
-            // Vertex Positions
-            v_pos_indices.push_back(v_pos_index[0]);
-            v_pos_indices.push_back(v_pos_index[1]);
-            v_pos_indices.push_back(v_pos_index[2]);
+            corner_normals[t * 3 + k] = glm::vec3(face.x * weight, face.y * weight, face.z * weight);
+        }
+    }
+}
 
-            // Vertex Textures
-            v_tex_indices.push_back(v_tex_index[0]);
-            v_tex_indices.push_back(v_tex_index[1]);
-            v_tex_indices.push_back(v_tex_index[2]);
+// the corners around each position, built once so positions can be summed in parallel
+struct SNormalGather
+{
+    const glm::vec3 *corner_normals;
+    std::vector<unsigned int> start;    // corners of position i are corners[start[i], start[i + 1])
+    std::vector<unsigned int> corners;
+};
+
+// sums and normalizes the corner normals of positions [begin, end) in the order the corners were read,
+// so the result does not depend on the number of threads
+void gather_normals_OBJ(unsigned int begin, unsigned int end, void *data)
+{
+    SNormalGather &gather = *(SNormalGather *) data;
 
-            // Vertex Normals
-            v_nor_indices.push_back(v_nor_index[0]);
-            v_nor_indices.push_back(v_nor_index[1]);
-            v_nor_indices.push_back(v_nor_index[2]);
+    for (unsigned int i = begin; i < end; i++)
+    {
+        glm::vec3 sum(0.f, 0.f, 0.f);
+        for (unsigned int c = gather.start[i]; c < gather.start[i + 1]; c++)
+        {
+            const glm::vec3 &n = gather.corner_normals[gather.corners[c]];
+            sum.x += n.x;
+            sum.y += n.y;
+            sum.z += n.z;
         }
+
+        // positions that only belong to degenerate triangles, or none, point up
+        float length = sqrtf(sum.x * sum.x + sum.y * sum.y + sum.z * sum.z);
+        if (length > 0.f)
+            temp_vec_v_generated_normals[i] = glm::vec3(sum.x / length, sum.y / length, sum.z / length);
+        else
+            temp_vec_v_generated_normals[i] = glm::vec3(0.f, 1.f, 0.f);
     }
+}
 
-    printf("INFO: Successfully Loaded File!\n");
+// smooth normal of every position from the angle weighted normals of the triangles around it
+void generate_normals_OBJ(unsigned int threads)
+{
+    unsigned int triangle_count = v_pos_indices.size() / 3;
+    unsigned int position_count = temp_vec_v_positions.size();
+
+    std::vector<glm::vec3> corner_normals((size_t) triangle_count * 3);
+    parallel_chunks_OBJ(triangle_count, threads, corner_normals_OBJ, corner_normals.data());
+
+    // counting sort of the corners by position
+    SNormalGather gather;
+    gather.corner_normals = corner_normals.data();
+    gather.start.assign(position_count + 1, 0);
+    gather.corners.resize(v_pos_indices.size());
+
+    for (unsigned int c = 0; c < v_pos_indices.size(); c++)
+        gather.start[v_pos_indices[c]]++;
+    for (unsigned int i = 0; i < position_count; i++)
+        gather.start[i + 1] += gather.start[i];
+
+    std::vector<unsigned int> cursor(gather.start.begin(), gather.start.end() - 1);
+    for (unsigned int c = 0; c < v_pos_indices.size(); c++)
+        gather.corners[cursor[v_pos_indices[c] - 1]++] = c;
+
+    temp_vec_v_generated_normals.resize(position_count);
+    parallel_chunks_OBJ(position_count, threads, gather_normals_OBJ, &gather);
+
+    printf("INFO: Generated Smooth Normals for %u Corners on %u Threads!\n", missing_normals, threads);
 }
 
 void process_data_OBJ()
 {
     // PROCESSING THE DATA
     // Iterate through each vertex (each v/vt/vn) of each triangle (each face line with a “f”)
+    v_positions.reserve(v_pos_indices.size());
+    v_textures.reserve(v_tex_indices.size());
+    v_normals.reserve(v_nor_indices.size());
 
     // For each vertex position of each triangle
     for(unsigned int i = 0; i < v_pos_indices.size(); i++)
@@ -165,20 +525,20 @@ void process_data_OBJ()
         v_positions.push_back(v);
     }
 
-    // For each vertex texture of each triangle
+    // For each vertex texture of each triangle, corners without one are mapped to (0, 0)
     for(unsigned int i = 0; i < v_tex_indices.size(); i++)
     {
         unsigned int v_tex_index = v_tex_indices[i];
-        glm::vec2 vt = temp_vec_v_textures[v_tex_index - 1];
+        glm::vec2 vt = v_tex_index > 0 ? temp_vec_v_textures[v_tex_index - 1] : glm::vec2(0.f, 0.f);
 
         v_textures.push_back(vt);
     }
 
-    // For each vertex normal of each triangle
+    // For each vertex normal of each triangle, corners without one take the generated normal of their position
     for(unsigned int i = 0; i < v_nor_indices.size(); i++)
     {
         unsigned int v_nor_index = v_nor_indices[i];
-        glm::vec3 vn = temp_vec_v_normals[v_nor_index - 1];
+        glm::vec3 vn = v_nor_index > 0 ? temp_vec_v_normals[v_nor_index - 1] : temp_vec_v_generated_normals[v_pos_indices[i] - 1];
 
         v_normals.push_back(vn);
     }
@@ -186,32 +546,71 @@ void process_data_OBJ()
     printf("INFO: Successfully Parsed Data!\n");
 }
 
-float *create_vertices()
+SBounds compute_bounds_OBJ()
 {
-    // Size of v vectors are number of "f" lines * 3, and contain the 3 vectors of the face
+    SBounds bounds;
+    bounds.min = glm::vec3(0.f, 0.f, 0.f);
+    bounds.max = glm::vec3(0.f, 0.f, 0.f);
+    bounds.center = glm::vec3(0.f, 0.f, 0.f);
+    bounds.radius = 0.f;
 
-    float *vertices = (float *) malloc((sizeof(float)) * (v_positions.size() * 8));
+    if (v_positions.empty())
+        return bounds;
+
+    // axis aligned box over every vertex position
+    bounds.min = v_positions[0];
+    bounds.max = v_positions[0];
 
-    int i = 0;
-    while (i < v_positions.size() * 8)
+    for (unsigned int i = 1; i < v_positions.size(); i++)
     {
         for (int j = 0; j < 3; j++)
         {
-            vertices[i] = v_positions[i / 8][j];
-            ++i;
-        }
-        for (int j = 0; j < 2; j++)
-        {
-            vertices[i] = v_textures[i / 8][j];
-            ++i;
-        }
-        for (int j = 0; j < 3; j++)
-        {
-            vertices[i] = v_normals[i / 8][j];
-            ++i;
+            if (v_positions[i][j] < bounds.min[j])
+                bounds.min[j] = v_positions[i][j];
+            if (v_positions[i][j] > bounds.max[j])
+                bounds.max[j] = v_positions[i][j];
         }
     }
 
+    // sphere around the box centre, the radius is the furthest vertex rather than the box corner
+    for (int j = 0; j < 3; j++)
+        bounds.center[j] = 0.5f * (bounds.min[j] + bounds.max[j]);
+
+    float radius_squared = 0.f;
+    for (unsigned int i = 0; i < v_positions.size(); i++)
+    {
+        float dx = v_positions[i].x - bounds.center.x;
+        float dy = v_positions[i].y - bounds.center.y;
+        float dz = v_positions[i].z - bounds.center.z;
+        float d = dx * dx + dy * dy + dz * dz;
+
+        if (d > radius_squared)
+            radius_squared = d;
+    }
+    bounds.radius = sqrtf(radius_squared);
+
+    return bounds;
+}
+
+float *create_vertices()
+{
+    // Size of v vectors are number of "f" lines * 3, and contain the 3 vectors of the face
+
+    float *vertices = (float *) malloc((sizeof(float)) * (v_positions.size() * 8));
+
+    for (size_t v = 0; v < v_positions.size(); v++)
+    {
+        float *vertex = vertices + v * 8;
+        vertex[0] = v_positions[v].x;
+        vertex[1] = v_positions[v].y;
+        vertex[2] = v_positions[v].z;
+        vertex[3] = v_textures[v].x;
+        vertex[4] = v_textures[v].y;
+        vertex[5] = v_normals[v].x;
+        vertex[6] = v_normals[v].y;
+        vertex[7] = v_normals[v].z;
+    }
+
     printf("INFO: Successfully Created Vertices Array!\n");
     printf("INFO: ------------------------------------\n");
 
@@ -234,6 +633,7 @@ float *create_vertices()
     temp_vec_v_positions.clear();
     temp_vec_v_textures.clear();
     temp_vec_v_normals.clear();
+    temp_vec_v_generated_normals.clear();
 
     v_pos_indices.clear();
     v_tex_indices.clear();
@@ -246,3 +646,131 @@ float *create_vertices()
     return vertices;
 }
 
+// true for the quads that start an L shaped polygon over themselves, their right and their lower neighbour
+static bool benchmark_corner_OBJ(unsigned int x, unsigned int z, unsigned int width)
+{
+    return z % 2 == 0 && x % 16 == 0 && x + 1 < width && z + 1 < width;
+}
+
+// writes a width x width grid of quads without normals, counter clockwise seen from above: even rows as
+// plain v faces with positive indices, odd rows as v/vt faces with negative indices, and every 16th quad of
+// an even row as the corner of a concave eight sided L that needs ear clipping
+static unsigned int write_benchmark_OBJ(FILE *obj_file, unsigned int width)
+{
+    for (unsigned int z = 0; z <= width; z++)
+        for (unsigned int x = 0; x <= width; x++)
+        {
+            float fx = (float) x / (float) width, fz = (float) z / (float) width;
+            fprintf(obj_file, "v %f %f %f\n", fx * 100.f - 50.f, 4.f * sinf(fx * 17.f) * cosf(fz * 13.f), fz * 100.f - 50.f);
+            fprintf(obj_file, "vt %f %f\n", fx, fz);
+        }
+
+    long count = (long) (width + 1) * (width + 1);
+    long row = (long) width + 1;
+    unsigned int triangles = 0;
+    for (unsigned int z = 0; z < width; z++)
+        for (unsigned int x = 0; x < width; x++)
+        {
+            // covered by the L of the row above
+            if (z > 0 && benchmark_corner_OBJ(x, z - 1, width))
+                continue;
+
+            long a = (long) z * row + x + 1, b = a + 1, c = a + row, d = c + 1;
+            if (benchmark_corner_OBJ(x, z, width))
+            {
+                long e = b + 1, f = d + 1, g = d + row, h = c + row;
+                fprintf(obj_file, "f %ld %ld %ld %ld %ld %ld %ld %ld\n", a, c, h, g, d, f, e, b);
+                triangles += 6;
+                x++;
+                continue;
+            }
+
+            if (z % 2 == 1)
+            {
+                a -= count + 1; b -= count + 1; c -= count + 1; d -= count + 1;
+                fprintf(obj_file, "f %ld/%ld %ld/%ld %ld/%ld %ld/%ld\n", a, a, c, c, d, d, b, b);
+            }
+            else
+                fprintf(obj_file, "f %ld %ld %ld %ld\n", a, c, d, b);
+            triangles += 2;
+        }
+
+    return triangles;
+}
+
+// Benchmark: about triangle_count triangles of quads and n-gons without normals, timing each stage of
+// the pipeline, and the normal generation on one and on every thread
+int benchmark_OBJ(unsigned int triangle_count)
+{
+    typedef std::chrono::high_resolution_clock clock;
+    unsigned int width = (unsigned int) sqrtf((float) triangle_count * 0.5f);
+    if (width < 2)
+        width = 2;
+
+    FILE *obj_file = tmpfile();
+    if (obj_file == nullptr)
+    {
+        printf("ERROR: Cannot Create a Temporary File.\n");
+        return -1;
+    }
+
+    clock::time_point start = clock::now();
+    unsigned int written = write_benchmark_OBJ(obj_file, width);
+    float write_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    long file_size = ftell(obj_file);
+    rewind(obj_file);
+
+    start = clock::now();
+    process_stream_OBJ(obj_file);
+    float read_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    fclose(obj_file);
+
+    start = clock::now();
+    generate_normals_OBJ(1);
+    float single_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    std::vector<glm::vec3> single_normals = temp_vec_v_generated_normals;
+
+    unsigned int threads = threads_OBJ();
+    start = clock::now();
+    generate_normals_OBJ(threads);
+    float multi_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+
+    // the same normals whatever the number of threads, and the terrain's normals all point up
+    bool same = memcmp(single_normals.data(), temp_vec_v_generated_normals.data(), single_normals.size() * sizeof(glm::vec3)) == 0;
+    unsigned int down = 0;
+    for (unsigned int i = 0; i < temp_vec_v_generated_normals.size(); i++)
+        if (temp_vec_v_generated_normals[i].y <= 0.f)
+            down++;
+
+    // the triangles have to cover the 100 x 100 terrain once, all wound the same way
+    unsigned int triangles = v_pos_indices.size() / 3;
+    double area = 0.0, flipped = 0.0;
+    for (unsigned int t = 0; t < triangles; t++)
+    {
+        const glm::vec3 &p0 = temp_vec_v_positions[v_pos_indices[t * 3] - 1];
+        const glm::vec3 &p1 = temp_vec_v_positions[v_pos_indices[t * 3 + 1] - 1];
+        const glm::vec3 &p2 = temp_vec_v_positions[v_pos_indices[t * 3 + 2] - 1];
+        double twice = (double) (p1.z - p0.z) * (p2.x - p0.x) - (double) (p2.z - p0.z) * (p1.x - p0.x);
+        area += 0.5 * twice;
+        if (twice < 0.0)
+            flipped -= 0.5 * twice;
+    }
+
+    start = clock::now();
+    process_data_OBJ();
+    float *vertices = create_vertices();
+    float vertices_ms = std::chrono::duration<float, std::milli>(clock::now() - start).count();
+    free(vertices);
+
+    printf("INFO: OBJ Benchmark - %u triangles (%u written) from %.1f MB, %u faces skipped\n",
+           triangles, written, (double) file_size / (1024.0 * 1024.0), skipped_faces);
+    printf("INFO:   write:    %.1f ms\n", write_ms);
+    printf("INFO:   read:     %.1f ms, %.2f Mtriangles/s parsed and triangulated\n", read_ms, (float) triangles / (read_ms * 1000.f));
+    printf("INFO:   normals:  %.1f ms on 1 thread, %.1f ms on %u threads, %s, %u facing down\n",
+           single_ms, multi_ms, threads, same ? "identical" : "DIFFERENT", down);
+    printf("INFO:   vertices: %.1f ms\n", vertices_ms);
+    printf("INFO:   check:    %.2f of 10000 units covered, %.2f by flipped triangles\n", area, flipped);
+
+    bool covered = fabs(area - 10000.0) < 1.0 && flipped == 0.0;
+    return same && covered && down == 0 && triangles == written && skipped_faces == 0 ? 0 : -1;
+}
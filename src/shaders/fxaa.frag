@@ -0,0 +1,57 @@
+#version 330 core
+
+in vec2 uv;
+
+// The scene was rendered into the bottom left region of the texture, region is its size in texture coordinates
+uniform sampler2D Source;
+uniform vec2 region;
+uniform vec2 texel;
+
+out vec4 fragColour;
+
+#define FXAA_REDUCE_MIN (1.f / 128.f)
+#define FXAA_REDUCE_MUL (1.f / 8.f)
+#define FXAA_SPAN_MAX   8.f
+
+float luma(vec3 colour)
+{
+    return dot(colour, vec3(0.299f, 0.587f, 0.114f));
+}
+
+vec3 tap(vec2 p)
+{
+    return texture(Source, clamp(p, texel * 0.5f, region - texel * 0.5f)).rgb;
+}
+
+void main()
+{
+    vec2 p = uv * region;
+
+    vec3 rgb_nw = tap(p + vec2(-1.f, -1.f) * texel);
+    vec3 rgb_ne = tap(p + vec2(1.f, -1.f) * texel);
+    vec3 rgb_sw = tap(p + vec2(-1.f, 1.f) * texel);
+    vec3 rgb_se = tap(p + vec2(1.f, 1.f) * texel);
+    vec3 rgb_m = tap(p);
+
+    float luma_nw = luma(rgb_nw);
+    float luma_ne = luma(rgb_ne);
+    float luma_sw = luma(rgb_sw);
+    float luma_se = luma(rgb_se);
+    float luma_m = luma(rgb_m);
+
+    float luma_min = min(luma_m, min(min(luma_nw, luma_ne), min(luma_sw, luma_se)));
+    float luma_max = max(luma_m, max(max(luma_nw, luma_ne), max(luma_sw, luma_se)));
+
+    // The edge runs perpendicular to the luma gradient, blur along it
+    vec2 dir = vec2(-((luma_nw + luma_ne) - (luma_sw + luma_se)), (luma_nw + luma_sw) - (luma_ne + luma_se));
+    float dir_reduce = max((luma_nw + luma_ne + luma_sw + luma_se) * (0.25f * FXAA_REDUCE_MUL), FXAA_REDUCE_MIN);
+    float rcp_dir_min = 1.f / (min(abs(dir.x), abs(dir.y)) + dir_reduce);
+    dir = clamp(dir * rcp_dir_min, vec2(-FXAA_SPAN_MAX), vec2(FXAA_SPAN_MAX)) * texel;
+
+    vec3 rgb_a = 0.5f * (tap(p + dir * (1.f / 3.f - 0.5f)) + tap(p + dir * (2.f / 3.f - 0.5f)));
+    vec3 rgb_b = rgb_a * 0.5f + 0.25f * (tap(p - dir * 0.5f) + tap(p + dir * 0.5f));
+
+    // The wider blur is rejected when it picked up colours from outside the local range
+    float luma_b = luma(rgb_b);
+    fragColour = vec4((luma_b < luma_min || luma_b > luma_max) ? rgb_a : rgb_b, 1.f);
+}
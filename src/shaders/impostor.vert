@@ -0,0 +1,52 @@
+#version 330 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec2 aTex;
+
+// One model per instance of the draw, RQ_MAX_INSTANCES in render_queue.h. Each one maps the
+// [-1, 1] box of the quad onto the bounding sphere of an instance.
+layout(std140) uniform ObjectData
+{
+    mat4 models[64];
+};
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 camPos;
+
+// Yaw views, pitch views and the highest pitch (radians) the atlas was captured with
+uniform vec3 impostorViews;
+
+out vec2 tex;
+out vec3 FragPos;
+
+// Axes of the quad, which stand in for those of the camera the normals were captured with
+out vec3 quadRight;
+out vec3 quadUp;
+out vec3 quadForward;
+
+void main()
+{
+    mat4 model = models[gl_InstanceID];
+    vec3 center = model[3].xyz;
+    float size = length(model[0].xyz);
+
+    // Face the camera and stay upright, unless the camera is straight above
+    quadForward = normalize(camPos - center);
+    vec3 right = cross(vec3(0.f, 1.f, 0.f), quadForward);
+    quadRight = length(right) > 1e-4 ? normalize(right) : vec3(1.f, 0.f, 0.f);
+    quadUp = cross(quadForward, quadRight);
+
+    // The captured view closest to the direction of the camera in object space
+    vec3 local = normalize(transpose(mat3(model)) * quadForward);
+    float yaw = atan(local.x, local.z);
+    float pitch = asin(clamp(local.y, -1.f, 1.f));
+    float column = mod(floor(yaw / 6.2831853 * impostorViews.x + 0.5), impostorViews.x);
+    float row = clamp(floor(pitch / impostorViews.z * (impostorViews.y - 1.f) + 0.5), 0.f, impostorViews.y - 1.f);
+
+    // Colours fill the lower half of the atlas, normals the upper half
+    tex = vec2((column + aTex.x) / impostorViews.x, (row + aTex.y) / (2.f * impostorViews.y));
+
+    FragPos = center + (quadRight * aPos.x + quadUp * aPos.y) * size;
+    gl_Position = projection * view * vec4(FragPos, 1.f);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+in vec2 tex;
+in vec3 nor;
+in vec3 FragPos;
+
+uniform sampler2D Texture;
+uniform mat4 view;
+
+// 0 captures the texture colour, 1 the normal in the space of the capture camera
+uniform int bakeNormals;
+
+out vec4 fragColour;
+
+void main()
+{
+    // Alpha marks the texels the mesh covers, the rest of the atlas stays clear
+    if (bakeNormals != 0)
+        fragColour = vec4(normalize(mat3(view) * normalize(nor)) * 0.5 + 0.5, 1.f);
+    else
+        fragColour = vec4(texture(Texture, tex).rgb, 1.f);
+}
@@ -0,0 +1,34 @@
+#version 330 core
+
+in vec2 uv;
+
+// The scene was rendered into the bottom left region of the texture, region is its size in texture coordinates
+uniform sampler2D Source;
+uniform vec2 region;
+uniform vec2 texel;
+uniform float sharpness;
+
+out vec4 fragColour;
+
+void main()
+{
+    // Keep the taps inside the rendered region so nothing from the previous, larger frame bleeds in
+    vec2 lo = texel * 0.5f;
+    vec2 hi = region - texel * 0.5f;
+    vec2 p = clamp(uv * region, lo, hi);
+
+    vec3 c = texture(Source, p).rgb;
+    vec3 n = texture(Source, clamp(p + vec2(0.f, texel.y), lo, hi)).rgb;
+    vec3 s = texture(Source, clamp(p - vec2(0.f, texel.y), lo, hi)).rgb;
+    vec3 e = texture(Source, clamp(p + vec2(texel.x, 0.f), lo, hi)).rgb;
+    vec3 w = texture(Source, clamp(p - vec2(texel.x, 0.f), lo, hi)).rgb;
+
+    // Contrast adaptive sharpening: the negative lobe shrinks where the neighbourhood is already
+    // close to black or white, so edges get crisper without ringing
+    vec3 lowest = min(c, min(min(n, s), min(e, w)));
+    vec3 highest = max(c, max(max(n, s), max(e, w)));
+    vec3 amount = sqrt(clamp(min(lowest, 1.f - highest) / max(highest, 1e-4f), 0.f, 1.f));
+    vec3 weight = -amount * (0.2f * sharpness);
+
+    fragColour = vec4(clamp((c + (n + s + e + w) * weight) / (1.f + 4.f * weight), 0.f, 1.f), 1.f);
+}
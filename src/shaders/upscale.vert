@@ -0,0 +1,11 @@
+#version 330 core
+
+// Full screen triangle generated from the vertex id, no vertex buffer is bound
+out vec2 uv;
+
+void main()
+{
+    vec2 corner = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    uv = corner;
+    gl_Position = vec4(corner * 2.f - 1.f, 0.f, 1.f);
+}
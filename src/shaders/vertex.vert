@@ -4,7 +4,12 @@ layout(location = 0) in vec3 aPos;
 layout(location = 1) in vec2 aTex;
 layout(location = 2) in vec3 aNor;
 
-uniform mat4 model;
+// Streamed per draw through a ring buffer, see stream_buffer.h
+layout(std140) uniform ObjectData
+{
+    mat4 model;
+};
+
 uniform mat4 view;
 uniform mat4 projection;
 